@@ -28,10 +28,21 @@
 #include "StdAfx.h"
 #include "AmiraVectorField2D.h"
 #include "amirareader.h"
+#include <math.h>
+
+#define AVF_STAGNATION_DIST	1e-3f	//RK4 steps shorter than this (in cells) next to a dead sample terminate the integration
 
 CAmiraVectorField2D::CAmiraVectorField2D()
 {
-	m_pFileRead = new CAmiraReader();
+	m_pFileRead				= new CAmiraReader();
+	m_nReferenceFrame		= RF_LAB;
+	m_pRegionVelocities		= nullptr;
+	m_pRegionVelocityReady	= nullptr;
+	m_ppOccupancy			= nullptr;
+	m_nSubSteps				= 1;
+	m_nCurrSubStep			= 0;
+	m_nTemporalInterpolation= TI_LINEAR;
+	m_fFramePyramidTime		= -1.0f;
 }
 
 bool CAmiraVectorField2D::LoadAmiraFile(const char* strFileName)
@@ -43,6 +54,9 @@ bool CAmiraVectorField2D::LoadAmiraFile(const char* strFileName)
 CAmiraVectorField2D::~CAmiraVectorField2D(void)
 {
 	delete m_pFileRead;
+	delete [] m_pRegionVelocities;
+	delete [] m_pRegionVelocityReady;
+	_freeOccupancy();
 }
 
 //do tri-linear interpolation
@@ -68,7 +82,7 @@ CVector2D CAmiraVectorField2D::GetVectorAt(float dx, float dy) const
 	static float x, y;
 	_getGridCoordinates(dx, dy, x, y);
 
-	return _getVectorAt(x, y, static_cast<float>(m_currTimeStep));
+	return _getVectorAt(x, y, GetCurrentTime());
 }
 
 CVector2D CAmiraVectorField2D::GetVectorAt(const CPointf &point) const
@@ -76,7 +90,77 @@ CVector2D CAmiraVectorField2D::GetVectorAt(const CPointf &point) const
 	static float x, y;
 	_getGridCoordinates(point.x, point.y, x, y);
 
-	return _getVectorAt(x, y, static_cast<float>(m_currTimeStep));
+	return _getVectorAt(x, y, GetCurrentTime());
+}
+
+CVector2D CAmiraVectorField2D::GetVectorAt(const CPointf &point, float fFootprint) const
+{
+	float x, y;
+	_getGridCoordinates(point.x, point.y, x, y);
+
+	int nLevel;
+	CGridPyramid &pyramid = _getFramePyramid(fFootprint, nLevel);
+
+	if (nLevel == 0)
+		return _getVectorAt(x, y, GetCurrentTime());
+
+	float pVector[2];
+	pyramid.GetAt(x, y, static_cast<float>(1 << nLevel), pVector);
+
+	return CVector2D(pVector[0], pVector[1]) - _getCurrentReferenceVelocity();
+}
+
+CVectorField2D* CAmiraVectorField2D::GetCoarseVectorField(float fFootprint, COccupancyGrid &occupancy) const
+{
+	occupancy.Clear();
+
+	int nLevel;
+	CGridPyramid &pyramid = _getFramePyramid(fFootprint, nLevel);
+
+	if (nLevel == 0) return nullptr;
+
+	const int nWidth		= pyramid.GetWidth(nLevel);
+	const int nHeight		= pyramid.GetHeight(nLevel);
+	const float fSpacing	= static_cast<float>(1 << nLevel);
+	const float fCellX		= m_rcDomain.getWidth() / m_nMaxIdxX;
+	const float fCellY		= m_rcDomain.getHeight() / m_nMaxIdxY;
+
+	//The last sample of a level lies one cell before the border of the domain, if the finest level has an even number of samples
+	const CRectF rcLevel(m_rcDomain.m_Min.x, m_rcDomain.m_Min.y, 
+						 m_rcDomain.m_Min.x + (nWidth - 1) * fSpacing * fCellX, m_rcDomain.m_Min.y + (nHeight - 1) * fSpacing * fCellY);
+
+	CVectorField2D *pRetVal = new CVectorField2D(rcLevel, nWidth, nHeight);
+	memcpy(pRetVal->m_pData, pyramid.GetData(nLevel), nWidth * nHeight * sizeof(CVector2D));
+
+	pRetVal->m_ReferenceVelocity = _getCurrentReferenceVelocity();
+
+	//Samples, whose whole footprint is dead, stay NaN or zero in the level
+	occupancy.Build(reinterpret_cast<const CVector2D*>(pRetVal->m_pData), rcLevel, nWidth, nHeight);
+
+	if (!occupancy.IsFull())
+		pRetVal->SetOccupancy(&occupancy);
+
+	return pRetVal;
+}
+
+CGridPyramid& CAmiraVectorField2D::_getFramePyramid(float fFootprint, int &nLevel) const
+{
+	const CVector2D *pFrame = GetCurrentFrame();
+	const float fTime		= GetCurrentTime();
+
+	//Keyed by time as well, since the memory of virtual frames is reused
+	if (m_FramePyramid.GetBase() != reinterpret_cast<const float*>(pFrame) || m_fFramePyramidTime != fTime)
+	{
+		m_FramePyramid.Init(reinterpret_cast<const float*>(pFrame), m_nSamplesX, m_nSamplesY, 2);
+		m_fFramePyramidTime = fTime;
+	}
+
+	//Footprint in samples of the finest level
+	const float fSamples = fFootprint * max(m_nMaxIdxX / m_rcDomain.getWidth(), m_nMaxIdxY / m_rcDomain.getHeight());
+
+	nLevel = m_FramePyramid.GetLevel(fSamples);
+
+	return m_FramePyramid;
 }
 
 void CAmiraVectorField2D::GetJacobian(float dx, float dy, arma::fmat22 *pJacobian) const
@@ -94,11 +178,13 @@ void CAmiraVectorField2D::GetJacobian(float dx, float dy, arma::fmat22 *pJacobia
 	_getGridCoordinates(dx, dy, x, y);
 
 	//Central differences (spatial components)
-	CVector2D p1(_getVectorAt(x + delta, y, static_cast<float>(m_currTimeStep)));
-	CVector2D p2(_getVectorAt(x - delta, y, static_cast<float>(m_currTimeStep)));
+	const float fTime = GetCurrentTime();
+
+	CVector2D p1(_getVectorAt(x + delta, y, fTime));
+	CVector2D p2(_getVectorAt(x - delta, y, fTime));
 
-	CVector2D p3(_getVectorAt(x, y + delta, static_cast<float>(m_currTimeStep)));
-	CVector2D p4(_getVectorAt(x, y - delta, static_cast<float>(m_currTimeStep)));
+	CVector2D p3(_getVectorAt(x, y + delta, fTime));
+	CVector2D p4(_getVectorAt(x, y - delta, fTime));
 
 	(*pJacobian)(0,0) = (p1.x - p2.x)/(div);	//U_x
 	(*pJacobian)(0,1) = (p3.x - p4.x)/(div);	//U_y
@@ -180,7 +266,7 @@ bool CAmiraVectorField2D::_insideGrid(const CVector2D& pos) const
 
 float CAmiraVectorField2D::GetVorticity(float x, float y) const
 {
-	return GetVorticity(x, y, static_cast<float>(m_currTimeStep));
+	return GetVorticity(x, y, GetCurrentTime());
 }
 
 CVector3D CAmiraVectorField2D::_getVectorAt(float x, float y,  float z, float time) const
@@ -196,46 +282,136 @@ CVector3D CAmiraVectorField2D::_getVectorAt(float x, float y,  float z, float ti
 	if (py > static_cast<int>(m_nMaxIdxY)) py = static_cast<int>(m_nMaxIdxY);
 	int py1 = (py == static_cast<int>(m_nMaxIdxY))? py : py +1;
 	
-	//get floor and ceil for the timestep to interpolate
-	int tx = static_cast<int>( time );
-	if (tx < 0) tx = 0;
-	if (tx > static_cast<int>(m_nMaxTimestep)) tx = static_cast<int>(m_nMaxTimestep);
-	int tx1 = (tx == static_cast<int>(m_nMaxTimestep))? tx : tx + 1;
+	//get the timesteps to interpolate and their weights
+	int pFrames[4];
+	float pWeights[4];
+	const int nNumFrames = _getTemporalStencil(time, pFrames, pWeights);
 
 	//compute weights
 	const register float wx = x - px;
 	const register float wy = y - py;
-	const register float wt = time - tx;
 
-	CVector2D v1, v2, v3, v4;
+	const CVector2D* vecField = GetFrame(pFrames[0]);
 
-	//Get the two timesteps
-	const CVector2D* vecField = GetFrame(tx);		//t-1
+	CVector2D v1 ( vecField[py * m_nSamplesX + px] );
+	CVector2D v2 ( vecField[py1 * m_nSamplesX + px] );
+	CVector2D v3 ( vecField[py * m_nSamplesX + px1] );
+	CVector2D v4 ( vecField[py1 * m_nSamplesX + px1] );
 
-	if (wt != 0.0f)
+	if (nNumFrames > 1)
 	{
-		const CVector2D* vecField2 = GetFrame(tx1);		//t+1
-
 		//interpolate in time
-		v1 = vecField[py * m_nSamplesX + px] * (1.0f-wt) + vecField2[py * m_nSamplesX + px] * wt;
-		v2 = vecField[py1 * m_nSamplesX + px] * (1.0f-wt) + vecField2[py1 * m_nSamplesX + px] * wt;
+		v1 *= pWeights[0];
+		v2 *= pWeights[0];
+		v3 *= pWeights[0];
+		v4 *= pWeights[0];
 
-		v3 = vecField[py * m_nSamplesX + px1] * (1.0f-wt) + vecField2[py * m_nSamplesX + px1] * wt;
-		v4 = vecField[py1 * m_nSamplesX + px1] * (1.0f-wt) + vecField2[py1 * m_nSamplesX + px1]* wt;
-	}
-	else
-	{
-		v1 = vecField[py * m_nSamplesX + px];
-		v2 = vecField[py1 * m_nSamplesX + px];
-		v3 = vecField[py * m_nSamplesX + px1];
-		v4 = vecField[py1 * m_nSamplesX + px1];
+		for (int i = 1; i < nNumFrames; i++)
+		{
+			vecField = GetFrame(pFrames[i]);
+
+			v1 += vecField[py * m_nSamplesX + px] * pWeights[i];
+			v2 += vecField[py1 * m_nSamplesX + px] * pWeights[i];
+			v3 += vecField[py * m_nSamplesX + px1] * pWeights[i];
+			v4 += vecField[py1 * m_nSamplesX + px1] * pWeights[i];
+		}
 	}
 
 	//Bilinear interpolation in space
 	CVector2D dummy1 = v1 * (1.0f - wy) + v2 * wy;
 	CVector2D dummy2 = v3 * (1.0f - wy) + v4 * wy;
+	CVector2D v = dummy1 * (1.0f - wx) + dummy2 * wx;
+
+	//Transformation into the reference frame, whose velocity is interpolated in time as well
+	if (m_nReferenceFrame != RF_LAB)
+	{
+		for (int i = 0; i < nNumFrames; i++)
+			v -= GetReferenceVelocityAt(pFrames[i]) * pWeights[i];
+	}
+
+	return CVector3D(v, z);
+}
+
+int CAmiraVectorField2D::_getTemporalStencil(float time, int *pFrames, float *pWeights) const
+{
+	const int nMaxTimestep = static_cast<int>(m_nMaxTimestep);
+
+	//get floor and ceil for the timestep to interpolate
+	int tx = static_cast<int>( time );
+	if (tx < 0) tx = 0;
+	if (tx > nMaxTimestep) tx = nMaxTimestep;
+
+	const float wt = time - tx;
+
+	pFrames[0]	= tx;
+	pWeights[0]	= 1.0f;
+
+	if (wt == 0.0f || tx == nMaxTimestep) return 1;
+
+	if (m_nTemporalInterpolation == TI_LINEAR)
+	{
+		pFrames[1]	= tx + 1;
+		pWeights[0]	= 1.0f - wt;
+		pWeights[1]	= wt;
+
+		return 2;
+	}
+
+	//Catmull-Rom spline through the time steps tx-1 ... tx+2, clamped at the ends
+	const float wt2 = wt * wt;
+	const float wt3 = wt2 * wt;
+
+	pFrames[0]	= max(tx - 1, 0);
+	pFrames[1]	= tx;
+	pFrames[2]	= tx + 1;
+	pFrames[3]	= min(tx + 2, nMaxTimestep);
+
+	pWeights[0]	= 0.5f * (-wt3 + 2.0f * wt2 - wt);
+	pWeights[1]	= 0.5f * (3.0f * wt3 - 5.0f * wt2 + 2.0f);
+	pWeights[2]	= 0.5f * (-3.0f * wt3 + 4.0f * wt2 + wt);
+	pWeights[3]	= 0.5f * (wt3 - wt2);
+
+	return 4;
+}
+
+void CAmiraVectorField2D::SetTemporalResolution(unsigned int nSubSteps, TEMPORAL_INTERPOLATION nInterpolation)
+{
+	if (nSubSteps < 1) nSubSteps = 1;
+
+	//Keep the current time, if it is a virtual frame at the new resolution
+	const unsigned int nSubStep = (m_nCurrSubStep * nSubSteps) % m_nSubSteps == 0 ? (m_nCurrSubStep * nSubSteps) / m_nSubSteps : 0;
+
+	m_nSubSteps					= nSubSteps;
+	m_nTemporalInterpolation	= nInterpolation;
+
+	m_VirtualFrames.Clear();
+	m_FramePyramid.Clear();
+	m_pCurrVirtualFrame			= nullptr;
+	m_nCurrSubStep				= 0;
+
+	GotoVirtualFrame(m_currTimeStep * m_nSubSteps + nSubStep);
+}
 
-	return CVector3D( dummy1 * (1.0f - wx) + dummy2 * wx, z);
+void CAmiraVectorField2D::GotoVirtualFrame(unsigned int nFrame)
+{
+	if (nFrame >= GetNumVirtualFrames()) return;
+
+	m_currTimeStep		= nFrame / m_nSubSteps;
+	m_nCurrSubStep		= nFrame % m_nSubSteps;
+	m_pCurrVirtualFrame	= nullptr;
+
+	if (m_nCurrSubStep == 0) return;
+
+	int pFrames[4];
+	float pWeights[4];
+	const int nNumFrames = _getTemporalStencil(GetCurrentTime(), pFrames, pWeights);
+
+	const CVector2D *ppFrames[4];
+
+	for (int i = 0; i < nNumFrames; i++)
+		ppFrames[i] = GetFrame(pFrames[i]);
+
+	m_pCurrVirtualFrame = m_VirtualFrames.GetFrame(static_cast<int>(nFrame), ppFrames, pWeights, nNumFrames, m_nSamplesX * m_nSamplesY);
 }
 
 CVector2D CAmiraVectorField2D::_getVectorAt(float x, float y, float time) const
@@ -246,6 +422,8 @@ CVector2D CAmiraVectorField2D::_getVectorAt(float x, float y, float time) const
 
 void CAmiraVectorField2D::Init(const CRectF &rcDomain, float fExtentZ, int nSamplesX, int nSamplesY, int nSamplesZ, CAmiraVectorField2D* pData)
 {
+	_freeOccupancy();
+
 	CDataField2D::Init(rcDomain, nSamplesX, nSamplesY);
 
 	m_nMaxIdxX		= nSamplesX-1;
@@ -255,15 +433,200 @@ void CAmiraVectorField2D::Init(const CRectF &rcDomain, float fExtentZ, int nSamp
 	m_numTimeSteps	= nSamplesZ;
 	m_nMaxTimestep	= m_numTimeSteps-1;
 	m_currTimeStep	= 0;
+	m_nCurrSubStep	= 0;
 	m_pData			= reinterpret_cast<CMathVector*>(pData);
+
+	//Virtual frames and mip-maps of the previous data are invalid
+	m_VirtualFrames.Clear();
+	m_FramePyramid.Clear();
+	m_pCurrVirtualFrame = nullptr;
+
+	ResetReferenceFrame();
+
+	//The occupancy of each time step is built on first use
+	m_ppOccupancy = new COccupancyGrid*[m_numTimeSteps];
+
+	for (unsigned int i = 0; i < m_numTimeSteps; i++)
+		m_ppOccupancy[i] = nullptr;
+}
+
+void CAmiraVectorField2D::_freeOccupancy()
+{
+	if (!m_ppOccupancy) return;
+
+	for (unsigned int i = 0; i < m_numTimeSteps; i++)
+		delete m_ppOccupancy[i];
+
+	delete [] m_ppOccupancy;
+	m_ppOccupancy = nullptr;
+}
+
+const COccupancyGrid* CAmiraVectorField2D::GetOccupancy(int nTimeStep) const
+{
+	if (!m_ppOccupancy || !m_pData) return nullptr;
+
+	if (nTimeStep < 0) nTimeStep = 0;
+	if (nTimeStep > static_cast<int>(m_nMaxTimestep)) nTimeStep = static_cast<int>(m_nMaxTimestep);
+
+	COccupancyGrid *pGrid = m_ppOccupancy[nTimeStep];
+	if (pGrid) return pGrid;
+
+	pGrid = new COccupancyGrid();
+	pGrid->Build(GetFrame(nTimeStep), m_rcDomain, m_nSamplesX, m_nSamplesY);
+
+	//Several threads may build the same time step, only the first grid is published
+	PVOID pPrev = InterlockedCompareExchangePointer(reinterpret_cast<PVOID volatile*>(&m_ppOccupancy[nTimeStep]), pGrid, nullptr);
+
+	if (pPrev) {
+		delete pGrid;
+		pGrid = static_cast<COccupancyGrid*>(pPrev);
+	}
+
+	return pGrid;
+}
+
+void CAmiraVectorField2D::ResetReferenceFrame()
+{
+	m_nReferenceFrame	= RF_LAB;
+	m_ReferenceVelocity	= CVector2D(0.0f, 0.0f);
+}
+
+void CAmiraVectorField2D::SetReferenceFrame(const CVector2D &velocity)
+{
+	m_nReferenceFrame	= RF_GALILEAN;
+	m_ReferenceVelocity	= velocity;
+}
+
+void CAmiraVectorField2D::SetReferenceFrame(const CRectF &rcRegion)
+{
+	ResetReferenceFrame();
+
+	if (m_numTimeSteps == 0) return;
+
+	m_rcReferenceRegion = rcRegion;
+
+	if (m_rcReferenceRegion.m_Min.x < m_rcDomain.m_Min.x) m_rcReferenceRegion.m_Min.x = m_rcDomain.m_Min.x;
+	if (m_rcReferenceRegion.m_Min.y < m_rcDomain.m_Min.y) m_rcReferenceRegion.m_Min.y = m_rcDomain.m_Min.y;
+	if (m_rcReferenceRegion.m_Max.x > m_rcDomain.m_Max.x) m_rcReferenceRegion.m_Max.x = m_rcDomain.m_Max.x;
+	if (m_rcReferenceRegion.m_Max.y > m_rcDomain.m_Max.y) m_rcReferenceRegion.m_Max.y = m_rcDomain.m_Max.y;
+
+	//The mean velocities are computed on first use
+	delete [] m_pRegionVelocities;
+	delete [] m_pRegionVelocityReady;
+
+	m_pRegionVelocities		= new CVector2D[m_numTimeSteps];
+	m_pRegionVelocityReady	= new LONG[m_numTimeSteps];
+
+	for (unsigned int i = 0; i < m_numTimeSteps; i++)
+		m_pRegionVelocityReady[i] = 0;
+
+	m_nReferenceFrame = RF_REGION_MEAN;
+}
+
+CVector2D CAmiraVectorField2D::GetReferenceVelocityAt(int nTimeStep) const
+{
+	switch (m_nReferenceFrame)
+	{
+		case RF_GALILEAN:
+			return m_ReferenceVelocity;
+		case RF_REGION_MEAN:
+		{
+			if (nTimeStep < 0) nTimeStep = 0;
+			if (nTimeStep > static_cast<int>(m_nMaxTimestep)) nTimeStep = static_cast<int>(m_nMaxTimestep);
+
+			//Several threads may compute the same time step, but they all store the same value
+			if (!m_pRegionVelocityReady[nTimeStep]) {
+				m_pRegionVelocities[nTimeStep] = GetMeanVelocity(m_rcReferenceRegion, nTimeStep);
+				InterlockedExchange(&m_pRegionVelocityReady[nTimeStep], 1);
+			}
+
+			return m_pRegionVelocities[nTimeStep];
+		}
+		default:
+			return CVector2D(0.0f, 0.0f);
+	}
 }
 
-CVectorField2D* CAmiraVectorField2D::_getCurrentVectorFieldPtr() const
+CVector2D CAmiraVectorField2D::GetMeanVelocity(const CRectF &rcRegion, int nTimeStep) const
 {
-	return _getVectorFieldPtr(m_currTimeStep);
+	float fMinX, fMinY, fMaxX, fMaxY;
+
+	_getGridCoordinates(rcRegion.m_Min.x, rcRegion.m_Min.y, fMinX, fMinY);
+	_getGridCoordinates(rcRegion.m_Max.x, rcRegion.m_Max.y, fMaxX, fMaxY);
+
+	//Samples inside the region, or the sample closest to its center, if there is none
+	int nMinX = static_cast<int>( ceil(fMinX) ), nMaxX = static_cast<int>( floor(fMaxX) );
+	int nMinY = static_cast<int>( ceil(fMinY) ), nMaxY = static_cast<int>( floor(fMaxY) );
+
+	if (nMinX > nMaxX) nMinX = nMaxX = static_cast<int>( floor(0.5f * (fMinX + fMaxX) + 0.5f) );
+	if (nMinY > nMaxY) nMinY = nMaxY = static_cast<int>( floor(0.5f * (fMinY + fMaxY) + 0.5f) );
+
+	nMinX = max(nMinX, 0);	nMaxX = min(nMaxX, static_cast<int>(m_nMaxIdxX));
+	nMinY = max(nMinY, 0);	nMaxY = min(nMaxY, static_cast<int>(m_nMaxIdxY));
+
+	const CVector2D *pFrame = GetFrame(nTimeStep);
+	double dSumX(0.0), dSumY(0.0), dNumSamples(0.0);
+
+	//Masked samples are not finite and are left out
+	#pragma omp parallel for reduction(+:dSumX,dSumY,dNumSamples)
+	for (int y = nMinY; y <= nMaxY; y++)
+	{
+		const CVector2D *pRow = pFrame + y * m_nSamplesX;
+
+		for (int x = nMinX; x <= nMaxX; x++) 
+		{
+			if (isFiniteNumber(pRow[x].x) && isFiniteNumber(pRow[x].y)) {
+				dSumX += pRow[x].x;
+				dSumY += pRow[x].y;
+				dNumSamples += 1.0;
+			}
+		}
+	}
+
+	if (dNumSamples == 0.0) return CVector2D(0.0f, 0.0f);
+
+	return CVector2D( static_cast<float>(dSumX / dNumSamples), static_cast<float>(dSumY / dNumSamples) );
 }
 
-CVectorField2D* CAmiraVectorField2D::_getVectorFieldPtr(int time) const
+CVectorField2D* CAmiraVectorField2D::_getCurrentVectorFieldPtr(bool bLabFrame) const
+{
+	if (!m_pCurrVirtualFrame)
+		return _getVectorFieldPtr(m_currTimeStep, bLabFrame);
+
+	CVectorField2D *pDummy = new CVectorField2D();
+	pDummy->m_nSamplesX = m_nSamplesX;
+	pDummy->m_nSamplesY = m_nSamplesY;
+
+	pDummy->m_rcDomain = m_rcDomain;
+
+	pDummy->m_pData = reinterpret_cast<CMathVector*>(GetCurrentFrame());
+
+	if (!bLabFrame)
+		pDummy->m_ReferenceVelocity = _getCurrentReferenceVelocity();
+
+	//Obstacles rarely move, the occupancy of the closest time step is used
+	pDummy->m_pOccupancy = GetOccupancy( (2 * m_nCurrSubStep < m_nSubSteps)? m_currTimeStep : m_currTimeStep + 1 );
+
+	return pDummy;
+}
+
+CVector2D CAmiraVectorField2D::_getCurrentReferenceVelocity() const
+{
+	CVector2D vRef(0.0f, 0.0f);
+
+	if (m_nReferenceFrame == RF_LAB) return vRef;
+
+	int pFrames[4];
+	float pWeights[4];
+	const int nNumFrames = _getTemporalStencil(GetCurrentTime(), pFrames, pWeights);
+
+	for (int i = 0; i < nNumFrames; i++)
+		vRef += GetReferenceVelocityAt(pFrames[i]) * pWeights[i];
+
+	return vRef;
+}
+
+CVectorField2D* CAmiraVectorField2D::_getVectorFieldPtr(int time, bool bLabFrame) const
 {
 	CVectorField2D *pDummy = new CVectorField2D();
 	pDummy->m_nSamplesX = m_nSamplesX;
@@ -273,9 +636,47 @@ CVectorField2D* CAmiraVectorField2D::_getVectorFieldPtr(int time) const
 
 	pDummy->m_pData = &m_pData[m_nSamplesX*m_nSamplesY*time * sizeof(CVector2D)];
 
+	if (!bLabFrame)
+		pDummy->m_ReferenceVelocity = GetReferenceVelocityAt(time);
+
+	pDummy->m_pOccupancy = GetOccupancy(time);
+
 	return pDummy;
 }
 
+CVectorField2D* CAmiraVectorField2D::GetTemporalDerivativeField(int nFrame) const
+{
+	nFrame = min(max(nFrame, 0), static_cast<int>(m_nMaxTimestep));
+
+	const int nPrev			= max(nFrame - 1, 0);
+	const int nNext			= min(nFrame + 1, static_cast<int>(m_nMaxTimestep));
+	const int nNumSamples	= m_nSamplesX * m_nSamplesY;
+
+	CVectorField2D *pRetVal = new CVectorField2D(m_rcDomain, m_nSamplesX, m_nSamplesY);
+	CVector2D *pOut = reinterpret_cast<CVector2D*>(pRetVal->m_pData);
+
+	if (nPrev == nNext)
+	{
+		//A single time step does not change
+		for (int i = 0; i < nNumSamples; i++)
+			pOut[i] = CVector2D(0.0f, 0.0f);
+
+		return pRetVal;
+	}
+
+	const float fSamplesPerSecond	= (m_fExtentZ > 0.0f)? GetSamplesPerSecond() : 1.0f;
+	const float fScale				= fSamplesPerSecond / static_cast<float>(nNext - nPrev);
+	const CVector2D vRef			( (GetReferenceVelocityAt(nNext) - GetReferenceVelocityAt(nPrev)) * fScale );
+	const CVector2D *pPrev			= GetFrame(nPrev);
+	const CVector2D *pNext			= GetFrame(nNext);
+
+	#pragma omp parallel for
+	for (int i = 0; i < nNumSamples; i++)
+		pOut[i] = (pNext[i] - pPrev[i]) * fScale - vRef;
+
+	return pRetVal;
+}
+
 CScalarField2D* CAmiraVectorField2D::GetVectorMagnitudeField(float time) const
 {
 	CVectorField2D *pDummy;
@@ -327,6 +728,47 @@ CScalarField2D* CAmiraVectorField2D::GetVorticityField(CRectF rect, bool bGetMag
 	return pRetVal;
 }
 
+void CAmiraVectorField2D::GetVorticity(int nFrame, int nMinX, int nMinY, int nWidth, int nHeight, float *pOut, int nStride) const
+{
+	CVectorField2D *pDummy = _getVectorFieldPtr(nFrame);
+
+	pDummy->GetVorticity(nMinX, nMinY, nWidth, nHeight, pOut, nStride);
+
+	pDummy->m_pData = nullptr;
+	delete pDummy;
+}
+
+void CAmiraVectorField2D::GetDerivedFields(unsigned int nFields, CScalarField2D **ppFields, float time, bool bLabFrame) const
+{
+	//In the lab frame, the reference frame is not accessed at all, so it may be changed meanwhile
+	CVectorField2D *pDummy;
+
+	if (time < 0)
+		pDummy = _getCurrentVectorFieldPtr(bLabFrame);
+	else
+		pDummy = _getVectorFieldPtr(static_cast<int>(time), bLabFrame);
+
+	pDummy->GetDerivedFields(nFields, ppFields);
+
+	pDummy->m_pData = nullptr;
+	delete pDummy;
+}
+
+void CAmiraVectorField2D::GetVorticityFields(CScalarField2D **ppVorticity, CScalarField2D **ppVorticityAbs, float time) const
+{
+	CVectorField2D *pDummy;
+
+	if (time < 0)
+		pDummy = _getCurrentVectorFieldPtr();
+	else
+		pDummy = _getVectorFieldPtr(static_cast<int>(time));
+
+	pDummy->GetVorticityFields(ppVorticity, ppVorticityAbs);
+
+	pDummy->m_pData = nullptr;
+	delete pDummy;
+}
+
 void CAmiraVectorField2D::integrateRK4(float xOrg, float yOrg, int numSteps, float stepLen, CPointf *pOutBuff) const
 {
 	CVectorField2D *pDummy = _getCurrentVectorFieldPtr();
@@ -336,48 +778,167 @@ void CAmiraVectorField2D::integrateRK4(float xOrg, float yOrg, int numSteps, flo
 	delete pDummy;
 }
 
-void CAmiraVectorField2D::integrateRK4(const CVector3D &pos, int nNumSteps, float stepLen, bool bForward, vector<CPointf> *pOutBuff, const CRectF &rcIntegrationDomain) const
+void CAmiraVectorField2D::integrateRK4(const CVector3D &pos, int nNumSteps, float stepLen, bool bForward, vector<CPointf> *pOutBuff, const CRectF &rcIntegrationDomain, IntegrationState *pState) const
 {
-	CVector3D currPos;
-	CPointf trace;
+	IntegrationState state;
 
-	CRectF rcDomain(rcIntegrationDomain);
+	state.rcDomain = rcIntegrationDomain;
 
 	//Ensure the integration domain does not exceed the real domain
-	if (rcDomain.m_Min.x < m_rcDomain.m_Min.x) rcDomain.m_Min.x = m_rcDomain.m_Min.x;
-	if (rcDomain.m_Min.y < m_rcDomain.m_Min.y) rcDomain.m_Min.y = m_rcDomain.m_Min.y;
-	if (rcDomain.m_Max.x > m_rcDomain.m_Max.x) rcDomain.m_Max.x = m_rcDomain.m_Max.x;
-	if (rcDomain.m_Max.y > m_rcDomain.m_Max.y) rcDomain.m_Max.y = m_rcDomain.m_Max.y;
+	if (state.rcDomain.m_Min.x < m_rcDomain.m_Min.x) state.rcDomain.m_Min.x = m_rcDomain.m_Min.x;
+	if (state.rcDomain.m_Min.y < m_rcDomain.m_Min.y) state.rcDomain.m_Min.y = m_rcDomain.m_Min.y;
+	if (state.rcDomain.m_Max.x > m_rcDomain.m_Max.x) state.rcDomain.m_Max.x = m_rcDomain.m_Max.x;
+	if (state.rcDomain.m_Max.y > m_rcDomain.m_Max.y) state.rcDomain.m_Max.y = m_rcDomain.m_Max.y;
 
 	pOutBuff->reserve(nNumSteps);
 
-	_getGridCoordinates(pos.x, pos.y, currPos.x, currPos.y);
+	state.origin = pos;
+	_getGridCoordinates(pos.x, pos.y, state.gridPos.x, state.gridPos.y);
+	state.gridPos.z	= pos.z;
 	
 	pOutBuff->push_back( CPointf(pos.x, pos.y) );
-	float fTimeStep		= static_cast<float>(m_currTimeStep);
-	bool bError			= false;
-	float dir			= (bForward)? 1.0f : -1.0f;
-	const float deltaTime = _getDeltaT(pos.z, stepLen);
+	state.fStartTime	= GetCurrentTime();
+	state.fTimeStep		= state.fStartTime;
+	state.fDeltaTime	= _getDeltaT(pos.z, stepLen);
+	state.stepLen		= stepLen;
+	state.bForward		= bForward;
+	state.nNumSteps		= 1;
 
-	for (int i =1; i < nNumSteps; i++)
+	_continueRK4(state, nNumSteps, pOutBuff);
+
+	pOutBuff->shrink_to_fit();
+
+	if (pState) {
+		*pState = state;
+	}
+}
+
+void CAmiraVectorField2D::resizeIntegration(IntegrationState &state, int nNumSteps, vector<CPointf> *pOutBuff) const
+{
+	if (nNumSteps < 1) nNumSteps = 1;
+
+	if (nNumSteps > state.nNumSteps)
+	{
+		if (!state.bTerminated) {
+			_continueRK4(state, nNumSteps, pOutBuff);
+		}
+		return;
+	}
+
+	if (nNumSteps == state.nNumSteps) return;
+
+	//Remove the surplus vertices at the far end of the line
+	if (state.bForward) {
+		pOutBuff->resize(nNumSteps);
+	} else {
+		pOutBuff->erase(pOutBuff->begin(), pOutBuff->begin() + (state.nNumSteps - nNumSteps));
+	}
+
+	//Rewind state to the new last vertex
+	const CPointf &ptLast = (state.bForward)? pOutBuff->back() : pOutBuff->front();
+	_getGridCoordinates(ptLast.x, ptLast.y, state.gridPos.x, state.gridPos.y);
+
+	state.nNumSteps		= nNumSteps;
+	state.fTimeStep		= state.fStartTime + (nNumSteps-1) * state.fDeltaTime;
+	state.bTerminated	= false;
+}
+
+int CAmiraVectorField2D::integrateCellwise(const CVector3D &pos, int nNumSteps, float stepLen, bool bForward, vector<CPointf> *pOutBuff, const CRectF &rcIntegrationDomain) const
+{
+	CVectorField2D *pDummy = _getCurrentVectorFieldPtr();
+	int nEval = pDummy->integrateCellwise(pos.x, pos.y, nNumSteps, stepLen, bForward, pOutBuff, rcIntegrationDomain);
+
+	pDummy->m_pData = nullptr;
+	delete pDummy;
+
+	pOutBuff->shrink_to_fit();
+
+	return nEval;
+}
+
+bool CAmiraVectorField2D::advectParticle(CPointf &pos, float fTimeFrom, float fTimeTo, float stepLen) const
+{
+	//Number of time steps covered by one unit of the integration parameter
+	const float factor	= GetSamplesPerSecond()/GetSamplesPerUnitX();
+	const float fSpan	= fabs(fTimeTo - fTimeFrom);
+
+	if (fSpan == 0.0f) return true;
+
+	//Use equally sized steps, s.t. the last step ends exactly at fTimeTo
+	int nNumSteps		= max(1, static_cast<int>( ceil(fSpan / (stepLen * factor)) ));
+	float fStepLen		= fSpan / (nNumSteps * factor);
+	float fDeltaTime	= (fTimeTo - fTimeFrom) / nNumSteps;
+	float fDir			= (fTimeTo > fTimeFrom)? 1.0f : -1.0f;
+
+	CVector3D currPos;
+	_getGridCoordinates(pos.x, pos.y, currPos.x, currPos.y);
+
+	float fTimeStep = fTimeFrom;
+	bool bError		= false;
+
+	for (int i=0; i < nNumSteps; i++)
 	{
-		currPos.z	= pos.z;
-		currPos		= _RK4(currPos, fTimeStep, stepLen, dir, bError);
+		currPos.z = 1.0f;
+		CVector3D nextPos( _RK4(currPos, fTimeStep, fStepLen, fDir, bError) );
+
+		if (bError || nextPos.x < 0.0f || nextPos.y < 0.0f || nextPos.x > m_nMaxIdxX || nextPos.y > m_nMaxIdxY) {
+			_getDomainCoordinates(currPos.x, currPos.y, pos.x, pos.y);
+			return false;
+		}
+
+		currPos		= nextPos;
+		fTimeStep	+= fDeltaTime;
+	}
+
+	_getDomainCoordinates(currPos.x, currPos.y, pos.x, pos.y);
+
+	return true;
+}
+
+CVector2D CAmiraVectorField2D::GetParticleVelocity(const CPointf &pos, float fTime) const
+{
+	float x, y;
+	_getGridCoordinates(pos.x, pos.y, x, y);
+
+	//advectParticle() moves a particle by v grid cells per 'factor' time steps
+	const float factor	= GetSamplesPerSecond()/GetSamplesPerUnitX();
+	CVector2D v			= _getVectorAt(x, y, fTime) / factor;
+
+	return CVector2D(v.x * m_rcDomain.getWidth() / (m_nSamplesX - 1), v.y * m_rcDomain.getHeight() / (m_nSamplesY - 1));
+}
+
+void CAmiraVectorField2D::_continueRK4(IntegrationState &state, int nNumSteps, vector<CPointf> *pOutBuff) const
+{
+	CVector3D currPos(state.gridPos);
+	CPointf trace;
+	bool bError		= false;
+	float dir		= (state.bForward)? 1.0f : -1.0f;
+
+	if (static_cast<int>(pOutBuff->capacity()) < nNumSteps) {
+		pOutBuff->reserve(nNumSteps);
+	}
+
+	for (; state.nNumSteps < nNumSteps; state.nNumSteps++)
+	{
+		currPos.z	= state.origin.z;
+		currPos		= _RK4(currPos, state.fTimeStep, state.stepLen, dir, bError);
 
 		_getDomainCoordinates(currPos.x, currPos.y, trace.x, trace.y);
 
-		if (bError || !rcDomain.PtInRect(trace.x, trace.y) ||  fTimeStep >= m_numTimeSteps) break;
+		if (bError || !state.rcDomain.PtInRect(trace.x, trace.y) ||  state.fTimeStep >= m_numTimeSteps) {
+			state.bTerminated = true;
+			break;
+		}
 
-		if (bForward) {
+		if (state.bForward) {
 			pOutBuff->push_back( trace );
 		} else {
-			pOutBuff->insert(pOutBuff->end()-pOutBuff->size(), trace );
+			pOutBuff->insert(pOutBuff->begin(), trace );
 		}
 
-		fTimeStep += deltaTime;
+		state.gridPos	= currPos;
+		state.fTimeStep += state.fDeltaTime;
 	}
-
-	pOutBuff->shrink_to_fit();
 }
 
 void CAmiraVectorField2D::integrateTimeLine(const CPointf &ptSeedLineStart, const CPointf &ptSeedLineEnd, int nNumSamples, int nNumSteps, float stepLen, bool bForward, vector<CPointf> *pOutBuff, const CRectF &rcIntegrationDomain) const
@@ -398,7 +959,7 @@ void CAmiraVectorField2D::integrateTimeLine(const CPointf &ptSeedLineStart, cons
 
 		_getGridCoordinates(pos.x, pos.y, currPos.x, currPos.y);
 	
-		float fTimeStep		= static_cast<float>(m_currTimeStep);
+		float fTimeStep		= GetCurrentTime();
 		bool bError			= false;
 		float dir			= (bForward)? 1.0f : -1.0f;
 		const float deltaTime = _getDeltaT(pos.z, stepLen);
@@ -460,7 +1021,7 @@ void CAmiraVectorField2D::integrateStreakLine(const CVector3D &pos, int nNumStep
 	_getGridCoordinates(pos.x, pos.y, origin.x, origin.y);
 	origin.z	= pos.z;
 
-	float fTimeStep		= static_cast<float>(m_currTimeStep);
+	float fTimeStep		= GetCurrentTime();
 	bool bError			= false;
 	float dir			= (bForward)? 1.0f : -1.0f;
 	bool bContinue		= true;
@@ -539,10 +1100,23 @@ CVector3D CAmiraVectorField2D::_RK4(const CVector3D &pos, float fTimeStep, float
 
 		retVal = pos + ((v1 + (v2 + v3)*2.0f + v4)/6.0f)*stepLen;
 
-		static CVector3D ZeroVector (0.0f, 0.0f, 0.0f);
+		const CVector3D ZeroVector (0.0f, 0.0f, 0.0f);	//No function static, this function is called concurrently
 		bError = (v1 == ZeroVector || v2 == ZeroVector || v3 == ZeroVector || v4 == ZeroVector
 			  || !isFinite(retVal.x) || !isFinite(retVal.y) );
 
+		const COccupancyGrid *pOccupancy = (bError)? nullptr : GetOccupancy( static_cast<int>(fTimeStep + 0.5f) );
+
+		if (pOccupancy && !pOccupancy->IsFull())
+		{
+			//Stop on entering an obstacle or a masked region of the nearest time step, 
+			//and where the flow stagnates towards one, instead of approaching it asymptotically
+			const float dx = retVal.x - pos.x;
+			const float dy = retVal.y - pos.y;
+
+			bError = !pOccupancy->IsLive(retVal.x, retVal.y) 
+				  || (dx*dx + dy*dy < AVF_STAGNATION_DIST*AVF_STAGNATION_DIST && pOccupancy->IsBoundary(retVal.x, retVal.y));
+		}
+
 		return retVal;
 	}
 
@@ -552,11 +1126,21 @@ CVector3D CAmiraVectorField2D::_RK4(const CVector3D &pos, float fTimeStep, float
 
 CRITICAL_POINT_TYPE CAmiraVectorField2D::GetCriticalPointType(const CPointf& point) const
 {
-	CVectorField2D *pDummy = _getCurrentVectorFieldPtr();
-	CRITICAL_POINT_TYPE nType = pDummy->GetCriticalPointType(point);
+	float x, y;
+	_getGridCoordinates(point.x, point.y, x, y);
 
-	pDummy->m_pData = nullptr;
-	delete pDummy;
+	const float delta	= 0.5f;
+	const float fTime	= GetCurrentTime();
+
+	//Central differences, converted to domain units
+	CVector2D p1( _getVectorAt(x + delta, y, fTime) );
+	CVector2D p2( _getVectorAt(x - delta, y, fTime) );
+	CVector2D p3( _getVectorAt(x, y + delta, fTime) );
+	CVector2D p4( _getVectorAt(x, y - delta, fTime) );
+
+	const float fCellX = m_rcDomain.getWidth() / (m_nSamplesX - 1);
+	const float fCellY = m_rcDomain.getHeight() / (m_nSamplesY - 1);
 
-	return nType;
+	return ClassifyCriticalPoint(	(p1.x - p2.x) / (2.0f*delta*fCellX), (p3.x - p4.x) / (2.0f*delta*fCellY),
+									(p1.y - p2.y) / (2.0f*delta*fCellX), (p3.y - p4.y) / (2.0f*delta*fCellY) );
 }
\ No newline at end of file
@@ -28,10 +28,22 @@
 #pragma once
 #include "vectorfield2d.h"
 #include "BasicFileReader.h"
+#include "VirtualFramePool.h"
+#include "GridPyramid.h"
 #include <vector>
 
 using namespace std;
 
+/**
+ *	Reference frames, in which a CAmiraVectorField2D can be observed.
+ */
+enum REFERENCE_FRAME
+{
+	RF_LAB = 0,		/**< The vectors as stored. */
+	RF_GALILEAN,	/**< A frame moving with a constant velocity. */
+	RF_REGION_MEAN	/**< A frame moving with the mean velocity of a region in each time step. The mean is the translation, that fits the region best. */
+};
+
 /**
  * Represents a 2-dimensional time-dependent vectorfield on a uniform grid.
  */
@@ -46,6 +58,26 @@ protected:
 	float		 m_fExtentZ;		/**< Extent of this CAmiraVectorField2D in temporal domain in seconds. */	//
 	CBasicFileReader *m_pFileRead;	/**< Pointer to a class, derived from CBasicFileReader, that handles reading vector fields from disk. */
 
+	//Reference frame
+	REFERENCE_FRAME		m_nReferenceFrame;			/**< The reference frame, in which all vectors are returned. The velocity of a RF_GALILEAN frame is stored in m_ReferenceVelocity. */
+	CRectF				m_rcReferenceRegion;		/**< Region, whose mean velocity is the velocity of a RF_REGION_MEAN frame. */
+	CVector2D		   *m_pRegionVelocities;		/**< Mean velocity of m_rcReferenceRegion per time step, computed on first use. */
+	volatile LONG	   *m_pRegionVelocityReady;		/**< Non-zero for each time step, whose entry in m_pRegionVelocities is valid. */
+
+	//Occupancy
+	COccupancyGrid * volatile *m_ppOccupancy;		/**< The COccupancyGrid of each time step, built on first use. */
+
+	//Temporal resampling
+	unsigned int			m_nSubSteps;				/**< Number of virtual frames per interval between two time steps, including the time step itself. 1 disables resampling. */
+	unsigned int			m_nCurrSubStep;				/**< The current virtual frame after m_currTimeStep, 0 is the time step itself. */
+	TEMPORAL_INTERPOLATION	m_nTemporalInterpolation;	/**< Interpolation scheme between time steps, used by all sampling and integration functions. */
+	CVirtualFramePool		m_VirtualFrames;			/**< Recently used virtual frames. */
+	shared_ptr< const vector<CVector2D> > m_pCurrVirtualFrame;	/**< Samples of the current virtual frame, or nullptr if the current time is a time step. */
+
+	//Multiresolution
+	mutable CGridPyramid	m_FramePyramid;				/**< Mip-map of the current frame in the lab frame, whose levels are built on first use. */
+	mutable float			m_fFramePyramidTime;		/**< Time of the frame of m_FramePyramid. */
+
 	/**
 	 *	Helper structure to integrate through 2D, time-dependent vector fields.
 	 */
@@ -57,6 +89,27 @@ protected:
 			:pos(p), time(t) {}
 	};
 
+public:
+	/**
+	 *	End state of an RK4 integration, as returned by integrateRK4().
+	 *	Allows to continue a previous integration where it stopped, or to truncate it,
+	 *	without integrating the whole line again from its origin.
+	 */
+	struct IntegrationState {
+		CVector3D	origin;		/**< Starting position of the integration in domain space. */
+		CVector3D	gridPos;	/**< Position of the last vertex in grid space. */
+		CRectF		rcDomain;	/**< Clamped integration domain. */
+		float		fStartTime;	/**< Time step at the origin. */
+		float		fTimeStep;	/**< Time step at the last vertex. */
+		float		fDeltaTime;	/**< Time increment per integration step. */
+		float		stepLen;	/**< Step length in grid space. */
+		int			nNumSteps;	/**< Number of vertices generated so far, including the origin. */
+		bool		bForward;	/**< Integration direction. */
+		bool		bTerminated;/**< True, if the integration left the domain or the valid time span. */
+		IntegrationState() 
+			:fStartTime(0), fTimeStep(0), fDeltaTime(0), stepLen(0), nNumSteps(0), bForward(true), bTerminated(false) {}
+	};
+
 public:
 	CAmiraVectorField2D();	//path to amira file as parameter
 	~CAmiraVectorField2D(void);
@@ -105,8 +158,66 @@ public:
 	 *	@param bForward If true, forward integration is performed, otherwise backward integration
 	 *	@param pOutBuff Pointer to a std::vector to hold the vertices of the resulting stream line in domain space
 	 *	@param rcIntegrationDomain Rectangular region in which the integration is performed. can be <= to the domain rectangle of the vector field.
+	 *	@param pState Optional pointer to an IntegrationState, that receives the end state of the integration.
+	 */
+	void integrateRK4(const CVector3D &pos, int nNumSteps, float stepLen, bool bForward, vector<CPointf> *pOutBuff, const CRectF &rcIntegrationDomain, IntegrationState *pState = nullptr) const;
+
+	/**
+	 *	Changes the length of a line, previously computed by integrateRK4().
+	 *	If the line grows, integration continues from the stored end state and only the new vertices are computed.
+	 *	If the line shrinks, the surplus vertices are removed and the end state is rewound.
+	 *
+	 *	@param state End state of the previous integration. Will be updated.
+	 *	@param nNumSteps New maximum number of integration steps.
+	 *	@param pOutBuff Pointer to the std::vector, that holds the vertices of the previous integration.
+	 *
+	 *	@remarks The function assumes, that pOutBuff was not modified since the integration that produced state.
+	 */
+	void resizeIntegration(IntegrationState &state, int nNumSteps, vector<CPointf> *pOutBuff) const;
+
+	/**
+	 *	Traces a stream line at the current time step cell by cell, see CVectorField2D::integrateCellwise().
+	 *
+	 *	@param pos Starting position of integration in domain space
+	 *	@param nNumSteps Maximum number of vertices of the resulting stream line.
+	 *	@param stepLen Distance between two vertices in terms of the integration parameter, in grid space.
+	 *	@param bForward If true, forward integration is performed, otherwise backward integration
+	 *	@param pOutBuff Pointer to a std::vector to hold the vertices of the resulting stream line in domain space
+	 *	@param rcIntegrationDomain Rectangular region in which the integration is performed. can be <= to the domain rectangle of the vector field.
+	 *
+	 *	@return The number of evaluations of the interpolant.
+	 *
+	 *	@remarks The result is equivalent to integrateRK4() with pos.z = 0, but requires far less field evaluations for small step lengths.
+	 */
+	int integrateCellwise(const CVector3D &pos, int nNumSteps, float stepLen, bool bForward, vector<CPointf> *pOutBuff, const CRectF &rcIntegrationDomain) const;
+
+	/**
+	 *	Advects a single particle through the time-dependent vector field (path line integration), 
+	 *	from one point in time to another.
+	 *
+	 *	@param pos Starting position in domain space. Receives the end position.
+	 *	@param fTimeFrom Start time, measured in time steps.
+	 *	@param fTimeTo End time, measured in time steps. If fTimeTo < fTimeFrom, the particle is advected backward in time.
+	 *	@param stepLen Maximum step length for the RK4 integrator in grid space.
+	 *
+	 *	@return Returns false, if the particle left the domain or reached a critical point before fTimeTo. 
+	 *			In this case, pos receives the last valid position.
+	 *
+	 *	@remarks This function does neither depend on, nor change the current time step. It can safely be called from multiple threads.
+	 */
+	bool advectParticle(CPointf &pos, float fTimeFrom, float fTimeTo, float stepLen) const;
+
+	/**
+	 *	Retrieve the velocity of a particle, as seen by advectParticle().
+	 *
+	 *	@param pos Position in domain space.
+	 *	@param fTime Time, measured in time steps.
+	 *
+	 *	@return The velocity in domain units per time step.
+	 *
+	 *	@remarks This function does not depend on the current time step and can safely be called from multiple threads.
 	 */
-	void integrateRK4(const CVector3D &pos, int nNumSteps, float stepLen, bool bForward, vector<CPointf> *pOutBuff, const CRectF &rcIntegrationDomain) const;
+	CVector2D GetParticleVelocity(const CPointf &pos, float fTime) const;
 
 	/**
 	 * Starts streak line integration, based on the RK4 integrator.
@@ -160,6 +271,7 @@ public:
 	 * Retrieve the current time step number.
 	 * For the first time step in a vector field, this function will return 0,
 	 * whereas for the last time step it will return (n-1), where n is the total number of time steps.
+	 * At a virtual frame, the preceding time step is returned.
 	 *
 	 * @return Current time step as unsigned integer.
 	 */
@@ -171,6 +283,7 @@ public:
 	 * Retrieve a pointer to the current time step.
 	 * The pointer points to the first element of the current time step.
 	 * The retrieved frame contains m_nSamplesX * m_nSamplesY elemnts.
+	 * At a virtual frame, the pointer refers to the interpolated samples, which must not be modified.
 	 *
 	 * @see GetExtentX()
 	 * @see GetExtentY()
@@ -178,6 +291,9 @@ public:
 	 * @return Pointer to the first element of the current time step as CVector2D*
 	 */
 	__inline CVector2D* GetCurrentFrame() const { 
+		if (m_pCurrVirtualFrame)
+			return const_cast<CVector2D*>(m_pCurrVirtualFrame->data());
+
 		return GetFrame(m_currTimeStep); 
 	}
 
@@ -251,13 +367,62 @@ public:
 	 * The current time step is set to timeStep.
 	 * The current time step is only changed, if the specified time step 
 	 * is greater 0 and less than the maximum number of time steps.
+	 * If it is changed, the current virtual frame is the time step itself.
 	 *
 	 * @return The current time step number
 	 */
 	__inline void GotoTimeStep(unsigned int timeStep) {
-		if (timeStep >= 0 && timeStep < m_numTimeSteps)
-			m_currTimeStep = timeStep;
+		if (timeStep >= 0 && timeStep < m_numTimeSteps) {
+			m_currTimeStep		= timeStep;
+			m_nCurrSubStep		= 0;
+			m_pCurrVirtualFrame	= nullptr;
+		}
 	}
+	/**
+	 * Set the temporal resolution of the virtual frames, and the interpolation scheme between time steps.
+	 * The current time is kept, if it is a virtual frame at the new resolution, otherwise the preceding time step becomes current.
+	 *
+	 * @param nSubSteps Number of virtual frames per interval between two time steps, including the time step itself. 1 disables resampling.
+	 * @param nInterpolation The interpolation scheme. It applies to all sampling and integration functions, not only to virtual frames.
+	 */
+	void SetTemporalResolution(unsigned int nSubSteps, TEMPORAL_INTERPOLATION nInterpolation = TI_LINEAR);
+	/**
+	 * Retrieve the number of virtual frames per interval between two time steps.
+	 */
+	__inline unsigned int GetTemporalResolution() const {
+		return m_nSubSteps;
+	}
+	/**
+	 * Retrieve the interpolation scheme between time steps.
+	 */
+	__inline TEMPORAL_INTERPOLATION GetTemporalInterpolation() const {
+		return m_nTemporalInterpolation;
+	}
+	/**
+	 * Retrieve the total number of virtual frames. Every time step is a virtual frame as well.
+	 */
+	__inline unsigned int GetNumVirtualFrames() const {
+		return (m_numTimeSteps > 0)? m_nMaxTimestep * m_nSubSteps + 1 : 0;
+	}
+	/**
+	 * Retrieve the index of the current virtual frame. The time step n is the virtual frame n * GetTemporalResolution().
+	 */
+	__inline unsigned int GetCurrentVirtualFrame() const {
+		return m_currTimeStep * m_nSubSteps + m_nCurrSubStep;
+	}
+	/**
+	 * Retrieve the current time, measured in time steps. It is fractional at virtual frames between two time steps.
+	 */
+	__inline float GetCurrentTime() const {
+		return static_cast<float>(m_currTimeStep) + static_cast<float>(m_nCurrSubStep) / static_cast<float>(m_nSubSteps);
+	}
+	/**
+	 * Go to the specified virtual frame. It is interpolated in a parallel pass, unless it is a time step, 
+	 * or was used recently. The current virtual frame is only changed, if nFrame is less than GetNumVirtualFrames().
+	 *
+	 * @param nFrame The index of the virtual frame.
+	 */
+	void GotoVirtualFrame(unsigned int nFrame);
 
 		//Probing functions
 public:
@@ -315,6 +480,37 @@ public:
 	*/
 	virtual CVector2D GetVectorAt(const CPointf &point) const;
 
+	/**
+	 *	Retrieve the vector at the specified location at the current time, pre-filtered for an area of the size of fFootprint.
+	 *	Display functions use it to sample each pixel once, when zoomed out, without aliasing.
+	 *
+	 *	@param point Location to retrieve the vector from, in domain coordinates.
+	 *	@param fFootprint Size of the sampled area, e.g. a screen pixel, in domain units.
+	 *
+	 *	@return The interpolated vector as CVector2D.
+	 *
+	 *	@remarks	If the footprint is smaller than about a cell, the vector is interpolated as by GetVectorAt(). Otherwise it is 
+	 *				interpolated at the level of a mip-map of the current frame, whose cells are about as large as the footprint.
+	 *				Dead samples, e.g. NaN in masked regions, are left out, see CGridPyramid.
+	 *
+	 *				Levels are built on first use, without synchronization. This function is meant for the UI thread. Parallel code
+	 *				must call it once with the same footprint before its loop, so the level of the current frame exists, and the
+	 *				current time must not change during the loop.
+	 */
+	CVector2D GetVectorAt(const CPointf &point, float fFootprint) const;
+
+	/**
+	 *	Retrieve a coarse copy of the current frame, whose cells are about as large as fFootprint, see GetVectorAt(const CPointf&, float).
+	 *	Stream lines traced through it at a fixed step length in grid space cover the same number of footprints at every zoom level.
+	 *
+	 *	@param fFootprint Size of a cell of the returned field in domain units.
+	 *	@param occupancy Receives the occupancy of the returned field, which the field refers to. It must outlive the field.
+	 *
+	 *	@return A pointer to a new CVectorField2D in the current reference frame, which the caller is responsible for deleting, 
+	 *			or nullptr, if the footprint is smaller than about a cell.
+	 */
+	CVectorField2D* GetCoarseVectorField(float fFootprint, COccupancyGrid &occupancy) const;
+
 	/**
 	 *	Returns the vorticity value at the specified location at the specified time
 	 *
@@ -372,6 +568,51 @@ public:
 	*/
 	virtual CScalarField2D* GetVorticityField(CRectF rect, bool bGetMagnitude = false, float time = -1) const;
 
+	/**
+	 *	Computes the vorticity of a block of samples of a time step, see CVectorField2D::GetVorticity().
+	 *
+	 *	@param nFrame The time step.
+	 *	@param nMinX Index of the first column of the block.
+	 *	@param nMinY Index of the first row of the block.
+	 *	@param nWidth Number of columns of the block.
+	 *	@param nHeight Number of rows of the block.
+	 *	@param pOut Receives the vorticity of the block, row by row.
+	 *	@param nStride Distance between two rows in pOut, in elements.
+	 */
+	void GetVorticity(int nFrame, int nMinX, int nMinY, int nWidth, int nHeight, float *pOut, int nStride) const;
+
+	/**
+	 *	Computes the temporal derivative dv/dt of a time step by central differences between its neighbouring time steps.
+	 *	One-sided differences are used at the first and the last time step. The derivative is measured per second.
+	 *
+	 *	@param nFrame The time step. It is clamped to the valid time steps.
+	 *
+	 *	@return A pointer to a new CVectorField2D on the grid of this field. The caller is responsible for deleting it.
+	 *
+	 *	@remarks	The derivative is taken in the current reference frame, i.e. the acceleration of a RF_REGION_MEAN frame is subtracted.
+	 *				Use a CTemporalDerivativeCache to avoid computing the same time step repeatedly.
+	 */
+	CVectorField2D* GetTemporalDerivativeField(int nFrame) const;
+
+	/**
+	 *	Computes several scalar fields derived from the velocity gradient of a time step in a single pass, see CVectorField2D::GetDerivedFields().
+	 *
+	 *	@param nFields Combination of DERIVED_FIELD flags.
+	 *	@param ppFields Array of DF_NUM_FIELDS pointers, receives the requested fields.
+	 *	@param time Time step. If time is < 0, the fields are obtained from the current time step.
+	 *	@param bLabFrame If true, the vector magnitude is computed in the lab frame, regardless of the reference frame.
+	 */
+	void GetDerivedFields(unsigned int nFields, CScalarField2D **ppFields, float time = -1, bool bLabFrame = false) const;
+
+	/**
+	 *	Computes the vorticity field of a time step and its magnitude in a single sweep, see CVectorField2D::GetVorticityFields().
+	 *
+	 *	@param ppVorticity If not nullptr, receives the new vorticity field.
+	 *	@param ppVorticityAbs If not nullptr, receives the new vorticity magnitude field.
+	 *	@param time Time step. If time is < 0, the fields are obtained from the current time step.
+	 */
+	void GetVorticityFields(CScalarField2D **ppVorticity, CScalarField2D **ppVorticityAbs, float time = -1) const;
+
 	/**
 	 *	Retrieves the Jacobian at the specified location and time.
 	 *	Directional derivatives are in X, Y and temporal direction.
@@ -422,6 +663,73 @@ public:
 		return m_fExtentZ;
 	}
 
+	/**
+	 *	Observe the vector field in the lab frame, i.e. return the vectors as stored.
+	 */
+	void ResetReferenceFrame();
+
+	/**
+	 *	Observe the vector field in a frame moving with a constant velocity. 
+	 *
+	 *	@param velocity Velocity of the reference frame, in the units of the samples.
+	 *
+	 *	@see CVectorField2D::SetReferenceVelocity()
+	 */
+	void SetReferenceFrame(const CVector2D &velocity);
+
+	/**
+	 *	Observe the vector field in a frame moving with the mean velocity of a region. The mean velocity of a 
+	 *	time step is computed, when the time step is sampled for the first time.
+	 *
+	 *	@param rcRegion The region in domain coordinates. It is clamped to the domain, and covers at least one sample.
+	 */
+	void SetReferenceFrame(const CRectF &rcRegion);
+
+	/**
+	 *	Retrieve the type of the current reference frame.
+	 */
+	__inline REFERENCE_FRAME GetReferenceFrame() const {
+		return m_nReferenceFrame;
+	}
+
+	/**
+	 *	Retrieve the region of a RF_REGION_MEAN reference frame.
+	 */
+	__inline const CRectF& GetReferenceRegion() const {
+		return m_rcReferenceRegion;
+	}
+
+	/**
+	 *	Retrieve the velocity of the reference frame at a time step. It is subtracted from every vector of the time step,
+	 *	by all sampling and integration functions of this CAmiraVectorField2D.
+	 *
+	 *	@param nTimeStep The time step.
+	 */
+	CVector2D GetReferenceVelocityAt(int nTimeStep) const;
+
+	/**
+	 *	Computes the mean velocity of a region at a time step in the lab frame. This is the translation, that fits the 
+	 *	velocities inside the region best in the least squares sense.
+	 *
+	 *	@param rcRegion The region in domain coordinates. If it contains no sample, the sample closest to its center is used. Samples, that are not finite, are ignored.
+	 *	@param nTimeStep The time step.
+	 */
+	CVector2D GetMeanVelocity(const CRectF &rcRegion, int nTimeStep) const;
+
+	/**
+	 *	Retrieve the grid of the cells of a time step, that contain flow. It is built in a parallel pass on first use.
+	 *	Integrators stop on entering a dead cell, and display and seeding functions should skip them.
+	 *
+	 *	@param nTimeStep The time step. It is clamped to the valid time steps.
+	 *
+	 *	@return A pointer to the grid, which is owned by this CAmiraVectorField2D and stays valid until the next call to Init(),
+	 *			or nullptr if the field holds no data.
+	 *
+	 *	@remarks	The occupancy refers to the stored vectors and is independent of the reference frame. 
+	 *				It may be requested from multiple threads.
+	 */
+	const COccupancyGrid* GetOccupancy(int nTimeStep) const;
+
 protected:
 	/**
 	 *	Retrieve the bi-linearly interpolated vextor at the specified location.
@@ -445,6 +753,29 @@ protected:
 	 *	@return A CVector2D with the components ( u(x,y,t), v(x,y,t) )
 	 */
 	CVector2D _getVectorAt(float x, float y, float time) const;//Amira
+	/**
+	 *	Retrieve the time steps and their weights, which are blended at a point in time, according to m_nTemporalInterpolation.
+	 *
+	 *	@param time The time, measured in time steps. It is clamped to the valid time span.
+	 *	@param pFrames Array of 4 elements, receives the time steps.
+	 *	@param pWeights Array of 4 elements, receives the weights of the time steps.
+	 *
+	 *	@return The number of time steps to be blended. It is 1, if time is a time step.
+	 */
+	int _getTemporalStencil(float time, int *pFrames, float *pWeights) const;
+
+	/**
+	 *	Retrieve the velocity of the reference frame at the current time, interpolated in time like the vectors.
+	 */
+	CVector2D _getCurrentReferenceVelocity() const;
+
+	/**
+	 *	Retrieve m_FramePyramid, initialized for the current frame.
+	 *
+	 *	@param fFootprint Size of a footprint in domain units.
+	 *	@param nLevel Receives the level of m_FramePyramid, that matches the footprint.
+	 */
+	CGridPyramid& _getFramePyramid(float fFootprint, int &nLevel) const;
 
 	/**
 	 *	@see GetJacobian(float dx, float dy, float t, arma::fmat33 *pJacobian)
@@ -474,21 +805,24 @@ protected:
 	bool _integrateStreakLine(float fStepLen, float deltaTime, float &fTimeStep, bool &bError, vector<particle> &vertexBuff, int nIterations) const;
 
 	/**
-	 *	Retrieves a pointer to the time slice at the current time step.
+	 *	Retrieves a pointer to the time slice at the current time step, or at the current virtual frame.
+	 *
+	 *	@param	bLabFrame If true, the returned field is in the lab frame, regardless of the reference frame.
 	 *
-	 *	@return a Pointer to a new CVectorField2D, representing the specified time step.
+	 *	@return a Pointer to a new CVectorField2D, representing the current time.
 	 *
 	 *	@remarks	The returned CVectorField2D holds a pointer into the original data held by this CAmiraVectorField and must not be deleted by the user!
 	 *				The m_pData member of the returned CVectorField2D must be set to nullptr, before the CVectorField2D is deleted.
 	 */
-	CVectorField2D* _getCurrentVectorFieldPtr() const;
+	CVectorField2D* _getCurrentVectorFieldPtr(bool bLabFrame = false) const;
 
 	/**
 	 *	Retrieves a pointer to the time slice at the specified time step.
 	 *
 	 *	@param	The time step at which the vector field is to be retrieved.
+	 *	@param	bLabFrame If true, the returned field is in the lab frame, regardless of the reference frame.
 	 *
-	 *	@return a Pointer to a new CVectorField2D, representing the specified time step.
+	 *	@return a Pointer to a new CVectorField2D, representing the specified time step in the current reference frame.
 	 *
 	 *	@remarks	This function does not validate the specified time step.
 	 *				If a negative or too large value is given the behaviour of this function is undefined.
@@ -496,7 +830,12 @@ protected:
 	 *				The returned CVectorField2D holds a pointer into the original data held by this CAmiraVectorField and must not be deleted by the user!
 	 *				The m_pData member of the returned CVectorField2D must be set to nullptr, before the CVectorField2D is deleted.
 	 */
-	CVectorField2D* _getVectorFieldPtr(int time) const;
+	CVectorField2D* _getVectorFieldPtr(int time, bool bLabFrame = false) const;
+
+	/**
+	 *	Deletes the occupancy grids of all time steps.
+	 */
+	void _freeOccupancy();
 
 	/**
 	 *	Validates, if a gives position in grid coordinates is inside the sample grid boundaries.
@@ -532,6 +871,15 @@ private:
 	 */
 	CVector3D _RK4(const CVector3D &pos, float fTimeStep, float stepLen, float fDir, bool &bError, bool bNormalize=false) const;
 
+	/**
+	 *	Continues an RK4 integration from the given state, until state.nNumSteps equals nNumSteps or the integration terminates.
+	 *
+	 *	@param state The state to continue from. Will be updated.
+	 *	@param nNumSteps Maximum number of vertices of the resulting line.
+	 *	@param pOutBuff Pointer to a std::vector to receive the new vertices.
+	 */
+	void _continueRK4(IntegrationState &state, int nNumSteps, vector<CPointf> *pOutBuff) const;
+
 	friend class CAmiraReader;
 };
 
@@ -0,0 +1,332 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "StdAfx.h"
+#include "CriticalPointTracker.h"
+#include <math.h>
+#include <algorithm>
+
+#define CPT_MAX_NEWTON_ITERATIONS	8		//Maximum number of Newton iterations per time step
+#define CPT_MAX_STEP				2.0f	//Maximum length of a single Newton step in cells
+#define CPT_MERGE_DIST				0.5f	//Critical points closer than this (in cells) are considered to collide
+#define CPT_MATCH_DIST				1.0f	//Extracted critical points closer than this (in cells) to a track are no births
+
+//Compares two entries of the list built by _sortByCell by their cell only
+static bool _cellLess(const pair<int, int> &a, const pair<int, int> &b)
+{
+	return a.first < b.first;
+}
+
+//Sorts locations in grid space by the index of the cell they fall into
+static void _sortByCell(const vector<CPointf> &positions, const vector<int> &indices, int nCellsX, vector< pair<int, int> > &keys)
+{
+	keys.clear();
+	keys.reserve(indices.size());
+
+	for (size_t i = 0; i < indices.size(); i++) 
+	{
+		const CPointf &pt = positions[indices[i]];
+		keys.push_back( make_pair(static_cast<int>(pt.y) * nCellsX + static_cast<int>(pt.x), static_cast<int>(i)) );
+	}
+
+	sort(keys.begin(), keys.end());
+}
+
+CCriticalPointTracker::CCriticalPointTracker(const CAmiraVectorField2D *pVecField, CCriticalPointCache *pCache)
+{
+	m_pVecField			= pVecField;
+	m_pCache			= pCache;
+	m_nBirthInterval	= 10;
+}
+
+CCriticalPointTracker::~CCriticalPointTracker(void)
+{
+}
+
+void CCriticalPointTracker::SetBirthInterval(int nInterval)
+{
+	m_nBirthInterval = max(nInterval, 0);
+}
+
+bool CCriticalPointTracker::_evaluate(int nFrame, float x, float y, CVector2D &v, float J[4]) const
+{
+	const int nx = static_cast<int>(m_pVecField->GetExtentX());
+	const int ny = static_cast<int>(m_pVecField->GetExtentY());
+
+	if (x < 0.0f || y < 0.0f || x > nx - 1 || y > ny - 1) return false;
+
+	const int px = min(static_cast<int>(x), nx - 2);
+	const int py = min(static_cast<int>(y), ny - 2);
+	const float s = x - px;
+	const float t = y - py;
+
+	const CVector2D *pRow0 = m_pVecField->GetFrame(nFrame) + py * nx + px;
+	const CVector2D *pRow1 = pRow0 + nx;
+
+	const float a1 = pRow0[1].x - pRow0[0].x, a2 = pRow1[0].x - pRow0[0].x, a3 = pRow0[0].x - pRow0[1].x - pRow1[0].x + pRow1[1].x;
+	const float b1 = pRow0[1].y - pRow0[0].y, b2 = pRow1[0].y - pRow0[0].y, b3 = pRow0[0].y - pRow0[1].y - pRow1[0].y + pRow1[1].y;
+
+	v.x = pRow0[0].x + a1*s + a2*t + a3*s*t;
+	v.y = pRow0[0].y + b1*s + b2*t + b3*s*t;
+	v -= m_pVecField->GetReferenceVelocityAt(nFrame);
+
+	J[0] = a1 + a3*t;
+	J[1] = a2 + a3*s;
+	J[2] = b1 + b3*t;
+	J[3] = b2 + b3*s;
+
+	return true;
+}
+
+bool CCriticalPointTracker::_advance(int nFrame, float &x, float &y) const
+{
+	CVector2D v0, v1;
+	float J[4], J1[4];
+
+	if (!_evaluate(nFrame, x, y, v0, J) || !_evaluate(nFrame + 1, x, y, v1, J1)) return false;
+
+	//Predictor: dx/dt = -J^-1 * dv/dt
+	float px(x), py(y);
+	float det = J[0]*J[3] - J[1]*J[2];
+
+	if (det != 0.0f)
+	{
+		const CVector2D dv(v1 - v0);
+		const float dx = -( J[3]*dv.x - J[1]*dv.y) / det;
+		const float dy = -(-J[2]*dv.x + J[0]*dv.y) / det;
+
+		if (dx*dx + dy*dy < CPT_MAX_STEP*CPT_MAX_STEP) {
+			px += dx;
+			py += dy;
+		}
+	}
+
+	//Corrector: Newton's method on the next time step
+	for (int i = 0; i < CPT_MAX_NEWTON_ITERATIONS; i++)
+	{
+		CVector2D v;
+		if (!_evaluate(nFrame + 1, px, py, v, J)) return false;
+
+		const float fScale = max( max(fabs(J[0]), fabs(J[1])), max(fabs(J[2]), fabs(J[3])) );
+		det = J[0]*J[3] - J[1]*J[2];
+
+		if (fabs(det) <= 1e-6f * fScale * fScale) return false;	//Degenerate, typically right before a pair annihilation
+
+		const float sx = ( J[3]*v.x - J[1]*v.y) / det;
+		const float sy = (-J[2]*v.x + J[0]*v.y) / det;
+		const float fStep2 = sx*sx + sy*sy;
+
+		if (fStep2 > CPT_MAX_STEP*CPT_MAX_STEP) return false;
+
+		px -= sx;
+		py -= sy;
+
+		if (fStep2 < 1e-8f) {
+			x = px;
+			y = py;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+CriticalPoint CCriticalPointTracker::_makeCriticalPoint(int nFrame, float x, float y) const
+{
+	const CRectF rcDomain	= m_pVecField->GetDomainRect();
+	const float fCellX		= rcDomain.getWidth() / (m_pVecField->GetExtentX() - 1);
+	const float fCellY		= rcDomain.getHeight() / (m_pVecField->GetExtentY() - 1);
+
+	CVector2D v;
+	float J[4];
+	_evaluate(nFrame, x, y, v, J);
+
+	CriticalPoint cp;
+	cp.pos		= CPointf(rcDomain.m_Min.x + x * fCellX, rcDomain.m_Min.y + y * fCellY);
+	cp.ux		= J[0] / fCellX;
+	cp.uy		= J[1] / fCellY;
+	cp.vx		= J[2] / fCellX;
+	cp.vy		= J[3] / fCellY;
+	cp.nType	= ClassifyCriticalPoint(cp.ux, cp.uy, cp.vx, cp.vy);
+
+	return cp;
+}
+
+size_t CCriticalPointTracker::Track(int nStartFrame, int nEndFrame)
+{
+	m_Tracks.clear();
+
+	if (!m_pVecField || !m_pCache || m_pVecField->GetExtentX() < 2 || m_pVecField->GetExtentY() < 2) return 0;
+
+	const int nMaxFrame = static_cast<int>(m_pVecField->GetNumTimeSteps()) - 1;
+	nStartFrame = min(max(nStartFrame, 0), nMaxFrame);
+	nEndFrame	= min(max(nEndFrame, nStartFrame), nMaxFrame);
+
+	const int nCellsX		= static_cast<int>(m_pVecField->GetExtentX()) - 1;
+	const CRectF rcDomain	= m_pVecField->GetDomainRect();
+	const float fCellX		= rcDomain.getWidth() / nCellsX;
+	const float fCellY		= rcDomain.getHeight() / (m_pVecField->GetExtentY() - 1);
+
+	vector<CPointf>	positions;	//Current location of each track in grid space
+	vector<int>		active;		//Indices of the tracks, that are still alive
+
+	for (int nFrame = nStartFrame; nFrame <= nEndFrame; nFrame++)
+	{
+		//Start new tracks for critical points, that are not yet tracked
+		if (nFrame == nStartFrame || (m_nBirthInterval > 0 && (nFrame - nStartFrame) % m_nBirthInterval == 0))
+		{
+			const vector<CriticalPoint> *pPoints = m_pCache->GetCriticalPoints(nFrame);
+
+			vector< pair<int, int> > keys;
+			_sortByCell(positions, active, nCellsX, keys);
+
+			for (auto iter = pPoints->begin(); iter != pPoints->end(); ++iter)
+			{
+				const CPointf pt( (iter->pos.x - rcDomain.m_Min.x) / fCellX, (iter->pos.y - rcDomain.m_Min.y) / fCellY );
+				const int cx = static_cast<int>(pt.x);
+				const int cy = static_cast<int>(pt.y);
+				bool bTracked = false;
+
+				for (int ny = cy - 1; ny <= cy + 1 && !bTracked; ny++)
+				{
+					for (int nx = cx - 1; nx <= cx + 1 && !bTracked; nx++)
+					{
+						auto range = equal_range(keys.begin(), keys.end(), make_pair(ny * nCellsX + nx, -1), _cellLess);
+
+						for (auto k = range.first; k != range.second; ++k)
+						{
+							const CPointf &ptTrack = positions[active[k->second]];
+							if (CVector2D(ptTrack.x - pt.x, ptTrack.y - pt.y).abs() < CPT_MATCH_DIST) {
+								bTracked = true;
+								break;
+							}
+						}
+					}
+				}
+
+				if (!bTracked)
+				{
+					CriticalPointTrack track;
+					track.nStartFrame	= nFrame;
+					track.bBirth		= (nFrame != nStartFrame);
+					track.bDeath		= false;
+					track.points.push_back(*iter);
+
+					active.push_back( static_cast<int>(m_Tracks.size()) );
+					positions.push_back(pt);
+					m_Tracks.push_back(track);
+				}
+			}
+		}
+
+		if (nFrame == nEndFrame) break;
+
+		//Continue all tracks to the next time step
+		const int nNumActive = static_cast<int>(active.size());
+		vector<char> alive(nNumActive);
+
+		#pragma omp parallel for schedule(dynamic, 64)
+		for (int i = 0; i < nNumActive; i++)
+		{
+			CPointf &pt = positions[active[i]];
+			alive[i] = _advance(nFrame, pt.x, pt.y)? 1 : 0;
+		}
+
+		//Detect collisions. Older tracks come first in active, so duplicates of a track are always the younger one.
+		vector<int> survivors;
+		for (int i = 0; i < nNumActive; i++) {
+			if (alive[i]) survivors.push_back(active[i]);
+		}
+
+		vector< pair<int, int> > keys;
+		_sortByCell(positions, survivors, nCellsX, keys);
+
+		vector<char> collided(survivors.size(), 0);
+
+		for (size_t i = 0; i < survivors.size(); i++)
+		{
+			if (collided[i]) continue;
+
+			const CPointf &pt = positions[survivors[i]];
+			const int cx = static_cast<int>(pt.x);
+			const int cy = static_cast<int>(pt.y);
+
+			for (int ny = cy - 1; ny <= cy + 1; ny++)
+			{
+				for (int nx = cx - 1; nx <= cx + 1; nx++)
+				{
+					auto range = equal_range(keys.begin(), keys.end(), make_pair(ny * nCellsX + nx, -1), _cellLess);
+
+					for (auto k = range.first; k != range.second; ++k)
+					{
+						const size_t j = k->second;
+						if (j <= i || collided[j]) continue;
+
+						const CPointf &ptOther = positions[survivors[j]];
+						if (CVector2D(ptOther.x - pt.x, ptOther.y - pt.y).abs() >= CPT_MERGE_DIST) continue;
+
+						CVector2D v;
+						float Ji[4], Jj[4];
+						_evaluate(nFrame + 1, pt.x, pt.y, v, Ji);
+						_evaluate(nFrame + 1, ptOther.x, ptOther.y, v, Jj);
+
+						const float detI = Ji[0]*Ji[3] - Ji[1]*Ji[2];
+						const float detJ = Jj[0]*Jj[3] - Jj[1]*Jj[2];
+
+						//Opposite index: pair annihilation. Same index: both converged to the same critical point.
+						if ( (detI < 0.0f) != (detJ < 0.0f) ) {
+							collided[i] = 1;
+						}
+						collided[j] = 1;
+					}
+				}
+			}
+		}
+
+		vector<int> nextActive;
+		nextActive.reserve(survivors.size());
+
+		for (size_t i = 0; i < survivors.size(); i++)
+		{
+			if (collided[i]) {
+				m_Tracks[survivors[i]].bDeath = true;
+			} else {
+				const CPointf &pt = positions[survivors[i]];
+				m_Tracks[survivors[i]].points.push_back( _makeCriticalPoint(nFrame + 1, pt.x, pt.y) );
+				nextActive.push_back(survivors[i]);
+			}
+		}
+
+		for (int i = 0; i < nNumActive; i++) {
+			if (!alive[i]) m_Tracks[active[i]].bDeath = true;
+		}
+
+		active.swap(nextActive);
+	}
+
+	return m_Tracks.size();
+}
@@ -0,0 +1,133 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+#include "CriticalPoints.h"
+#include <vector>
+
+using namespace std;
+
+/**
+ *	The path of a single critical point through time.
+ */
+struct CriticalPointTrack
+{
+	int						nStartFrame;	/**< Time step of the first entry of points. */
+	bool					bBirth;			/**< If true, the critical point appeared after the first tracked time step. */
+	bool					bDeath;			/**< If true, the critical point vanished before the last tracked time step. */
+	vector<CriticalPoint>	points;			/**< The critical point at each time step, starting at nStartFrame. */
+};
+
+/**
+ *	CCriticalPointTracker follows the critical points of a CAmiraVectorField2D through time.
+ *
+ *	Each critical point is continued to the next time step by a feature flow predictor, 
+ *	dx/dt = -J^-1 * dv/dt, followed by a few Newton iterations on the bi-linear interpolant of the next time step.
+ *	The costs are proportional to the number of critical points, independent of the size of the domain.
+ *
+ *	A critical point dies, if Newton's method fails to converge, or if it collides with a critical point of opposite index 
+ *	(pair annihilation of a saddle and a non-saddle). Births cannot be predicted locally. They are detected by extracting 
+ *	all critical points of every n-th time step with a CCriticalPointCache and starting a new track for each unmatched one.
+ */
+class CCriticalPointTracker
+{
+protected:
+	const CAmiraVectorField2D	*m_pVecField;		/**< The vector field. */
+	CCriticalPointCache			*m_pCache;			/**< Provides the critical points of the first time step, and those used to detect births. */
+	int							 m_nBirthInterval;	/**< Number of time steps between two searches for new critical points. Zero disables the search. */
+	vector<CriticalPointTrack>	 m_Tracks;			/**< The tracks of the last call to Track(). */
+
+public:
+	/**
+	 *	Construct a new CCriticalPointTracker.
+	 *
+	 *	@param pVecField Pointer to the vector field.
+	 *	@param pCache Pointer to a CCriticalPointCache, initialized for pVecField.
+	 */
+	CCriticalPointTracker(const CAmiraVectorField2D *pVecField, CCriticalPointCache *pCache);
+	~CCriticalPointTracker(void);
+
+public:
+	/**
+	 *	Set the number of time steps between two searches for new critical points. The default is 10.
+	 *
+	 *	@param nInterval The number of time steps. If zero, only the critical points of the first time step are tracked.
+	 */
+	void SetBirthInterval(int nInterval);
+
+	/**
+	 *	Tracks all critical points from one time step to another. Results of a previous call are discarded.
+	 *
+	 *	@param nStartFrame First time step.
+	 *	@param nEndFrame Last time step. Must not be smaller than nStartFrame.
+	 *
+	 *	@return The number of tracks.
+	 */
+	size_t Track(int nStartFrame, int nEndFrame);
+
+	/**
+	 *	Retrieve the number of tracks.
+	 */
+	__inline size_t GetNumTracks() const { return m_Tracks.size(); }
+
+	/**
+	 *	Retrieve a single track.
+	 *
+	 *	@param nIdx Index of the track.
+	 */
+	__inline const CriticalPointTrack& GetTrack(size_t nIdx) const { return m_Tracks[nIdx]; }
+
+protected:
+	/**
+	 *	Evaluates the bi-linear interpolant of a time step and its Jacobian, in grid space.
+	 *
+	 *	@param nFrame The time step.
+	 *	@param x X-component of the location in grid space.
+	 *	@param y Y-component of the location in grid space.
+	 *	@param v Receives the vector.
+	 *	@param J Receives the Jacobian (u_x, u_y, v_x, v_y) in grid units.
+	 *
+	 *	@return Returns false, if the location lies outside the grid.
+	 */
+	bool _evaluate(int nFrame, float x, float y, CVector2D &v, float J[4]) const;
+
+	/**
+	 *	Continues a critical point to the next time step.
+	 *
+	 *	@param nFrame The time step of the critical point.
+	 *	@param x X-component of the location in grid space. Receives the location in the next time step.
+	 *	@param y Y-component of the location in grid space. Receives the location in the next time step.
+	 *
+	 *	@return Returns false, if the critical point could not be found in the next time step.
+	 */
+	bool _advance(int nFrame, float &x, float &y) const;
+
+	/**
+	 *	Converts a location in grid space of a time step into a CriticalPoint.
+	 */
+	CriticalPoint _makeCriticalPoint(int nFrame, float x, float y) const;
+};
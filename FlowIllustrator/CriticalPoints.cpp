@@ -0,0 +1,218 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "StdAfx.h"
+#include "CriticalPoints.h"
+#include <math.h>
+
+#define CP_BAND_ROWS 16		//Number of cell rows processed as one parallel task
+
+CCriticalPointCache::CCriticalPointCache()
+{
+	m_pVecField = nullptr;
+}
+
+CCriticalPointCache::~CCriticalPointCache()
+{
+	Clear();
+}
+
+void CCriticalPointCache::Init(const CAmiraVectorField2D *pVecField)
+{
+	if (pVecField == m_pVecField) return;
+
+	Clear();
+
+	m_pVecField = pVecField;
+
+	if (m_pVecField) {
+		m_Frames.resize(m_pVecField->GetNumTimeSteps(), nullptr);
+	}
+}
+
+void CCriticalPointCache::Clear()
+{
+	for (auto iter = m_Frames.begin(); iter != m_Frames.end(); ++iter) {
+		delete (*iter);
+	}
+
+	m_Frames.clear();
+	m_pVecField = nullptr;
+}
+
+const vector<CriticalPoint>* CCriticalPointCache::GetCriticalPoints(int nFrame)
+{
+	if (!m_pVecField || nFrame < 0 || nFrame >= static_cast<int>(m_Frames.size())) return nullptr;
+
+	if (!m_Frames[nFrame])
+	{
+		vector<CriticalPoint> *pPoints = new vector<CriticalPoint>;
+		Extract(m_pVecField, nFrame, *pPoints);
+		m_Frames[nFrame] = pPoints;
+	}
+
+	return m_Frames[nFrame];
+}
+
+void CCriticalPointCache::Extract(const CAmiraVectorField2D *pVecField, int nFrame, vector<CriticalPoint> &points)
+{
+	points.clear();
+
+	const int nx = static_cast<int>(pVecField->GetExtentX());
+	const int ny = static_cast<int>(pVecField->GetExtentY());
+
+	if (nx < 2 || ny < 2 || nFrame < 0 || nFrame >= static_cast<int>(pVecField->GetNumTimeSteps())) return;
+
+	const CVector2D *pData	= pVecField->GetFrame(nFrame);
+	const CVector2D vRef	= pVecField->GetReferenceVelocityAt(nFrame);
+	const CRectF rcDomain	= pVecField->GetDomainRect();
+	const float fCellX		= rcDomain.getWidth() / (nx - 1);
+	const float fCellY		= rcDomain.getHeight() / (ny - 1);
+
+	const int nNumBands = (ny - 1 + CP_BAND_ROWS - 1) / CP_BAND_ROWS;
+	vector< vector<CriticalPoint> > bands(nNumBands);
+
+	#pragma omp parallel for schedule(dynamic)
+	for (int nBand = 0; nBand < nNumBands; nBand++)
+	{
+		const int yMax = min((nBand + 1) * CP_BAND_ROWS, ny - 1);
+
+		for (int y = nBand * CP_BAND_ROWS; y < yMax; y++)
+		{
+			const CVector2D *pRow0 = &pData[y * nx];
+			const CVector2D *pRow1 = pRow0 + nx;
+
+			for (int x = 0; x < nx - 1; x++)
+			{
+				//Critical points depend on the reference frame
+				const CVector2D v00 = pRow0[x] - vRef;
+				const CVector2D v10 = pRow0[x+1] - vRef;
+				const CVector2D v01 = pRow1[x] - vRef;
+				const CVector2D v11 = pRow1[x+1] - vRef;
+
+				//The bi-linear interpolant stays within the range of the corner values
+				if ( (v00.x > 0.0f && v10.x > 0.0f && v01.x > 0.0f && v11.x > 0.0f) ||
+					 (v00.x < 0.0f && v10.x < 0.0f && v01.x < 0.0f && v11.x < 0.0f) ||
+					 (v00.y > 0.0f && v10.y > 0.0f && v01.y > 0.0f && v11.y > 0.0f) ||
+					 (v00.y < 0.0f && v10.y < 0.0f && v01.y < 0.0f && v11.y < 0.0f) ) {
+					continue;
+				}
+
+				float s[2], t[2];
+				const int nNumZeros = _solveCell(v00, v10, v01, v11, x == nx - 2, y == ny - 2, s, t);
+
+				for (int i = 0; i < nNumZeros; i++)
+				{
+					const float a1 = v10.x - v00.x, a2 = v01.x - v00.x, a3 = v00.x - v10.x - v01.x + v11.x;
+					const float b1 = v10.y - v00.y, b2 = v01.y - v00.y, b3 = v00.y - v10.y - v01.y + v11.y;
+
+					CriticalPoint cp;
+					cp.pos		= CPointf(rcDomain.m_Min.x + (x + s[i]) * fCellX, rcDomain.m_Min.y + (y + t[i]) * fCellY);
+					cp.ux		= (a1 + a3 * t[i]) / fCellX;
+					cp.uy		= (a2 + a3 * s[i]) / fCellY;
+					cp.vx		= (b1 + b3 * t[i]) / fCellX;
+					cp.vy		= (b2 + b3 * s[i]) / fCellY;
+					cp.nType	= ClassifyCriticalPoint(cp.ux, cp.uy, cp.vx, cp.vy);
+
+					bands[nBand].push_back(cp);
+				}
+			}
+		}
+	}
+
+	size_t nNumPoints(0);
+	for (int i = 0; i < nNumBands; i++) nNumPoints += bands[i].size();
+
+	points.reserve(nNumPoints);
+	for (int i = 0; i < nNumBands; i++) {
+		points.insert(points.end(), bands[i].begin(), bands[i].end());
+	}
+}
+
+int CCriticalPointCache::_solveCell(const CVector2D &v00, const CVector2D &v10, const CVector2D &v01, const CVector2D &v11, bool bLastX, bool bLastY, float s[2], float t[2])
+{
+	//u(s,t) = a0 + a1*s + a2*t + a3*s*t, v(s,t) accordingly with b
+	const double a0 = v00.x, a1 = v10.x - v00.x, a2 = v01.x - v00.x, a3 = v00.x - v10.x - v01.x + v11.x;
+	const double b0 = v00.y, b1 = v10.y - v00.y, b2 = v01.y - v00.y, b3 = v00.y - v10.y - v01.y + v11.y;
+
+	//Eliminating s from u = 0 and v = 0 yields A*t^2 + B*t + C = 0
+	const double A = b2*a3 - b3*a2;
+	const double B = b0*a3 + b2*a1 - b1*a2 - b3*a0;
+	const double C = b0*a1 - b1*a0;
+
+	const double fScale = max( max(fabs(A), fabs(B)), fabs(C) );
+	if (fScale == 0.0) return 0;	//Both components vanish identically, or are linearly dependent
+
+	double roots[2];
+	int nNumRoots(0);
+
+	if (fabs(A) < 1e-9 * fScale)
+	{
+		if (fabs(B) < 1e-9 * fScale) return 0;
+		roots[nNumRoots++] = -C / B;
+	}
+	else
+	{
+		const double disc = B*B - 4.0*A*C;
+		if (disc < 0.0) return 0;
+
+		//Numerically stable form of the quadratic formula
+		const double q = -0.5 * (B + ((B < 0.0)? -sqrt(disc) : sqrt(disc)));
+
+		roots[nNumRoots++] = q / A;
+		if (q != 0.0 && disc > 0.0) roots[nNumRoots++] = C / q;
+	}
+
+	const double eps = 1e-7;
+	int nNumZeros(0);
+
+	for (int i = 0; i < nNumRoots; i++)
+	{
+		const double tt = roots[i];
+		if (tt < 0.0 || tt > 1.0 + eps || (!bLastY && tt >= 1.0)) continue;
+
+		//Solve for s with the better conditioned of both equations
+		const double du = a1 + a3*tt;
+		const double dv = b1 + b3*tt;
+		double ss;
+
+		if (fabs(du) >= fabs(dv)) {
+			if (du == 0.0) continue;
+			ss = -(a0 + a2*tt) / du;
+		} else {
+			ss = -(b0 + b2*tt) / dv;
+		}
+
+		if (ss < 0.0 || ss > 1.0 + eps || (!bLastX && ss >= 1.0)) continue;
+
+		s[nNumZeros] = static_cast<float>( min(max(ss, 0.0), 1.0) );
+		t[nNumZeros] = static_cast<float>( min(max(tt, 0.0), 1.0) );
+		nNumZeros++;
+	}
+
+	return nNumZeros;
+}
@@ -0,0 +1,115 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+#include "AmiraVectorField2D.h"
+#include <vector>
+
+using namespace std;
+
+/**
+ *	A critical point (zero) of a 2D vector field.
+ */
+struct CriticalPoint
+{
+	CPointf				pos;		/**< Position in domain space. */
+	CRITICAL_POINT_TYPE	nType;		/**< Classification, see ClassifyCriticalPoint(). */
+	float				ux;			/**< Partial derivative du/dx of the bi-linear interpolant at pos, in domain units. */
+	float				uy;			/**< Partial derivative du/dy of the bi-linear interpolant at pos, in domain units. */
+	float				vx;			/**< Partial derivative dv/dx of the bi-linear interpolant at pos, in domain units. */
+	float				vy;			/**< Partial derivative dv/dy of the bi-linear interpolant at pos, in domain units. */
+};
+
+/**
+ *	CCriticalPointCache extracts all critical points of a frame of a CAmiraVectorField2D and caches them per frame.
+ *
+ *	Critical points are the exact zeros of the bi-linear interpolant. Each grid cell is solved in closed form,
+ *	cells, in which either component does not change its sign, are rejected after four comparisons.
+ *	The grid is processed in parallel, in bands of rows.
+ */
+class CCriticalPointCache
+{
+protected:
+	const CAmiraVectorField2D			*m_pVecField;	/**< The vector field. */
+	vector< vector<CriticalPoint>* >	 m_Frames;		/**< Critical points of each frame, or nullptr if not yet extracted. */
+
+public:
+	CCriticalPointCache();
+	~CCriticalPointCache();
+
+public:
+	/**
+	 *	Initializes the cache for the specified vector field. If the vector field changed, all cached results are discarded.
+	 *
+	 *	@param pVecField Pointer to the vector field.
+	 */
+	void Init(const CAmiraVectorField2D *pVecField);
+
+	/**
+	 *	Discards all cached results.
+	 */
+	void Clear();
+
+	/**
+	 *	Retrieves the critical points of a frame. If they are not cached, they are extracted.
+	 *
+	 *	@param nFrame The time step.
+	 *
+	 *	@return A pointer to a std::vector, holding the critical points, or nullptr if nFrame is invalid.
+	 *
+	 *	@remarks The returned pointer is owned by the cache and remains valid until Clear() is called.
+	 */
+	const vector<CriticalPoint>* GetCriticalPoints(int nFrame);
+
+	/**
+	 *	Extracts all critical points of a frame.
+	 *
+	 *	@param pVecField Pointer to the vector field.
+	 *	@param nFrame The time step.
+	 *	@param points Receives the critical points, ordered by grid cell, row by row.
+	 */
+	static void Extract(const CAmiraVectorField2D *pVecField, int nFrame, vector<CriticalPoint> &points);
+
+protected:
+	/**
+	 *	Solves a single cell of the bi-linear interpolant for its zeros.
+	 *
+	 *	@param v00 Vector at the lower left corner.
+	 *	@param v10 Vector at the lower right corner.
+	 *	@param v01 Vector at the upper left corner.
+	 *	@param v11 Vector at the upper right corner.
+	 *	@param bLastX If true, zeros on the right edge of the cell are included.
+	 *	@param bLastY If true, zeros on the upper edge of the cell are included.
+	 *	@param s Receives the local x-coordinates of the zeros in [0,1].
+	 *	@param t Receives the local y-coordinates of the zeros in [0,1].
+	 *
+	 *	@return The number of zeros, at most two.
+	 *
+	 *	@remarks Zeros on the right and upper edge are excluded, unless bLastX or bLastY is set, so that zeros on shared edges are reported once.
+	 */
+	static int _solveCell(const CVector2D &v00, const CVector2D &v10, const CVector2D &v01, const CVector2D &v11, bool bLastX, bool bLastY, float s[2], float t[2]);
+};
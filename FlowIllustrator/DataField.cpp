@@ -30,9 +30,11 @@
 
 namespace FICore
 {
+	static volatile LONG s_nLastSerial = 0;	//The last serial number of a field, see CDataField2D::GetSerial()
+
 	CDataField2D::CDataField2D(const CRectF &rcDomain, int nSamplesX, int nSamplesY)
 		:	m_nSamplesX(nSamplesX), m_nSamplesY(nSamplesY), m_rcDomain(rcDomain),
-			m_nMaxIdxX(nSamplesX-1), m_nMaxIdxY(nSamplesY-1)
+			m_nMaxIdxX(nSamplesX-1), m_nMaxIdxY(nSamplesY-1), m_nSerial(_getNextSerial())
 	{
 	}
 
@@ -40,4 +42,15 @@ namespace FICore
 	CDataField2D::~CDataField2D(void)
 	{
 	}
+
+	unsigned int CDataField2D::_getNextSerial()
+	{
+		unsigned int nSerial = static_cast<unsigned int>(InterlockedIncrement(&s_nLastSerial));
+
+		//0 is reserved for "no field", which is only reached after wrapping around
+		if (nSerial == 0)
+			nSerial = static_cast<unsigned int>(InterlockedIncrement(&s_nLastSerial));
+
+		return nSerial;
+	}
 }
\ No newline at end of file
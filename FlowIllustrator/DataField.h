@@ -36,6 +36,16 @@ namespace FICore
 				f != -std::numeric_limits<float>::infinity());
 	}
 
+	/**
+	 *	Returns true, if f is neither infinite nor NaN. The exponent is tested directly, since comparisons 
+	 *	involving NaN may be optimized away with /fp:fast.
+	 */
+	__inline bool isFiniteNumber(float f) {
+		union { float f; unsigned int n; } bits;
+		bits.f = f;
+		return (bits.n & 0x7f800000) != 0x7f800000;
+	}
+
 	/**
 	 *	CDataField2D is a virtual calss that serves as base data structure for 2D data fields.
 	 *	It provides basic functionality to query the extents of a field or to perform coordinate transformations.
@@ -51,6 +61,7 @@ namespace FICore
 		unsigned int	m_nMaxIdxX;			/**< Greatest valid index in X-direction. */
 		unsigned int	m_nMaxIdxY;			/**< Greatest valid index in Y-direction. */
 		CRectF			m_rcDomain;			/**< Rectangle describing the domain. */
+		unsigned int	m_nSerial;			/**< Number, that identifies this field, see GetSerial(). */
 
 	public:
 		/**
@@ -81,6 +92,17 @@ namespace FICore
 			m_nSamplesX = nSamplesX;
 			m_nSamplesY = nSampleY;
 			m_rcDomain = rcDomain;
+			m_nSerial = _getNextSerial();
+		}
+
+		/**
+		 *	Returns a number, that identifies this field among all fields, that were created or initialized since the program started.
+		 *	Caches of derived data use it instead of the address of the field, which may be reused, after the field was deleted.
+		 *
+		 *	@return The serial number of the field, which is never 0.
+		 */
+		__inline unsigned int GetSerial() const {
+			return m_nSerial;
 		}
 
 		/**
@@ -224,5 +246,10 @@ namespace FICore
 			dx = m_rcDomain.m_Min.x + (( gx / (m_nSamplesX-1) ) * m_rcDomain.getWidth()) ;
 			dy = m_rcDomain.m_Min.y + (( gy / (m_nSamplesY-1) ) * m_rcDomain.getHeight()) ;
 		}
+
+		/**
+		 *	Returns a new serial number for GetSerial(). It is safe to call it from several threads at once.
+		 */
+		static unsigned int _getNextSerial();
 	};
 }
\ No newline at end of file
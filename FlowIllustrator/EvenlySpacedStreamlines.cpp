@@ -0,0 +1,338 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "StdAfx.h"
+#include "EvenlySpacedStreamlines.h"
+#include <math.h>
+#include <algorithm>
+
+#define ESS_CHUNK_SIZE 32	//Number of RK4 steps integrated at once, before the new vertices are tested
+
+CEvenlySpacedStreamlines::CEvenlySpacedStreamlines(const CAmiraVectorField2D *pVecField, const CRectF &rcDomain, float fSeparation, float stepLen, int nMaxSteps)
+{
+	m_pVecField		= pVecField;
+	m_rcDomain		= rcDomain;
+	m_fSeparation	= fSeparation;
+	m_fTestRatio	= 0.5f;
+	m_fMinLength	= fSeparation;
+	m_fStepLen		= stepLen;
+	m_nMaxSteps		= max(nMaxSteps, 2);
+	m_pOccupancy	= nullptr;
+
+	//Ensure the domain does not exceed the domain of the vector field
+	CRectF rcField(pVecField->GetDomainRect());
+	if (m_rcDomain.m_Min.x < rcField.m_Min.x) m_rcDomain.m_Min.x = rcField.m_Min.x;
+	if (m_rcDomain.m_Min.y < rcField.m_Min.y) m_rcDomain.m_Min.y = rcField.m_Min.y;
+	if (m_rcDomain.m_Max.x > rcField.m_Max.x) m_rcDomain.m_Max.x = rcField.m_Max.x;
+	if (m_rcDomain.m_Max.y > rcField.m_Max.y) m_rcDomain.m_Max.y = rcField.m_Max.y;
+}
+
+CEvenlySpacedStreamlines::~CEvenlySpacedStreamlines(void)
+{
+}
+
+void CEvenlySpacedStreamlines::SetTestRatio(float fRatio)
+{
+	m_fTestRatio = min(max(fRatio, 0.1f), 1.0f);
+}
+
+void CEvenlySpacedStreamlines::SetMinLength(float fMinLength)
+{
+	m_fMinLength = fMinLength;
+}
+
+size_t CEvenlySpacedStreamlines::Compute()
+{
+	m_Lines.clear();
+
+	if (!m_pVecField || m_fSeparation <= 0.0f || m_rcDomain.getWidth() <= 0.0f || m_rcDomain.getHeight() <= 0.0f) {
+		return 0;
+	}
+
+	m_Hash.Init(m_rcDomain, m_fSeparation);
+	m_pOccupancy = m_pVecField->GetOccupancy( static_cast<int>(m_pVecField->GetCurrentTimeStep()) );
+
+	//Regions, that cannot be reached from already placed stream lines, are seeded from a regular grid
+	const int nGridX	= max(1, static_cast<int>(m_rcDomain.getWidth() / m_fSeparation));
+	const int nGridY	= max(1, static_cast<int>(m_rcDomain.getHeight() / m_fSeparation));
+	const int nNumGrid	= nGridX * nGridY;
+	const float fGridX	= m_rcDomain.getWidth() / nGridX;
+	const float fGridY	= m_rcDomain.getHeight() / nGridY;
+
+	size_t	nQueue(0);
+	int		nGridIdx(-1);	//-1 denotes the center of the domain, which is tried first
+
+	for (;;)
+	{
+		//Seed next to all stream lines, in the order they were accepted
+		while (nQueue < m_Lines.size())
+		{
+			vector<CPointf> seeds;
+			_getSeeds(m_Lines[nQueue++], seeds);
+			_processBatch(seeds);
+		}
+
+		bool bFound = false;
+
+		while (!bFound && nGridIdx < nNumGrid)
+		{
+			CPointf seed;
+			if (nGridIdx < 0) {
+				seed = CPointf::fromVector2D(m_rcDomain.GetCenter());
+			} else {
+				seed = CPointf(	m_rcDomain.m_Min.x + (nGridIdx % nGridX + 0.5f) * fGridX, 
+								m_rcDomain.m_Min.y + (nGridIdx / nGridX + 0.5f) * fGridY);
+			}
+			nGridIdx++;
+
+			if (_isSeedable(seed) && !m_Hash.IsCloser(seed, m_fSeparation)) {
+				bFound = (_processBatch( vector<CPointf>(1, seed) ) > 0);
+			}
+		}
+
+		if (!bFound) break;
+	}
+
+	return m_Lines.size();
+}
+
+size_t CEvenlySpacedStreamlines::_processBatch(const vector<CPointf> &seeds)
+{
+	const int nNumSeeds = static_cast<int>(seeds.size());
+	vector<Candidate> candidates(nNumSeeds);
+
+	//Candidates are tested against the stream lines accepted before this batch only
+	#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < nNumSeeds; i++)
+	{
+		candidates[i].seed = seeds[i];
+		_trace(candidates[i]);
+	}
+
+	size_t nAccepted(0);
+	for (auto iter = candidates.begin(); iter != candidates.end(); ++iter)
+	{
+		if (_accept(*iter)) nAccepted++;
+	}
+
+	return nAccepted;
+}
+
+void CEvenlySpacedStreamlines::_trace(Candidate &candidate) const
+{
+	CSpatialHash2D self(m_rcDomain, m_fSeparation);
+	vector<CPointf> fwd, bwd;
+
+	_traceDir(candidate.seed, true, self, fwd);
+	_traceDir(candidate.seed, false, self, bwd);
+
+	candidate.vertices.clear();
+	candidate.vertices.reserve(fwd.size() + bwd.size());
+
+	//The seed is the first vertex of both halves
+	candidate.vertices.insert(candidate.vertices.end(), bwd.rbegin(), bwd.rend());
+	candidate.nSeedIdx = candidate.vertices.size() - 1;
+	candidate.vertices.insert(candidate.vertices.end(), fwd.begin() + 1, fwd.end());
+}
+
+void CEvenlySpacedStreamlines::_traceDir(const CPointf &seed, bool bForward, CSpatialHash2D &self, vector<CPointf> &out) const
+{
+	const float fTest		= m_fSeparation * m_fTestRatio;
+	const float fSampleDist	= fTest * 0.5f;
+	const float fSelfLag	= 2.0f * m_fSeparation;		//Arc length, after which a sample of this line counts as an obstacle for itself
+
+	vector< pair<CPointf, float> > pending;				//Samples, not yet inserted into self, and their arc length
+	size_t nPending(0);
+	float fArcLen(0.0f);
+
+	out.clear();
+	out.push_back(seed);
+
+	CAmiraVectorField2D::IntegrationState state;
+	vector<CPointf> buff;
+	m_pVecField->integrateRK4( CVector3D(seed.x, seed.y, 0.0f), min(ESS_CHUNK_SIZE, m_nMaxSteps), m_fStepLen, bForward, &buff, m_rcDomain, &state);
+
+	size_t nDone(1);
+	bool bStop(false);
+
+	while (!bStop)
+	{
+		const size_t nSize = buff.size();
+
+		for (size_t i = nDone; i < nSize && !bStop; i++)
+		{
+			//Backward integration inserts new vertices at the front
+			const CPointf &pt	= (bForward)? buff[i] : buff[nSize - 1 - i];
+			const CPointf ptPrev(out.back());
+
+			const float dx		= pt.x - ptPrev.x;
+			const float dy		= pt.y - ptPrev.y;
+			const float fLen	= sqrt(dx*dx + dy*dy);
+			const int nSamples	= max(1, static_cast<int>( ceil(fLen / fSampleDist) ));
+
+			for (int k = 1; k <= nSamples; k++)
+			{
+				const float t = static_cast<float>(k) / nSamples;
+				CPointf sample(ptPrev.x + t*dx, ptPrev.y + t*dy);
+
+				if (m_Hash.IsCloser(sample, fTest) || self.IsCloser(sample, fTest)) {
+					bStop = true;
+					break;
+				}
+
+				pending.push_back( make_pair(sample, fArcLen + t*fLen) );
+			}
+
+			if (bStop) break;
+
+			fArcLen += fLen;
+			out.push_back(pt);
+
+			for (; nPending < pending.size() && pending[nPending].second < fArcLen - fSelfLag; nPending++) {
+				self.Insert(pending[nPending].first);
+			}
+		}
+
+		nDone = nSize;
+
+		if (bStop || state.bTerminated || state.nNumSteps >= m_nMaxSteps) break;
+
+		m_pVecField->resizeIntegration(state, min(state.nNumSteps + ESS_CHUNK_SIZE, m_nMaxSteps), &buff);
+
+		if (buff.size() == nDone) break;
+	}
+
+	//Samples far enough from the seed are obstacles for the other half of this line
+	for (; nPending < pending.size(); nPending++) {
+		if (pending[nPending].second > fSelfLag) self.Insert(pending[nPending].first);
+	}
+}
+
+bool CEvenlySpacedStreamlines::_segmentClear(const CSpatialHash2D &hash, const CPointf &ptFrom, const CPointf &ptTo, float fDist) const
+{
+	const float dx		= ptTo.x - ptFrom.x;
+	const float dy		= ptTo.y - ptFrom.y;
+	const float fLen	= sqrt(dx*dx + dy*dy);
+	const int nSamples	= max(1, static_cast<int>( ceil(fLen / (0.5f * fDist)) ));
+
+	for (int k = 1; k <= nSamples; k++)
+	{
+		const float t = static_cast<float>(k) / nSamples;
+		if (hash.IsCloser( CPointf(ptFrom.x + t*dx, ptFrom.y + t*dy), fDist )) return false;
+	}
+
+	return true;
+}
+
+bool CEvenlySpacedStreamlines::_accept(Candidate &candidate)
+{
+	vector<CPointf> &v(candidate.vertices);
+	if (v.size() < 2) return false;
+
+	//Stream lines accepted earlier in the same batch may have taken the place
+	if (m_Hash.IsCloser(candidate.seed, m_fSeparation * 0.99f)) return false;
+
+	const float fTest = m_fSeparation * m_fTestRatio;
+
+	//Truncate both halves at the first vertex, that comes too close to another stream line
+	size_t nLast = candidate.nSeedIdx;
+	while (nLast + 1 < v.size() && _segmentClear(m_Hash, v[nLast], v[nLast + 1], fTest)) nLast++;
+
+	size_t nFirst = candidate.nSeedIdx;
+	while (nFirst > 0 && _segmentClear(m_Hash, v[nFirst], v[nFirst - 1], fTest)) nFirst--;
+
+	float fArcLen(0.0f);
+	for (size_t i = nFirst; i < nLast; i++) {
+		fArcLen += CVector2D(v[i+1].x - v[i].x, v[i+1].y - v[i].y).abs();
+	}
+
+	if (nLast == nFirst || fArcLen < m_fMinLength) return false;
+
+	m_Lines.push_back( vector<CPointf>(v.begin() + nFirst, v.begin() + nLast + 1) );
+	_insert(m_Lines.back());
+
+	return true;
+}
+
+void CEvenlySpacedStreamlines::_insert(const vector<CPointf> &line)
+{
+	const float fSampleDist = m_fSeparation * m_fTestRatio * 0.5f;
+
+	m_Hash.Insert(line.front());
+
+	for (size_t i = 1; i < line.size(); i++)
+	{
+		const float dx		= line[i].x - line[i-1].x;
+		const float dy		= line[i].y - line[i-1].y;
+		const int nSamples	= max(1, static_cast<int>( ceil(sqrt(dx*dx + dy*dy) / fSampleDist) ));
+
+		for (int k = 1; k <= nSamples; k++)
+		{
+			const float t = static_cast<float>(k) / nSamples;
+			m_Hash.Insert( CPointf(line[i-1].x + t*dx, line[i-1].y + t*dy) );
+		}
+	}
+}
+
+void CEvenlySpacedStreamlines::_getSeeds(const vector<CPointf> &line, vector<CPointf> &seeds) const
+{
+	seeds.clear();
+
+	float fNextSeed(0.0f);	//Arc length of the next seed pair
+	float fArcLen(0.0f);
+
+	for (size_t i = 1; i < line.size(); i++)
+	{
+		const float dx		= line[i].x - line[i-1].x;
+		const float dy		= line[i].y - line[i-1].y;
+		const float fLen	= sqrt(dx*dx + dy*dy);
+
+		if (fLen <= 0.0f) continue;
+
+		//Unit normal of the current segment
+		const float nx = -dy / fLen;
+		const float ny =  dx / fLen;
+
+		for (; fNextSeed <= fArcLen + fLen; fNextSeed += m_fSeparation)
+		{
+			const float t = (fNextSeed - fArcLen) / fLen;
+			const float px = line[i-1].x + t*dx;
+			const float py = line[i-1].y + t*dy;
+
+			for (int nSide = -1; nSide <= 1; nSide += 2)
+			{
+				CPointf seed(px + nSide * nx * m_fSeparation, py + nSide * ny * m_fSeparation);
+
+				if (m_rcDomain.PtInRect(seed) && _isSeedable(seed) && !m_Hash.IsCloser(seed, m_fSeparation * 0.99f)) {
+					seeds.push_back(seed);
+				}
+			}
+		}
+
+		fArcLen += fLen;
+	}
+}
@@ -0,0 +1,170 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+#include "AmiraVectorField2D.h"
+#include "SpatialHash.h"
+#include <vector>
+
+using namespace std;
+
+/**
+ *	CEvenlySpacedStreamlines fills a rectangular region with evenly spaced stream lines of the current frame,
+ *	following the placement strategy of Jobard and Lefer:
+ *	New seeds are placed at the separation distance next to already accepted stream lines, 
+ *	and each new stream line is integrated until it comes closer than the test distance to any other stream line.
+ *	Distance tests are answered by a CSpatialHash2D, holding samples of all accepted stream lines.
+ *
+ *	The candidates seeded along one stream line are integrated in parallel, and then accepted one after another.
+ */
+class CEvenlySpacedStreamlines
+{
+protected:
+	/**
+	 *	A stream line, that has been integrated, but not yet accepted.
+	 */
+	struct Candidate {
+		CPointf			seed;		/**< The seed point. */
+		vector<CPointf>	vertices;	/**< Vertices from the backward end to the forward end. */
+		size_t			nSeedIdx;	/**< Index of the seed point in vertices. */
+	};
+
+	const CAmiraVectorField2D	*m_pVecField;	/**< The vector field. Stream lines are integrated in its current frame. */
+	CRectF						 m_rcDomain;	/**< Region to be filled with stream lines. */
+	float						 m_fSeparation;	/**< Distance between neighbouring stream lines in domain units. */
+	float						 m_fTestRatio;	/**< Ratio of the distance, at which integration stops, to m_fSeparation. */
+	float						 m_fMinLength;	/**< Minimum arc length of an accepted stream line in domain units. */
+	float						 m_fStepLen;	/**< Step length of the RK4 integrator in grid space. */
+	int							 m_nMaxSteps;	/**< Maximum number of integration steps in each direction. */
+	CSpatialHash2D				 m_Hash;		/**< Samples of all accepted stream lines. */
+	vector< vector<CPointf> >	 m_Lines;		/**< The accepted stream lines. */
+	const COccupancyGrid		*m_pOccupancy;	/**< Live cells of the current frame. No seeds are placed in dead cells. */
+
+public:
+	/**
+	 *	Construct a new CEvenlySpacedStreamlines.
+	 *
+	 *	@param pVecField Pointer to the vector field.
+	 *	@param rcDomain Region to be filled with stream lines.
+	 *	@param fSeparation Distance between neighbouring stream lines in domain units.
+	 *	@param stepLen Step length of the RK4 integrator in grid space.
+	 *	@param nMaxSteps Maximum number of integration steps in each direction from the seed point.
+	 */
+	CEvenlySpacedStreamlines(const CAmiraVectorField2D *pVecField, const CRectF &rcDomain, float fSeparation, float stepLen, int nMaxSteps);
+	~CEvenlySpacedStreamlines(void);
+
+public:
+	/**
+	 *	Set the ratio of the test distance to the separation distance. 
+	 *	Integration of a stream line stops, if it comes closer than the test distance to another stream line. The default is 0.5.
+	 *
+	 *	@param fRatio The new ratio, clamped to [0.1, 1].
+	 */
+	void SetTestRatio(float fRatio);
+
+	/**
+	 *	Set the minimum arc length of a stream line. Shorter stream lines are discarded. The default is the separation distance.
+	 *
+	 *	@param fMinLength The minimum arc length in domain units.
+	 */
+	void SetMinLength(float fMinLength);
+
+	/**
+	 *	Places the stream lines. Results of a previous call are discarded.
+	 *
+	 *	@return The number of stream lines.
+	 */
+	size_t Compute();
+
+	/**
+	 *	Retrieve the number of stream lines, placed by the last call to Compute().
+	 */
+	__inline size_t GetNumLines() const { return m_Lines.size(); }
+
+	/**
+	 *	Retrieve the vertices of a stream line, ordered in flow direction.
+	 *
+	 *	@param nIdx Index of the stream line.
+	 *
+	 *	@remarks	Integrating nNumVertices-1 RK4 steps forward from the first vertex approximately reproduces the stream line. 
+	 */
+	__inline const vector<CPointf>& GetLine(size_t nIdx) const { return m_Lines[nIdx]; }
+
+protected:
+	/**
+	 *	Integrates a candidate in both directions from its seed, until it leaves the domain, 
+	 *	comes too close to an accepted stream line or to itself, or reaches the maximum number of steps.
+	 *	Does not modify any member and can safely be called from multiple threads.
+	 */
+	void _trace(Candidate &candidate) const;
+
+	/**
+	 *	Integrates one half of a candidate.
+	 *
+	 *	@param seed The seed point.
+	 *	@param bForward Integration direction.
+	 *	@param self Samples of the candidate, used to stop stream lines from spiralling into themselves.
+	 *	@param out Receives the vertices, starting with the seed.
+	 */
+	void _traceDir(const CPointf &seed, bool bForward, CSpatialHash2D &self, vector<CPointf> &out) const;
+
+	/**
+	 *	Validates a candidate against all stream lines accepted so far, truncates it if necessary, and accepts it.
+	 *
+	 *	@return Returns true, if the candidate was accepted.
+	 */
+	bool _accept(Candidate &candidate);
+
+	/**
+	 *	Integrates a batch of seeds in parallel, and accepts the resulting candidates in order.
+	 *
+	 *	@return The number of accepted stream lines.
+	 */
+	size_t _processBatch(const vector<CPointf> &seeds);
+
+	/**
+	 *	Places seeds on both sides of a stream line, at the separation distance and spaced by the separation distance.
+	 */
+	void _getSeeds(const vector<CPointf> &line, vector<CPointf> &seeds) const;
+
+	/**
+	 *	Checks, if a seed lies in a live cell of the vector field.
+	 */
+	__inline bool _isSeedable(const CPointf &seed) const {
+		return !m_pOccupancy || m_pOccupancy->IsLive(seed);
+	}
+
+	/**
+	 *	Checks, if a line segment keeps at least the specified distance to all points of a CSpatialHash2D.
+	 */
+	bool _segmentClear(const CSpatialHash2D &hash, const CPointf &ptFrom, const CPointf &ptTo, float fDist) const;
+
+	/**
+	 *	Inserts samples of a stream line into m_Hash.
+	 */
+	void _insert(const vector<CPointf> &line);
+};
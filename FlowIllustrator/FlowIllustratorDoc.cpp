@@ -79,6 +79,8 @@ CFlowIllustratorDoc::CFlowIllustratorDoc()
 	m_pVectorField  = nullptr;
 	m_bDirty = FALSE;
 	m_IsLoadingSVG = FALSE;
+	m_pStatisticsThread = nullptr;
+	m_bCancelStatistics = 0;
 }
 
 CFlowIllustratorDoc::~CFlowIllustratorDoc()
@@ -107,7 +109,11 @@ BOOL CFlowIllustratorDoc::OnNewDocument()
 
 void CFlowIllustratorDoc::Destroy()
 {
+	StopFrameStatistics();
+
 	m_DrawObjMngr.RemoveAll();
+	m_VortexCatalog.Clear();
+	m_FrameStatistics.Clear();
 
 	if (m_pVectorField)
 	{
@@ -212,6 +218,13 @@ BOOL CFlowIllustratorDoc::OnOpenDocument(LPCTSTR lpszPathName)
 
 	if (bSuccess)
 	{
+		m_strAmiraFile = str;
+		m_VortexCatalog.Load(CVortexCatalog::GetFileName(str).c_str(), m_pVectorField, str);
+
+		if (!m_FrameStatistics.Load(CFrameStatistics::GetFileName(str).c_str(), m_pVectorField, str)) {
+			StartFrameStatistics();
+		}
+
 		CFlowIllustratorView* pView = reinterpret_cast<CFlowIllustratorView*>(GetActiveView());
 		if (pView)
 		{
@@ -229,13 +242,13 @@ void CFlowIllustratorDoc::NextFrame()
 {
 	if (m_pVectorField)
 	{
-		unsigned int currTimeStep = m_pVectorField->GetCurrentTimeStep() + 1;
-		if (currTimeStep >= m_pVectorField->GetNumTimeSteps() )
+		unsigned int nFrame = m_pVectorField->GetCurrentVirtualFrame() + 1;
+		if (nFrame >= m_pVectorField->GetNumVirtualFrames() )
 		{
-			currTimeStep = m_pVectorField->GetNumTimeSteps()-1;
+			nFrame = m_pVectorField->GetNumVirtualFrames()-1;
 		}
 
-		_gotoTimeStep(currTimeStep);
+		_gotoVirtualFrame(nFrame);
 	}
 }
 
@@ -243,13 +256,13 @@ void CFlowIllustratorDoc::PreviousFrame()
 {
 	if (m_pVectorField)
 	{
-		unsigned int currTimeStep = m_pVectorField->GetCurrentTimeStep() - 1;
-		if (currTimeStep < 0 )
+		unsigned int nFrame = m_pVectorField->GetCurrentVirtualFrame();
+		if (nFrame > 0)
 		{
-			currTimeStep = 0;
+			nFrame--;
 		}
 
-		_gotoTimeStep(currTimeStep);
+		_gotoVirtualFrame(nFrame);
 	}
 }
 
@@ -282,6 +295,31 @@ void CFlowIllustratorDoc::GotoFrame(unsigned int timeStep)
 	}
 }
 
+void CFlowIllustratorDoc::GotoVirtualFrame(unsigned int nFrame)
+{
+	if (m_pVectorField)
+	{
+		if (nFrame < m_pVectorField->GetNumVirtualFrames())
+		{
+			_gotoVirtualFrame(nFrame);
+		}
+	}
+}
+
+void CFlowIllustratorDoc::SetTemporalResolution(unsigned int nSubSteps, TEMPORAL_INTERPOLATION nInterpolation)
+{
+	if (m_pVectorField)
+	{
+		const bool bInterpolationChanged = (nInterpolation != m_pVectorField->GetTemporalInterpolation());
+
+		m_bDirty = TRUE;
+		m_pVectorField->SetTemporalResolution(nSubSteps, nInterpolation);
+
+		//The interpolation applies to integration as well, so everything integrated between time steps changes
+		_notifyParent( (bInterpolationChanged)? WM_DOC_REFERENCE_FRAME_CHANGED : WM_DOC_FRAME_CHANGED );
+	}
+}
+
 void CFlowIllustratorDoc::_gotoTimeStep(unsigned int timeStep)
 {
 	//Ensure that the part of the file is mapped to memory here
@@ -293,6 +331,44 @@ void CFlowIllustratorDoc::_gotoTimeStep(unsigned int timeStep)
 	_notifyParent(WM_DOC_FRAME_CHANGED);
 }
 
+void CFlowIllustratorDoc::_gotoVirtualFrame(unsigned int nFrame)
+{
+	m_bDirty = TRUE;
+	m_pVectorField->GotoVirtualFrame(nFrame);
+
+	_notifyParent(WM_DOC_FRAME_CHANGED);
+}
+
+void CFlowIllustratorDoc::ResetReferenceFrame()
+{
+	if (m_pVectorField)
+	{
+		m_pVectorField->ResetReferenceFrame();
+		m_bDirty = TRUE;
+		_notifyParent(WM_DOC_REFERENCE_FRAME_CHANGED);
+	}
+}
+
+void CFlowIllustratorDoc::SetReferenceFrame(const CVector2D &velocity)
+{
+	if (m_pVectorField)
+	{
+		m_pVectorField->SetReferenceFrame(velocity);
+		m_bDirty = TRUE;
+		_notifyParent(WM_DOC_REFERENCE_FRAME_CHANGED);
+	}
+}
+
+void CFlowIllustratorDoc::SetReferenceFrame(const CRectF &rcRegion)
+{
+	if (m_pVectorField)
+	{
+		m_pVectorField->SetReferenceFrame(rcRegion);
+		m_bDirty = TRUE;
+		_notifyParent(WM_DOC_REFERENCE_FRAME_CHANGED);
+	}
+}
+
 CView* CFlowIllustratorDoc::GetActiveView() const
 {
 	CFrameWnd * pFrame = (CFrameWnd *)(AfxGetApp()->m_pMainWnd);
@@ -305,10 +381,67 @@ CView* CFlowIllustratorDoc::GetActiveView() const
 
 void CFlowIllustratorDoc::SaveSVG(LPCTSTR lpszPathName)
 {
+	//Export exact path and time lines
+	CFlowIllustratorView *pView = reinterpret_cast<CFlowIllustratorView*>(GetActiveView());
+	BOOL bFastTrajectories = (pView)? pView->GetFastTrajectories() : FALSE;
+	if (bFastTrajectories) pView->SetFastTrajectories(FALSE);
+
 	CStdioFile file(lpszPathName, CFile::modeWrite | CFile::modeCreate);
 	file.WriteString(GetSVGString());
 	file.Flush();
 	file.Close();
+
+	if (bFastTrajectories) pView->SetFastTrajectories(TRUE);
+}
+
+BOOL CFlowIllustratorDoc::BuildVortexCatalog(float fThreshold)
+{
+	if (!m_pVectorField) return FALSE;
+
+	m_VortexCatalog.Build(m_pVectorField, fThreshold, m_strAmiraFile);
+
+	return m_VortexCatalog.Save(CVortexCatalog::GetFileName(m_strAmiraFile).c_str())? TRUE : FALSE;
+}
+
+void CFlowIllustratorDoc::StartFrameStatistics()
+{
+	StopFrameStatistics();
+
+	if (!m_pVectorField) return;
+
+	m_FrameStatistics.Reset(m_pVectorField, m_strAmiraFile);
+	m_bCancelStatistics = 0;
+
+	//Keep the thread object, such that StopFrameStatistics() can wait for it
+	m_pStatisticsThread = AfxBeginThread(_buildFrameStatistics, this, THREAD_PRIORITY_BELOW_NORMAL, 0, CREATE_SUSPENDED);
+
+	if (m_pStatisticsThread)
+	{
+		m_pStatisticsThread->m_bAutoDelete = FALSE;
+		m_pStatisticsThread->ResumeThread();
+	}
+}
+
+void CFlowIllustratorDoc::StopFrameStatistics()
+{
+	if (!m_pStatisticsThread) return;
+
+	InterlockedExchange(&m_bCancelStatistics, 1);
+	WaitForSingleObject(m_pStatisticsThread->m_hThread, INFINITE);
+
+	delete m_pStatisticsThread;
+	m_pStatisticsThread = nullptr;
+}
+
+UINT CFlowIllustratorDoc::_buildFrameStatistics(LPVOID pParam)
+{
+	CFlowIllustratorDoc *pDoc = reinterpret_cast<CFlowIllustratorDoc*>(pParam);
+
+	if (pDoc->m_FrameStatistics.Build(pDoc->m_pVectorField, &pDoc->m_bCancelStatistics)) {
+		pDoc->m_FrameStatistics.Save(CFrameStatistics::GetFileName(pDoc->m_strAmiraFile).c_str());
+	}
+
+	return 0;
 }
 
 void CFlowIllustratorDoc::SaveAmiraMesh(LPCTSTR lpszPathName, int nStartFrame, int nEndFrame, const CRectF &rcDomain)
@@ -378,6 +511,10 @@ void CFlowIllustratorDoc::SavePNG(LPCTSTR lpszPathName)
 
 	CFlowIllustratorView *pView = reinterpret_cast<CFlowIllustratorView*>(GetActiveView());
 	if (pView) {
+		//Export exact path and time lines
+		BOOL bFastTrajectories = pView->GetFastTrajectories();
+		if (bFastTrajectories) pView->SetFastTrajectories(FALSE);
+
 		pView->RedrawWindow();
 
 		BYTE *pPixelBuf = nullptr;
@@ -393,6 +530,8 @@ void CFlowIllustratorDoc::SavePNG(LPCTSTR lpszPathName)
 		img.Save(lpszPathName);
 
 		delete [] pPixelBuf;
+
+		if (bFastTrajectories) pView->SetFastTrajectories(TRUE);
 	}
 }
 
@@ -478,21 +617,30 @@ void CFlowIllustratorDoc::OnFileSaveScreenshotSeries()
 
 		CFlowIllustratorView *pView = reinterpret_cast<CFlowIllustratorView*>(GetActiveView());
 		if (pView) {
-			int nCurrFrame = m_pVectorField->GetCurrentTimeStep();
+			int nCurrFrame = m_pVectorField->GetCurrentVirtualFrame();
 			CString strOutName;
 
+			//With temporal resampling, the series contains the virtual frames between the selected time steps as well
+			const int nSubSteps		= static_cast<int>(m_pVectorField->GetTemporalResolution());
+			const int nStartFrame	= dlg.m_nStartFrame * nSubSteps;
+			const int nEndFrame		= dlg.m_nEndFrame * nSubSteps;
+
 			CStatusDlg statusDlg;
 			statusDlg.Create(IDD_DIALOG_STATUS, pView);
 			statusDlg.ShowWindow(SW_SHOW);
 
-			statusDlg.m_wndProgressBar.SetRange(dlg.m_nStartFrame, dlg.m_nEndFrame);
+			statusDlg.m_wndProgressBar.SetRange(nStartFrame, nEndFrame);
+
+			//Switch to exact path and time lines once for the whole series, instead of per frame in SavePNG()
+			BOOL bFastTrajectories = pView->GetFastTrajectories();
+			pView->SetFastTrajectories(FALSE);
 
-			for (int i= dlg.m_nStartFrame; i < dlg.m_nEndFrame; i++)
+			for (int i= nStartFrame; i < nEndFrame; i++)
 			{
 				statusDlg.m_wndProgressBar.SetPos(i);
 				strOutName.Format(_T("%s%s_%d.png"), strFolderName, strFileName, i);
 				if (!dlg.m_bGrowStreakLine) {
-					pView->JumpToFrame(i);
+					pView->JumpToVirtualFrame(i);
 				} else {
 					pView->GrowStreakLines(dlg.m_nNewParticles);
 				}
@@ -502,10 +650,11 @@ void CFlowIllustratorDoc::OnFileSaveScreenshotSeries()
 
 			//reset the amount of particles per streakline
 			if (dlg.m_bGrowStreakLine) {
-				pView->GrowStreakLines(dlg.m_nNewParticles * (dlg.m_nEndFrame-dlg.m_nStartFrame));
+				pView->GrowStreakLines(dlg.m_nNewParticles * (nEndFrame-nStartFrame));
 			}
 
-			GotoFrame(nCurrFrame);
+			GotoVirtualFrame(nCurrFrame);
+			pView->SetFastTrajectories(bFastTrajectories);
 			statusDlg.DestroyWindow();
 		}
 	}
@@ -45,12 +45,15 @@
 #include "AmiraVectorField2D.h"
 #include "Markup.h"
 #include "DrawingObjectMngr.h"
+#include "VortexCatalog.h"
+#include "FrameStatistics.h"
 
 using namespace FICore;
 
 const UINT WM_SAVE_SCREENSHOT = RegisterWindowMessage(_T("SAVE_SCREENSHOT"));
 const UINT WM_SVG_LOADED = RegisterWindowMessage(_T("WM_SVG_LOADED"));
 const UINT WM_DOC_FRAME_CHANGED = RegisterWindowMessage(_T("WM_DOC_FRAME_CHANGED"));
+const UINT WM_DOC_REFERENCE_FRAME_CHANGED = RegisterWindowMessage(_T("WM_DOC_REFERENCE_FRAME_CHANGED"));
 
 class CFlowIllustratorDoc : public CDocument
 {
@@ -64,17 +67,24 @@ private:
 	CAmiraVectorField2D *m_pVectorField;	/**< Pointer to the currently opened vector field.*/
 	BOOL	m_bDirty;						/**< The dirty-flag indicates that something in the opened vector field has changed, and it needs to be rendered. */
 	BOOL	m_IsLoadingSVG;					/**< Indicates that currently an SVG file is being loaded. */
+	CStringA		m_strAmiraFile;			/**< File name of the currently opened vector field. */
+	CVortexCatalog	m_VortexCatalog;		/**< Vortices of all frames of the currently opened vector field, loaded from or saved to a sidecar file. */
+	CFrameStatistics m_FrameStatistics;		/**< Value ranges of all frames of the currently opened vector field, loaded from a sidecar file or built by m_pStatisticsThread. */
+	CWinThread		*m_pStatisticsThread;	/**< Worker thread, that builds m_FrameStatistics. nullptr, if no build was started. */
+	volatile LONG	 m_bCancelStatistics;	/**< If non-zero, m_pStatisticsThread stops as soon as possible. */
 
 // Operations
 public:
 	/**
 	 *	Moves the internal frame pointer of m_pVectorField to the beginning of the previous frame (time-step).
+	 *	If temporal resampling is enabled, the previous virtual frame becomes current instead, see SetTemporalResolution().
 	 *	If the current time step is already the first time step available in the current vector field, nothing happens.
 	 */
 	void PreviousFrame();
 
 	/**
 	 *	Moves the internal frame pointer of m_pVectorField to the beginning of the next frame (time-step).
+	 *	If temporal resampling is enabled, the next virtual frame becomes current instead, see SetTemporalResolution().
 	 *	If the current time step is already the last time step available in the current vector field, nothing happens.
 	 */
 	void NextFrame();
@@ -99,6 +109,38 @@ public:
 	 */
 	void GotoFrame(unsigned int timeStep);
 
+	/**
+	 *	Moves the internal frame pointer of m_pVectorField to the specified virtual frame, see CAmiraVectorField2D::GotoVirtualFrame().
+	 *	If the specified virtual frame is >= the number of virtual frames, nothing happens.
+	 *
+	 *	@param nFrame The virtual frame to be made current.
+	 */
+	void GotoVirtualFrame(unsigned int nFrame);
+
+	/**
+	 *	Set the number of virtual frames between two time steps, and the interpolation between time steps, 
+	 *	see CAmiraVectorField2D::SetTemporalResolution(). Views are notified by WM_DOC_REFERENCE_FRAME_CHANGED,
+	 *	if the interpolation changed, otherwise by WM_DOC_FRAME_CHANGED.
+	 */
+	void SetTemporalResolution(unsigned int nSubSteps, TEMPORAL_INTERPOLATION nInterpolation);
+
+	/**
+	 *	Observe the vector field in the lab frame. Views are notified by WM_DOC_REFERENCE_FRAME_CHANGED.
+	 */
+	void ResetReferenceFrame();
+
+	/**
+	 *	Observe the vector field in a frame moving with a constant velocity, see CAmiraVectorField2D::SetReferenceFrame().
+	 *	Views are notified by WM_DOC_REFERENCE_FRAME_CHANGED.
+	 */
+	void SetReferenceFrame(const CVector2D &velocity);
+
+	/**
+	 *	Observe the vector field in a frame moving with the mean velocity of a region, see CAmiraVectorField2D::SetReferenceFrame().
+	 *	Views are notified by WM_DOC_REFERENCE_FRAME_CHANGED.
+	 */
+	void SetReferenceFrame(const CRectF &rcRegion);
+
 	/**
 	 *	Retrieve, if the current vector field is makred dirty.
 	 *
@@ -150,6 +192,33 @@ public:
 	 */
 	__inline const CAmiraVectorField2D* GetVectorfield() const { return m_pVectorField; }
 
+	/**
+	 *	Retrieve the vortex catalog of the currently opened vector field.
+	 *
+	 *	@return A pointer to the vortex catalog, or nullptr if no catalog was loaded or built for the current vector field.
+	 */
+	__inline const CVortexCatalog* GetVortexCatalog() const { return (m_VortexCatalog.IsValid(m_pVectorField))? &m_VortexCatalog : nullptr; }
+
+	/**
+	 *	Detects the vortices of all frames of the currently opened vector field and saves them to a sidecar file
+	 *	next to the vector field file, where they are loaded from the next time the vector field is opened.
+	 *
+	 *	@param fThreshold The extent of a vortex ends, where the vorticity magnitude drops below this fraction of the core value.
+	 *
+	 *	@return Returns TRUE, if the sidecar file was written.
+	 */
+	BOOL BuildVortexCatalog(float fThreshold);
+
+	/**
+	 *	Retrieve the per-frame statistics of the currently opened vector field.
+	 *
+	 *	@return A pointer to the statistics index, or nullptr if no vector field is opened.
+	 *
+	 *	@remarks	The index is built in the background after a vector field was opened, unless it could be loaded from 
+	 *				its sidecar file. Frames, that have not been computed yet, are reported as nullptr by CFrameStatistics::GetFrame().
+	 */
+	__inline const CFrameStatistics* GetFrameStatistics() const { return (m_FrameStatistics.IsValid(m_pVectorField))? &m_FrameStatistics : nullptr; }
+
 	/**
 	 *	Retrieve the current frame number of the opened vector field.
 	 *
@@ -159,6 +228,12 @@ public:
 	 */
 	__inline const int GetCurrentFrameNo() const { return m_pVectorField->GetCurrentTimeStep(); }
 
+	/**
+	 *	Retrieve the current virtual frame number of the opened vector field, see CAmiraVectorField2D::GetCurrentVirtualFrame().
+	 *	It equals GetCurrentFrameNo(), unless temporal resampling is enabled.
+	 */
+	__inline const int GetCurrentVirtualFrameNo() const { return m_pVectorField->GetCurrentVirtualFrame(); }
+
 	/**
 	 *	Saves all CDrawingObjects, currently managed by this document's CDrawingObjectManager to the SVG file at the specified location.
 	 *
@@ -228,7 +303,25 @@ public:
 protected:
 	BOOL DislpayFileDlg(const CString &strFilter, const CString &strFormat, CString &strFileName, BOOL bOpen = FALSE) const;
 	void Destroy();
+
+	/**
+	 *	Starts m_pStatisticsThread, which builds m_FrameStatistics and saves it to its sidecar file.
+	 */
+	void StartFrameStatistics();
+
+	/**
+	 *	Cancels m_pStatisticsThread and waits until it has finished.
+	 */
+	void StopFrameStatistics();
+
+	/**
+	 *	Thread function of m_pStatisticsThread.
+	 *
+	 *	@param pParam Pointer to the CFlowIllustratorDoc.
+	 */
+	static UINT _buildFrameStatistics(LPVOID pParam);
 	void _gotoTimeStep(unsigned int timeStep);
+	void _gotoVirtualFrame(unsigned int nFrame);
 	CString GetSVGString();
 
 	void parseStyleString(__in const CString& strSource, __out LPFLOATCOLOR pColor, __out BOOL &bSolid, __out float &fLineWidth);
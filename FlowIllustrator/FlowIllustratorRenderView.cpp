@@ -32,7 +32,6 @@
 #include "FlowIllustrator.h"
 #include "FlowIllustratorRenderView.h"
 #include "MainFrm.h"
-#include "Line.h"
 #include "OpenGlDummyWnd.h"
 
 // CFlowIllustratorRenderView
@@ -92,10 +91,12 @@ CFlowIllustratorRenderView::CFlowIllustratorRenderView()
 	m_pVectorMagnitudeField		= nullptr;
 	m_pDrawObjMngr				= nullptr;
 	m_pLICNoiseTex				= nullptr;
+	m_pFTLEField				= nullptr;
 	m_fPixelUnitRatioX			= 1.0f;
 	m_fPixelUnitRatioY			= 1.0f;
 	gZoomFactor					= 1.0;
 	m_fIsoVal					= 0.0f;
+	m_nNumIsoLevels				= 1;
 	m_nColorOffset				= 0;
 	m_xExtent					= 0;
 	m_yExtent					= 0;
@@ -106,6 +107,24 @@ CFlowIllustratorRenderView::CFlowIllustratorRenderView()
 	m_bVorticityValid			= FALSE;
 	m_bVectorMagnitudeValid		= FALSE;
 	m_bLICNoiseTexValid			= FALSE;
+	m_nStreamlineIntegrator		= SI_RK4;
+	m_nContrastEnhancement		= CE_NONE;
+	m_bFTLEValid				= FALSE;
+	m_nFTLEFrame				= -1;
+	m_nDerivedFieldsValid		= 0;
+	m_nDerivedFieldsUsed		= 0;
+	m_fDerivedFieldsTime		= -1.0f;
+
+	for (int i = 0; i < DF_NUM_FIELDS; i++)
+		m_pDerivedFields[i] = nullptr;
+	m_pTemporalDerivativeMagnitude	= nullptr;
+	m_nTemporalDerivativeFrame		= -1;
+	m_nScalarPyramidSerial			= 0;
+	m_fScalarPyramidTime			= -1.0f;
+	m_nFTLEWidth				= 0;
+	m_nFTLEHeight				= 0;
+	m_nFTLEIntegrationLen		= 20;
+	m_fFTLEStepLen				= 0.5f;
 	m_bDrawCoordinateAxes		= TRUE;
 
 	m_ptViewportCenter			= CPointf(-1,-1);
@@ -138,6 +157,27 @@ CFlowIllustratorRenderView::CFlowIllustratorRenderView()
 
 	m_DisplayFunctions.push_back(	std::pair<CString, void (CFlowIllustratorRenderView::*)(const CAmiraVectorField2D*)> 
 									("LIC", &CFlowIllustratorRenderView::renderLIC) );
+
+	m_DisplayFunctions.push_back(	std::pair<CString, void (CFlowIllustratorRenderView::*)(const CAmiraVectorField2D*)> 
+									("FTLE", &CFlowIllustratorRenderView::renderFTLE) );
+
+	m_DisplayFunctions.push_back(	std::pair<CString, void (CFlowIllustratorRenderView::*)(const CAmiraVectorField2D*)> 
+									("Divergence", &CFlowIllustratorRenderView::renderDivergence) );
+
+	m_DisplayFunctions.push_back(	std::pair<CString, void (CFlowIllustratorRenderView::*)(const CAmiraVectorField2D*)> 
+									("Q-criterion", &CFlowIllustratorRenderView::renderQCriterion) );
+
+	m_DisplayFunctions.push_back(	std::pair<CString, void (CFlowIllustratorRenderView::*)(const CAmiraVectorField2D*)> 
+									("Lambda2", &CFlowIllustratorRenderView::renderLambda2) );
+
+	m_DisplayFunctions.push_back(	std::pair<CString, void (CFlowIllustratorRenderView::*)(const CAmiraVectorField2D*)> 
+									("Okubo-Weiss", &CFlowIllustratorRenderView::renderOkuboWeiss) );
+
+	m_DisplayFunctions.push_back(	std::pair<CString, void (CFlowIllustratorRenderView::*)(const CAmiraVectorField2D*)> 
+									("Strain rate", &CFlowIllustratorRenderView::renderStrainRate) );
+
+	m_DisplayFunctions.push_back(	std::pair<CString, void (CFlowIllustratorRenderView::*)(const CAmiraVectorField2D*)> 
+									("Temporal derivative", &CFlowIllustratorRenderView::renderTemporalDerivative) );
 }
 
 CFlowIllustratorRenderView::~CFlowIllustratorRenderView()
@@ -336,8 +376,8 @@ void CFlowIllustratorRenderView::DrawScene(void)
 		glDisableClientState(GL_COLOR_ARRAY);
 	}
 
-	if (m_IsoLineMngr.Size() > 0) {
-		m_IsoLineMngr.Draw();	//Draw iso lines
+	if (!m_IsoContours.IsEmpty()) {
+		DrawIsoContours();	//Draw iso lines
 	}
 
 	if (m_pDrawObjMngr)	{	//Draw flow templates
@@ -414,6 +454,22 @@ void CFlowIllustratorRenderView::DrawCoordinateAxes(void)
 	SetProjection(m_rcViewPort.m_Min.x, m_rcViewPort.m_Max.x, m_rcViewPort.m_Min.y, m_rcViewPort.m_Max.y);
 }
 
+void CFlowIllustratorRenderView::DrawIsoContours(void)
+{
+	glColor4fv( reinterpret_cast<const GLfloat*>(&m_NewObjectColor) );
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(2, GL_FLOAT, 0, m_IsoContours.GetPoints());
+
+	for (size_t i = 0; i < m_IsoContours.GetNumLines(); i++)
+	{
+		const IsoContourLine &line = m_IsoContours.GetLine(i);
+		glDrawArrays((line.bClosed)? GL_LINE_LOOP : GL_LINE_STRIP, line.nFirst, line.nNumPoints);
+	}
+
+	glDisableClientState(GL_VERTEX_ARRAY);
+}
+
 void CFlowIllustratorRenderView::GetDisplayFunctionNames(CStringArray &arrNames) const
 {
 	arrNames.RemoveAll();
@@ -433,7 +489,7 @@ void CFlowIllustratorRenderView::SetDisplayFunction(int nID)
 {
 	if(nID >= 0 && nID < static_cast<int>(m_DisplayFunctions.size()) )
 	{
-		m_IsoLineMngr.RemoveAll();
+		m_IsoContours.Clear();
 		m_nDisplayFuncID = nID;
 		m_pDisplayFunc = m_DisplayFunctions[nID].second;
 		Dirty();
@@ -489,12 +545,87 @@ void CFlowIllustratorRenderView::SetLICSeed(int nSeed)
 	}
 }
 
+STREAMLINE_INTEGRATOR CFlowIllustratorRenderView::GetStreamlineIntegrator() const
+{
+	return m_nStreamlineIntegrator;
+}
+
+void CFlowIllustratorRenderView::SetStreamlineIntegrator(STREAMLINE_INTEGRATOR nIntegrator)
+{
+	if (m_nStreamlineIntegrator != nIntegrator) {
+		m_nStreamlineIntegrator = nIntegrator;
+		Dirty();
+	}
+}
+
+CONTRAST_ENHANCEMENT CFlowIllustratorRenderView::GetContrastEnhancement() const
+{
+	return m_nContrastEnhancement;
+}
+
+void CFlowIllustratorRenderView::SetContrastEnhancement(CONTRAST_ENHANCEMENT nMode)
+{
+	if (m_nContrastEnhancement != nMode) {
+		m_nContrastEnhancement = nMode;
+		Dirty();
+	}
+}
+
+void CFlowIllustratorRenderView::SetFTLEResolution(int nWidth, int nHeight)
+{
+	if (m_nFTLEWidth != nWidth || m_nFTLEHeight != nHeight) {
+		m_nFTLEWidth	= nWidth;
+		m_nFTLEHeight	= nHeight;
+		m_bFTLEValid	= FALSE;
+		Dirty();
+	}
+}
+
+void CFlowIllustratorRenderView::SetFTLEIntegrationLen(int nNumFrames)
+{
+	if (m_nFTLEIntegrationLen != nNumFrames) {
+		m_nFTLEIntegrationLen	= nNumFrames;
+		m_bFTLEValid			= FALSE;
+		Dirty();
+	}
+}
+
+int CFlowIllustratorRenderView::GetFTLEIntegrationLen() const
+{
+	return m_nFTLEIntegrationLen;
+}
+
 void CFlowIllustratorRenderView::SetIsoValue(float IsoVal)
 {
 	m_fIsoVal = IsoVal;
 	Dirty();
 }
 
+int CFlowIllustratorRenderView::GetNumIsoLevels() const
+{
+	return m_nNumIsoLevels;
+}
+
+void CFlowIllustratorRenderView::SetNumIsoLevels(int nNumLevels)
+{
+	nNumLevels = max(nNumLevels, 1);
+
+	if (m_nNumIsoLevels != nNumLevels) {
+		m_nNumIsoLevels = nNumLevels;
+		Dirty();
+	}
+}
+
+const CIsoContours& CFlowIllustratorRenderView::GetIsoContours() const
+{
+	return m_IsoContours;
+}
+
+CString CFlowIllustratorRenderView::GetIsoContoursSVGString(float fLineWidthFactor) const
+{
+	return m_IsoContours.toString(m_NewObjectColor, 1.0f, fLineWidthFactor);
+}
+
 void CFlowIllustratorRenderView::SetMinMaxIsoValue(float fMin, float fMax)
 {
 	CMainFrame *pMainFrm = reinterpret_cast<CMainFrame*>(GetParent());
@@ -572,6 +703,34 @@ BOOL CFlowIllustratorRenderView::AcquireVorticityField()
 	return (m_bVorticityValid = FALSE);
 }
 
+BOOL CFlowIllustratorRenderView::AcquireFTLEField()
+{
+	CFlowIllustratorDoc *pDoc = GetDocument();
+	if (pDoc)
+	{
+		const CAmiraVectorField2D *pVecField = pDoc->GetVectorfield();
+		if (pVecField)
+		{
+			int nFrame = static_cast<int>(pVecField->GetCurrentTimeStep());
+			if (m_bFTLEValid && m_nFTLEFrame == nFrame) return m_bFTLEValid;
+
+			if (m_pFTLEField) {delete m_pFTLEField; m_pFTLEField = nullptr;}
+
+			//The cache discards its flow maps by itself, if the grid changed
+			m_FlowMapCache.Init(pVecField, pVecField->GetDomainRect(), m_nFTLEWidth, m_nFTLEHeight, m_fFTLEStepLen);
+			m_pFTLEField = m_FlowMapCache.GetFTLEField(nFrame, m_nFTLEIntegrationLen);
+
+			if (m_pFTLEField)
+			{
+				m_nFTLEFrame = nFrame;
+				return (m_bFTLEValid = TRUE);
+			}
+		}
+	}
+
+	return (m_bFTLEValid = FALSE);
+}
+
 BOOL CFlowIllustratorRenderView::AcquireVectorMagnitudeField()
 {
 	if (m_bVectorMagnitudeValid) return m_bVectorMagnitudeValid;
@@ -596,6 +755,91 @@ BOOL CFlowIllustratorRenderView::AcquireVectorMagnitudeField()
 	return (m_bVectorMagnitudeValid = FALSE);
 }
 
+CScalarField2D* CFlowIllustratorRenderView::AcquireDerivedField(DERIVED_FIELD nField)
+{
+	CFlowIllustratorDoc *pDoc = GetDocument();
+	if (!pDoc) return nullptr;
+
+	const CAmiraVectorField2D *pVecField = pDoc->GetVectorfield();
+	if (!pVecField) return nullptr;
+
+	int nIndex = 0;
+	while ((1u << nIndex) != static_cast<unsigned int>(nField)) nIndex++;
+
+	//Keyed by time, since virtual frames are renumbered, if the temporal resolution changes
+	const float fTime = pVecField->GetCurrentTime();
+
+	if (fTime != m_fDerivedFieldsTime) {
+		InvalidateDerivedFields();
+		m_fDerivedFieldsTime = fTime;
+	}
+
+	if (m_nDerivedFieldsValid & nField) return m_pDerivedFields[nIndex];
+
+	m_nDerivedFieldsUsed |= nField;
+
+	//Compute every field in use, that is missing, in a single pass
+	CScalarField2D *ppFields[DF_NUM_FIELDS];
+	pVecField->GetDerivedFields(m_nDerivedFieldsUsed & ~m_nDerivedFieldsValid, ppFields);
+
+	for (int i = 0; i < DF_NUM_FIELDS; i++)
+	{
+		if (ppFields[i]) {
+			m_pDerivedFields[i] = ppFields[i];
+		}
+	}
+
+	m_nDerivedFieldsValid |= m_nDerivedFieldsUsed;
+
+	return m_pDerivedFields[nIndex];
+}
+
+CScalarField2D* CFlowIllustratorRenderView::AcquireTemporalDerivativeMagnitude()
+{
+	CFlowIllustratorDoc *pDoc = GetDocument();
+	if (!pDoc) return nullptr;
+
+	const CAmiraVectorField2D *pVecField = pDoc->GetVectorfield();
+	if (!pVecField) return nullptr;
+
+	const int nFrame = static_cast<int>(pVecField->GetCurrentTimeStep());
+	if (m_pTemporalDerivativeMagnitude && m_nTemporalDerivativeFrame == nFrame) return m_pTemporalDerivativeMagnitude;
+
+	if (m_pTemporalDerivativeMagnitude) {delete m_pTemporalDerivativeMagnitude; m_pTemporalDerivativeMagnitude = nullptr;}
+
+	m_TemporalDerivativeCache.Init(pVecField);
+	shared_ptr<const CVectorField2D> pField = m_TemporalDerivativeCache.GetField(nFrame);
+
+	if (pField)
+	{
+		m_pTemporalDerivativeMagnitude	= pField->GetMagnitudeField();
+		m_nTemporalDerivativeFrame		= nFrame;
+	}
+
+	return m_pTemporalDerivativeMagnitude;
+}
+
+void CFlowIllustratorRenderView::InvalidateDerivedFields()
+{
+	for (int i = 0; i < DF_NUM_FIELDS; i++)
+	{
+		if (m_pDerivedFields[i]) {
+			delete m_pDerivedFields[i];
+			m_pDerivedFields[i] = nullptr;
+		}
+	}
+
+	m_nDerivedFieldsValid = 0;
+	m_fDerivedFieldsTime = -1.0f;
+
+	if (m_pTemporalDerivativeMagnitude) {
+		delete m_pTemporalDerivativeMagnitude;
+		m_pTemporalDerivativeMagnitude = nullptr;
+	}
+
+	m_nTemporalDerivativeFrame = -1;
+}
+
 void CFlowIllustratorRenderView::AdjustViewport(BOOL bCenterOnMousePos)
 {
 	CFlowIllustratorDoc* pDoc = GetDocument();
@@ -860,13 +1104,26 @@ void CFlowIllustratorRenderView::renderColorCoding(const CAmiraVectorField2D *pV
 
 	float saturation (1.0f);
 
+	//Obstacles and masked regions are black, their vectors are not sampled
+	const COccupancyGrid *pOccupancy = pVectorField->GetOccupancy( static_cast<int>(pVectorField->GetCurrentTimeStep()) );
+	if (pOccupancy && pOccupancy->IsFull()) pOccupancy = nullptr;
+
+	//Size of a pixel in domain units, zoomed out the vectors are pre-filtered to it
+	const float fFootprint = max(1.0f / m_fPixelUnitRatioX, 1.0f / m_fPixelUnitRatioY);
+
 	for (int y = m_yMin; y < (m_yExtent+m_yMin); y++) 
 	{
 		for (int x = m_xMin; x < (m_xExtent+m_xMin); x++) 
 		{
 			CPointf pos(ScreenToDomainf(CPointf( static_cast<float>(x), static_cast<float>(y))));
 
-			CVector2D v( pVectorField->GetVectorAt(pos) );
+			if (pOccupancy && !pOccupancy->IsLive(pos)) {
+				pColor[0] = pColor[1] = pColor[2] = 0.0f;
+				pColor += 3;
+				continue;
+			}
+
+			CVector2D v( pVectorField->GetVectorAt(pos, fFootprint) );
 
 			float val (v.abs());
 			float dummy ( (xAxis * v) / val );
@@ -893,28 +1150,121 @@ void CFlowIllustratorRenderView::renderVorticity(const CAmiraVectorField2D* /*pV
 	_renderScalarField(m_pVortField);
 }
 
+void CFlowIllustratorRenderView::renderFTLE(const CAmiraVectorField2D* /*pVectorField*/)
+{
+	if (!AcquireFTLEField()) return;
+	_renderScalarField(m_pFTLEField);
+}
+
+void CFlowIllustratorRenderView::renderDivergence(const CAmiraVectorField2D* /*pVectorField*/)
+{
+	CScalarField2D *pField = AcquireDerivedField(DF_DIVERGENCE);
+	if (pField) _renderScalarField(pField);
+}
+
+void CFlowIllustratorRenderView::renderQCriterion(const CAmiraVectorField2D* /*pVectorField*/)
+{
+	CScalarField2D *pField = AcquireDerivedField(DF_Q_CRITERION);
+	if (pField) _renderScalarField(pField);
+}
+
+void CFlowIllustratorRenderView::renderLambda2(const CAmiraVectorField2D* /*pVectorField*/)
+{
+	CScalarField2D *pField = AcquireDerivedField(DF_LAMBDA2);
+	if (pField) _renderScalarField(pField);
+}
+
+void CFlowIllustratorRenderView::renderOkuboWeiss(const CAmiraVectorField2D* /*pVectorField*/)
+{
+	CScalarField2D *pField = AcquireDerivedField(DF_OKUBO_WEISS);
+	if (pField) _renderScalarField(pField);
+}
+
+void CFlowIllustratorRenderView::renderStrainRate(const CAmiraVectorField2D* /*pVectorField*/)
+{
+	CScalarField2D *pField = AcquireDerivedField(DF_STRAIN_RATE);
+	if (pField) _renderScalarField(pField);
+}
+
+void CFlowIllustratorRenderView::renderTemporalDerivative(const CAmiraVectorField2D* /*pVectorField*/)
+{
+	CScalarField2D *pField = AcquireTemporalDerivativeMagnitude();
+	if (pField) _renderScalarField(pField);
+}
+
 void CFlowIllustratorRenderView::_renderScalarField(CScalarField2D *pSrc)
 {
 	//calculate the colors for the vectors
 	float *pColor = &m_pColorBuffer[0];
 
-	float max(pSrc->GetMaxValue());
-	float min(pSrc->GetMinValue());
+	float fMax(pSrc->GetMaxValue());
+	float fMin(pSrc->GetMinValue());
 	float colVar(0);
 
+	//Sample the displayed pixels first, such that the contrast is enhanced for the visible part of the field
+	vector<float> values(m_xExtent * m_yExtent);
+	float *pValue = (values.empty())? nullptr : &values[0];
+
+	//Size of a pixel in samples of the field. Zoomed out, pixels are sampled from a pre-filtered level of similar size.
+	const CRectF rcSrc		= pSrc->GetDomainRect();
+	const int nWidth		= static_cast<int>(pSrc->GetExtentX());
+	const int nHeight		= static_cast<int>(pSrc->GetExtentY());
+	const float fSamplesX	= (nWidth - 1) / rcSrc.getWidth();
+	const float fSamplesY	= (nHeight - 1) / rcSrc.getHeight();
+	const float fFootprint	= max(fSamplesX / m_fPixelUnitRatioX, fSamplesY / m_fPixelUnitRatioY);
+
+	//Keyed by the serial number of the field, whose address may be reused, and the time, since fields may be updated in place
+	CFlowIllustratorDoc *pDoc	= GetDocument();
+	const float fTime			= (pDoc && pDoc->GetVectorfield())? pDoc->GetVectorfield()->GetCurrentTime() : 0.0f;
+
+	if (pSrc->GetSerial() != m_nScalarPyramidSerial || fTime != m_fScalarPyramidTime) {
+		m_ScalarPyramid.Init(pSrc->GetData(), nWidth, nHeight, 1);
+		m_nScalarPyramidSerial	= pSrc->GetSerial();
+		m_fScalarPyramidTime	= fTime;
+	}
+
+	const bool bPyramid = (m_ScalarPyramid.GetLevel(fFootprint) > 0);
+
 	for (int y = m_yMin; y < (m_yExtent+m_yMin); y++) 
 	{
 		for (int x = m_xMin; x < (m_xExtent+m_xMin); x++) 
 		{
-			CPointf pos(ScreenToDomain(CPoint(x, y)));
-			
-			float dummy( pSrc->GetValue(pos) );
+			const CPointf pos( ScreenToDomain(CPoint(x, y)) );
+
+			if (bPyramid)
+				m_ScalarPyramid.GetAt((pos.x - rcSrc.m_Min.x) * fSamplesX, (pos.y - rcSrc.m_Min.y) * fSamplesY, fFootprint, pValue++);
+			else
+				*pValue++ = pSrc->GetValue(pos);
+		}
+	}
+
+	if (m_nContrastEnhancement != CE_NONE && !values.empty())
+	{
+		//Equalise the magnitudes, such that zero keeps its colour
+		CHistogramEqualizer equalizer;
+
+		equalizer.SetMode(m_nContrastEnhancement, m_xExtent, m_yExtent);
+		equalizer.SetSymmetric(true);
+		equalizer.SetRange(fMin, fMax);
+		equalizer.Apply(&values[0], m_xExtent, m_yExtent);
+
+		fMax = (fabs(fMin) > fabs(fMax))? fabs(fMin) : fabs(fMax);
+		fMin = -fMax;
+	}
+
+	pValue = (values.empty())? nullptr : &values[0];
+
+	for (int y = m_yMin; y < (m_yExtent+m_yMin); y++) 
+	{
+		for (int x = m_xMin; x < (m_xExtent+m_xMin); x++) 
+		{
+			float dummy( *pValue++ );
 
 			if (dummy >= 0.0f) {
-				dummy = dummy/max;
+				dummy = dummy/fMax;
 				colVar = 90.0f;
 			} else {
-				dummy = -dummy/min;
+				dummy = -dummy/fMin;
 				colVar = -90.0f;
 			}
 
@@ -989,115 +1339,41 @@ void CFlowIllustratorRenderView::renderDerivatives_y(const CAmiraVectorField2D *
 	}
 }
 
-void CFlowIllustratorRenderView::renderIsoLines(const CAmiraVectorField2D *pVectorField)
+void CFlowIllustratorRenderView::renderIsoLines(const CAmiraVectorField2D* /*pVectorField*/)
 {
-	renderVorticity(pVectorField);
-
-	int extX = m_pVortField->GetExtentX();
-	int extY = m_pVortField->GetExtentY();
-
-	CScalarField2D *pDummyField = m_pVortField;
-
-	CPointf ptFrom, ptTo;
-	CPointf special1, special2;
-	bool bSpecial = false;
-
-
-	m_IsoLineMngr.RemoveAll();
-
-	for (int y = 0; y < extY-1; y++) 
-	{
-		for (int x = 0; x < extX-1; x++) 
-		{			
-			float val1 = pDummyField->GetAt(x,y);
-			float val2 = pDummyField->GetAt(x+1,y);
-			float val3 = pDummyField->GetAt(x+1,y+1);
-			float val4 = pDummyField->GetAt(x,y+1);
-			
-			DWORD ms = 0;
-
-			if (val1 > m_fIsoVal)
-				ms |= 0x00000001;
-
-			if (val2 > m_fIsoVal)
-				ms |= 0x00000002;
-
-			if (val3 > m_fIsoVal)
-				ms |= 0x00000004;
-
-			if (val4 > m_fIsoVal)
-				ms |= 0x00000008;
-
-			switch(ms)
-			{
-				case 0x00000001:
-				case 0x0000000E:
-					ptFrom	= pDummyField->GetDomainCoordinates(x + 0.5f, static_cast<float>(y));
-					ptTo	= pDummyField->GetDomainCoordinates(static_cast<float>(x), y + .5f );
-				break;
-				case 0x00000002:
-				case 0x0000000D:
-					ptFrom	= pDummyField->GetDomainCoordinates(x + 0.5f, static_cast<float>(y));
-					ptTo	= pDummyField->GetDomainCoordinates(x + 1.0f, y + 0.5f);
-				break;
-				case 0x00000003:
-				case 0x0000000C:
-					ptFrom	= pDummyField->GetDomainCoordinates(static_cast<float>(x), y + 0.5f);
-					ptTo	= pDummyField->GetDomainCoordinates(x + 1.0f, y + .5f);
-				break;
-				case 0x00000004:
-				case 0x0000000B:
-					ptFrom	= pDummyField->GetDomainCoordinates(x + 1.0f, y + 0.5f);
-					ptTo	= pDummyField->GetDomainCoordinates(x + 0.5f, y + 1.0f);
-				break;
-				case 0x00000005:
-					ptFrom		= pDummyField->GetDomainCoordinates(x + .5f, static_cast<float>(y));
-					ptTo		= pDummyField->GetDomainCoordinates(x + 1.0f, y + .5f);
-					special1	= pDummyField->GetDomainCoordinates(static_cast<float>(x), y+.5f);
-					special2	= pDummyField->GetDomainCoordinates(x + .5f, y + 1.0f);
-					bSpecial	= true;
-				break;
-				case 0x00000006:
-				case 0x00000009:
-					ptFrom	= pDummyField->GetDomainCoordinates(x + 0.5f, static_cast<float>(y));
-					ptTo	= pDummyField->GetDomainCoordinates(x + 0.5f, y + 1.0f);
-				break;
-				case 0x00000007:
-				case 0x00000008:
-					ptFrom	= pDummyField->GetDomainCoordinates(static_cast<float>(x), y + 0.5f);
-					ptTo	= pDummyField->GetDomainCoordinates(x + 0.5f, y + 1.0f);
-				break;
-				case 0x0000000A:
-					ptFrom		= pDummyField->GetDomainCoordinates(static_cast<float>(x), y + .5f);
-					ptTo		= pDummyField->GetDomainCoordinates(x + 0.5f, static_cast<float>(y));
-					special1	= pDummyField->GetDomainCoordinates(x + 0.5f, y + 1.0f);
-					special2	= pDummyField->GetDomainCoordinates(x + 1.0f, y + 0.5f);
-					bSpecial	= true;
-				break;
-
-				default:	//0x00 && 0x0F
-					continue;
-					break;
-			}
+	if (!AcquireVorticityField()) {
+		m_IsoContours.Clear();
+		return;
+	}
 
-			m_IsoLineMngr.Add(new CLine(ptFrom, ptTo, m_NewObjectColor));
+	_renderScalarField(m_pVortField);
 
-			if (bSpecial) {
-				m_IsoLineMngr.Add(new CLine(special1, special2, m_NewObjectColor));
-				bSpecial = false;
-			}
-		}
+	if (m_nNumIsoLevels > 1) {
+		m_IsoContours.Extract(m_pVortField, m_pVortField->GetMinValue(), m_pVortField->GetMaxValue(), m_nNumIsoLevels);
+	} else {
+		m_IsoContours.Extract(m_pVortField, &m_fIsoVal, 1);
 	}
 }
 
 void CFlowIllustratorRenderView::renderLIC(const CAmiraVectorField2D* pVectorField)
 {
-	CScalarField2D *pNoiseTex= _generateRandomNoiseTexture(m_rcViewPort); 
-	CScalarField2D LicTex(m_rcViewPort, m_nLicWidth, m_nLicHeight);
+	//More LIC pixels than screen pixels are not visible
+	const int nLicWidth		= (m_xExtent > 0)? min(m_nLicWidth, m_xExtent) : m_nLicWidth;
+	const int nLicHeight	= (m_yExtent > 0)? min(m_nLicHeight, m_yExtent) : m_nLicHeight;
+
+	CScalarField2D *pNoiseTex= _generateRandomNoiseTexture(m_rcViewPort, nLicWidth, nLicHeight); 
+	CScalarField2D LicTex(m_rcViewPort, nLicWidth, nLicHeight);
 	LicTex.Zero();
 
-	float fPixelSize = min (pVectorField->GetExtentX() / float(m_nLicWidth), pVectorField->GetExtentY() / float(m_nLicHeight)); //min(pt.x, pt.y);
-	float minStep = 1e-2f*pVectorField->GetSamplesPerUnitX();
+	//Zoomed out, stream lines are traced through a coarse copy of the field, whose cells are about as large as a LIC pixel.
+	//So they cover the same number of LIC pixels at every zoom level, and their cost does not depend on the size of the field.
+	const float fLicPixel = max(m_rcViewPort.getWidth() / nLicWidth, m_rcViewPort.getHeight() / nLicHeight);
+	COccupancyGrid coarseOccupancy;
+	CVectorField2D *pCoarseField = pVectorField->GetCoarseVectorField(fLicPixel, coarseOccupancy);
+	const CVectorField2D *pTracedField = (pCoarseField)? pCoarseField : pVectorField;
+
+	float fPixelSize = min (pTracedField->GetExtentX() / float(nLicWidth), pTracedField->GetExtentY() / float(nLicHeight)); //min(pt.x, pt.y);
+	float minStep = 1e-2f*pTracedField->GetSamplesPerUnitX();
 	if (fPixelSize < minStep) 
 		fPixelSize = minStep;
 
@@ -1116,6 +1392,10 @@ void CFlowIllustratorRenderView::renderLIC(const CAmiraVectorField2D* pVectorFie
 
 	vector<int> visited(dimX * dimY, 0);
 
+	//No stream lines are seeded in obstacles and masked regions
+	const COccupancyGrid *pOccupancy = pVectorField->GetOccupancy( static_cast<int>(pVectorField->GetCurrentTimeStep()) );
+	if (pOccupancy && pOccupancy->IsFull()) pOccupancy = nullptr;
+
 	for (unsigned int y = 0; y < dimY; y++) 
 	{
 		for (unsigned int x = 0; x < dimX; x++) 
@@ -1125,8 +1405,23 @@ void CFlowIllustratorRenderView::renderLIC(const CAmiraVectorField2D* pVectorFie
 
 			pos = pNoiseTex->GetDomainCoordinates(static_cast<float>(x), static_cast<float>(y));
 
-			calcStreamLine(pos, &StreamF, true);
-			calcStreamLine(pos, &StreamB, false);
+			if (pOccupancy && !pOccupancy->IsLive(pos)) {
+				visited[index]++;
+				continue;
+			}
+
+			if (pCoarseField)
+			{
+				StreamF.GetDataPoints()->clear();
+				StreamB.GetDataPoints()->clear();
+				pCoarseField->integrateCellwise(pos.x, pos.y, nKSize, fPixelSize, true, StreamF.GetDataPoints(), m_rcViewPort);
+				pCoarseField->integrateCellwise(pos.x, pos.y, nKSize, fPixelSize, false, StreamB.GetDataPoints(), m_rcViewPort);
+			}
+			else
+			{
+				calcStreamLine(pos, &StreamF, true);
+				calcStreamLine(pos, &StreamB, false);
+			}
 
 			vector<CPointf> *pSLB = StreamB.GetDataPoints();
 			vector<CPointf> *pSLF = StreamF.GetDataPoints();
@@ -1181,6 +1476,9 @@ void CFlowIllustratorRenderView::renderLIC(const CAmiraVectorField2D* pVectorFie
 		}
 	} 
 
+	if (pCoarseField)
+		delete pCoarseField;
+
 	//Normalize
 	for(unsigned int j=0;j<dimY;j++)
 	{
@@ -1209,52 +1507,22 @@ void CFlowIllustratorRenderView::renderLIC(const CAmiraVectorField2D* pVectorFie
 	}
 }
 
-#define HISTO_SIZE 256
 void CFlowIllustratorRenderView::EnhanceContrast(CScalarField2D &texture)
 {
-	//Calc the histogram;
-
-	int histo[HISTO_SIZE];
-	int histoCumulative[HISTO_SIZE];
-	memset(histo, 0, HISTO_SIZE * sizeof(int));
-
-	//min and max color values
-	int min(HISTO_SIZE);
-	int max(0);
-
-	int extX(texture.GetExtentX());
-	int extY(texture.GetExtentY());
-	int numPxl = extX*extY;
-
-	for (int j=0; j<extY; j++) {
-		for (int i=0; i<extX; i++) {
-			int indx =  static_cast<int>(texture.GetAt(i,j) * (HISTO_SIZE-1));
-			histo[ indx ] ++;
-			if (indx < min) min = indx;
-			else if (indx > max) max = indx;
-		}
-	}
+	CHistogramEqualizer equalizer;
 
-	//compute cumulative histogram
-	histoCumulative[0] = histo[0];
-	for (int i=0; i < HISTO_SIZE; i++) {
-		histoCumulative[i] = histoCumulative[i-1]+histo[i];
-	}
-
-
-	//Loop over the image
-	for (int j=0; j<extY; j++) {
-		for (int i=0; i<extX; i++) {
-			int indx =  static_cast<int>(texture.GetAt(i,j) * (HISTO_SIZE-1));
-
-			//Compute the output pixel
-			texture.SetAt(i,j, (texture.GetAt(i,j)+histoCumulative[indx]/float(numPxl))/2.0f);
-		}
-	}
+	equalizer.SetMode( (m_nContrastEnhancement == CE_ADAPTIVE)? CE_ADAPTIVE : CE_GLOBAL, texture.GetExtentX(), texture.GetExtentY() );
+	equalizer.SetRange(0.0f, 1.0f);
+	equalizer.SetBlend(0.5f);
+	equalizer.Apply(texture);
 }
 
-CScalarField2D* CFlowIllustratorRenderView::_generateRandomNoiseTexture(const CRectF &rcDomain)
+CScalarField2D* CFlowIllustratorRenderView::_generateRandomNoiseTexture(const CRectF &rcDomain, int nWidth, int nHeight)
 {
+	//The size follows the window, if the LIC texture is larger than the screen
+	if (m_pLICNoiseTex && (static_cast<int>(m_pLICNoiseTex->GetExtentX()) != nWidth || static_cast<int>(m_pLICNoiseTex->GetExtentY()) != nHeight))
+		m_bLICNoiseTexValid = FALSE;
+
 	if (!m_bLICNoiseTexValid)
 	{
 		if (m_pLICNoiseTex)
@@ -1262,11 +1530,11 @@ CScalarField2D* CFlowIllustratorRenderView::_generateRandomNoiseTexture(const CR
 
 		srand(m_nLicSeed);
 
-		m_pLICNoiseTex = new CScalarField2D(rcDomain, m_nLicWidth, m_nLicHeight); //For now
+		m_pLICNoiseTex = new CScalarField2D(rcDomain, nWidth, nHeight); //For now
 
-		for (int y = 0; y < m_nLicHeight; y++) 
+		for (int y = 0; y < nHeight; y++) 
 		{
-			for (int x = 0; x < m_nLicWidth; x++) 
+			for (int x = 0; x < nWidth; x++) 
 			{
 				m_pLICNoiseTex->SetAt(x,y, (rand()%255)/255.0f);
 			}
@@ -1413,6 +1681,12 @@ void CFlowIllustratorRenderView::OnDestroy()
 
 	if (m_pLICNoiseTex)
 		delete m_pLICNoiseTex;
+
+	if (m_pFTLEField)
+		delete m_pFTLEField;
+
+	InvalidateDerivedFields();
+	m_FlowMapCache.Clear();
 }
 
 BOOL CFlowIllustratorRenderView::OnEraseBkgnd(CDC* /*pDC*/)
@@ -1433,7 +1707,12 @@ void CFlowIllustratorRenderView::calcStreamLine(const CPointf& point, CStreamLin
 			vector<CPointf>* pData = pStreamLine->GetDataPoints();
 			pData->clear();
 			CVector3D vec(point.x, point.y, 0);
-			pVecField->integrateRK4( vec  , static_cast<int>(pStreamLine->GetMaxIntegrationLen()), pStreamLine->GetStepSize(), bForward,  pData, m_rcViewPort);
+
+			if (m_nStreamlineIntegrator == SI_CELLWISE) {
+				pVecField->integrateCellwise( vec, static_cast<int>(pStreamLine->GetMaxIntegrationLen()), pStreamLine->GetStepSize(), bForward,  pData, m_rcViewPort);
+			} else {
+				pVecField->integrateRK4( vec  , static_cast<int>(pStreamLine->GetMaxIntegrationLen()), pStreamLine->GetStepSize(), bForward,  pData, m_rcViewPort);
+			}
 			pStreamLine->SetOrigin( point );
 		}
 	}
@@ -30,6 +30,11 @@
 #include "DrawingObjectMngr.h"
 #include "ShaderMngr.h"
 #include "StreamLine.h"
+#include "FlowMap.h"
+#include "TemporalDerivativeCache.h"
+#include "HistogramEqualizer.h"
+#include "IsoContours.h"
+#include "GridPyramid.h"
 
 
 const float COORDINATE_AXIS_WIDTH = 30.0f;	/**< Width of the vertical coordinate axis in pixel. */
@@ -65,6 +70,7 @@ protected:
 	float		m_fPixelUnitRatioY;			/**< Pixels per domain unit in Y-direction. */
 
 	float		m_fIsoVal;					/**< Current iso-value to render iso contours. */
+	int			m_nNumIsoLevels;			/**< Number of iso contours. If greater than one, they are evenly distributed over the vorticity range and m_fIsoVal is ignored. */
 	BOOL		m_bDrawCoordinateAxes;		/**< Flag, that determines if coordinate axes are drawn around the domain. */
 
 	CScalarField2D *m_pVortField;			/**< Pointer to the vorticity field, corresponding to the vector field of the current frame. */
@@ -90,7 +96,7 @@ protected:
 
 	CShaderMngr			m_ShaderMngr;		/**< Does the nasty shader management stuff. */
 	CDrawingObjectMngr *m_pDrawObjMngr;		/**< Pointer to  the CDrawingObjectMngr, owned by CFlowIllustratorDocument. */
-	CDrawingObjectMngr	m_IsoLineMngr;		/**< Special CDrawingObjectMngr, who manages and keeps track of per-frame iso lines. */
+	CIsoContours		m_IsoContours;		/**< Per-frame iso lines of the vorticity. */
 	
 	HGLRC					m_hRc;				/**< Handle to the OpenGL render context. */
 	int						m_nPixelFormatMSAA;	/**< Index that identifies the pixel format to set. The various pixel formats supported by a device context are identified by one-based indexes. */
@@ -104,6 +110,39 @@ protected:
 	BOOL			m_bLICNoiseTexValid;	/**< If TRUE, the NOISE texture is valid (no need to generate a new one each time). */
 	CScalarField2D *m_pLICNoiseTex;			/**< Pointer to the noise texture. */
 
+	STREAMLINE_INTEGRATOR m_nStreamlineIntegrator;	/**< Integrator used for stream lines and LIC. */
+	CONTRAST_ENHANCEMENT  m_nContrastEnhancement;	/**< Contrast enhancement of scalar displays. LIC is always equalised, adaptively if CE_ADAPTIVE is selected. */
+
+	//FTLE
+protected:
+	CFlowMapCache	m_FlowMapCache;			/**< Caches the flow maps between consecutive frames, used to compute FTLE fields. */
+	CScalarField2D *m_pFTLEField;			/**< Pointer to the FTLE field of the current frame. */
+	BOOL			m_bFTLEValid;			/**< If TRUE, m_pFTLEField matches the current settings. */
+	int				m_nFTLEFrame;			/**< Start frame of m_pFTLEField. */
+	int				m_nFTLEWidth;			/**< Number of FTLE samples in X-direction. */
+	int				m_nFTLEHeight;			/**< Number of FTLE samples in Y-direction. */
+	int				m_nFTLEIntegrationLen;	/**< FTLE integration time in frames. Negative values yield backward FTLE. */
+	float			m_fFTLEStepLen;			/**< Maximum RK4 step length used to compute the flow maps, in grid space. */
+
+	//Derived fields
+protected:
+	CScalarField2D *m_pDerivedFields[DF_NUM_FIELDS];	/**< Fields derived from the velocity gradient of the current frame, indexed like DERIVED_FIELD. */
+	unsigned int	m_nDerivedFieldsValid;				/**< DERIVED_FIELD flags of the fields in m_pDerivedFields, that match m_fDerivedFieldsTime. */
+	unsigned int	m_nDerivedFieldsUsed;				/**< DERIVED_FIELD flags of all fields requested so far. They are computed together on the next frame. */
+	float			m_fDerivedFieldsTime;				/**< Time of m_pDerivedFields in time steps, fractional at virtual frames. */
+
+	//Temporal derivative
+protected:
+	CTemporalDerivativeCache m_TemporalDerivativeCache;		/**< Temporal derivatives of recently used frames, used by renderTemporalDerivative(). */
+	CScalarField2D *m_pTemporalDerivativeMagnitude;		/**< Magnitude of the temporal derivative of m_nTemporalDerivativeFrame. */
+	int				m_nTemporalDerivativeFrame;			/**< Frame of m_pTemporalDerivativeMagnitude, or -1 if it is invalid. */
+
+	//Multiresolution
+protected:
+	CGridPyramid			m_ScalarPyramid;		/**< Mip-map of the scalar field, that was displayed last. */
+	unsigned int			m_nScalarPyramidSerial;	/**< Serial number of the field of m_ScalarPyramid, see CDataField2D::GetSerial(). */
+	float					m_fScalarPyramidTime;	/**< Time of the vector field, when m_ScalarPyramid was initialized. */
+
 protected:
 	CFlowIllustratorRenderView();           /**<	Protected constructor used by dynamic creation */
 	virtual ~CFlowIllustratorRenderView();	/**<	Destroy this CFlowIllustratorRenderView and all its data. */ 
@@ -229,6 +268,56 @@ public:
 	 */
 	void SetLICSeed(int nSeed); 
 
+	/**
+	 *	Retrieve the integrator, used to compute stream lines and LIC.
+	 *
+	 *	@return The integrator as STREAMLINE_INTEGRATOR.
+	 */
+	STREAMLINE_INTEGRATOR GetStreamlineIntegrator() const;
+
+	/**
+	 *	Set the integrator, used to compute stream lines and LIC.
+	 *
+	 *	@param nIntegrator The new integrator.
+	 */
+	virtual void SetStreamlineIntegrator(STREAMLINE_INTEGRATOR nIntegrator);
+
+	/**
+	 *	Retrieve the contrast enhancement of scalar displays.
+	 */
+	CONTRAST_ENHANCEMENT GetContrastEnhancement() const;
+
+	/**
+	 *	Set the contrast enhancement of scalar displays, such as vorticity, FTLE and LIC.
+	 *
+	 *	@param nMode The new contrast enhancement.
+	 */
+	void SetContrastEnhancement(CONTRAST_ENHANCEMENT nMode);
+
+	//FTLE
+public:
+	/**
+	 *	Set the resolution of the grid, the FTLE field is computed on.
+	 *
+	 *	@param nWidth Number of samples in X-direction.
+	 *	@param nHeight Number of samples in Y-direction.
+	 *
+	 *	@remarks Changing the resolution discards all cached flow maps.
+	 */
+	void SetFTLEResolution(int nWidth, int nHeight);
+
+	/**
+	 *	Set the integration time of the FTLE field.
+	 *
+	 *	@param nNumFrames Integration time in frames. A negative value yields a backward FTLE field.
+	 */
+	void SetFTLEIntegrationLen(int nNumFrames);
+
+	/**
+	 *	Retrieve the integration time of the FTLE field in frames.
+	 */
+	int GetFTLEIntegrationLen() const;
+
 	/**
 	 *	Set the vorticity iso value, used to render iso-lines.
 	 *
@@ -236,6 +325,31 @@ public:
 	 */
 	void SetIsoValue(float IsoVal);
 
+	/**
+	 *	Retrieve the number of vorticity iso contours.
+	 */
+	int GetNumIsoLevels() const;
+
+	/**
+	 *	Set the number of vorticity iso contours. A single contour is drawn at the iso value, several contours are
+	 *	evenly distributed over the vorticity range of the current frame.
+	 *
+	 *	@param nNumLevels The number of contours, at least one.
+	 */
+	void SetNumIsoLevels(int nNumLevels);
+
+	/**
+	 *	Retrieve the iso contours of the current frame. They are empty, unless the iso contour display is selected.
+	 */
+	const CIsoContours& GetIsoContours() const;
+
+	/**
+	 *	Retrieve the iso contours of the current frame as SVG paths, in the colour of new flow templates.
+	 *
+	 *	@param fLineWidthFactor Pixels per domain unit.
+	 */
+	CString GetIsoContoursSVGString(float fLineWidthFactor) const;
+
 	/**
 	 *	Reset the viewport to display the entire domain of the currently opened vector field.
 	 */
@@ -262,6 +376,42 @@ protected:
 
 	BOOL AcquireVectorMagnitudeField();
 
+	/**
+	 *	Retrieves a field derived from the velocity gradient of the vector field's currently displayed time step.
+	 *
+	 *	@param nField The DERIVED_FIELD to retrieve.
+	 *
+	 *	@return A pointer to the field, or nullptr if it could not be retrieved. The field is owned by this view.
+	 *
+	 *	@remarks	All fields requested so far are computed in a single pass, when the time step changes.
+	 */
+	CScalarField2D* AcquireDerivedField(DERIVED_FIELD nField);
+
+	/**
+	 *	Discards all derived fields, e.g. after a new vector field was loaded.
+	 */
+	void InvalidateDerivedFields();
+
+	/**
+	 *	Retrieves the FTLE field, starting at the vector field's currently displayed time step.
+	 *
+	 *	@return TRUE, if the FTLE field could be retrieved successfully, otherwise FALSE.
+	 *
+	 *	@remarks	The FTLE field can be accessed via m_pFTLEField.
+	 *				Flow maps of previous calls are reused, hence stepping through the frames only requires
+	 *				the integration of a single new frame interval.
+	 */
+	BOOL AcquireFTLEField();
+
+	/**
+	 *	Retrieves the magnitude of the temporal derivative of the vector field's currently displayed time step.
+	 *
+	 *	@return A pointer to the field, or nullptr if it could not be retrieved. The field is owned by this view.
+	 *
+	 *	@see CTemporalDerivativeCache
+	 */
+	CScalarField2D* AcquireTemporalDerivativeMagnitude();
+
 	/**
 	 *	Adjust the viewport, according to the current zoom factor. 
 	 *
@@ -381,6 +531,11 @@ protected:
 	 */
 	void DrawCoordinateAxes(void);
 
+	/**
+	 *	Draws the iso contours in m_IsoContours, directly from its point array.
+	 */
+	void DrawIsoContours(void);
+
 	/**
 	 *	Virtual function to allows custom draw operations in derived classes.
 	 */
@@ -422,6 +577,9 @@ protected:
 	 */
 	void renderVorticity(const CAmiraVectorField2D *pVectorField);
 
+	/**
+	 *	Displays a scalar field. Zoomed out, each pixel is sampled from the level of m_ScalarPyramid, that matches its size.
+	 */
 	void _renderScalarField(CScalarField2D *pSrc);
 
 	/**
@@ -442,12 +600,13 @@ protected:
 
 	/**
 	 *	Displays the supplied vector field as vorticity rendering and 
-	 *	calculates vorticity iso lines, based on the currently set iso-value.
+	 *	calculates vorticity iso lines, based on the currently set iso-value or number of iso contours.
 	 *
 	 *	@param pVectorField Pointer to the vector field to be rendered.
 	 *
 	 *	@see renderVorticity()
 	 *	@see m_fIsoVal
+	 *	@see m_nNumIsoLevels
 	 */
 	void renderIsoLines(const CAmiraVectorField2D *pVectorField);
 
@@ -457,13 +616,47 @@ protected:
 	 *	@param pVectorField Pointer to the vector field to be rendered.
 	 *
 	 *	@remarks	This function uses the fast LIC algorithm, proposed by Stalling and Hege.			
+	 *				The LIC texture has at most one pixel per screen pixel. If its pixels are larger than the cells of the field,
+	 *				the stream lines are traced cell-wise through a coarse copy of the field, see CAmiraVectorField2D::GetCoarseVectorField().
 	 */
 	void renderLIC(const CAmiraVectorField2D *pVectorField);
 
+	/**
+	 *	Displays the finite-time Lyapunov exponent (FTLE) field of the supplied vector field.
+	 *
+	 *	@param pVectorField Pointer to the vector field to be rendered.
+	 *
+	 *	@see AcquireFTLEField()
+	 */
+	void renderFTLE(const CAmiraVectorField2D *pVectorField);
+
+	/**
+	 *	Display functions for fields derived from the velocity gradient.
+	 *
+	 *	@param pVectorField Pointer to the vector field to be rendered.
+	 *
+	 *	@see AcquireDerivedField()
+	 */
+	void renderDivergence(const CAmiraVectorField2D *pVectorField);
+	void renderQCriterion(const CAmiraVectorField2D *pVectorField);
+	void renderLambda2(const CAmiraVectorField2D *pVectorField);
+	void renderOkuboWeiss(const CAmiraVectorField2D *pVectorField);
+	void renderStrainRate(const CAmiraVectorField2D *pVectorField);
+
+	/**
+	 *	Displays the magnitude of the temporal derivative dv/dt of the supplied vector field.
+	 *
+	 *	@param pVectorField Pointer to the vector field to be rendered.
+	 *
+	 *	@see AcquireTemporalDerivativeMagnitude()
+	 */
+	void renderTemporalDerivative(const CAmiraVectorField2D *pVectorField);
+
 	/**
 	 *	Enhances the contrast of a monochrome image, using histogram equalisation.
+	 *	The equalised intensities are averaged with the original ones.
 	 *
-	 *	@param 	texture A reference to a CScalarField2D representing the monochrome image.
+	 *	@param 	texture A reference to a CScalarField2D representing the monochrome image, with intensities between 0 and 1.
 	 */
 	void EnhanceContrast(CScalarField2D &texture);
 
@@ -472,6 +665,8 @@ protected:
 	 *
 	 *	@param rcDomain Reference to a CRectF, describing the domain, for which the 
 	 *					noise texture is created.
+	 *	@param nWidth Width of the noise texture in pixel.
+	 *	@param nHeight Height of the noise texture in pixel.
 	 *
 	 *	@return A pointer to a CScalarField2D, representing the noise texture.
 	 *
@@ -479,7 +674,7 @@ protected:
 	 *				in order to create the noise texture.
 	 *				A pointer to the noise texture is stored in m_pLICNoiseTex, and managed by this CFlowIllustratorRenderView.
 	 */
-	CScalarField2D* _generateRandomNoiseTexture(const CRectF &rcDomain);
+	CScalarField2D* _generateRandomNoiseTexture(const CRectF &rcDomain, int nWidth, int nHeight);
 
 
 	/**
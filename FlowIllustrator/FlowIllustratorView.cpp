@@ -64,6 +64,9 @@
 #include "Rectangle.h"
 #include "Triangle.h"
 #include "PathLine.h"
+#include "EvenlySpacedStreamlines.h"
+#include "CriticalPointTracker.h"
+#include "VortexDetector.h"
 
 
 const float fDefaultArrowLength = 12.0f;
@@ -99,6 +102,7 @@ BEGIN_MESSAGE_MAP(CFlowIllustratorView, CView)
 	ON_REGISTERED_MESSAGE(WM_TRACKRECT_END_TRACK, &CFlowIllustratorView::OnTrackerRectEndTrack)
 	ON_REGISTERED_MESSAGE(WM_SVG_LOADED, &CFlowIllustratorView::OnSVGLoaded)
 	ON_REGISTERED_MESSAGE(WM_DOC_FRAME_CHANGED, &CFlowIllustratorView::OnDocFrameChanged)
+	ON_REGISTERED_MESSAGE(WM_DOC_REFERENCE_FRAME_CHANGED, &CFlowIllustratorView::OnDocReferenceFrameChanged)
 	ON_REGISTERED_MESSAGE(WM_VIEW_UPDATE_SELECTED, &CFlowIllustratorView::OnViewUpdateSelected)
 	ON_REGISTERED_MESSAGE(DRAWINGOBJS_SELECT_ITEM, &CFlowIllustratorView::OnSelectDrawingObject)
 	ON_WM_HSCROLL()
@@ -124,7 +128,12 @@ CFlowIllustratorView::CFlowIllustratorView()
 	m_ptLClick					= CPointf(-1.0f, -1.0f);
 	m_bCreateDroplets			= FALSE;
 	m_bAutoUpdateTrajectories	= FALSE;
+	m_bFastTrajectories			= FALSE;
+	m_fTrajectoryMaxError		= 0.25f;
 	m_bRenderStreaklineAsParticles = FALSE;
+	m_fStreamLineSeparation		= 20.0f;
+	m_bShowSkeleton				= FALSE;
+	m_bPreviewIntegrationValid	= FALSE;
 
 	m_bPasteHere = FALSE;
 
@@ -132,11 +141,24 @@ CFlowIllustratorView::CFlowIllustratorView()
 	SetEditMode(EM_VORTEX);
 
 	m_nDetectorFuncID	= 0;
+	m_nVortexFrame		= -1;
 
 	m_bLoadExample = TRUE;
 
 	m_DetectorFunctions.push_back(	std::pair<CString, bool (CFlowIllustratorView::*)(const CAmiraVectorField2D*, const CPointf&)>
 									(_T("Vorticity magnitude"), &CFlowIllustratorView::_isVortVorticityMagnitude) );
+
+	m_DetectorFunctions.push_back(	std::pair<CString, bool (CFlowIllustratorView::*)(const CAmiraVectorField2D*, const CPointf&)>
+									(_T("Q-criterion"), &CFlowIllustratorView::_isVortQCriterion) );
+
+	m_DetectorFunctions.push_back(	std::pair<CString, bool (CFlowIllustratorView::*)(const CAmiraVectorField2D*, const CPointf&)>
+									(_T("Lambda2"), &CFlowIllustratorView::_isVortLambda2) );
+
+	m_DetectorFunctions.push_back(	std::pair<CString, bool (CFlowIllustratorView::*)(const CAmiraVectorField2D*, const CPointf&)>
+									(_T("Okubo-Weiss"), &CFlowIllustratorView::_isVortOkuboWeiss) );
+
+	m_DetectorFunctions.push_back(	std::pair<CString, bool (CFlowIllustratorView::*)(const CAmiraVectorField2D*, const CPointf&)>
+									(_T("Vortex catalog"), &CFlowIllustratorView::_isVortCatalog) );
 }
 
 CFlowIllustratorView::~CFlowIllustratorView()
@@ -391,6 +413,20 @@ void CFlowIllustratorView::JumpToFrame(int nFrame)
 	pDoc->GotoFrame(nFrame);
 }
 
+void CFlowIllustratorView::JumpToVirtualFrame(int nFrame)
+{
+	CFlowIllustratorDoc* pDoc = GetDocument();
+	ASSERT_VALID(pDoc);
+	if (!pDoc) {
+		return;
+	}
+
+	m_bVorticityValid = FALSE;
+	m_bVectorMagnitudeValid = FALSE;
+
+	pDoc->GotoVirtualFrame(nFrame);
+}
+
 void CFlowIllustratorView::StartTimer()
 {
 	SetTimer(1, 40, NULL);
@@ -429,6 +465,7 @@ BOOL CFlowIllustratorView::OnMouseWheel(UINT nFlags, short zDelta, CPoint pt)
 			gZoomFactor = 1.0f;
 
 		m_bLICNoiseTexValid = FALSE;
+		m_bPreviewIntegrationValid = FALSE;	//Integration domain depends on the viewport
 		m_ptViewportCenter = m_ptMouseMove;
 
 		CFlowIllustratorDoc *pDoc = GetDocument();
@@ -505,7 +542,9 @@ BOOL CFlowIllustratorView::OnMouseWheel(UINT nFlags, short zDelta, CPoint pt)
 
 				SetStreamlineLength(m_nStreamLineLen);
 
-				calcCharacteristicLine(m_pCreateDummy.get(), m_ptMouseMove);
+				if (!resizePreviewLine()) {
+					calcCharacteristicLine(m_pCreateDummy.get(), m_ptMouseMove);
+				}
 				break;
 			}
 			case EM_VORTEX:
@@ -555,6 +594,19 @@ void CFlowIllustratorView::DocumentLoaded(void)
 	m_nLicWidth		= pVecField->GetExtentX();
 	m_nLicHeight	= pVecField->GetExtentY();
 
+	m_FlowMapCache.Clear();
+	m_TrajectoryCache.Clear();
+	m_CriticalPoints.Clear();
+	m_Skeleton.Clear();
+	m_SkeletonLines.clear();
+	m_VorticityCache.Clear();
+	m_TemporalDerivativeCache.Clear();
+	m_bShowSkeleton	= FALSE;
+	m_bFTLEValid	= FALSE;
+	InvalidateDerivedFields();
+	m_nFTLEWidth	= pVecField->GetExtentX();
+	m_nFTLEHeight	= pVecField->GetExtentY();
+
 	Dirty();
 
 	UpdateStatusBar();
@@ -682,7 +734,7 @@ void CFlowIllustratorView::Select(int nSelIDx, BOOL bAddToSelection)
 	}
 }
 
-void CFlowIllustratorView::calcStreamLine(const CPointf& point, CStreamLine *pStreamLine, bool bForward)
+void CFlowIllustratorView::calcStreamLine(const CPointf& point, CStreamLine *pStreamLine, bool bForward, CAmiraVectorField2D::IntegrationState *pState)
 {
 	CFlowIllustratorDoc *pDoc = GetDocument();
 
@@ -695,13 +747,18 @@ void CFlowIllustratorView::calcStreamLine(const CPointf& point, CStreamLine *pSt
 			vector<CPointf>* pData = pStreamLine->GetDataPoints();
 			pData->clear();
 			CVector3D vec(point.x, point.y, 0);
-			pVecField->integrateRK4( vec  , static_cast<int>(pStreamLine->GetMaxIntegrationLen()), pStreamLine->GetStepSize(), bForward,  pData, m_rcViewPort);
+
+			if (m_nStreamlineIntegrator == SI_CELLWISE) {
+				pVecField->integrateCellwise( vec, static_cast<int>(pStreamLine->GetMaxIntegrationLen()), pStreamLine->GetStepSize(), bForward,  pData, m_rcViewPort);
+			} else {
+				pVecField->integrateRK4( vec  , static_cast<int>(pStreamLine->GetMaxIntegrationLen()), pStreamLine->GetStepSize(), bForward,  pData, m_rcViewPort, pState);
+			}
 			pStreamLine->SetOrigin( point );
 		}
 	}
 }
 
-void CFlowIllustratorView::calcPathLine(const CPointf& point, CPathLine *pPathLine) const
+void CFlowIllustratorView::calcPathLine(const CPointf& point, CPathLine *pPathLine, CAmiraVectorField2D::IntegrationState *pState) const
 {
 	CFlowIllustratorDoc *pDoc = GetDocument();
 
@@ -718,16 +775,24 @@ void CFlowIllustratorView::calcPathLine(const CPointf& point, CPathLine *pPathLi
 			int nFrame(0);
 			if (pPathLine->UseFixedStartFrame()) {
 				if (!pPathLine->NeedRecalc()) return;
-				nFrame = pVecField->GetCurrentTimeStep();
+				nFrame = pVecField->GetCurrentVirtualFrame();
 				pVecField->GotoTimeStep(pPathLine->GetStartFrame());
 			}
 
-			pVecField->integrateRK4( vec, static_cast<int>(pPathLine->GetMaxIntegrationLen()), pPathLine->GetStepSize(), true,  pData, m_rcViewPort);
+			float fMaxError;
+			CFlowMapCache *pCache = AcquireTrajectoryCache(fMaxError);
+
+			if (pCache) {
+				pCache->IntegratePathLine(	point, pVecField->GetCurrentTime(), static_cast<int>(pPathLine->GetMaxIntegrationLen()), 
+											pPathLine->GetStepSize(), true, fMaxError, pData, m_rcViewPort);
+			} else {
+				pVecField->integrateRK4( vec, static_cast<int>(pPathLine->GetMaxIntegrationLen()), pPathLine->GetStepSize(), true,  pData, m_rcViewPort, pState);
+			}
 			pPathLine->SetOrigin( point );
 
 			if (pPathLine->UseFixedStartFrame()) {
 				pPathLine->NeedRecalc(false);
-				pVecField->GotoTimeStep(nFrame);
+				pVecField->GotoVirtualFrame(nFrame);
 			}
 		}
 	}
@@ -750,7 +815,7 @@ void CFlowIllustratorView::calcStreakLine(const CPointf& point, CStreakLine *pSt
 			int nFrame(0);
 			if (pStreakLine->UseFixedStartFrame()) {
 				if (!pStreakLine->NeedRecalc()) return;
-				nFrame = pVecField->GetCurrentTimeStep();
+				nFrame = pVecField->GetCurrentVirtualFrame();
 				pVecField->GotoTimeStep(pStreakLine->GetStartFrame());
 			}
 
@@ -760,7 +825,7 @@ void CFlowIllustratorView::calcStreakLine(const CPointf& point, CStreakLine *pSt
 
 			if (pStreakLine->UseFixedStartFrame()) {
 				pStreakLine->NeedRecalc(false);
-				pVecField->GotoTimeStep(nFrame);
+				pVecField->GotoVirtualFrame(nFrame);
 			} 
 		}
 	}
@@ -777,7 +842,7 @@ void CFlowIllustratorView::calcTimeLine( CTimeLine *pTimeLine)
 		int nFrame(0);
 		if (pTimeLine->UseFixedStartFrame()) {
 			if (!pTimeLine->NeedRecalc() ) return;
-			nFrame = pVecField->GetCurrentTimeStep();
+			nFrame = pVecField->GetCurrentVirtualFrame();
 			pVecField->GotoTimeStep(pTimeLine->GetStartFrame());
 		}
 
@@ -785,14 +850,22 @@ void CFlowIllustratorView::calcTimeLine( CTimeLine *pTimeLine)
 		{
 			vector<CPointf> *pData = pTimeLine->GetDataPoints();
 
-			pVecField->integrateTimeLine(	pTimeLine->GetOrigin(), pTimeLine->GetSeedLineEnd(), 
-											pTimeLine->GetNumSamples(), pTimeLine->GetMaxIntegrationLen(), 
-											pTimeLine->GetStepSize(), true, pData, m_rcDomain);
+			float fMaxError;
+			CFlowMapCache *pCache = AcquireTrajectoryCache(fMaxError);
+
+			if (pCache) {
+				pCache->AdvectTimeLine(	pData, pVecField->GetCurrentTime(), pTimeLine->GetMaxIntegrationLen(), 
+										pTimeLine->GetStepSize(), true, fMaxError, m_rcDomain);
+			} else {
+				pVecField->integrateTimeLine(	pTimeLine->GetOrigin(), pTimeLine->GetSeedLineEnd(), 
+												pTimeLine->GetNumSamples(), pTimeLine->GetMaxIntegrationLen(), 
+												pTimeLine->GetStepSize(), true, pData, m_rcDomain);
+			}
 		}
 
 		if (pTimeLine->UseFixedStartFrame()) {
 			pTimeLine->NeedRecalc(false);
-			pVecField->GotoTimeStep(nFrame);
+			pVecField->GotoVirtualFrame(nFrame);
 		} 
 	}
 }
@@ -810,9 +883,22 @@ void CFlowIllustratorView::calcVortexTrajectory(CVortexObj *pVortex) const
 	CSpeedLine *pTrajectory = new CSpeedLine(pVortex->GetColor(), pVortex->GetThickness(), 1.0f);
 	vector<CPointf> *pPoints = pTrajectory->GetDataPoints();
 
+	//The vortex catalog and the vorticity windows hold whole time steps only.
+	//At a virtual frame, the trajectory continues from the preceding time step.
 	int time = pVecField->GetCurrentTimeStep();
 
 	CPointf pt = pVortex->GetCenter();
+
+	//Trajectories are a lookup, if the vortex is part of the vortex catalog, and measured with the same threshold
+	const VortexCore *pCore = FindCatalogVortex(pt, pVortex->GetThreshold());
+
+	if (pCore)
+	{
+		pDoc->GetVortexCatalog()->GetTrajectory(pCore, time, pVortex->GetTrajectoryLength() + 1, *pPoints);
+		pVortex->SetTrajectory(pTrajectory);
+		return;
+	}
+
 	pPoints->push_back(pt);
 
 	CRectF rect;
@@ -822,12 +908,14 @@ void CFlowIllustratorView::calcVortexTrajectory(CVortexObj *pVortex) const
 	else 
 		rect = CRectF(0, 0, m_rcDomain.getWidth()/3, m_rcDomain.getWidth()/3);
 
+	m_VorticityCache.Init(pVecField);
+
 	for (int i=time, j = 0; j < pVortex->GetTrajectoryLength() && i > 0; i--, j++) {
 		rect.SetCenter(CPointf::toVector2D(pt));
 
-		auto pVort(pVecField->GetVorticityField(rect, true, static_cast<float>(i)));
+		CVorticityWindow window = m_VorticityCache.GetWindow(rect, i, true);
 
-		if (pVort->GradientAscent(pt, pt))
+		if (window.GradientAscent(pt, pt))
 			pPoints->push_back(pt);
 	}
 
@@ -854,6 +942,8 @@ void CFlowIllustratorView::calcTimeLineTrajectory(CTimeLine *pTimeLine) const
 
 	pTimeLine->DeleteAllChildren();
 
+	//The start frame is only recorded by the path lines. They do not use a fixed start frame, so calcPathLine() 
+	//integrates them from the current time, which is fractional at virtual frames.
 	int StartFrame = pTimeLine->UseFixedStartFrame()? pTimeLine->GetStartFrame() : pVecField->GetCurrentTimeStep();
 
 	for (int i=0; i<3; i++) {
@@ -906,10 +996,15 @@ void CFlowIllustratorView::UpdateStatusBar()
 
 				CString str;
 				CString strPos;
-				str.Format(_T("DimX: %d  DimY:%d  DimZ:%d  Streamline length: %d"),		pVecField->GetExtentX(), 
-																						pVecField->GetExtentY(), 
-																						pVecField->GetNumTimeSteps(), 
-																						m_nStreamLineLen);
+				static const TCHAR *strFrames[] = { _T("lab"), _T("Galilean"), _T("region mean") };
+
+				str.Format(_T("DimX: %d  DimY:%d  DimZ:%d  Streamline length: %d  Integrator: %s  Path lines: %s  Frame: %s"),	pVecField->GetExtentX(), 
+																													pVecField->GetExtentY(), 
+																													pVecField->GetNumTimeSteps(), 
+																													m_nStreamLineLen,
+																													(m_nStreamlineIntegrator == SI_CELLWISE)? _T("cell-wise") : _T("RK4"),
+																													(m_bFastTrajectories)? _T("fast") : _T("exact"),
+																													strFrames[pVecField->GetReferenceFrame()]);
 
 				strPos.Format(_T("X:%f  Y:%f"), m_ptMouseMove.x, m_ptMouseMove.y);
 				pMainFrm->UpdateStatusBar(str, strPos);
@@ -937,6 +1032,45 @@ bool CFlowIllustratorView::_isVortVorticityMagnitude(const CAmiraVectorField2D*
 	return false;
 }
 
+bool CFlowIllustratorView::_isVortQCriterion(const CAmiraVectorField2D* /*pVecField*/, const CPointf& pt)
+{
+	CScalarField2D *pField = AcquireDerivedField(DF_Q_CRITERION);
+
+	if (pField) {
+		return (pField->GetValue(pt.x, pt.y) >= pField->GetMaxValue()*m_fVortexThreshold);
+	}
+
+	return false;
+}
+
+bool CFlowIllustratorView::_isVortLambda2(const CAmiraVectorField2D* /*pVecField*/, const CPointf& pt)
+{
+	CScalarField2D *pField = AcquireDerivedField(DF_LAMBDA2);
+
+	//Vortices have negative lambda2, thus compare against the minimum
+	if (pField) {
+		return (pField->GetValue(pt.x, pt.y) <= pField->GetMinValue()*m_fVortexThreshold);
+	}
+
+	return false;
+}
+
+bool CFlowIllustratorView::_isVortOkuboWeiss(const CAmiraVectorField2D* /*pVecField*/, const CPointf& pt)
+{
+	CScalarField2D *pField = AcquireDerivedField(DF_OKUBO_WEISS);
+
+	if (pField) {
+		return (pField->GetValue(pt.x, pt.y) <= pField->GetMinValue()*m_fVortexThreshold);
+	}
+
+	return false;
+}
+
+bool CFlowIllustratorView::_isVortCatalog(const CAmiraVectorField2D* /*pVecField*/, const CPointf& pt)
+{
+	return (FindCatalogVortex(pt, m_fVortexThreshold) != nullptr);
+}
+
 void CFlowIllustratorView::OnInitialUpdate()
 {
 	UpdateMainRibbonCategory();
@@ -982,8 +1116,8 @@ void CFlowIllustratorView::UpdateRibbonDropdowns()
 
 void CFlowIllustratorView::OnKeyDown(UINT nChar, UINT nRepCnt, UINT nFlags)
 {
-	bool bCtrlPressed = (GetKeyState(VK_CONTROL) != 0);
-	bool bAltPressed = (GetKeyState(VK_SHIFT) != 0); //alt key
+	bool bCtrlPressed = ((GetKeyState(VK_CONTROL) & 0x8000) != 0);
+	bool bAltPressed = ((GetKeyState(VK_SHIFT) & 0x8000) != 0); //alt key
 
 	switch (nChar)
 	{
@@ -1014,6 +1148,87 @@ void CFlowIllustratorView::OnKeyDown(UINT nChar, UINT nRepCnt, UINT nFlags)
 				}
 			}
 			break;
+		case 'I':
+			//Toggle between RK4 and cell-wise stream line integration
+			SetStreamlineIntegrator( (m_nStreamlineIntegrator == SI_RK4)? SI_CELLWISE : SI_RK4 );
+			break;
+		case 'F':
+			//Toggle between exact and approximated path and time lines, or cycle the error bound of the approximation
+			//through 0.125, 0.25, 0.5 and 1 cell with SHIFT
+			if (bAltPressed) {
+				SetTrajectoryMaxError( (m_fTrajectoryMaxError >= 1.0f)? 0.125f : m_fTrajectoryMaxError * 2.0f );
+			} else {
+				SetFastTrajectories(!m_bFastTrajectories);
+			}
+			break;
+		case 'E':
+			//Place evenly spaced stream lines, or cycle their separation through 10, 20 and 40 pixel with SHIFT
+			if (bAltPressed) {
+				SetStreamlineSeparation( (m_fStreamLineSeparation >= 40.0f)? 10.0f : m_fStreamLineSeparation * 2.0f );
+			} else {
+				AddEvenlySpacedStreamLines(m_fStreamLineSeparation);
+			}
+			break;
+		case 'C':
+			if (!bCtrlPressed) {
+				AddCriticalPointMarkers();
+			}
+			break;
+		case 'T':
+			AddCriticalPointTracks();
+			break;
+		case 'K':
+			ShowTopologicalSkeleton(!m_bShowSkeleton);
+			break;
+		case 'H':
+			//Cycle through no, global and adaptive contrast enhancement
+			SetContrastEnhancement( static_cast<CONTRAST_ENHANCEMENT>((m_nContrastEnhancement + 1) % (CE_ADAPTIVE + 1)) );
+			break;
+		case 'L':
+			//Cycle between a single iso contour and contour plots of 8, 16 and 32 levels
+			SetNumIsoLevels( (m_nNumIsoLevels >= 32)? 1 : max(m_nNumIsoLevels*2, 8) );
+			break;
+		case 'R':
+			if (!bCtrlPressed) {
+				CycleReferenceFrame();
+			}
+			break;
+		case 'D':
+			//Detect vortices by segmentation, or by scale space with SHIFT
+			if (!bCtrlPressed) {
+				DetectVortices(bAltPressed);
+			}
+			break;
+		case 'V':
+			if (!bCtrlPressed) {
+				BuildVortexCatalog();
+			}
+			break;
+		case 'G':
+			if (!bCtrlPressed) {
+				CycleFTLEResolution();
+			}
+			break;
+		case 'Y':
+			//Cycle the FTLE integration time through 10, 20 and 40 frames, or reverse its direction with SHIFT
+			if (!bCtrlPressed) {
+				if (bAltPressed) {
+					SetFTLEIntegrationLen(-m_nFTLEIntegrationLen);
+				} else {
+					CycleFTLEIntegrationLen();
+				}
+			}
+			break;
+		case 'S':
+			//Cycle through 1, 2, 4 and 8 virtual frames per time step, or toggle between linear and cubic interpolation in time
+			if (!bCtrlPressed) {
+				if (bAltPressed) {
+					ToggleTemporalInterpolation();
+				} else {
+					CycleTemporalResolution();
+				}
+			}
+			break;
 	}
 
 	CView::OnKeyDown(nChar, nRepCnt, nFlags);
@@ -1224,43 +1439,45 @@ void CFlowIllustratorView::AddNewVortex(const CPointf& point)
 	const CAmiraVectorField2D *pVecField = pDoc->GetVectorfield();
 	BOOL bResult = FALSE;
 
+	float fCoreVal(0.0f);
+
+	//The precomputed vortex catalog is used, if it is the selected detector
+	const VortexCore *pCore = (m_pDetectorFunc == &CFlowIllustratorView::_isVortCatalog)? FindCatalogVortex(point, m_fVortexThreshold) : nullptr;
+
 	//Only measure if point is actually inside a vortex.
 	//Otherwise behaviour is undeterminded and it might hit the fan...
-	if (m_pDetectorFunc && (this->*m_pDetectorFunc)(pVecField, point))
+	if (pCore || (m_pDetectorFunc && (this->*m_pDetectorFunc)(pVecField, point)))
 	{
-		pt = GetVortexCore(point);
+		CRITICAL_POINT_TYPE nType = CENTER;
+		BOOL bMeasured = FALSE;
 
-		if (measureVortex(m_pVortFieldAbs, pt, r1, r2, angle, m_fVortexThreshold))
+		if (pCore)
 		{
-			//Is vortex source or sink?
-			//Adjust appearence
-
-			CRITICAL_POINT_TYPE nType = CENTER;
-			if (pVecField)
-				nType = pVecField->GetCriticalPointType(pt);
-
-			float fCoreVal = m_pVortField->GetValue(pt.x, pt.y);
-			nVortDir = (fCoreVal < 0)? CVortexObj::CLOCK_WISE : CVortexObj::COUNTER_CLOCKWISE;
+			pt			= pCore->pos;
+			r1			= pCore->fRadius1;
+			r2			= pCore->fRadius2;
+			angle		= pCore->fAngle;
+			nType		= pCore->nType;
+			fCoreVal	= pCore->fVorticity;
+			bMeasured	= TRUE;
+		}
+		else
+		{
+			pt = GetVortexCore(point);
 
-			switch(nType)
+			if (measureVortex(m_pVortFieldAbs, pt, r1, r2, angle, m_fVortexThreshold)) 
 			{
-				case REPELLING_FOCUS:
-					if (nVortDir == CVortexObj::CLOCK_WISE) {
-						nVortType = CVortexObj::SPIRAL_CLOCKWISE;
-					} else {
-						nVortType = CVortexObj::SPIRAL_COUNTERCLOCKWISE;
-					}
-					break;
-				case ATTRACTING_FOCUS:
-					if (nVortDir == CVortexObj::CLOCK_WISE) {
-						nVortType = CVortexObj::SPIRAL_COUNTERCLOCKWISE;
-					} else {
-						nVortType = CVortexObj::SPIRAL_CLOCKWISE;
-					}
-					break;
-				default:
-					nVortType = CVortexObj::ELLIPTIC;
+				if (pVecField)
+					nType = pVecField->GetCriticalPointType(pt);
+
+				fCoreVal	= m_pVortField->GetValue(pt.x, pt.y);
+				bMeasured	= TRUE;
 			}
+		}
+
+		if (bMeasured)
+		{
+			GetVortexStyle(nType, fCoreVal, nVortType, nVortDir);
 			bResult = TRUE;
 		}
 	}
@@ -1275,7 +1492,40 @@ void CFlowIllustratorView::AddNewVortex(const CPointf& point)
 		nVortDir	= CVortexObj::CLOCK_WISE;
 	}
 
-	float vorticitty = m_pVortFieldAbs->GetValue(pt);
+	float vorticitty = (pCore)? fabs(pCore->fVorticity) : m_pVortFieldAbs->GetValue(pt);
+
+	m_pDrawObjMngr->Add(CreateVortexObj(pt, r1, r2, angle, vorticitty, nVortType, nVortDir));
+}
+
+void CFlowIllustratorView::GetVortexStyle(CRITICAL_POINT_TYPE nType, float fVorticity, CVortexObj::VORTEX_STYLE &nVortType, CVortexObj::VORTEX_ROTATION_DIR &nVortDir)
+{
+	//Is vortex source or sink?
+	//Adjust appearence
+	nVortDir = (fVorticity < 0)? CVortexObj::CLOCK_WISE : CVortexObj::COUNTER_CLOCKWISE;
+
+	switch(nType)
+	{
+		case REPELLING_FOCUS:
+			if (nVortDir == CVortexObj::CLOCK_WISE) {
+				nVortType = CVortexObj::SPIRAL_CLOCKWISE;
+			} else {
+				nVortType = CVortexObj::SPIRAL_COUNTERCLOCKWISE;
+			}
+			break;
+		case ATTRACTING_FOCUS:
+			if (nVortDir == CVortexObj::CLOCK_WISE) {
+				nVortType = CVortexObj::SPIRAL_COUNTERCLOCKWISE;
+			} else {
+				nVortType = CVortexObj::SPIRAL_CLOCKWISE;
+			}
+			break;
+		default:
+			nVortType = CVortexObj::ELLIPTIC;
+	}
+}
+
+CVortexObj* CFlowIllustratorView::CreateVortexObj(const CPointf &pt, float r1, float r2, float angle, float vorticitty, CVortexObj::VORTEX_STYLE nVortType, CVortexObj::VORTEX_ROTATION_DIR nVortDir) const
+{
 	float revolutions = (vorticitty > 3)? vorticitty/2.0f : 1.5F;
 	if (revolutions > 5) revolutions = 5;
 
@@ -1291,7 +1541,7 @@ void CFlowIllustratorView::AddNewVortex(const CPointf& point)
 	e->SetRotation(angle);
 	e->SetThickness(linethickness);
 
-	m_pDrawObjMngr->Add(e);
+	return e;
 }
 
 CPointf CFlowIllustratorView::GetVortexCore(const CPointf& point)
@@ -1307,48 +1557,35 @@ CPointf CFlowIllustratorView::GetVortexCore(const CPointf& point)
 
 BOOL CFlowIllustratorView::measureVortex(CScalarField2D *pVortField, const CPointf &ptVortexCore, float &radius1, float &radius2, float &angle, float fThreshold)
 {
-	
-	//Get gradient and co-gradient and follow them to find the extent of the vortex
-	CVector2D gradient = pVortField->GetGradient(ptVortexCore.x, ptVortexCore.y);
-	CVector2D coGrad(-gradient.y, gradient.x);
-
-	if (gradient.abs() > 1e-5)
-	{
-		CVector2D dummyG(ptVortexCore.x - gradient.x, ptVortexCore.y - gradient.y);
-		CVector2D dummyCG(ptVortexCore.x - coGrad.x, ptVortexCore.y - coGrad.y);
+	const CRectF rcDomain	= pVortField->GetDomainRect();
+	const int nx			= static_cast<int>(pVortField->GetExtentX());
+	const int ny			= static_cast<int>(pVortField->GetExtentY());
+	const CPointf ptCore	= pVortField->GetGridCoordinates(ptVortexCore.x, ptVortexCore.y);
 
-		float threshold = pVortField->GetValue(ptVortexCore.x, ptVortexCore.y) * fThreshold;
+	CVortexMeasure measure;
+	VortexExtent extent;
 
-		while (pVortField->InsideDomain(dummyG) && pVortField->GetValue(dummyG.x, dummyG.y) >= threshold)
-		{
-			dummyG -= gradient;
-		}
+	measure.Measure(*pVortField, 0, 0, nx-1, ny-1, rcDomain.getWidth()/(nx-1), rcDomain.getHeight()/(ny-1), CPointf::toVector2D(ptCore), fThreshold, extent);
 
-		while (pVortField->InsideDomain(dummyCG) && pVortField->GetValue(dummyCG.x, dummyCG.y) >= threshold)
-		{
-			dummyCG -= coGrad;
-		}
+	radius1 = extent.fRadius1;
+	radius2 = extent.fRadius2;
+	angle	= extent.fAngle;
 
-		radius1 = sqrt(pow( float(ptVortexCore.x-dummyG.x), 2) + pow( float(ptVortexCore.y-dummyG.y), 2));
-		radius2 = sqrt(pow( float(ptVortexCore.x-dummyCG.x), 2) + pow( float(ptVortexCore.y-dummyCG.y), 2));
-
-		gradient.Normalize();
-		coGrad.Normalize();
+	return extent.bValid;
+}
 
-		CVector2D xAxis(1.0f, 0.0f);
+BOOL CFlowIllustratorView::measureVortex(const CVorticityWindow &window, const CPointf &ptVortexCore, float &radius1, float &radius2, float &angle, float fThreshold)
+{
+	CVortexMeasure measure;
+	VortexExtent extent;
 
-		angle = RadToDeg(acos(gradient*xAxis));
+	window.MeasureVortex(measure, ptVortexCore, fThreshold, extent);
 
-		return TRUE;
-	}
-	else
-	{
-		radius1 = 0;
-		radius2 = 0;
-		angle	= 0;
-	}
+	radius1 = extent.fRadius1;
+	radius2 = extent.fRadius2;
+	angle	= extent.fAngle;
 
-	return FALSE;
+	return extent.bValid;
 }
 
 void CFlowIllustratorView::AddNewRectangle(const CPointf& ptMouseDown, const CPointf& ptMouseUp)
@@ -1485,6 +1722,8 @@ void CFlowIllustratorView::SetEditMode(EDIT_MODE nMode)
 		m_pCreateDummy = nullptr;
 	}
 
+	m_bPreviewIntegrationValid = FALSE;
+
 	m_nEditMode = nMode;
 
 	CDrawingObject *pNewObj(nullptr);
@@ -1556,6 +1795,19 @@ void CFlowIllustratorView::SetStreamlineLength(int nNumSteps)
 	}
 }
 
+void CFlowIllustratorView::SetStreamlineIntegrator(STREAMLINE_INTEGRATOR nIntegrator)
+{
+	CFlowIllustratorRenderView::SetStreamlineIntegrator(nIntegrator);
+
+	if (m_pCreateDummy && m_pCreateDummy->GetType() == DO_STREAMLINE)
+	{
+		reinterpret_cast<CStreamLine*>(m_pCreateDummy.get())->NeedRecalc(true);
+		calcCharacteristicLine(m_pCreateDummy.get(), m_ptMouseMove);
+	}
+
+	UpdateStatusBar();
+}
+
 void CFlowIllustratorView::SetStreamlineStepSize(float fStepSize)
 {
 	m_fStreamLineStep = fStepSize;
@@ -1665,13 +1917,22 @@ void CFlowIllustratorView::calcCharacteristicLine(CDrawingObject* pObj, const CP
 			return;
 		}
 
+		//Keep the end state of the preview line, so it can be resized without a full recomputation. 
+		//No vertices mark the state as not written, since only the RK4 integrator writes it.
+		CAmiraVectorField2D::IntegrationState *pState(nullptr);
+		if (pObj == m_pCreateDummy.get()) {
+			pState = &m_PreviewIntegration;
+			pState->nNumSteps = 0;
+			m_bPreviewIntegrationValid = FALSE;
+		}
+
 		switch(pObj->GetType())
 		{
 			case DO_STREAMLINE:
-				calcStreamLine(pOrigin, reinterpret_cast<CStreamLine*>(pObj));
+				calcStreamLine(pOrigin, reinterpret_cast<CStreamLine*>(pObj), true, pState);
 				break;
 			case DO_PATHLINE:
-				calcPathLine(pOrigin, reinterpret_cast<CPathLine*>(pObj));
+				calcPathLine(pOrigin, reinterpret_cast<CPathLine*>(pObj), pState);
 				break;
 			case DO_STREAKLINE:
 				calcStreakLine(pOrigin, reinterpret_cast<CStreakLine*>(pObj));
@@ -1681,10 +1942,42 @@ void CFlowIllustratorView::calcCharacteristicLine(CDrawingObject* pObj, const CP
 				break;
 		}
 
+		if (pState) {
+			m_bPreviewIntegrationValid = (pState->nNumSteps > 0);
+		}
+
 		CalcStreamlineBoundingBox(reinterpret_cast<CStreamLine*>(pObj));
 	}
 }
 
+BOOL CFlowIllustratorView::resizePreviewLine()
+{
+	if (!m_bPreviewIntegrationValid || !m_pCreateDummy) return FALSE;
+
+	//Stream lines and path lines only, streak lines re-advect all particles in each step
+	if (m_pCreateDummy->GetType() != DO_STREAMLINE && m_pCreateDummy->GetType() != DO_PATHLINE) return FALSE;
+
+	CStreamLine *pLine = reinterpret_cast<CStreamLine*>(m_pCreateDummy.get());
+	if (m_PreviewIntegration.origin.x != m_ptMouseMove.x || m_PreviewIntegration.origin.y != m_ptMouseMove.y) return FALSE;
+	if (m_PreviewIntegration.stepLen != pLine->GetStepSize()) return FALSE;
+
+	CFlowIllustratorDoc *pDoc = GetDocument();
+	if (!pDoc) return FALSE;
+
+	const CAmiraVectorField2D *pVecField = pDoc->GetVectorfield();
+	if (!pVecField) return FALSE;
+
+	pVecField->resizeIntegration(m_PreviewIntegration, static_cast<int>(pLine->GetMaxIntegrationLen()), pLine->GetDataPoints());
+
+	if (pLine->UseFixedStartFrame()) {
+		pLine->NeedRecalc(false);
+	}
+
+	CalcStreamlineBoundingBox(pLine);
+
+	return TRUE;
+}
+
 void CFlowIllustratorView::AdvanceStreamObjects()
 {
 	CFlowIllustratorDoc *pDoc = GetDocument();
@@ -1713,6 +2006,24 @@ void CFlowIllustratorView::AdvanceStreamObjects()
 				CPointf pt = pVort->GetCenter();
 				CRectF rect;
 
+				//Follow the track of the vortex in the vortex catalog, if it was measured with the threshold of this vortex
+				const VortexCore *pCore = FindCatalogVortex(pt, pVort->GetThreshold(), m_nVortexFrame);
+				if (pCore)
+				{
+					pVort->SetCenter(pCore->pos);
+
+					if (pVort->AutoAdjustSize()) {
+						pVort->SetRadius1(pCore->fRadius1);
+						pVort->SetRadius2(pCore->fRadius2);
+						pVort->SetRotation(pCore->fAngle);
+					}
+
+					if (m_bAutoUpdateTrajectories)
+						calcVortexTrajectory(pVort);
+
+					break;
+				}
+
 				if (m_rcDomain.getHeight() < m_rcDomain.getWidth())
 					 rect = CRectF(0, 0, m_rcDomain.getHeight()/3.0f, m_rcDomain.getHeight()/3.0f); 
 				else 
@@ -1720,35 +2031,38 @@ void CFlowIllustratorView::AdvanceStreamObjects()
 
 				rect.SetCenter(CPointf::toVector2D(pt));
 
-				CScalarField2D *pVortField = pVecField->GetVorticityField(rect, true, static_cast<float>(pVecField->GetCurrentTimeStep()) );
-				//float val = pVortField->GetValue(pt);
+				//Like the vortex catalog, the vorticity cache holds whole time steps only, so vortices move at time steps, not at the virtual frames between them
+				m_VorticityCache.Init(pVecField);
+				CVorticityWindow window = m_VorticityCache.GetWindow(rect, pVecField->GetCurrentTimeStep(), true);
 
-				if (pVortField->GetValue(pt) > 1e-3)
+				if (window.GetValue(pt) > 1e-3)
 				{
-					if (pVortField->GradientAscent(pt, pt))
+					//The vortex is lost only, if its core left the window. A search, that stalled or ran out of iterations, keeps its best location.
+					if (!window.FollowMaximum(pt, pt))
 					{
-						float r1, r2, angle;
-						if (measureVortex(pVortField, pt, r1, r2, angle, pVort->GetThreshold()))
-						{
+						pDrawObjMngr->DeleteAt(i);
+						i--;
+						break;
+					}
 
-							pVort->SetCenter(pt);
+					float r1, r2, angle;
+					if (measureVortex(window, pt, r1, r2, angle, pVort->GetThreshold()))
+					{
+
+						pVort->SetCenter(pt);
 
-							if (pVort->AutoAdjustSize()) {
-								pVort->SetRadius1(r1);
-								pVort->SetRadius2(r2);
-								pVort->SetRotation(angle);
-							}
+						if (pVort->AutoAdjustSize()) {
+							pVort->SetRadius1(r1);
+							pVort->SetRadius2(r2);
+							pVort->SetRotation(angle);
 						}
 					}
-					else
-					{
-						pDrawObjMngr->DeleteAt(i);
-						i--;
-					}
 
 					if (m_bAutoUpdateTrajectories)
 						calcVortexTrajectory(pVort);
 				}
+
+				break;
 			}
 
 			case DO_STREAMLINE:
@@ -1765,6 +2079,8 @@ void CFlowIllustratorView::AdvanceStreamObjects()
 		}
 	}
 
+	m_nVortexFrame = pDoc->GetCurrentFrameNo();
+
 	if (!m_Selected.empty()) {
 		for(size_t i = 0;i < m_Selected.size(); i++)
 		{
@@ -2257,6 +2573,9 @@ LRESULT CFlowIllustratorView::OnSVGLoaded(WPARAM /*wParam*/, LPARAM /*lParam*/)
 {
 	m_Selected.clear();
 
+	//The loaded vortices were not placed in a known time step
+	m_nVortexFrame = -1;
+
 	if (!m_pDrawObjMngr) {
 		CFlowIllustratorDoc *pDoc = GetDocument();
 		if (pDoc) {
@@ -2272,6 +2591,9 @@ LRESULT CFlowIllustratorView::OnDocFrameChanged(WPARAM /*wParam*/, LPARAM /*lPar
 	CFlowIllustratorDoc *pDoc = GetDocument();
 	if (!pDoc) return 1;
 
+	//The preview line was integrated in the previous frame
+	m_bPreviewIntegrationValid = FALSE;
+
 	CMainFrame *pMainFrm = reinterpret_cast<CMainFrame*>(GetParent());
 	if (pMainFrm)
 	{
@@ -2280,8 +2602,21 @@ LRESULT CFlowIllustratorView::OnDocFrameChanged(WPARAM /*wParam*/, LPARAM /*lPar
 
 	auto pVecfield = pDoc->GetVectorfield();
 	if (pVecfield)
-	{		
-		if (AcquireVectorMagnitudeField())
+	{
+		//Classify the cells of the new frame once, before display functions and integrators query them
+		pVecfield->GetOccupancy(pDoc->GetCurrentFrameNo());
+
+		//Look the maximum up in the statistics index, and only compute the magnitude field while it is being built.
+		//The index holds lab frame magnitudes of whole time steps, virtual frames between them compute their own maximum.
+		const bool bTimeStep = (pVecfield->GetCurrentTime() == static_cast<float>(pDoc->GetCurrentFrameNo()));
+		const CFrameStatistics *pStatistics = (pVecfield->GetReferenceFrame() == RF_LAB && bTimeStep)? pDoc->GetFrameStatistics() : nullptr;
+		const FrameStatistics *pFrameStats = (pStatistics)? pStatistics->GetFrame(pDoc->GetCurrentFrameNo()) : nullptr;
+
+		if (pFrameStats)
+		{
+			MAX_VELOCITY = pFrameStats->magnitude.fMax;
+		}
+		else if (AcquireVectorMagnitudeField())
 		{
 			MAX_VELOCITY = m_pVectorMagnitudeField->GetMaxValue();
 		}
@@ -2289,11 +2624,112 @@ LRESULT CFlowIllustratorView::OnDocFrameChanged(WPARAM /*wParam*/, LPARAM /*lPar
 
 	if (!pDoc->IsLoadingSVG()) {
 		AdvanceStreamObjects();
+
+		if (m_bShowSkeleton) {
+			UpdateTopologicalSkeleton();
+		}
 	}
 
 	return 0;
 }
 
+LRESULT CFlowIllustratorView::OnDocReferenceFrameChanged(WPARAM /*wParam*/, LPARAM /*lParam*/)
+{
+	//Velocities, everything integrated from them, and temporal derivatives change, spatial derivatives such as the vorticity do not
+	m_bVectorMagnitudeValid		= FALSE;
+	m_bFTLEValid				= FALSE;
+	m_bPreviewIntegrationValid	= FALSE;
+	InvalidateDerivedFields();
+
+	m_FlowMapCache.Clear();
+	m_TrajectoryCache.Clear();
+	m_CriticalPoints.Clear();
+	m_Skeleton.Clear();
+	m_TemporalDerivativeCache.Clear();
+
+	Dirty();
+	UpdateStatusBar();
+
+	return OnDocFrameChanged(NULL, NULL);
+}
+
+void CFlowIllustratorView::CycleReferenceFrame()
+{
+	CFlowIllustratorDoc *pDoc = GetDocument();
+	if (!pDoc) return;
+
+	const CAmiraVectorField2D *pVecField = pDoc->GetVectorfield();
+	if (!pVecField) return;
+
+	switch (pVecField->GetReferenceFrame())
+	{
+		case RF_LAB:
+			pDoc->SetReferenceFrame( pVecField->GetMeanVelocity(m_rcViewPort, pVecField->GetCurrentTimeStep()) );
+			break;
+		case RF_GALILEAN:
+			pDoc->SetReferenceFrame(m_rcViewPort);
+			break;
+		default:
+			pDoc->ResetReferenceFrame();
+			break;
+	}
+}
+
+void CFlowIllustratorView::CycleTemporalResolution()
+{
+	CFlowIllustratorDoc *pDoc = GetDocument();
+	if (!pDoc) return;
+
+	const CAmiraVectorField2D *pVecField = pDoc->GetVectorfield();
+	if (!pVecField) return;
+
+	const unsigned int nSubSteps = pVecField->GetTemporalResolution();
+
+	pDoc->SetTemporalResolution( (nSubSteps >= 8)? 1 : nSubSteps*2, pVecField->GetTemporalInterpolation() );
+}
+
+void CFlowIllustratorView::ToggleTemporalInterpolation()
+{
+	CFlowIllustratorDoc *pDoc = GetDocument();
+	if (!pDoc) return;
+
+	const CAmiraVectorField2D *pVecField = pDoc->GetVectorfield();
+	if (!pVecField) return;
+
+	pDoc->SetTemporalResolution( pVecField->GetTemporalResolution(), (pVecField->GetTemporalInterpolation() == TI_LINEAR)? TI_CUBIC : TI_LINEAR );
+}
+
+void CFlowIllustratorView::CycleFTLEResolution()
+{
+	CFlowIllustratorDoc *pDoc = GetDocument();
+	if (!pDoc) return;
+
+	const CAmiraVectorField2D *pVecField = pDoc->GetVectorfield();
+	if (!pVecField) return;
+
+	const int nWidth	= static_cast<int>(pVecField->GetExtentX());
+	const int nHeight	= static_cast<int>(pVecField->GetExtentY());
+
+	//The next divisor of the vector field's resolution
+	int nDivisor = 1;
+
+	if (m_nFTLEWidth >= nWidth) {
+		nDivisor = 2;
+	} else if (m_nFTLEWidth >= (nWidth + 1) / 2) {
+		nDivisor = 4;
+	}
+
+	SetFTLEResolution( max((nWidth + nDivisor - 1) / nDivisor, 2), max((nHeight + nDivisor - 1) / nDivisor, 2) );
+}
+
+void CFlowIllustratorView::CycleFTLEIntegrationLen()
+{
+	const int nNumFrames	= abs(m_nFTLEIntegrationLen);
+	const int nNext			= (nNumFrames >= 40)? 10 : max(2 * nNumFrames, 10);
+
+	SetFTLEIntegrationLen( (m_nFTLEIntegrationLen < 0)? -nNext : nNext );
+}
+
 void CFlowIllustratorView::ToggleAutoUpdateVortexTrajectory()
 {
 	m_bAutoUpdateTrajectories = ! m_bAutoUpdateTrajectories;
@@ -2304,6 +2740,377 @@ BOOL CFlowIllustratorView::GetAutoUpdateVortexTrajectory()
 	return m_bAutoUpdateTrajectories;
 }
 
+void CFlowIllustratorView::SetFastTrajectories(BOOL bFast)
+{
+	if (m_bFastTrajectories == bFast) return;
+
+	m_bFastTrajectories = bFast;
+
+	RecalcTrajectories();
+	UpdateStatusBar();
+}
+
+BOOL CFlowIllustratorView::GetFastTrajectories() const
+{
+	return m_bFastTrajectories;
+}
+
+void CFlowIllustratorView::SetTrajectoryMaxError(float fMaxError)
+{
+	if (m_fTrajectoryMaxError == fMaxError) return;
+
+	m_fTrajectoryMaxError = fMaxError;
+
+	if (m_bFastTrajectories) {
+		RecalcTrajectories();
+	}
+}
+
+CFlowMapCache* CFlowIllustratorView::AcquireTrajectoryCache(float &fMaxError) const
+{
+	fMaxError = 0.0f;
+
+	if (!m_bFastTrajectories) return nullptr;
+
+	CFlowIllustratorDoc *pDoc = GetDocument();
+	if (!pDoc) return nullptr;
+
+	const CAmiraVectorField2D *pVecField = pDoc->GetVectorfield();
+	if (!pVecField) return nullptr;
+
+	//Coarser than the vector field, intervals exceeding the error bound are integrated exactly anyway
+	const int nSamplesX = max(2, static_cast<int>(pVecField->GetExtentX()) / 2);
+	const int nSamplesY = max(2, static_cast<int>(pVecField->GetExtentY()) / 2);
+
+	m_TrajectoryCache.Init(pVecField, pVecField->GetDomainRect(), nSamplesX, nSamplesY, 0.5f);
+
+	fMaxError = m_fTrajectoryMaxError * pVecField->GetDomainRect().getWidth() / (pVecField->GetExtentX() - 1);
+
+	return &m_TrajectoryCache;
+}
+
+void CFlowIllustratorView::AddEvenlySpacedStreamLines(float fSeparation)
+{
+	CFlowIllustratorDoc *pDoc = GetDocument();
+	if (!pDoc || !m_pDrawObjMngr) return;
+
+	const CAmiraVectorField2D *pVecField = pDoc->GetVectorfield();
+	if (!pVecField) return;
+
+	CWaitCursor wait;
+
+	CEvenlySpacedStreamlines placement(pVecField, m_rcViewPort, fSeparation * gPixelPerUnit, m_fStreamLineStep, m_nStreamLineLen);
+	size_t nNumLines = placement.Compute();
+
+	for (size_t i = 0; i < nNumLines; i++)
+	{
+		const vector<CPointf> &line = placement.GetLine(i);
+
+		//Seeded at the backward end, s.t. recomputing the stream line yields (nearly) the same vertices
+		CStreamLine *pStreamLine = new CStreamLine(line.front(), static_cast<unsigned int>(line.size()), m_fArrowLength*gPixelPerUnit, m_NewObjectColor, m_fStreamLineStep);
+		*pStreamLine->GetDataPoints() = line;
+		pStreamLine->SetArrowCount(1);
+
+		CalcStreamlineBoundingBox(pStreamLine);
+		m_pDrawObjMngr->Add(pStreamLine);
+	}
+
+	NotifyDrawingObjsChanged();
+	RedrawWindow();
+}
+
+void CFlowIllustratorView::AddCriticalPointMarkers()
+{
+	CFlowIllustratorDoc *pDoc = GetDocument();
+	if (!pDoc || !m_pDrawObjMngr) return;
+
+	const CAmiraVectorField2D *pVecField = pDoc->GetVectorfield();
+	if (!pVecField) return;
+
+	m_CriticalPoints.Init(pVecField);
+	const vector<CriticalPoint> *pPoints = m_CriticalPoints.GetCriticalPoints(pVecField->GetCurrentTimeStep());
+	if (!pPoints) return;
+
+	const float fRadius = 4.0f * gPixelPerUnit;
+
+	for (auto iter = pPoints->begin(); iter != pPoints->end(); ++iter)
+	{
+		if (!m_rcViewPort.PtInRect(iter->pos)) continue;
+
+		m_pDrawObjMngr->Add(new CEllipsoid(iter->pos, fRadius, fRadius, GetCriticalPointColor(iter->nType), true));
+	}
+
+	NotifyDrawingObjsChanged();
+	RedrawWindow();
+}
+
+void CFlowIllustratorView::AddCriticalPointTracks()
+{
+	CFlowIllustratorDoc *pDoc = GetDocument();
+	if (!pDoc || !m_pDrawObjMngr) return;
+
+	const CAmiraVectorField2D *pVecField = pDoc->GetVectorfield();
+	if (!pVecField) return;
+
+	m_CriticalPoints.Init(pVecField);
+
+	CCriticalPointTracker tracker(pVecField, &m_CriticalPoints);
+	size_t nNumTracks = tracker.Track(pVecField->GetCurrentTimeStep(), static_cast<int>(pVecField->GetNumTimeSteps()) - 1);
+
+	for (size_t i = 0; i < nNumTracks; i++)
+	{
+		const CriticalPointTrack &track = tracker.GetTrack(i);
+		if (track.points.size() < 2) continue;
+
+		CSpeedLine *pTrack = new CSpeedLine(GetCriticalPointColor(track.points.front().nType), 2.0f, 1.0f);
+		vector<CPointf> *pPoints = pTrack->GetDataPoints();
+		pPoints->reserve(track.points.size());
+
+		for (auto iter = track.points.begin(); iter != track.points.end(); ++iter) {
+			pPoints->push_back(iter->pos);
+		}
+
+		pTrack->CalcBoundingRect();
+		m_pDrawObjMngr->Add(pTrack);
+	}
+
+	NotifyDrawingObjsChanged();
+	RedrawWindow();
+}
+
+void CFlowIllustratorView::BuildVortexCatalog()
+{
+	CFlowIllustratorDoc *pDoc = GetDocument();
+	if (!pDoc || !pDoc->GetVectorfield()) return;
+
+	CWaitCursor wait;
+	pDoc->BuildVortexCatalog(m_fVortexThreshold);
+}
+
+void CFlowIllustratorView::DetectVortices(BOOL bMultiScale)
+{
+	CFlowIllustratorDoc *pDoc = GetDocument();
+	if (!pDoc || !m_pDrawObjMngr) return;
+
+	const CAmiraVectorField2D *pVecField = pDoc->GetVectorfield();
+	if (!pVecField) return;
+
+	CWaitCursor wait;
+
+	CVortexDetector detector;
+	vector<VortexRegion> regions;
+
+	//Segment the same field as the current detector function
+	if (m_pDetectorFunc == &CFlowIllustratorView::_isVortQCriterion)
+		detector.SetField(VDF_Q_CRITERION);
+	else if (m_pDetectorFunc == &CFlowIllustratorView::_isVortLambda2)
+		detector.SetField(VDF_LAMBDA2);
+	else if (m_pDetectorFunc == &CFlowIllustratorView::_isVortOkuboWeiss)
+		detector.SetField(VDF_OKUBO_WEISS);
+
+	if (bMultiScale)
+		detector.DetectMultiScale(pVecField, pVecField->GetCurrentTimeStep(), regions);
+	else
+		detector.Detect(pVecField, pVecField->GetCurrentTimeStep(), regions);
+
+	for (auto iter = regions.begin(); iter != regions.end(); ++iter)
+	{
+		CVortexObj::VORTEX_STYLE nVortType(CVortexObj::ELLIPTIC);
+		CVortexObj::VORTEX_ROTATION_DIR nVortDir(CVortexObj::CLOCK_WISE);
+
+		GetVortexStyle(pVecField->GetCriticalPointType(iter->ptPeak), iter->fVorticity, nVortType, nVortDir);
+
+		m_pDrawObjMngr->Add(CreateVortexObj(iter->ptCentroid, iter->fRadius1, iter->fRadius2, iter->fAngle, fabs(iter->fVorticity), nVortType, nVortDir));
+	}
+
+	NotifyDrawingObjsChanged();
+	RedrawWindow();
+}
+
+const VortexCore* CFlowIllustratorView::FindCatalogVortex(const CPointf &point, float fThreshold, int nFromFrame) const
+{
+	CFlowIllustratorDoc *pDoc = GetDocument();
+	if (!pDoc || !pDoc->GetVectorfield()) return nullptr;
+
+	const CVortexCatalog *pCatalog = pDoc->GetVortexCatalog();
+
+	if (!pCatalog || fabs(pCatalog->GetMeasureThreshold() - fThreshold) > 1e-4f) return nullptr;
+
+	const int nFrame = pDoc->GetCurrentFrameNo();
+
+	if (nFromFrame < 0 || nFromFrame == nFrame) {
+		return pCatalog->FindCore(nFrame, point);
+	}
+
+	//The vortex is identified in the time step, it was advanced to last, and followed along its track
+	return pCatalog->FollowCore(pCatalog->FindCore(nFromFrame, point), nFrame);
+}
+
+void CFlowIllustratorView::ShowTopologicalSkeleton(BOOL bShow)
+{
+	m_bShowSkeleton = bShow;
+
+	if (m_bShowSkeleton) {
+		UpdateTopologicalSkeleton();
+	} 
+	else if (m_pDrawObjMngr)
+	{
+		for (auto iter = m_SkeletonLines.begin(); iter != m_SkeletonLines.end(); ++iter) 
+		{
+			shared_ptr<CDrawingObject> pLine = iter->lock();
+			if (pLine) {
+				m_pDrawObjMngr->Delete(pLine.get());
+			}
+		}
+
+		m_SkeletonLines.clear();
+		m_Skeleton.Clear();
+	}
+
+	NotifyDrawingObjsChanged();
+	RedrawWindow();
+}
+
+BOOL CFlowIllustratorView::GetShowTopologicalSkeleton() const
+{
+	return m_bShowSkeleton;
+}
+
+void CFlowIllustratorView::UpdateTopologicalSkeleton()
+{
+	CFlowIllustratorDoc *pDoc = GetDocument();
+	if (!pDoc || !m_pDrawObjMngr) return;
+
+	const CAmiraVectorField2D *pVecField = pDoc->GetVectorfield();
+	if (!pVecField) return;
+
+	//Long enough to cross the domain twice
+	const int nMaxSteps = static_cast<int>( 2.0f * (pVecField->GetExtentX() + pVecField->GetExtentY()) / m_fStreamLineStep );
+
+	m_CriticalPoints.Init(pVecField);
+	m_Skeleton.Init(pVecField, &m_CriticalPoints);
+	m_Skeleton.SetIntegrationParams(m_fStreamLineStep, nMaxSteps);
+
+	const size_t nNumSeparatrices = m_Skeleton.Update();
+
+	//Stream lines of the previous frame are reused, only their vertices are replaced
+	for (size_t i = 0; i < nNumSeparatrices; i++)
+	{
+		const Separatrix &sep = m_Skeleton.GetSeparatrix(i);
+		shared_ptr<CDrawingObject> pObj;
+
+		if (i < m_SkeletonLines.size()) {
+			pObj = m_SkeletonLines[i].lock();
+		}
+
+		if (!pObj)
+		{
+			const floatColor color = (sep.bForward)? floatColor(1.0f, 0.0f, 0.0f) : floatColor(0.0f, 0.0f, 1.0f);
+
+			pObj = shared_ptr<CDrawingObject>( new CStreamLine(sep.points.front(), static_cast<unsigned int>(sep.points.size()), m_fArrowLength*gPixelPerUnit, color, m_fStreamLineStep) );
+			reinterpret_cast<CStreamLine*>(pObj.get())->SetArrowCount(1);
+			m_pDrawObjMngr->Add(pObj);
+
+			if (i < m_SkeletonLines.size()) {
+				m_SkeletonLines[i] = pObj;
+			} else {
+				m_SkeletonLines.push_back(pObj);
+			}
+		}
+
+		//Vertices are ordered in flow direction, stable separatrices end at their saddle
+		CStreamLine *pLine = reinterpret_cast<CStreamLine*>(pObj.get());
+		vector<CPointf> *pPoints = pLine->GetDataPoints();
+
+		if (sep.bForward) {
+			pPoints->assign(sep.points.begin(), sep.points.end());
+		} else {
+			pPoints->assign(sep.points.rbegin(), sep.points.rend());
+		}
+
+		//The vertices are set explicitly, the stream line must not be integrated again from its origin
+		pLine->SetOrigin(pPoints->front());
+		pLine->SetMaxIntegrationLen(static_cast<int>(pPoints->size()));
+		pLine->NeedRecalc(false);
+		CalcStreamlineBoundingBox(pLine);
+	}
+
+	for (size_t i = nNumSeparatrices; i < m_SkeletonLines.size(); i++) 
+	{
+		shared_ptr<CDrawingObject> pLine = m_SkeletonLines[i].lock();
+		if (pLine) {
+			m_pDrawObjMngr->Delete(pLine.get());
+		}
+	}
+
+	m_SkeletonLines.resize(nNumSeparatrices);
+}
+
+floatColor CFlowIllustratorView::GetCriticalPointColor(CRITICAL_POINT_TYPE nType)
+{
+	switch (nType)
+	{
+		case SADDLE:			return floatColor(0.0f, 0.0f, 1.0f);
+		case REPELLING_SADDLE:	return floatColor(1.0f, 0.0f, 0.0f);
+		case ATTRACTING_SADDLE:	return floatColor(0.0f, 0.6f, 0.0f);
+		case REPELLING_FOCUS:	return floatColor(1.0f, 0.5f, 0.0f);
+		case ATTRACTING_FOCUS:	return floatColor(0.0f, 0.7f, 0.7f);
+		case CENTER:			return floatColor(0.8f, 0.0f, 0.8f);
+		default:				return floatColor(0.5f, 0.5f, 0.5f);
+	}
+}
+
+void CFlowIllustratorView::SetStreamlineSeparation(float fSeparation)
+{
+	m_fStreamLineSeparation = max(fSeparation, 1.0f);
+}
+
+float CFlowIllustratorView::GetStreamlineSeparation() const
+{
+	return m_fStreamLineSeparation;
+}
+
+void CFlowIllustratorView::RecalcTrajectories()
+{
+	if (!m_pDrawObjMngr) return;
+
+	if (m_pCreateDummy && m_pCreateDummy->GetType() == DO_PATHLINE)
+	{
+		reinterpret_cast<CStreamLine*>(m_pCreateDummy.get())->NeedRecalc(true);
+		calcCharacteristicLine(m_pCreateDummy.get(), m_ptMouseMove);
+	}
+
+	for (size_t i=0; i < m_pDrawObjMngr->Size(); i++)
+	{
+		CDrawingObject *pObj = m_pDrawObjMngr->GetAt(i).get();
+
+		switch (pObj->GetType())
+		{
+			case DO_PATHLINE:
+				reinterpret_cast<CStreamLine*>(pObj)->NeedRecalc(true);
+				calcCharacteristicLine(pObj, reinterpret_cast<CStreamLine*>(pObj)->GetOrigin());
+				break;
+			case DO_TIMELINE:
+			{
+				CTimeLine *pTimeLine = reinterpret_cast<CTimeLine*>(pObj);
+
+				//Time lines without a fixed start frame are advanced incrementally and switch with the next frame
+				if (pTimeLine->UseFixedStartFrame()) {
+					pTimeLine->SetOrigin(pTimeLine->GetOrigin());
+					calcCharacteristicLine(pTimeLine, pTimeLine->GetOrigin());
+				}
+
+				if (pTimeLine->ShowTrajectory()) {
+					calcTimeLineTrajectory(pTimeLine);
+				}
+				break;
+			}
+		}
+	}
+
+	RedrawWindow();
+}
+
 void CFlowIllustratorView::SetRenderStreaklineAsParticles(BOOL bAsParticles)
 {
 	m_bRenderStreaklineAsParticles = bAsParticles;
@@ -52,6 +52,10 @@
 #include "VortexObj.h"
 #include "Selection.h"
 #include "FlowIllustratorRenderView.h"
+#include "CriticalPoints.h"
+#include "TopologicalSkeleton.h"
+#include "VortexCatalog.h"
+#include "VorticityCache.h"
 
 const UINT FIV_SHOW_OBJECT_BROWSER = RegisterWindowMessage(_T("FIV_SHOW_OBJECT_BROWSER"));
 const UINT DRAWINGOBJS_CHANGED = RegisterWindowMessage(_T("DRAWINGOBJS_CHANGED"));
@@ -103,13 +107,28 @@ protected:
 	float						m_fVortexThreshold;				/**< Threshold used to measure a new vortex(relative to peak value at vortex core). */
 	BOOL						m_bCreateDroplets;				/**< Indicates, if stream and path lines are created as droplets. */
 	BOOL						m_bRenderStreaklineAsParticles; /**< Indicates, if new streak lines are displayed as particles. */
+	float						m_fStreamLineSeparation;		/**< Distance between automatically placed, evenly spaced stream lines in pixel. */
+	CAmiraVectorField2D::IntegrationState m_PreviewIntegration;	/**< End state of the integration of m_pCreateDummy, used to resize stream and path lines incrementally. */
+	BOOL						m_bPreviewIntegrationValid;		/**< Indicates, if m_PreviewIntegration matches the vertices of m_pCreateDummy. */
 	
 	int							m_nDetectorFuncID;				/**< ID/index of the currently selected vortex detector function. */
+	int							m_nVortexFrame;					/**< Time step, to which the vortices were advanced last. -1, if they were not advanced yet. */
 
 	vector<shared_ptr<CSelection>>	m_Selected;			/**< Vector of currently selected objects. */
 
 	BOOL			m_bAutoUpdateTrajectories;			/**< Indicates, if vortex trajectories are updated each time the simulation time step is changed. */
 
+	//Approximated path and time lines
+	BOOL					m_bFastTrajectories;	/**< If TRUE, path lines and time lines are approximated by composing cached flow maps, instead of RK4 integration. */
+	float					m_fTrajectoryMaxError;	/**< Maximum error estimate per frame interval of approximated path and time lines, in cells of the vector field. */
+	mutable CFlowMapCache	m_TrajectoryCache;		/**< Flow maps between consecutive frames, used to approximate path and time lines. */
+
+	CCriticalPointCache		m_CriticalPoints;		/**< Critical points of all frames, extracted on demand. */
+	CTopologicalSkeleton	m_Skeleton;				/**< Separatrices of the current frame, updated incrementally while the skeleton is shown. */
+	vector< weak_ptr<CDrawingObject> > m_SkeletonLines;	/**< Stream lines displaying the separatrices of m_Skeleton, in the same order. */
+	BOOL					m_bShowSkeleton;		/**< If TRUE, the topological skeleton is updated each time the frame changes. */
+	mutable CVorticityCache	m_VorticityCache;		/**< Vorticity tiles of all frames, shared by vortex tracking and vortex trajectories. */
+
 	//File Drag and Drop
 	COleDropTarget	m_DropTarget;	/**< Registers this CFlowIllustratorView as target for drag and drop operations. Used to open files. */
 	DROPEFFECT		m_DropEffect;	/**< Symbol, displayed during a drag and drop operation. Indicates, if drag and drop is successfully possible. */
@@ -205,6 +224,13 @@ public:
 
 	void SetEditMode(EDIT_MODE nMode);
 	void SetStreamlineLength(int nNumSteps);
+
+	/**
+	 *	Set the integrator, used to compute stream lines and LIC, and update the stream line preview.
+	 *
+	 *	@param nIntegrator The new integrator.
+	 */
+	virtual void SetStreamlineIntegrator(STREAMLINE_INTEGRATOR nIntegrator);
 	void SetStreamlineStepSize(float fStepSize);
 	void SetVortexThreshold(float fThreshold);
 	void SetArrowLength(float fArrowLen);
@@ -223,8 +249,102 @@ public:
 	void ToggleAutoUpdateVortexTrajectory();
 	BOOL GetAutoUpdateVortexTrajectory();
 
+	/**
+	 *	Switch between exact and approximated path lines and time lines, and recompute the affected objects.
+	 *
+	 *	@param bFast If TRUE, path lines and time lines are approximated by composing cached flow maps between consecutive frames.
+	 *
+	 *	@remarks The approximation is meant for interactive work. CFlowIllustratorDoc switches to exact integration, before anything is exported.
+	 */
+	void SetFastTrajectories(BOOL bFast);
+	BOOL GetFastTrajectories() const;
+
+	/**
+	 *	Set the maximum error estimate per frame interval of approximated path and time lines.
+	 *
+	 *	@param fMaxError The maximum error, measured in cells of the vector field. Larger values favour speed over accuracy.
+	 */
+	void SetTrajectoryMaxError(float fMaxError);
+
+	/**
+	 *	Fills the viewport with evenly spaced stream lines of the current frame, and adds them to the document.
+	 *	The stream lines use the current step size, and at most the current stream line length in each direction.
+	 *
+	 *	@param fSeparation Distance between neighbouring stream lines in pixel.
+	 */
+	void AddEvenlySpacedStreamLines(float fSeparation);
+
+	/**
+	 *	Places a marker on each critical point of the current frame inside the viewport.
+	 *	The marker color encodes the type of the critical point.
+	 */
+	void AddCriticalPointMarkers();
+
+	/**
+	 *	Tracks the critical points from the current frame to the last frame, and adds their paths as speed lines to the document.
+	 *	The color of each speed line encodes the type of the critical point, where the track starts.
+	 */
+	void AddCriticalPointTracks();
+
+	/**
+	 *	Shows or hides the topological skeleton of the vector field, i.e. the separatrices of all saddles.
+	 *	While it is shown, the separatrices are added to the document as stream lines and follow the current frame.
+	 *
+	 *	@param bShow If TRUE, the skeleton is shown, otherwise its stream lines are removed from the document.
+	 */
+	void ShowTopologicalSkeleton(BOOL bShow);
+	BOOL GetShowTopologicalSkeleton() const;
+
+	/**
+	 *	Detects the vortices of all frames with the current vortex threshold, and stores them as vortex catalog
+	 *	next to the vector field file. Placing and following vortices becomes a lookup into this catalog.
+	 */
+	void BuildVortexCatalog();
+
+	/**
+	 *	Detects all vortices of the current frame by segmenting the vorticity magnitude, and adds a vortex object for each of them.
+	 *	Each vortex object is placed at the centroid of its region, with the ellipse of the same second moments.
+	 *
+	 *	@param bMultiScale If TRUE, vortices are detected as blobs in scale space instead, and sized by their characteristic scale.
+	 */
+	void DetectVortices(BOOL bMultiScale = FALSE);
+
+	/**
+	 *	Cycles the reference frame of the vector field from the lab frame, to a Galilean frame moving with the current 
+	 *	mean velocity of the viewport, to a frame following the mean velocity of the viewport in every time step.
+	 */
+	void CycleReferenceFrame();
+
+	/**
+	 *	Cycles the number of virtual frames per time step through 1, 2, 4 and 8, see CFlowIllustratorDoc::SetTemporalResolution().
+	 */
+	void CycleTemporalResolution();
+
+	/**
+	 *	Toggles the interpolation between time steps between linear and cubic, see CFlowIllustratorDoc::SetTemporalResolution().
+	 */
+	void ToggleTemporalInterpolation();
+
+	/**
+	 *	Cycles the grid of the FTLE field through the full, half and quarter resolution of the vector field, see SetFTLEResolution().
+	 */
+	void CycleFTLEResolution();
+
+	/**
+	 *	Cycles the integration time of the FTLE field through 10, 20 and 40 frames, and keeps its direction, see SetFTLEIntegrationLen().
+	 */
+	void CycleFTLEIntegrationLen();
+
+	void SetStreamlineSeparation(float fSeparation);
+	float GetStreamlineSeparation() const;
+
 protected:
+	static floatColor GetCriticalPointColor(CRITICAL_POINT_TYPE nType);
+	void UpdateTopologicalSkeleton();
+	const VortexCore* FindCatalogVortex(const CPointf &point, float fThreshold, int nFromFrame = -1) const;
 	void AddNewVortex(const CPointf& point);
+	static void GetVortexStyle(CRITICAL_POINT_TYPE nType, float fVorticity, CVortexObj::VORTEX_STYLE &nVortType, CVortexObj::VORTEX_ROTATION_DIR &nVortDir);
+	CVortexObj* CreateVortexObj(const CPointf &pt, float r1, float r2, float angle, float fVorticity, CVortexObj::VORTEX_STYLE nVortType, CVortexObj::VORTEX_ROTATION_DIR nVortDir) const;
 	void AddNewRectangle(const CPointf& ptMouseDown, const CPointf& ptMouseUp);
 	void AddNewEllipse(const CPointf& ptMouseDown, const CPointf& ptMouseUp);
 	void AddNewTriangle(const CPointf& ptMouseDown, const CPointf& ptMouseUp);
@@ -242,6 +362,10 @@ protected:
 
 private:
 	bool _isVortVorticityMagnitude(const CAmiraVectorField2D*, const CPointf&);
+	bool _isVortQCriterion(const CAmiraVectorField2D*, const CPointf&);
+	bool _isVortLambda2(const CAmiraVectorField2D*, const CPointf&);
+	bool _isVortOkuboWeiss(const CAmiraVectorField2D*, const CPointf&);
+	bool _isVortCatalog(const CAmiraVectorField2D*, const CPointf&);
 
 
 // Implementation
@@ -267,11 +391,19 @@ protected:
 	 *	@param pStreamLine	Pointer to a CStreamLine to receive the vertices obtained by the integration.
 	 *	@param bForward	If true, forward integration is performed, otherwise backward integration.
 	 */
-	void calcStreamLine(const CPointf& point, CStreamLine *pStreamLine, bool bForward = true);
-	void calcPathLine(const CPointf& point, CPathLine *pPathLine) const;
+	void calcStreamLine(const CPointf& point, CStreamLine *pStreamLine, bool bForward = true, CAmiraVectorField2D::IntegrationState *pState = nullptr);
+	void calcPathLine(const CPointf& point, CPathLine *pPathLine, CAmiraVectorField2D::IntegrationState *pState = nullptr) const;
 	void calcStreakLine(const CPointf& point, CStreakLine *pStreakLine);
 	void calcTimeLine( CTimeLine *pTimeLine);
 	void calcCharacteristicLine(CDrawingObject* pObj, const CPointf &pOrigin);
+
+	/**
+	 *	Adapts the vertices of the stream or path line preview (m_pCreateDummy) to its current maximum integration length,
+	 *	by continuing or truncating the previous integration.
+	 *
+	 *	@return Returns TRUE, if the preview was resized, FALSE if it has to be recomputed from its origin.
+	 */
+	BOOL resizePreviewLine();
 	void calcVortexTrajectory(CVortexObj *pVortex) const;
 
 	/**
@@ -284,7 +416,24 @@ protected:
 	 *				and performes a path line integration for each particle.
 	 */
 	void calcTimeLineTrajectory(CTimeLine *pTimeLine) const;
+
+	/**
+	 *	Retrieves the flow map cache for approximated path and time lines, and initializes it for the current vector field, if necessary.
+	 *
+	 *	@param fMaxError Receives the maximum error estimate per frame interval in domain units.
+	 *
+	 *	@return A pointer to m_TrajectoryCache, or nullptr if fast trajectories are disabled.
+	 *
+	 *	@remarks The flow maps are computed on a grid with half the resolution of the vector field.
+	 */
+	CFlowMapCache* AcquireTrajectoryCache(float &fMaxError) const;
+
+	/**
+	 *	Recomputes all path lines and time lines with a fixed start frame, e.g. after switching between exact and approximated integration.
+	 */
+	void RecalcTrajectories();
 	BOOL measureVortex(CScalarField2D *pVortField, const CPointf &ptVortexCore, float &radius1, float &radius2, float &angle, float fThreshold);
+	BOOL measureVortex(const CVorticityWindow &window, const CPointf &ptVortexCore, float &radius1, float &radius2, float &angle, float fThreshold);
 	CPointf GetVortexCore(const CPointf& point);
 
 public:
@@ -295,6 +444,7 @@ public:
 	void JumpToLastFrame();
 
 	void JumpToFrame(int nFrame);
+	void JumpToVirtualFrame(int nFrame);
 
 	BOOL IsPlaying();
 	BOOL IsPlayingFwd();
@@ -337,6 +487,7 @@ public:
 	virtual void OnDragLeave();
 
 	afx_msg LRESULT OnDocFrameChanged(WPARAM wParam, LPARAM lParam);
+	afx_msg LRESULT OnDocReferenceFrameChanged(WPARAM wParam, LPARAM lParam);
 	afx_msg LRESULT OnSVGLoaded(WPARAM wParam, LPARAM lParam);
 	afx_msg LRESULT OnViewUpdateSelected(WPARAM wParam, LPARAM lParam);
 	afx_msg LRESULT OnSelectDrawingObject(WPARAM wParam, LPARAM lParam);
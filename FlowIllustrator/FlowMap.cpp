@@ -0,0 +1,571 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "StdAfx.h"
+#include "FlowMap.h"
+#include <math.h>
+
+#define FLOWMAP_TILE_SIZE 32	//Edge length of the tiles, the flow map grid is split into for parallel processing
+
+CFlowMap2D::CFlowMap2D(const CRectF &rcDomain, int nSamplesX, int nSamplesY, int nFrame, bool bForward)
+	: CDataField2D(rcDomain, nSamplesX, nSamplesY)
+{
+	m_pDisplacement	= new CVector2D[nSamplesX * nSamplesY];
+	m_pValid		= new bool[nSamplesX * nSamplesY];
+	m_nFrame		= nFrame;
+	m_bForward		= bForward;
+}
+
+CFlowMap2D::~CFlowMap2D(void)
+{
+	delete [] m_pDisplacement;
+	delete [] m_pValid;
+}
+
+void CFlowMap2D::Compute(const CAmiraVectorField2D *pVecField, float stepLen)
+{
+	const int nTilesX	= (m_nSamplesX + FLOWMAP_TILE_SIZE - 1) / FLOWMAP_TILE_SIZE;
+	const int nTilesY	= (m_nSamplesY + FLOWMAP_TILE_SIZE - 1) / FLOWMAP_TILE_SIZE;
+	const int nNumTiles = nTilesX * nTilesY;
+
+	const float fTimeFrom	= static_cast<float>(m_nFrame);
+	const float fTimeTo		= static_cast<float>( (m_bForward)? m_nFrame + 1 : m_nFrame - 1 );
+
+	//Particles close to vortices need more steps, hence dynamic scheduling
+	#pragma omp parallel for schedule(dynamic)
+	for (int nTile = 0; nTile < nNumTiles; nTile++)
+	{
+		const int xMin = (nTile % nTilesX) * FLOWMAP_TILE_SIZE;
+		const int yMin = (nTile / nTilesX) * FLOWMAP_TILE_SIZE;
+		const int xMax = min(xMin + FLOWMAP_TILE_SIZE, static_cast<int>(m_nSamplesX));
+		const int yMax = min(yMin + FLOWMAP_TILE_SIZE, static_cast<int>(m_nSamplesY));
+
+		for (int y = yMin; y < yMax; y++)
+		{
+			for (int x = xMin; x < xMax; x++)
+			{
+				CPointf ptSeed;
+				_getDomainCoordinates(static_cast<float>(x), static_cast<float>(y), ptSeed.x, ptSeed.y);
+
+				CPointf pt(ptSeed);
+				const int idx = y * m_nSamplesX + x;
+
+				m_pValid[idx]			= pVecField->advectParticle(pt, fTimeFrom, fTimeTo, stepLen);
+				m_pDisplacement[idx]	= CVector2D(pt.x - ptSeed.x, pt.y - ptSeed.y);
+			}
+		}
+	}
+}
+
+bool CFlowMap2D::Map(const CPointf &ptFrom, CPointf &ptTo, float *pError) const
+{
+	float x, y;
+	_getGridCoordinates(ptFrom.x, ptFrom.y, x, y);
+
+	if (x < 0.0f || y < 0.0f || x > m_nMaxIdxX || y > m_nMaxIdxY || m_nSamplesX < 2 || m_nSamplesY < 2) {
+		ptTo = ptFrom;
+		return false;
+	}
+
+	const int px = min(static_cast<int>(x), static_cast<int>(m_nMaxIdxX) - 1);
+	const int py = min(static_cast<int>(y), static_cast<int>(m_nMaxIdxY) - 1);
+
+	const float wx = x - px;
+	const float wy = y - py;
+
+	const int i00 = py * m_nSamplesX + px;
+	const int i10 = i00 + 1;
+	const int i01 = i00 + m_nSamplesX;
+	const int i11 = i01 + 1;
+
+	//Bilinear interpolation of the displacements
+	CVector2D d0 ( m_pDisplacement[i00] * (1.0f - wx) + m_pDisplacement[i10] * wx );
+	CVector2D d1 ( m_pDisplacement[i01] * (1.0f - wx) + m_pDisplacement[i11] * wx );
+	CVector2D d	 ( d0 * (1.0f - wy) + d1 * wy );
+
+	ptTo = CPointf(ptFrom.x + d.x, ptFrom.y + d.y);
+
+	if (pError) {
+		//The bilinear twist term vanishes for affine displacements, and bounds the deviation from them
+		CVector2D twist ( m_pDisplacement[i00] - m_pDisplacement[i10] - m_pDisplacement[i01] + m_pDisplacement[i11] );
+		*pError = 0.25f * twist.abs();
+	}
+
+	return (m_pValid[i00] && m_pValid[i10] && m_pValid[i01] && m_pValid[i11]);
+}
+
+
+CFlowMapCache::CFlowMapCache()
+{
+	m_pVecField	= nullptr;
+	m_nSamplesX	= 0;
+	m_nSamplesY	= 0;
+	m_fStepLen	= 0.0f;
+	m_nMaxMaps	= 64;
+	m_nNumMaps	= 0;
+}
+
+CFlowMapCache::~CFlowMapCache()
+{
+	Clear();
+}
+
+void CFlowMapCache::Init(const CAmiraVectorField2D *pVecField, const CRectF &rcDomain, int nSamplesX, int nSamplesY, float fStepLen)
+{
+	if (pVecField == m_pVecField && nSamplesX == m_nSamplesX && nSamplesY == m_nSamplesY && fStepLen == m_fStepLen &&
+		rcDomain.m_Min.x == m_rcDomain.m_Min.x && rcDomain.m_Min.y == m_rcDomain.m_Min.y &&
+		rcDomain.m_Max.x == m_rcDomain.m_Max.x && rcDomain.m_Max.y == m_rcDomain.m_Max.y)
+	{
+		return;
+	}
+
+	Clear();
+
+	m_pVecField = pVecField;
+	m_rcDomain	= rcDomain;
+	m_nSamplesX = nSamplesX;
+	m_nSamplesY = nSamplesY;
+	m_fStepLen	= fStepLen;
+
+	if (m_pVecField)
+	{
+		m_ForwardMaps.resize(m_pVecField->GetNumTimeSteps(), nullptr);
+		m_BackwardMaps.resize(m_pVecField->GetNumTimeSteps(), nullptr);
+	}
+}
+
+void CFlowMapCache::Clear()
+{
+	for (auto iter = m_ForwardMaps.begin(); iter != m_ForwardMaps.end(); ++iter) {
+		delete (*iter);
+	}
+	for (auto iter = m_BackwardMaps.begin(); iter != m_BackwardMaps.end(); ++iter) {
+		delete (*iter);
+	}
+
+	m_ForwardMaps.clear();
+	m_BackwardMaps.clear();
+	m_nNumMaps	= 0;
+	m_pVecField = nullptr;
+}
+
+void CFlowMapCache::SetMaxSize(size_t nMaxMaps)
+{
+	m_nMaxMaps = max(nMaxMaps, static_cast<size_t>(1));
+}
+
+const CFlowMap2D* CFlowMapCache::GetFlowMap(int nFrame, bool bForward)
+{
+	return _getFlowMap(nFrame, bForward, nFrame, nFrame);
+}
+
+const CFlowMap2D* CFlowMapCache::_getFlowMap(int nFrame, bool bForward, int nKeepMin, int nKeepMax)
+{
+	if (!m_pVecField || m_nSamplesX < 2 || m_nSamplesY < 2) return nullptr;
+
+	const int nMaxFrame = static_cast<int>(m_pVecField->GetNumTimeSteps()) - 1;
+
+	//A forward map starting at the last frame, or a backward map starting at the first frame does not exist
+	if (nFrame < 0 || nFrame > nMaxFrame) return nullptr;
+	if ( (bForward && nFrame == nMaxFrame) || (!bForward && nFrame == 0) ) return nullptr;
+
+	vector<CFlowMap2D*> &maps = (bForward)? m_ForwardMaps : m_BackwardMaps;
+
+	if (!maps[nFrame])
+	{
+		_evict(nKeepMin, nKeepMax);
+
+		CFlowMap2D *pMap = new CFlowMap2D(m_rcDomain, m_nSamplesX, m_nSamplesY, nFrame, bForward);
+		pMap->Compute(m_pVecField, m_fStepLen);
+
+		maps[nFrame] = pMap;
+		m_nNumMaps++;
+	}
+
+	return maps[nFrame];
+}
+
+void CFlowMapCache::_evict(int nKeepMin, int nKeepMax)
+{
+	while (m_nNumMaps >= m_nMaxMaps)
+	{
+		CFlowMap2D **ppFarthest = nullptr;
+		int nMaxDist = -1;
+
+		for (int nDir = 0; nDir < 2; nDir++)
+		{
+			vector<CFlowMap2D*> &maps = (nDir == 0)? m_ForwardMaps : m_BackwardMaps;
+
+			for (int i = 0; i < static_cast<int>(maps.size()); i++)
+			{
+				if (!maps[i]) continue;
+
+				int nDist = (i < nKeepMin)? nKeepMin - i : ( (i > nKeepMax)? i - nKeepMax : 0 );
+				if (nDist > nMaxDist) {
+					nMaxDist	= nDist;
+					ppFarthest	= &maps[i];
+				}
+			}
+		}
+
+		if (!ppFarthest) break;
+
+		delete (*ppFarthest);
+		*ppFarthest = nullptr;
+		m_nNumMaps--;
+	}
+}
+
+CScalarField2D* CFlowMapCache::GetFTLEField(int nStartFrame, int nNumFrames)
+{
+	if (!m_pVecField || m_nSamplesX < 2 || m_nSamplesY < 2) return nullptr;
+
+	const int nMaxFrame = static_cast<int>(m_pVecField->GetNumTimeSteps()) - 1;
+	const bool bForward	= (nNumFrames >= 0);
+
+	nStartFrame		= min(max(nStartFrame, 0), nMaxFrame);
+	int nEndFrame	= min(max(nStartFrame + nNumFrames, 0), nMaxFrame);
+	nNumFrames		= abs(nEndFrame - nStartFrame);
+
+	const int nNumNodes = m_nSamplesX * m_nSamplesY;
+	const int nKeepMin	= min(nStartFrame, nEndFrame);
+	const int nKeepMax	= max(nStartFrame, nEndFrame);
+
+	//All intervals must fit into the cache, otherwise the next start frame cannot reuse them
+	if (m_nMaxMaps < static_cast<size_t>(nNumFrames + 1)) {
+		m_nMaxMaps = nNumFrames + 1;
+	}
+
+	//Seed a particle at each grid node
+	vector<CPointf> positions(nNumNodes);
+	const float fCellX = m_rcDomain.getWidth() / (m_nSamplesX - 1);
+	const float fCellY = m_rcDomain.getHeight() / (m_nSamplesY - 1);
+
+	for (int y = 0; y < m_nSamplesY; y++) {
+		for (int x = 0; x < m_nSamplesX; x++) {
+			positions[y * m_nSamplesX + x] = CPointf(m_rcDomain.m_Min.x + x * fCellX, m_rcDomain.m_Min.y + y * fCellY);
+		}
+	}
+
+	//Compose the flow maps of all intervals
+	for (int k = 0; k < nNumFrames; k++)
+	{
+		const CFlowMap2D *pMap = _getFlowMap( (bForward)? nStartFrame + k : nStartFrame - k, bForward, nKeepMin, nKeepMax);
+		if (!pMap) break;
+
+		#pragma omp parallel for
+		for (int i = 0; i < nNumNodes; i++)
+		{
+			CPointf pt(positions[i]);
+			pMap->Map(pt, positions[i]);
+		}
+	}
+
+	CScalarField2D *pFTLE = new CScalarField2D(m_rcDomain, m_nSamplesX, m_nSamplesY);
+	float *pData = pFTLE->GetData();
+
+	//Integration time in seconds
+	const float fT = nNumFrames / m_pVecField->GetSamplesPerSecond();
+
+	#pragma omp parallel for
+	for (int y = 0; y < m_nSamplesY; y++)
+	{
+		const int y0 = max(y - 1, 0);
+		const int y1 = min(y + 1, m_nSamplesY - 1);
+
+		for (int x = 0; x < m_nSamplesX; x++)
+		{
+			if (nNumFrames == 0) {
+				pData[y * m_nSamplesX + x] = 0.0f;
+				continue;
+			}
+
+			const int x0 = max(x - 1, 0);
+			const int x1 = min(x + 1, m_nSamplesX - 1);
+
+			const CPointf &pl = positions[y * m_nSamplesX + x0];
+			const CPointf &pr = positions[y * m_nSamplesX + x1];
+			const CPointf &pb = positions[y0 * m_nSamplesX + x];
+			const CPointf &pt = positions[y1 * m_nSamplesX + x];
+
+			//Jacobian of the flow map by central differences
+			const float a = (pr.x - pl.x) / ((x1 - x0) * fCellX);
+			const float b = (pt.x - pb.x) / ((y1 - y0) * fCellY);
+			const float c = (pr.y - pl.y) / ((x1 - x0) * fCellX);
+			const float d = (pt.y - pb.y) / ((y1 - y0) * fCellY);
+
+			//Largest eigenvalue of the Cauchy-Green tensor J^T * J
+			const float c11 = a*a + c*c;
+			const float c12 = a*b + c*d;
+			const float c22 = b*b + d*d;
+			const float tr	= c11 + c22;
+			const float det = c11*c22 - c12*c12;
+			const float lambdaMax = 0.5f * (tr + sqrt(max(tr*tr - 4.0f*det, 0.0f)));
+
+			pData[y * m_nSamplesX + x] = (lambdaMax > 1e-12f)? log(sqrt(lambdaMax)) / fT : 0.0f;
+		}
+	}
+
+	float fMin(pData[0]), fMax(pData[0]);
+	for (int i = 1; i < nNumNodes; i++)
+	{
+		if (pData[i] < fMin) fMin = pData[i];
+		if (pData[i] > fMax) fMax = pData[i];
+	}
+	pFTLE->SetMinMax(fMin, fMax);
+
+	return pFTLE;
+}
+
+void CFlowMapCache::_reserve(float fTimeFrom, float fTimeTo)
+{
+	const size_t nNumMaps = static_cast<size_t>( ceil(fabs(fTimeTo - fTimeFrom)) ) + 1;
+
+	//A single trajectory must not evict the maps of its own earlier intervals
+	if (m_nMaxMaps < nNumMaps) {
+		m_nMaxMaps = nNumMaps;
+	}
+}
+
+bool CFlowMapCache::_advectInterval(CPointf &pos, const CFlowMap2D *pMap, int nFrame, bool bForward, float fMaxError) const
+{
+	if (pMap)
+	{
+		CPointf ptTo;
+		float fError;
+
+		if (pMap->Map(pos, ptTo, &fError) && fError <= fMaxError) {
+			pos = ptTo;
+			return true;
+		}
+	}
+
+	const float fTimeFrom	= static_cast<float>(nFrame);
+	const float fTimeTo		= static_cast<float>( (bForward)? nFrame + 1 : nFrame - 1 );
+
+	return m_pVecField->advectParticle(pos, fTimeFrom, fTimeTo, m_fStepLen);
+}
+
+void CFlowMapCache::_advect(CPointf *pPoints, bool *pValid, int nNumPoints, float fTimeFrom, float fTimeTo, float fMaxError)
+{
+	const float fMaxTime = static_cast<float>(m_pVecField->GetNumTimeSteps() - 1);
+
+	fTimeFrom	= min(max(fTimeFrom, 0.0f), fMaxTime);
+	fTimeTo		= min(max(fTimeTo, 0.0f), fMaxTime);
+
+	const bool bForward = (fTimeTo >= fTimeFrom);
+
+	//First and last frame boundary inside [fTimeFrom, fTimeTo]
+	const int nFirst	= static_cast<int>( (bForward)? ceil(fTimeFrom) : floor(fTimeFrom) );
+	const int nLast		= static_cast<int>( (bForward)? floor(fTimeTo) : ceil(fTimeTo) );
+
+	if ( (bForward && nFirst > nLast) || (!bForward && nFirst < nLast) )
+	{
+		//The whole time span lies within a single frame interval
+		#pragma omp parallel for if(nNumPoints > 64)
+		for (int i = 0; i < nNumPoints; i++) {
+			if (pValid[i]) pValid[i] = m_pVecField->advectParticle(pPoints[i], fTimeFrom, fTimeTo, m_fStepLen);
+		}
+		return;
+	}
+
+	_reserve(fTimeFrom, fTimeTo);
+
+	const int nKeepMin = min(nFirst, nLast);
+	const int nKeepMax = max(nFirst, nLast);
+
+	//Leading fraction of a frame interval
+	#pragma omp parallel for if(nNumPoints > 64)
+	for (int i = 0; i < nNumPoints; i++) {
+		if (pValid[i]) pValid[i] = m_pVecField->advectParticle(pPoints[i], fTimeFrom, static_cast<float>(nFirst), m_fStepLen);
+	}
+
+	//Whole frame intervals
+	for (int nFrame = nFirst; nFrame != nLast; nFrame += (bForward)? 1 : -1)
+	{
+		const CFlowMap2D *pMap = (fMaxError > 0.0f)? _getFlowMap(nFrame, bForward, nKeepMin, nKeepMax) : nullptr;
+
+		#pragma omp parallel for if(nNumPoints > 64) schedule(dynamic, 16)
+		for (int i = 0; i < nNumPoints; i++) {
+			if (pValid[i]) pValid[i] = _advectInterval(pPoints[i], pMap, nFrame, bForward, fMaxError);
+		}
+	}
+
+	//Trailing fraction of a frame interval
+	#pragma omp parallel for if(nNumPoints > 64)
+	for (int i = 0; i < nNumPoints; i++) {
+		if (pValid[i]) pValid[i] = m_pVecField->advectParticle(pPoints[i], static_cast<float>(nLast), fTimeTo, m_fStepLen);
+	}
+}
+
+bool CFlowMapCache::AdvectParticle(CPointf &pos, float fTimeFrom, float fTimeTo, float fMaxError)
+{
+	if (!m_pVecField) return false;
+
+	bool bValid = true;
+	_advect(&pos, &bValid, 1, fTimeFrom, fTimeTo, fMaxError);
+
+	return bValid;
+}
+
+int CFlowMapCache::IntegratePathLine(const CPointf &ptOrigin, float fStartTime, int nNumSteps, float stepLen, bool bForward, float fMaxError, vector<CPointf> *pOutBuff, const CRectF &rcIntegrationDomain)
+{
+	if (!m_pVecField || nNumSteps < 1) return 0;
+
+	CRectF rcDomain(rcIntegrationDomain);
+	const CRectF rcField(m_pVecField->GetDomainRect());
+
+	//Ensure the integration domain does not exceed the real domain
+	if (rcDomain.m_Min.x < rcField.m_Min.x) rcDomain.m_Min.x = rcField.m_Min.x;
+	if (rcDomain.m_Min.y < rcField.m_Min.y) rcDomain.m_Min.y = rcField.m_Min.y;
+	if (rcDomain.m_Max.x > rcField.m_Max.x) rcDomain.m_Max.x = rcField.m_Max.x;
+	if (rcDomain.m_Max.y > rcField.m_Max.y) rcDomain.m_Max.y = rcField.m_Max.y;
+
+	const float fDir		= (bForward)? 1.0f : -1.0f;
+	const float fMaxTime	= static_cast<float>(m_pVecField->GetNumTimeSteps() - 1);
+	const float fDeltaTime	= stepLen * m_pVecField->GetSamplesPerSecond() / m_pVecField->GetSamplesPerUnitX() * fDir;
+	const float fEps		= 1e-4f;
+
+	fStartTime = min(max(fStartTime, 0.0f), fMaxTime);
+	const float fEndTime = min(max(fStartTime + (nNumSteps - 1) * fDeltaTime, 0.0f), fMaxTime);
+
+	_reserve(fStartTime, fEndTime);
+
+	vector<CPointf> line;
+	line.reserve(nNumSteps);
+	line.push_back(ptOrigin);
+
+	float		t0(fStartTime);
+	CPointf		p0(ptOrigin);
+	CVector2D	v0(m_pVecField->GetParticleVelocity(p0, t0));
+	int			k(1);
+	bool		bTerminated(false);
+
+	while (!bTerminated && k < nNumSteps && (fEndTime - t0) * fDir > fEps)
+	{
+		//Advance to the next frame boundary
+		float t1 = (bForward)? floor(t0 + fEps) + 1.0f : ceil(t0 - fEps) - 1.0f;
+		if ( (t1 - fEndTime) * fDir > 0.0f ) t1 = fEndTime;
+
+		CPointf p1(p0);
+
+		if (AdvectParticle(p1, t0, t1, fMaxError))
+		{
+			const CVector2D v1(m_pVecField->GetParticleVelocity(p1, t1));
+			const float h = t1 - t0;
+
+			//Cubic Hermite interpolation of all vertices inside [t0, t1]
+			for (; k < nNumSteps; k++)
+			{
+				const float tk = fStartTime + k * fDeltaTime;
+				if ( (tk - t1) * fDir > fEps ) break;
+
+				const float s	= (tk - t0) / h;
+				const float s2	= s*s;
+				const float s3	= s2*s;
+				const float h00 = 2.0f*s3 - 3.0f*s2 + 1.0f;
+				const float h10 = (s3 - 2.0f*s2 + s) * h;
+				const float h01 = -2.0f*s3 + 3.0f*s2;
+				const float h11 = (s3 - s2) * h;
+
+				CPointf pt(	h00*p0.x + h10*v0.x + h01*p1.x + h11*v1.x,
+							h00*p0.y + h10*v0.y + h01*p1.y + h11*v1.y );
+
+				if (!rcDomain.PtInRect(pt.x, pt.y)) {
+					bTerminated = true;
+					break;
+				}
+
+				line.push_back(pt);
+			}
+
+			t0 = t1;
+			p0 = p1;
+			v0 = v1;
+		}
+		else
+		{
+			//The particle leaves the domain inside this interval, find the last vertex exactly
+			CPointf pt(p0);
+			float t(t0);
+
+			for (; k < nNumSteps; k++)
+			{
+				const float tk = fStartTime + k * fDeltaTime;
+				if ( (tk - t1) * fDir > fEps ) break;
+
+				if ( !m_pVecField->advectParticle(pt, t, tk, stepLen) || !rcDomain.PtInRect(pt.x, pt.y) ) break;
+
+				line.push_back(pt);
+				t = tk;
+			}
+
+			bTerminated = true;
+		}
+	}
+
+	if (bForward) {
+		pOutBuff->insert(pOutBuff->end(), line.begin(), line.end());
+	} else {
+		pOutBuff->insert(pOutBuff->begin(), line.rbegin(), line.rend());
+	}
+
+	return static_cast<int>(line.size());
+}
+
+void CFlowMapCache::AdvectTimeLine(vector<CPointf> *pPoints, float fStartTime, int nNumSteps, float stepLen, bool bForward, float fMaxError, const CRectF &rcIntegrationDomain)
+{
+	if (!m_pVecField || pPoints->empty()) return;
+
+	CRectF rcDomain(rcIntegrationDomain);
+	const CRectF rcField(m_pVecField->GetDomainRect());
+
+	//Ensure the integration domain does not exceed the real domain
+	if (rcDomain.m_Min.x < rcField.m_Min.x) rcDomain.m_Min.x = rcField.m_Min.x;
+	if (rcDomain.m_Min.y < rcField.m_Min.y) rcDomain.m_Min.y = rcField.m_Min.y;
+	if (rcDomain.m_Max.x > rcField.m_Max.x) rcDomain.m_Max.x = rcField.m_Max.x;
+	if (rcDomain.m_Max.y > rcField.m_Max.y) rcDomain.m_Max.y = rcField.m_Max.y;
+
+	const float fSpan		= nNumSteps * stepLen * m_pVecField->GetSamplesPerSecond() / m_pVecField->GetSamplesPerUnitX();
+	const float fTimeTo		= fStartTime + ((bForward)? fSpan : -fSpan);
+	const int	nNumPoints	= static_cast<int>(pPoints->size());
+
+	bool *pValid = new bool[nNumPoints];
+	for (int i = 0; i < nNumPoints; i++) pValid[i] = true;
+
+	_advect(&(*pPoints)[0], pValid, nNumPoints, fStartTime, fTimeTo, fMaxError);
+
+	delete [] pValid;
+
+	//Particles, that left the domain, stay at its border
+	for (auto iter = pPoints->begin(); iter != pPoints->end(); ++iter)
+	{
+		iter->x = min(max(iter->x, rcDomain.m_Min.x), rcDomain.m_Max.x);
+		iter->y = min(max(iter->y, rcDomain.m_Min.y), rcDomain.m_Max.y);
+	}
+}
@@ -0,0 +1,294 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#pragma once
+#include "AmiraVectorField2D.h"
+#include "ScalarField.h"
+#include <vector>
+
+using namespace std;
+
+/**
+ *	Flow map of a 2D, time-dependent vector field over a single frame interval.
+ *	For each node of a uniform grid, it stores the position, a particle seeded at this node
+ *	at time step t reaches at time step t+1 (forward), or t-1 (backward).
+ *	Positions inbetween grid nodes are mapped by bi-linear interpolation of the displacements.
+ */
+class CFlowMap2D : public CDataField2D
+{
+protected:
+	CVector2D	*m_pDisplacement;	/**< Displacement of the particle seeded at each grid node, in domain units. */
+	bool		*m_pValid;			/**< Flags, that indicate if the particle seeded at a grid node stayed inside the domain. */
+	int			 m_nFrame;			/**< Time step, at which the particles are seeded. */
+	bool		 m_bForward;		/**< If true, this flow map covers [m_nFrame, m_nFrame+1], otherwise [m_nFrame-1, m_nFrame]. */
+
+public:
+	/**
+	 *	Construct a new, uninitialized CFlowMap2D.
+	 *
+	 *	@param rcDomain	Rectangular domain, covered by the grid of seed points.
+	 *	@param nSamplesX Number of grid nodes in X-direction.
+	 *	@param nSamplesY Number of grid nodes in Y-direction.
+	 *	@param nFrame Time step, at which the particles are seeded.
+	 *	@param bForward Direction in time.
+	 */
+	CFlowMap2D(const CRectF &rcDomain, int nSamplesX, int nSamplesY, int nFrame, bool bForward);
+	~CFlowMap2D(void);
+
+public:
+	/**
+	 *	Computes the flow map by advecting a particle from each grid node over one frame interval.
+	 *	The grid is split into tiles, which are processed in parallel.
+	 *
+	 *	@param pVecField Pointer to the underlying vector field.
+	 *	@param stepLen Maximum step length of the RK4 integrator in grid space.
+	 */
+	void Compute(const CAmiraVectorField2D *pVecField, float stepLen);
+
+	/**
+	 *	Maps a position to its location after one frame interval.
+	 *
+	 *	@param ptFrom Position in domain space.
+	 *	@param ptTo Reference to a CPointf, that receives the mapped position.
+	 *	@param pError Optional pointer to a float, that receives an estimate of the interpolation error in domain units.
+	 *
+	 *	@return Returns false, if ptFrom lies outside the domain, or if a particle of the surrounding grid nodes left the domain.
+	 *			In the latter case, ptTo still receives an approximate position.
+	 *
+	 *	@remarks	The error estimate is the deviation of the four surrounding displacements from an affine map.
+	 *				It is small where the flow is well resolved by the flow map grid, and grows with the deformation inside a cell.
+	 */
+	bool Map(const CPointf &ptFrom, CPointf &ptTo, float *pError = nullptr) const;
+
+	/**
+	 *	Retrieve the time step, at which the particles of this CFlowMap2D are seeded.
+	 */
+	__inline int GetFrame() const { return m_nFrame; }
+
+	/**
+	 *	Retrieve the direction in time of this CFlowMap2D.
+	 */
+	__inline bool IsForward() const { return m_bForward; }
+
+	/**
+	 *	Retrieve the number of bytes occupied by the data of this CFlowMap2D.
+	 */
+	__inline size_t GetMemSize() const { return m_nSamplesX * m_nSamplesY * (sizeof(CVector2D) + sizeof(bool)); }
+};
+
+
+/**
+ *	CFlowMapCache computes and stores the flow maps between consecutive frames of a CAmiraVectorField2D.
+ *	Particle trajectories spanning several frames are approximated by composing the flow maps of the individual intervals.
+ *	Since consecutive requests (e.g. while playing an animation) share most of their intervals, 
+ *	only the flow maps of the intervals not yet in the cache need to be integrated.
+ *
+ *	Based on the cached flow maps, CFlowMapCache computes finite-time Lyapunov exponent (FTLE) fields.
+ */
+class CFlowMapCache
+{
+protected:
+	const CAmiraVectorField2D	*m_pVecField;		/**< The vector field, the flow maps are computed for. */
+	CRectF						 m_rcDomain;		/**< Domain covered by the flow map grids. */
+	int							 m_nSamplesX;		/**< Number of flow map grid nodes in X-direction. */
+	int							 m_nSamplesY;		/**< Number of flow map grid nodes in Y-direction. */
+	float						 m_fStepLen;		/**< Maximum RK4 step length in grid space. */
+	size_t						 m_nMaxMaps;		/**< Maximum number of flow maps kept in memory. */
+	size_t						 m_nNumMaps;		/**< Current number of flow maps in memory. */
+	vector<CFlowMap2D*>			 m_ForwardMaps;		/**< Forward flow maps, indexed by their start frame. */
+	vector<CFlowMap2D*>			 m_BackwardMaps;	/**< Backward flow maps, indexed by their start frame. */
+
+public:
+	CFlowMapCache();
+	~CFlowMapCache();
+
+public:
+	/**
+	 *	Initializes the cache for the specified vector field and flow map grid.
+	 *	If any of the parameters differs from the previous call, all cached flow maps are discarded.
+	 *
+	 *	@param pVecField Pointer to the vector field.
+	 *	@param rcDomain Domain, covered by the flow map grid. Typically the domain of pVecField.
+	 *	@param nSamplesX Number of grid nodes in X-direction.
+	 *	@param nSamplesY Number of grid nodes in Y-direction.
+	 *	@param fStepLen Maximum RK4 step length in grid space.
+	 */
+	void Init(const CAmiraVectorField2D *pVecField, const CRectF &rcDomain, int nSamplesX, int nSamplesY, float fStepLen);
+
+	/**
+	 *	Discards all cached flow maps.
+	 */
+	void Clear();
+
+	/**
+	 *	Set the maximum number of flow maps kept in memory.
+	 *	If the cache is full, the flow maps farthest away from the requested frame are discarded first.
+	 *
+	 *	@param nMaxMaps The maximum number of flow maps.
+	 */
+	void SetMaxSize(size_t nMaxMaps);
+
+	/**
+	 *	Retrieves the flow map of a single frame interval. If the flow map is not cached, it is computed.
+	 *
+	 *	@param nFrame Start frame of the interval.
+	 *	@param bForward If true, the interval [nFrame, nFrame+1] is returned, otherwise [nFrame-1, nFrame].
+	 *
+	 *	@return A pointer to the CFlowMap2D, or nullptr if the interval lies outside the time span of the vector field.
+	 *
+	 *	@remarks The returned pointer is owned by the cache and becomes invalid with the next call to any non-const function of the cache.
+	 */
+	const CFlowMap2D* GetFlowMap(int nFrame, bool bForward);
+
+	/**
+	 *	Computes the finite-time Lyapunov exponent (FTLE) field on the flow map grid.
+	 *
+	 *	@param nStartFrame Start time step.
+	 *	@param nNumFrames Integration time in time steps. A negative value requests a backward FTLE field.
+	 *
+	 *	@return A pointer to a new CScalarField2D, containing the FTLE values, or nullptr if the cache was not initialized.
+	 *
+	 *	@remarks	The returned scalar field has to be deleted by the user if not needed anymore.
+	 *				The integration time is clamped to the time span of the vector field.
+	 *				If necessary, the maximum size of the cache is increased to hold all flow maps of the integration time.
+	 */
+	CScalarField2D* GetFTLEField(int nStartFrame, int nNumFrames);
+
+	/**
+	 *	Advects a single particle from one point in time to another by composing the cached flow maps.
+	 *	Fractions of frame intervals at the beginning and the end are integrated exactly.
+	 *
+	 *	@param pos Starting position in domain space. Receives the end position.
+	 *	@param fTimeFrom Start time, measured in time steps.
+	 *	@param fTimeTo End time, measured in time steps. If fTimeTo < fTimeFrom, the particle is advected backward in time.
+	 *	@param fMaxError Maximum tolerated error estimate per frame interval in domain units. 
+	 *			Intervals with a larger error estimate are integrated exactly. If zero, no flow maps are used at all.
+	 *
+	 *	@return Returns false, if the particle left the domain before fTimeTo. In this case, pos receives the last valid position.
+	 */
+	bool AdvectParticle(CPointf &pos, float fTimeFrom, float fTimeTo, float fMaxError);
+
+	/**
+	 *	Approximates a path line by composing the cached flow maps.
+	 *	The positions at the frame boundaries are obtained from AdvectParticle(), the vertices inbetween by cubic Hermite interpolation.
+	 *
+	 *	@param ptOrigin Starting position of integration in domain space.
+	 *	@param fStartTime Start time, measured in time steps.
+	 *	@param nNumSteps Maximum number of vertices of the resulting path line.
+	 *	@param stepLen Step length in grid space, that determines the temporal distance between two vertices.
+	 *	@param bForward If true, forward integration is performed, otherwise backward integration.
+	 *	@param fMaxError Maximum tolerated error estimate per frame interval in domain units, see AdvectParticle().
+	 *	@param pOutBuff Pointer to a std::vector to hold the vertices of the resulting path line in domain space.
+	 *	@param rcIntegrationDomain Rectangular region in which the integration is performed.
+	 *
+	 *	@return The number of vertices of the path line.
+	 *
+	 *	@remarks	The vertices are spaced in time like the steps of CAmiraVectorField2D::advectParticle(), 
+	 *				hence the result may deviate slightly from CAmiraVectorField2D::integrateRK4() with the same step length.
+	 */
+	int IntegratePathLine(const CPointf &ptOrigin, float fStartTime, int nNumSteps, float stepLen, bool bForward, float fMaxError, vector<CPointf> *pOutBuff, const CRectF &rcIntegrationDomain);
+
+	/**
+	 *	Advects all vertices of a time line by composing the cached flow maps.
+	 *
+	 *	@param pPoints Pointer to a std::vector holding the particles in domain space. Receives the advected particles.
+	 *	@param fStartTime Start time, measured in time steps.
+	 *	@param nNumSteps Number of integration steps.
+	 *	@param stepLen Step length in grid space, that determines, together with nNumSteps, the integration time.
+	 *	@param bForward If true, forward integration is performed, otherwise backward integration.
+	 *	@param fMaxError Maximum tolerated error estimate per frame interval in domain units, see AdvectParticle().
+	 *	@param rcIntegrationDomain Rectangular region in which the integration is performed. Particles leaving it are clamped to its border.
+	 */
+	void AdvectTimeLine(vector<CPointf> *pPoints, float fStartTime, int nNumSteps, float stepLen, bool bForward, float fMaxError, const CRectF &rcIntegrationDomain);
+
+	/**
+	 *	Retrieve the number of grid nodes in X-direction.
+	 */
+	__inline int GetExtentX() const { return m_nSamplesX; }
+
+	/**
+	 *	Retrieve the number of grid nodes in Y-direction.
+	 */
+	__inline int GetExtentY() const { return m_nSamplesY; }
+
+protected:
+	/**
+	 *	Discards cached flow maps, until at most m_nMaxMaps-1 maps remain.
+	 *	Flow maps with a start frame far away from [nKeepMin, nKeepMax] are discarded first.
+	 *
+	 *	@param nKeepMin First frame of the range of frames, that should be kept in the cache.
+	 *	@param nKeepMax Last frame of the range of frames, that should be kept in the cache.
+	 */
+	void _evict(int nKeepMin, int nKeepMax);
+
+	/**
+	 *	Retrieves the flow map of a single frame interval and computes it, if necessary.
+	 *	If the cache is full, flow maps with start frames outside of [nKeepMin, nKeepMax] are discarded first.
+	 *
+	 *	@param nFrame Start frame of the interval.
+	 *	@param bForward Direction in time.
+	 *	@param nKeepMin First frame of the range of frames, that should be kept in the cache.
+	 *	@param nKeepMax Last frame of the range of frames, that should be kept in the cache.
+	 */
+	const CFlowMap2D* _getFlowMap(int nFrame, bool bForward, int nKeepMin, int nKeepMax);
+
+	/**
+	 *	Ensures the cache can hold the flow maps of all intervals between two points in time.
+	 *
+	 *	@param fTimeFrom Start time, measured in time steps.
+	 *	@param fTimeTo End time, measured in time steps.
+	 */
+	void _reserve(float fTimeFrom, float fTimeTo);
+
+	/**
+	 *	Advects a set of particles from one point in time to another. 
+	 *	Whole frame intervals are processed by the cached flow maps, one interval at a time for all particles in parallel.
+	 *
+	 *	@param pPoints Pointer to the particle positions in domain space. Receives the advected positions.
+	 *	@param pValid Pointer to an array of flags. Particles with a flag set to false are not advected. 
+	 *			Receives false for each particle, that left the domain.
+	 *	@param nNumPoints Number of particles.
+	 *	@param fTimeFrom Start time, measured in time steps.
+	 *	@param fTimeTo End time, measured in time steps.
+	 *	@param fMaxError Maximum tolerated error estimate per frame interval in domain units.
+	 */
+	void _advect(CPointf *pPoints, bool *pValid, int nNumPoints, float fTimeFrom, float fTimeTo, float fMaxError);
+
+	/**
+	 *	Advects a single particle over one whole frame interval, either by a flow map or, if its error estimate is too large, exactly.
+	 *
+	 *	@param pos Position in domain space. Receives the advected position.
+	 *	@param pMap The flow map of the interval. May be nullptr.
+	 *	@param nFrame Start frame of the interval.
+	 *	@param bForward Direction in time.
+	 *	@param fMaxError Maximum tolerated error estimate in domain units.
+	 *
+	 *	@return Returns false, if the particle left the domain.
+	 */
+	bool _advectInterval(CPointf &pos, const CFlowMap2D *pMap, int nFrame, bool bForward, float fMaxError) const;
+};
@@ -0,0 +1,152 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#pragma once
+#include <list>
+#include <memory>
+
+using namespace std;
+
+/**
+ *	CFrameLRU keeps the data of recently used frames, keyed by a frame index. If the number of frames exceeds
+ *	a limit, the least recently used one is evicted. The data is held by shared_ptr, so it stays valid for its
+ *	users even after it was evicted.
+ *
+ *	Only a few frames are kept, so frames are looked up by a linear search. CFrameLRU is not thread-safe.
+ */
+template <class T>
+class CFrameLRU
+{
+protected:
+	struct Entry
+	{
+		int				nFrame;	/**< The index of the frame. */
+		shared_ptr<T>	pData;	/**< The data of the frame. */
+	};
+
+	size_t			m_nMaxFrames;	/**< Maximum number of frames. */
+	list<Entry>		m_LRU;			/**< The frames, the most recently used first. */
+	size_t			m_nNumComputed;	/**< Number of frames inserted since the last call to Clear(). */
+
+public:
+	/**
+	 *	@param nMaxFrames Maximum number of frames, at least 1.
+	 */
+	CFrameLRU(size_t nMaxFrames) : m_nMaxFrames(max(nMaxFrames, size_t(1))), m_nNumComputed(0) {}
+
+public:
+	/**
+	 *	Discards all frames.
+	 */
+	void Clear()
+	{
+		m_LRU.clear();
+		m_nNumComputed = 0;
+	}
+
+	/**
+	 *	Set the maximum number of frames, at least 1. Surplus frames are evicted.
+	 */
+	void SetMaxFrames(size_t nMaxFrames)
+	{
+		m_nMaxFrames = max(nMaxFrames, size_t(1));
+
+		while (m_LRU.size() > m_nMaxFrames)
+			m_LRU.pop_back();
+	}
+
+	/**
+	 *	Looks up a frame and marks it as most recently used.
+	 *
+	 *	@return The data of the frame, or nullptr if the frame is not kept.
+	 */
+	shared_ptr<T> Find(int nFrame)
+	{
+		for (auto iter = m_LRU.begin(); iter != m_LRU.end(); ++iter)
+		{
+			if (iter->nFrame == nFrame)
+			{
+				//Move to the front of the LRU list
+				m_LRU.splice(m_LRU.begin(), m_LRU, iter);
+				return m_LRU.front().pData;
+			}
+		}
+
+		return nullptr;
+	}
+
+	/**
+	 *	Makes room for a new frame, by evicting the least recently used frame if the limit is reached.
+	 *
+	 *	@return The data of the evicted frame, if it is not referenced elsewhere, so its memory can be reused. Otherwise nullptr.
+	 */
+	shared_ptr<T> Evict()
+	{
+		shared_ptr<T> pData;
+
+		if (!m_LRU.empty() && m_LRU.size() >= m_nMaxFrames)
+		{
+			if (m_LRU.back().pData.unique())
+				pData = m_LRU.back().pData;
+
+			m_LRU.pop_back();
+		}
+
+		return pData;
+	}
+
+	/**
+	 *	Inserts a newly computed frame as most recently used, and evicts the least recently used frame if the limit is exceeded.
+	 *
+	 *	@return pData.
+	 */
+	shared_ptr<T> Insert(int nFrame, const shared_ptr<T> &pData)
+	{
+		Entry entry;
+		entry.nFrame	= nFrame;
+		entry.pData		= pData;
+
+		m_LRU.push_front(entry);
+		m_nNumComputed++;
+
+		while (m_LRU.size() > m_nMaxFrames)
+			m_LRU.pop_back();
+
+		return pData;
+	}
+
+	/**
+	 *	Retrieve the number of frames.
+	 */
+	__inline size_t GetNumFrames() const { return m_LRU.size(); }
+
+	/**
+	 *	Retrieve the number of frames inserted since the last call to Clear().
+	 */
+	__inline size_t GetNumComputedFrames() const { return m_nNumComputed; }
+};
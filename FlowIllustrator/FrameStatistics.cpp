@@ -0,0 +1,291 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "StdAfx.h"
+#include "FrameStatistics.h"
+#include <algorithm>
+#include <sys/stat.h>
+
+#define FS_FILE_MAGIC		0x54415453	//"STAT"
+#define FS_FILE_VERSION		1
+
+static const float s_fPercentiles[FS_NUM_PERCENTILES] = { 0.01f, 0.05f, 0.5f, 0.95f, 0.99f };
+
+CFrameStatistics::CFrameStatistics()
+{
+	m_pReady = nullptr;
+	Clear();
+}
+
+CFrameStatistics::~CFrameStatistics()
+{
+	Clear();
+}
+
+void CFrameStatistics::Clear()
+{
+	m_nSamplesX		= 0;
+	m_nSamplesY		= 0;
+	m_nTimeSteps	= 0;
+	m_nFileSize		= 0;
+	m_nFileTime		= 0;
+	m_bComplete		= 0;
+
+	if (m_pReady) {
+		delete [] m_pReady;
+		m_pReady = nullptr;
+	}
+
+	m_Frames.clear();
+}
+
+void CFrameStatistics::Reset(const CAmiraVectorField2D *pVecField, const char *strAmiraFile)
+{
+	Clear();
+
+	if (!pVecField || pVecField->GetNumTimeSteps() == 0) return;
+
+	m_nSamplesX = static_cast<int>(pVecField->GetExtentX());
+	m_nSamplesY = static_cast<int>(pVecField->GetExtentY());
+	_getFileStamp(strAmiraFile, m_nFileSize, m_nFileTime);
+
+	const int nTimeSteps = static_cast<int>(pVecField->GetNumTimeSteps());
+
+	m_Frames.resize(nTimeSteps);
+	m_pReady = new LONG[nTimeSteps];
+
+	for (int i = 0; i < nTimeSteps; i++)
+		m_pReady[i] = 0;
+
+	m_nTimeSteps = nTimeSteps;
+}
+
+bool CFrameStatistics::IsValid(const CAmiraVectorField2D *pVecField) const
+{
+	return pVecField && m_nTimeSteps > 0
+		&& m_nSamplesX	== static_cast<int>(pVecField->GetExtentX())
+		&& m_nSamplesY	== static_cast<int>(pVecField->GetExtentY())
+		&& m_nTimeSteps	== static_cast<int>(pVecField->GetNumTimeSteps());
+}
+
+string CFrameStatistics::GetFileName(const char *strAmiraFile)
+{
+	return string(strAmiraFile) + ".stats";
+}
+
+float CFrameStatistics::GetPercentile(int nIdx)
+{
+	return s_fPercentiles[nIdx];
+}
+
+bool CFrameStatistics::_getFileStamp(const char *strFileName, long long &nSize, long long &nTime)
+{
+	struct _stat64 st;
+
+	if (!strFileName || _stat64(strFileName, &st) != 0) {
+		nSize = nTime = 0;
+		return false;
+	}
+
+	nSize = static_cast<long long>(st.st_size);
+	nTime = static_cast<long long>(st.st_mtime);
+
+	return true;
+}
+
+bool CFrameStatistics::Build(const CAmiraVectorField2D *pVecField, volatile LONG *pCancel)
+{
+	if (!IsValid(pVecField)) return false;
+
+	//Each time step is computed by a single thread, which keeps the thread count fixed while the index is in use
+	#pragma omp parallel for schedule(dynamic, 1)
+	for (int i = 0; i < m_nTimeSteps; i++)
+	{
+		if ((pCancel && *pCancel) || m_pReady[i]) continue;
+
+		_computeFrame(pVecField, i, m_Frames[i]);
+		InterlockedExchange(&m_pReady[i], 1);
+	}
+
+	for (int i = 0; i < m_nTimeSteps; i++)
+	{
+		if (!m_pReady[i]) return false;
+	}
+
+	_computeGlobal();
+	InterlockedExchange(&m_bComplete, 1);
+
+	return true;
+}
+
+void CFrameStatistics::_computeFrame(const CAmiraVectorField2D *pVecField, int nFrame, FrameStatistics &stats)
+{
+	CScalarField2D *ppFields[DF_NUM_FIELDS];
+	pVecField->GetDerivedFields(DF_MAGNITUDE | DF_VORTICITY, ppFields, static_cast<float>(nFrame), true);
+
+	const size_t nSize = static_cast<size_t>(pVecField->GetExtentX()) * pVecField->GetExtentY();
+	vector<float> data(nSize);
+
+	//Magnitude and vorticity, at the indices of their DERIVED_FIELD flags
+	for (int k = 0; k < 2; k++)
+	{
+		const float *pData = ppFields[k]->GetData();
+		data.assign(pData, pData + nSize);
+
+		_computeScalar(data, (k == 0)? stats.magnitude : stats.vorticity);
+
+		delete ppFields[k];
+	}
+}
+
+void CFrameStatistics::_computeScalar(vector<float> &data, ScalarStatistics &stats)
+{
+	double dSum(0.0);
+
+	stats.fMin = stats.fMax = data[0];
+
+	for (size_t i = 0; i < data.size(); i++)
+	{
+		stats.fMin = min(stats.fMin, data[i]);
+		stats.fMax = max(stats.fMax, data[i]);
+		dSum += data[i];
+	}
+
+	stats.fMean = static_cast<float>(dSum / data.size());
+
+	//The percentiles are ascending, so each selection only has to partition the range above the previous one
+	vector<float>::iterator iterFirst = data.begin();
+
+	for (int p = 0; p < FS_NUM_PERCENTILES; p++)
+	{
+		vector<float>::iterator iterNth = data.begin() + static_cast<size_t>(s_fPercentiles[p] * (data.size() - 1) + 0.5f);
+
+		nth_element(iterFirst, iterNth, data.end());
+		stats.fPercentiles[p] = *iterNth;
+
+		iterFirst = iterNth;
+	}
+}
+
+void CFrameStatistics::_computeGlobal()
+{
+	m_Global = m_Frames[0];
+
+	double dMeanMag(0.0), dMeanVort(0.0);
+
+	for (int i = 0; i < m_nTimeSteps; i++)
+	{
+		const FrameStatistics &frame = m_Frames[i];
+
+		m_Global.magnitude.fMin = min(m_Global.magnitude.fMin, frame.magnitude.fMin);
+		m_Global.magnitude.fMax = max(m_Global.magnitude.fMax, frame.magnitude.fMax);
+		m_Global.vorticity.fMin = min(m_Global.vorticity.fMin, frame.vorticity.fMin);
+		m_Global.vorticity.fMax = max(m_Global.vorticity.fMax, frame.vorticity.fMax);
+
+		dMeanMag	+= frame.magnitude.fMean;
+		dMeanVort	+= frame.vorticity.fMean;
+
+		for (int p = 0; p < FS_NUM_PERCENTILES; p++)
+		{
+			if (s_fPercentiles[p] < 0.5f) {
+				m_Global.magnitude.fPercentiles[p] = min(m_Global.magnitude.fPercentiles[p], frame.magnitude.fPercentiles[p]);
+				m_Global.vorticity.fPercentiles[p] = min(m_Global.vorticity.fPercentiles[p], frame.vorticity.fPercentiles[p]);
+			} else {
+				m_Global.magnitude.fPercentiles[p] = max(m_Global.magnitude.fPercentiles[p], frame.magnitude.fPercentiles[p]);
+				m_Global.vorticity.fPercentiles[p] = max(m_Global.vorticity.fPercentiles[p], frame.vorticity.fPercentiles[p]);
+			}
+		}
+	}
+
+	//All time steps have the same number of samples
+	m_Global.magnitude.fMean = static_cast<float>(dMeanMag / m_nTimeSteps);
+	m_Global.vorticity.fMean = static_cast<float>(dMeanVort / m_nTimeSteps);
+}
+
+bool CFrameStatistics::Save(const char *strFileName) const
+{
+	if (!m_bComplete) return false;
+
+	FILE *pFile(nullptr);
+	fopen_s(&pFile, strFileName, "wb");
+	if (!pFile) return false;
+
+	const int header[6] = { FS_FILE_MAGIC, FS_FILE_VERSION, m_nSamplesX, m_nSamplesY, m_nTimeSteps, static_cast<int>(sizeof(FrameStatistics)) };
+	const long long stamp[2] = { m_nFileSize, m_nFileTime };
+
+	bool bResult =	fwrite(header, sizeof(int), 6, pFile) == 6 
+				 && fwrite(stamp, sizeof(long long), 2, pFile) == 2
+				 && fwrite(&m_Frames[0], sizeof(FrameStatistics), m_nTimeSteps, pFile) == static_cast<size_t>(m_nTimeSteps);
+
+	fclose(pFile);
+
+	return bResult;
+}
+
+bool CFrameStatistics::Load(const char *strFileName, const CAmiraVectorField2D *pVecField, const char *strAmiraFile)
+{
+	Reset(pVecField, strAmiraFile);
+
+	if (m_nTimeSteps == 0) return false;
+
+	FILE *pFile(nullptr);
+	fopen_s(&pFile, strFileName, "rb");
+	if (!pFile) {
+		Clear();
+		return false;
+	}
+
+	int header[6];
+	long long stamp[2];
+
+	bool bResult =	fread(header, sizeof(int), 6, pFile) == 6
+				 && fread(stamp, sizeof(long long), 2, pFile) == 2
+				 && header[0] == FS_FILE_MAGIC
+				 && header[1] == FS_FILE_VERSION
+				 && header[2] == m_nSamplesX
+				 && header[3] == m_nSamplesY
+				 && header[4] == m_nTimeSteps
+				 && header[5] == static_cast<int>(sizeof(FrameStatistics))
+				 && stamp[0] == m_nFileSize && stamp[1] == m_nFileTime
+				 && fread(&m_Frames[0], sizeof(FrameStatistics), m_nTimeSteps, pFile) == static_cast<size_t>(m_nTimeSteps);
+
+	fclose(pFile);
+
+	if (!bResult) {
+		Clear();
+		return false;
+	}
+
+	for (int i = 0; i < m_nTimeSteps; i++)
+		m_pReady[i] = 1;
+
+	_computeGlobal();
+	m_bComplete = 1;
+
+	return true;
+}
@@ -0,0 +1,193 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+#include "AmiraVectorField2D.h"
+#include <vector>
+#include <string>
+
+using namespace std;
+
+#define FS_NUM_PERCENTILES	5	/**< Number of percentiles in ScalarStatistics, see CFrameStatistics::GetPercentile(). */
+
+/**
+ *	Distribution of a scalar quantity over the samples of a time step.
+ */
+struct ScalarStatistics
+{
+	float fMin;								/**< Minimum value. */
+	float fMax;								/**< Maximum value. */
+	float fMean;							/**< Mean value. */
+	float fPercentiles[FS_NUM_PERCENTILES];	/**< Values below which 1%, 5%, 50%, 95% and 99% of the samples fall. */
+};
+
+/**
+ *	Statistics of a single time step.
+ */
+struct FrameStatistics
+{
+	ScalarStatistics magnitude;		/**< Vector magnitude in the lab frame, see CAmiraVectorField2D::GetReferenceFrame(). */
+	ScalarStatistics vorticity;		/**< Signed vorticity, in the units of CAmiraVectorField2D::GetVorticityField(). */
+};
+
+/**
+ *	CFrameStatistics is an index of the value ranges of every time step of a vector field.
+ *
+ *	Looking up a time step is constant in time, so the range of a frame is known without computing its magnitude or 
+ *	vorticity field. The global statistics cover all time steps, such that colour maps can remain fixed during an animation.
+ *
+ *	Build() may run in a worker thread, while the index is in use. Each time step becomes available as soon as it is 
+ *	computed, the global statistics once all time steps are complete. The index is stored in a sidecar file next to the 
+ *	vector field, see GetFileName().
+ */
+class CFrameStatistics
+{
+protected:
+	int						m_nSamplesX;	/**< Number of samples in x-direction of the vector field. */
+	int						m_nSamplesY;	/**< Number of samples in y-direction of the vector field. */
+	int						m_nTimeSteps;	/**< Number of time steps of the vector field. Zero, if the index is empty. */
+	long long				m_nFileSize;	/**< Size of the vector field file, used to detect outdated sidecar files. */
+	long long				m_nFileTime;	/**< Modification time of the vector field file, used to detect outdated sidecar files. */
+	vector<FrameStatistics>	m_Frames;		/**< The statistics of each time step. */
+	FrameStatistics			m_Global;		/**< The statistics over all time steps. */
+	volatile LONG		   *m_pReady;		/**< Non-zero for each time step, whose entry in m_Frames is complete. */
+	volatile LONG			m_bComplete;	/**< Non-zero, if all time steps and m_Global are complete. */
+
+public:
+	CFrameStatistics();
+	~CFrameStatistics();
+
+public:
+	/**
+	 *	Discards the index. Must not be called while Build() is running.
+	 */
+	void Clear();
+
+	/**
+	 *	Prepares an empty index for a vector field. Has to be called before Build() is started.
+	 *
+	 *	@param pVecField Pointer to the vector field.
+	 *	@param strAmiraFile Name of the file, the vector field was loaded from. Used to detect outdated sidecar files.
+	 */
+	void Reset(const CAmiraVectorField2D *pVecField, const char *strAmiraFile);
+
+	/**
+	 *	Computes the statistics of all time steps in parallel.
+	 *
+	 *	@param pVecField Pointer to the vector field, that was passed to Reset().
+	 *	@param pCancel If not nullptr, the computation stops as soon as *pCancel becomes non-zero.
+	 *
+	 *	@return Returns true, if all time steps were completed.
+	 */
+	bool Build(const CAmiraVectorField2D *pVecField, volatile LONG *pCancel = nullptr);
+
+	/**
+	 *	Loads the index from a sidecar file.
+	 *
+	 *	@param strFileName Name of the sidecar file.
+	 *	@param pVecField The vector field, the index has to belong to.
+	 *	@param strAmiraFile Name of the file, the vector field was loaded from.
+	 *
+	 *	@return Returns false, if the file could not be read, or if it belongs to another or a modified vector field.
+	 */
+	bool Load(const char *strFileName, const CAmiraVectorField2D *pVecField, const char *strAmiraFile);
+
+	/**
+	 *	Saves a complete index to a sidecar file.
+	 *
+	 *	@param strFileName Name of the sidecar file.
+	 *
+	 *	@return Returns false, if the index is incomplete or the file could not be written.
+	 */
+	bool Save(const char *strFileName) const;
+
+	/**
+	 *	Retrieve the name of the sidecar file, that belongs to a vector field file.
+	 *
+	 *	@param strAmiraFile Name of the vector field file.
+	 */
+	static string GetFileName(const char *strAmiraFile);
+
+	/**
+	 *	Retrieve the fraction of the samples, that fall below a percentile of ScalarStatistics.
+	 *
+	 *	@param nIdx Index into ScalarStatistics::fPercentiles.
+	 */
+	static float GetPercentile(int nIdx);
+
+	/**
+	 *	Checks, if the index belongs to the specified vector field.
+	 */
+	bool IsValid(const CAmiraVectorField2D *pVecField) const;
+
+	/**
+	 *	Checks, if all time steps have been computed.
+	 */
+	__inline bool IsComplete() const { return m_bComplete != 0; }
+
+	/**
+	 *	Retrieve the statistics of a time step.
+	 *
+	 *	@param nFrame The time step.
+	 *
+	 *	@return A pointer to the statistics, or nullptr if the time step has not been computed yet.
+	 */
+	__inline const FrameStatistics* GetFrame(int nFrame) const { 
+		return (nFrame >= 0 && nFrame < m_nTimeSteps && m_pReady[nFrame])? &m_Frames[nFrame] : nullptr; 
+	}
+
+	/**
+	 *	Retrieve the statistics over all time steps.
+	 *
+	 *	@return A pointer to the statistics, or nullptr if the index is incomplete.
+	 *
+	 *	@remarks Minimum, maximum and mean are exact. The percentiles are the extreme percentiles of all time steps, i.e.
+	 *			 the smallest value for percentiles below the median, and the largest value otherwise.
+	 */
+	__inline const FrameStatistics* GetGlobal() const { return m_bComplete? &m_Global : nullptr; }
+
+protected:
+	/**
+	 *	Computes the statistics of a single time step.
+	 */
+	static void _computeFrame(const CAmiraVectorField2D *pVecField, int nFrame, FrameStatistics &stats);
+
+	/**
+	 *	Computes the statistics of a scalar field. The data is reordered.
+	 */
+	static void _computeScalar(vector<float> &data, ScalarStatistics &stats);
+
+	/**
+	 *	Combines the statistics of all time steps to m_Global.
+	 */
+	void _computeGlobal();
+
+	/**
+	 *	Retrieves size and modification time of a file.
+	 */
+	static bool _getFileStamp(const char *strFileName, long long &nSize, long long &nTime);
+};
@@ -0,0 +1,346 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "StdAfx.h"
+#include "GaussianFilter.h"
+#include <math.h>
+#include <xmmintrin.h>
+
+#define GF_RECURSIVE_SIGMA	3.0f	//Above this standard deviation, the recursive filter is used
+#define GF_MAX_SIGMAS		4.0f	//Kernels and padding end at this multiple of the standard deviation
+#define GF_STRIP_WIDTH		64		//Number of neighbouring columns, that are filtered together
+
+namespace FICore
+{
+	//Computes pOut[i] = fB*pIn[i] + fB1*p1[i] + fB2*p2[i] + fB3*p3[i]. pOut may be pIn.
+	static void _recursiveStep(float *pOut, const float *pIn, const float *p1, const float *p2, const float *p3, int nCount, 
+							   float fB, float fB1, float fB2, float fB3)
+	{
+		const __m128 b  = _mm_set1_ps(fB);
+		const __m128 b1 = _mm_set1_ps(fB1);
+		const __m128 b2 = _mm_set1_ps(fB2);
+		const __m128 b3 = _mm_set1_ps(fB3);
+
+		int i = 0;
+
+		for (; i + 4 <= nCount; i += 4)
+		{
+			__m128 sum = _mm_mul_ps(b, _mm_loadu_ps(pIn + i));
+			sum = _mm_add_ps(sum, _mm_mul_ps(b1, _mm_loadu_ps(p1 + i)));
+			sum = _mm_add_ps(sum, _mm_mul_ps(b2, _mm_loadu_ps(p2 + i)));
+			sum = _mm_add_ps(sum, _mm_mul_ps(b3, _mm_loadu_ps(p3 + i)));
+			_mm_storeu_ps(pOut + i, sum);
+		}
+
+		for (; i < nCount; i++)
+			pOut[i] = fB*pIn[i] + fB1*p1[i] + fB2*p2[i] + fB3*p3[i];
+	}
+
+	CGaussianFilter::CGaussianFilter(float fSigma, int nKernelHalfSize)
+	{
+		m_fSigma		= max(fSigma, 0.5f);
+		m_bRecursive	= m_fSigma > GF_RECURSIVE_SIGMA;
+
+		const int nMaxHalfSize = static_cast<int>(ceil(GF_MAX_SIGMAS * m_fSigma));
+
+		if (m_bRecursive) {
+			m_nHalfSize = nMaxHalfSize;
+		} else if (nKernelHalfSize < 0) {
+			m_nHalfSize = static_cast<int>(ceil(3.0f * m_fSigma));
+		} else {
+			m_nHalfSize = min(nKernelHalfSize, nMaxHalfSize);
+		}
+
+		m_fB = m_fB1 = m_fB2 = m_fB3 = 0.0f;
+
+		if (m_bRecursive)
+		{
+			//Young and van Vliet, Recursive implementation of the Gaussian filter, 1995
+			const double q	= 0.98711 * m_fSigma - 0.96330;
+			const double b0	= 1.57825 + 2.44413*q + 1.4281*q*q + 0.422205*q*q*q;
+			const double b1	= 2.44413*q + 2.85619*q*q + 1.26661*q*q*q;
+			const double b2	= -(1.4281*q*q + 1.26661*q*q*q);
+			const double b3	= 0.422205*q*q*q;
+
+			m_fB1	= static_cast<float>(b1 / b0);
+			m_fB2	= static_cast<float>(b2 / b0);
+			m_fB3	= static_cast<float>(b3 / b0);
+			m_fB	= 1.0f - (m_fB1 + m_fB2 + m_fB3);
+		}
+		else
+		{
+			m_Kernel.resize(2 * m_nHalfSize + 1);
+
+			float sum(0.0f);
+
+			for (int k = -m_nHalfSize; k <= m_nHalfSize; k++)
+			{
+				m_Kernel[k + m_nHalfSize] = exp(-static_cast<float>(k*k) / (2.0f * m_fSigma * m_fSigma));
+				sum += m_Kernel[k + m_nHalfSize];
+			}
+
+			for (size_t k = 0; k < m_Kernel.size(); k++)
+				m_Kernel[k] /= sum;
+		}
+	}
+
+	void CGaussianFilter::Apply(float *pData, int nWidth, int nHeight) const
+	{
+		if (!pData || nWidth <= 0 || nHeight <= 0) return;
+
+		if (m_bRecursive)
+		{
+			_recursiveRows(pData, nWidth, nHeight);
+			_recursiveColumns(pData, nWidth, nHeight);
+		}
+		else
+		{
+			_convolveRows(pData, nWidth, nHeight);
+			_convolveColumns(pData, nWidth, nHeight);
+		}
+	}
+
+	void CGaussianFilter::_convolveRows(float *pData, int nWidth, int nHeight) const
+	{
+		const int nKernelSize	= 2 * m_nHalfSize + 1;
+		const float *pKernel	= &m_Kernel[0];
+
+		#pragma omp parallel
+		{
+			//The padding stays zero, only the samples in between are replaced for each row
+			vector<float> line(nWidth + 2 * m_nHalfSize, 0.0f);
+			float *pLine = &line[0];
+
+			#pragma omp for
+			for (int j = 0; j < nHeight; j++)
+			{
+				float *pRow = pData + static_cast<size_t>(j) * nWidth;
+
+				memcpy(pLine + m_nHalfSize, pRow, nWidth * sizeof(float));
+
+				int i = 0;
+
+				for (; i + 4 <= nWidth; i += 4)
+				{
+					__m128 sum = _mm_setzero_ps();
+
+					for (int k = 0; k < nKernelSize; k++)
+						sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(pKernel[k]), _mm_loadu_ps(pLine + i + k)));
+
+					_mm_storeu_ps(pRow + i, sum);
+				}
+
+				for (; i < nWidth; i++)
+				{
+					float sum(0.0f);
+
+					for (int k = 0; k < nKernelSize; k++)
+						sum += pKernel[k] * pLine[i + k];
+
+					pRow[i] = sum;
+				}
+			}
+		}
+	}
+
+	void CGaussianFilter::_convolveColumns(float *pData, int nWidth, int nHeight) const
+	{
+		const int nKernelSize	= 2 * m_nHalfSize + 1;
+		const float *pKernel	= &m_Kernel[0];
+		const int nNumStrips	= (nWidth + GF_STRIP_WIDTH - 1) / GF_STRIP_WIDTH;
+
+		#pragma omp parallel
+		{
+			//Copy of a strip, with m_nHalfSize black rows above and below
+			vector<float> strip((nHeight + 2 * m_nHalfSize) * GF_STRIP_WIDTH, 0.0f);
+			float *pStrip = &strip[0];
+
+			#pragma omp for schedule(dynamic, 1)
+			for (int s = 0; s < nNumStrips; s++)
+			{
+				const int nStart	= s * GF_STRIP_WIDTH;
+				const int nCount	= min(GF_STRIP_WIDTH, nWidth - nStart);
+
+				for (int j = 0; j < nHeight; j++)
+					memcpy(pStrip + (j + m_nHalfSize) * GF_STRIP_WIDTH, pData + static_cast<size_t>(j) * nWidth + nStart, nCount * sizeof(float));
+
+				for (int j = 0; j < nHeight; j++)
+				{
+					float *pOut = pData + static_cast<size_t>(j) * nWidth + nStart;
+					int i = 0;
+
+					for (; i + 4 <= nCount; i += 4)
+					{
+						__m128 sum = _mm_setzero_ps();
+
+						for (int k = 0; k < nKernelSize; k++)
+							sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(pKernel[k]), _mm_loadu_ps(pStrip + (j + k) * GF_STRIP_WIDTH + i)));
+
+						_mm_storeu_ps(pOut + i, sum);
+					}
+
+					for (; i < nCount; i++)
+					{
+						float sum(0.0f);
+
+						for (int k = 0; k < nKernelSize; k++)
+							sum += pKernel[k] * pStrip[(j + k) * GF_STRIP_WIDTH + i];
+
+						pOut[i] = sum;
+					}
+				}
+			}
+		}
+	}
+
+	void CGaussianFilter::_recursiveLine(float *pLine, int nLen) const
+	{
+		const __m128 b  = _mm_set1_ps(m_fB);
+		const __m128 b1 = _mm_set1_ps(m_fB1);
+		const __m128 b2 = _mm_set1_ps(m_fB2);
+		const __m128 b3 = _mm_set1_ps(m_fB3);
+
+		//Causal pass, black before the first sample
+		__m128 w1 = _mm_setzero_ps(), w2 = _mm_setzero_ps(), w3 = _mm_setzero_ps();
+
+		for (int n = 0; n < nLen; n++)
+		{
+			__m128 w = _mm_mul_ps(b, _mm_loadu_ps(pLine + 4*n));
+			w = _mm_add_ps(w, _mm_add_ps(_mm_mul_ps(b1, w1), _mm_add_ps(_mm_mul_ps(b2, w2), _mm_mul_ps(b3, w3))));
+			_mm_storeu_ps(pLine + 4*n, w);
+
+			w3 = w2; w2 = w1; w1 = w;
+		}
+
+		//Anti-causal pass, starting at the end of the padding, where the causal response has decayed
+		w1 = w2 = w3 = _mm_setzero_ps();
+
+		for (int n = nLen - 1; n >= 0; n--)
+		{
+			__m128 w = _mm_mul_ps(b, _mm_loadu_ps(pLine + 4*n));
+			w = _mm_add_ps(w, _mm_add_ps(_mm_mul_ps(b1, w1), _mm_add_ps(_mm_mul_ps(b2, w2), _mm_mul_ps(b3, w3))));
+			_mm_storeu_ps(pLine + 4*n, w);
+
+			w3 = w2; w2 = w1; w1 = w;
+		}
+	}
+
+	void CGaussianFilter::_recursiveRows(float *pData, int nWidth, int nHeight) const
+	{
+		const int nLen		= nWidth + m_nHalfSize;
+		const int nNumQuads	= (nHeight + 3) / 4;
+
+		#pragma omp parallel
+		{
+			//Four rows, interleaved sample by sample, followed by the black padding
+			vector<float> line(4 * nLen);
+			float *pLine = &line[0];
+
+			#pragma omp for
+			for (int q = 0; q < nNumQuads; q++)
+			{
+				const int nRows = min(4, nHeight - 4*q);
+
+				memset(pLine, 0, line.size() * sizeof(float));
+
+				for (int r = 0; r < nRows; r++)
+				{
+					const float *pRow = pData + static_cast<size_t>(4*q + r) * nWidth;
+
+					for (int i = 0; i < nWidth; i++)
+						pLine[4*i + r] = pRow[i];
+				}
+
+				_recursiveLine(pLine, nLen);
+
+				for (int r = 0; r < nRows; r++)
+				{
+					float *pRow = pData + static_cast<size_t>(4*q + r) * nWidth;
+
+					for (int i = 0; i < nWidth; i++)
+						pRow[i] = pLine[4*i + r];
+				}
+			}
+		}
+	}
+
+	void CGaussianFilter::_recursiveColumns(float *pData, int nWidth, int nHeight) const
+	{
+		const int nNumStrips = (nWidth + GF_STRIP_WIDTH - 1) / GF_STRIP_WIDTH;
+
+		#pragma omp parallel
+		{
+			//Rows of the black padding below the grid, preceded by three black rows for the causal pass
+			vector<float> tail((m_nHalfSize + 3) * GF_STRIP_WIDTH);
+			float *pBlack = &tail[0];
+			float *pTail  = pBlack + 3 * GF_STRIP_WIDTH;
+
+			#pragma omp for schedule(dynamic, 1)
+			for (int s = 0; s < nNumStrips; s++)
+			{
+				const int nStart	= s * GF_STRIP_WIDTH;
+				const int nCount	= min(GF_STRIP_WIDTH, nWidth - nStart);
+				const int nLen		= nHeight + m_nHalfSize;
+
+				memset(pBlack, 0, tail.size() * sizeof(float));
+
+				float *pRows[4];	//The current row and the three before it
+
+				//Causal pass, in place
+				for (int n = 0; n < nLen; n++)
+				{
+					for (int r = 0; r < 3; r++)
+					{
+						const int m = n - 3 + r;
+						pRows[r] = (m < 0)? pBlack : (m < nHeight)? pData + static_cast<size_t>(m) * nWidth + nStart : pTail + (m - nHeight) * GF_STRIP_WIDTH;
+					}
+
+					pRows[3] = (n < nHeight)? pData + static_cast<size_t>(n) * nWidth + nStart : pTail + (n - nHeight) * GF_STRIP_WIDTH;
+
+					_recursiveStep(pRows[3], pRows[3], pRows[2], pRows[1], pRows[0], nCount, m_fB, m_fB1, m_fB2, m_fB3);
+				}
+
+				//Anti-causal pass, in place. The rows after the padding are black.
+				memset(pBlack, 0, 3 * GF_STRIP_WIDTH * sizeof(float));
+
+				for (int n = nLen - 1; n >= 0; n--)
+				{
+					for (int r = 0; r < 3; r++)
+					{
+						const int m = n + 3 - r;
+						pRows[r] = (m >= nLen)? pBlack : (m < nHeight)? pData + static_cast<size_t>(m) * nWidth + nStart : pTail + (m - nHeight) * GF_STRIP_WIDTH;
+					}
+
+					pRows[3] = (n < nHeight)? pData + static_cast<size_t>(n) * nWidth + nStart : pTail + (n - nHeight) * GF_STRIP_WIDTH;
+
+					_recursiveStep(pRows[3], pRows[3], pRows[2], pRows[1], pRows[0], nCount, m_fB, m_fB1, m_fB2, m_fB3);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,93 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+#include <vector>
+
+using namespace std;
+
+namespace FICore
+{
+	/**
+	 *	CGaussianFilter smoothes a row-major grid of floats in place with a separable Gaussian, outside of which the grid is black.
+	 *
+	 *	Up to a standard deviation of GF_RECURSIVE_SIGMA, the grid is convolved with a truncated, normalized kernel. Above, 
+	 *	the filter switches to the third order recursive approximation of Young and van Vliet, whose costs do not depend on 
+	 *	the width of the kernel. Rows and columns are both filtered in parallel, four samples at a time with SSE, and without 
+	 *	transposing the grid: columns are processed in strips of neighbouring columns, rows in groups of four, that are 
+	 *	interleaved into a zero-padded line buffer.
+	 */
+	class CGaussianFilter
+	{
+	protected:
+		float			m_fSigma;		/**< Standard deviation of the Gaussian in samples. */
+		int				m_nHalfSize;	/**< Kernel half size, or length of the zero padding of the recursive filter. */
+		bool			m_bRecursive;	/**< If true, the recursive filter is used. */
+		vector<float>	m_Kernel;		/**< The normalized kernel of size 2*m_nHalfSize+1, if m_bRecursive is false. */
+		float			m_fB;			/**< Input weight of the recursive filter. */
+		float			m_fB1;			/**< Weight of the previous output of the recursive filter. */
+		float			m_fB2;			/**< Weight of the second to last output of the recursive filter. */
+		float			m_fB3;			/**< Weight of the third to last output of the recursive filter. */
+
+	public:
+		/**
+		 *	Creates a filter.
+		 *
+		 *	@param fSigma Standard deviation of the Gaussian in samples.
+		 *	@param nKernelHalfSize The half size of the kernel. If it is negative, the kernel is truncated at three standard deviations.
+		 *
+		 *	@remarks	Weights beyond four standard deviations are below 1/2980 of the center weight, and are always dropped.
+		 */
+		CGaussianFilter(float fSigma, int nKernelHalfSize = -1);
+
+	public:
+		/**
+		 *	Smoothes a grid.
+		 *
+		 *	@param pData Pointer to the samples, which are overwritten by the result.
+		 *	@param nWidth Number of samples per row.
+		 *	@param nHeight Number of rows.
+		 */
+		void Apply(float *pData, int nWidth, int nHeight) const;
+
+		/**
+		 *	Checks, if the recursive approximation is used.
+		 */
+		__inline bool IsRecursive() const { return m_bRecursive; }
+
+	protected:
+		void _convolveRows(float *pData, int nWidth, int nHeight) const;
+		void _convolveColumns(float *pData, int nWidth, int nHeight) const;
+		void _recursiveRows(float *pData, int nWidth, int nHeight) const;
+		void _recursiveColumns(float *pData, int nWidth, int nHeight) const;
+
+		/**
+		 *	Runs the recursive filter forward and backward over nLen interleaved groups of four samples.
+		 */
+		void _recursiveLine(float *pLine, int nLen) const;
+	};
+}
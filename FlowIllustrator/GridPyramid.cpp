@@ -0,0 +1,268 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "StdAfx.h"
+#include "GridPyramid.h"
+#include <algorithm>
+
+//Weights of the binomial kernel (1 4 6 4 1) / 16, from the outer taps to the center
+#define GP_WEIGHT_OUTER		0.0625f
+#define GP_WEIGHT_INNER		0.25f
+#define GP_WEIGHT_CENTER	0.375f
+
+namespace FICore
+{
+	static const float s_pBinomialWeights[5] = { GP_WEIGHT_OUTER, GP_WEIGHT_INNER, GP_WEIGHT_CENTER, GP_WEIGHT_INNER, GP_WEIGHT_OUTER };
+
+	//Weighted mean of the live values, or NaN if all of them are dead. Only called, if the plain weighted sum is not finite.
+	static float _getLiveMean(const float *pValues, const float *pWeights, int nNumValues)
+	{
+		float fSum(0.0f), fWeight(0.0f);
+
+		for (int k = 0; k < nNumValues; k++)
+		{
+			if (isFiniteNumber(pValues[k])) {
+				fSum	+= pWeights[k] * pValues[k];
+				fWeight	+= pWeights[k];
+			}
+		}
+
+		return (fWeight > 0.0f)? fSum / fWeight : numeric_limits<float>::quiet_NaN();
+	}
+
+	CGridPyramid::CGridPyramid()
+	{
+		m_pBase			= nullptr;
+		m_nComponents	= 0;
+		m_nNumBuilt		= 0;
+	}
+
+	void CGridPyramid::Init(const float *pData, int nWidth, int nHeight, int nComponents)
+	{
+		if (!pData || nWidth < 2 || nHeight < 2 || nComponents < 1) {
+			Clear();
+			return;
+		}
+
+		m_pBase			= pData;
+		m_nComponents	= nComponents;
+		m_nNumBuilt		= 1;
+
+		//Levels end, before they would be too small for bi-linear interpolation
+		int nLevels = 1;
+
+		for (int w = nWidth, h = nHeight; nLevels < GP_MAX_LEVELS; nLevels++)
+		{
+			w = (w + 1) / 2;
+			h = (h + 1) / 2;
+
+			if (w < 2 || h < 2) break;
+		}
+
+		m_Levels.resize(nLevels);
+
+		for (int l = 0; l < nLevels; l++)
+		{
+			m_Levels[l].nWidth	= (l == 0)? nWidth : (m_Levels[l-1].nWidth + 1) / 2;
+			m_Levels[l].nHeight	= (l == 0)? nHeight : (m_Levels[l-1].nHeight + 1) / 2;
+		}
+	}
+
+	void CGridPyramid::Clear()
+	{
+		m_pBase			= nullptr;
+		m_nComponents	= 0;
+		m_nNumBuilt		= 0;
+
+		m_Levels.clear();
+	}
+
+	int CGridPyramid::GetLevel(float fFootprint) const
+	{
+		const int nNumLevels = GetNumLevels();
+		int nLevel = 0;
+
+		//The spacing of the samples is closest to the footprint in log scale
+		while (nLevel + 1 < nNumLevels && fFootprint >= 1.41421356f * static_cast<float>(1 << nLevel))
+			nLevel++;
+
+		return nLevel;
+	}
+
+	const float* CGridPyramid::GetData(int nLevel)
+	{
+		if (nLevel <= 0) return m_pBase;
+
+		while (m_nNumBuilt <= nLevel)
+			_reduce(m_nNumBuilt++);
+
+		return &m_Levels[nLevel].data[0];
+	}
+
+	void CGridPyramid::GetAt(float x, float y, float fFootprint, float *pOut)
+	{
+		if (m_Levels.empty()) {
+			for (int c = 0; c < m_nComponents; c++) pOut[c] = 0.0f;
+			return;
+		}
+
+		const int nLevel	= GetLevel(fFootprint);
+		const float *pData	= GetData(nLevel);
+		const Level &level	= m_Levels[nLevel];
+
+		//To the samples of the level
+		const float fScale = 1.0f / static_cast<float>(1 << nLevel);
+
+		x = min(max(x * fScale, 0.0f), static_cast<float>(level.nWidth - 1));
+		y = min(max(y * fScale, 0.0f), static_cast<float>(level.nHeight - 1));
+
+		const int px	= min(static_cast<int>(x), level.nWidth - 2);
+		const int py	= min(static_cast<int>(y), level.nHeight - 2);
+		const float wx	= x - px;
+		const float wy	= y - py;
+
+		const int nRow	= level.nWidth * m_nComponents;
+		const float *p	= pData + (static_cast<size_t>(py) * level.nWidth + px) * m_nComponents;
+
+		for (int c = 0; c < m_nComponents; c++)
+		{
+			pOut[c] =	(p[c] * (1.0f - wx) + p[c + m_nComponents] * wx) * (1.0f - wy) + 
+						(p[c + nRow] * (1.0f - wx) + p[c + nRow + m_nComponents] * wx) * wy;
+
+			if (!isFiniteNumber(pOut[c])) {
+				const float pCorners[4] = { p[c], p[c + m_nComponents], p[c + nRow], p[c + nRow + m_nComponents] };
+				const float pWeights[4] = { (1.0f - wx) * (1.0f - wy), wx * (1.0f - wy), (1.0f - wx) * wy, wx * wy };
+				pOut[c] = _getLiveMean(pCorners, pWeights, 4);
+			}
+		}
+	}
+
+	void CGridPyramid::_reduce(int nLevel)
+	{
+		const Level &src	= m_Levels[nLevel-1];
+		Level &dst			= m_Levels[nLevel];
+
+		dst.data.resize(static_cast<size_t>(dst.nWidth) * dst.nHeight * m_nComponents);
+
+		Reduce((nLevel == 1)? m_pBase : &src.data[0], src.nWidth, src.nHeight, m_nComponents, &dst.data[0]);
+	}
+
+	void CGridPyramid::Reduce(const float *pSrc, int nWidth, int nHeight, int nComponents, float *pDst)
+	{
+		const int nC			= nComponents;
+		const int nDstWidth		= (nWidth + 1) / 2;
+		const int nDstHeight	= (nHeight + 1) / 2;
+		const int nSrcRow		= nWidth * nC;
+		const int nDstRow		= nDstWidth * nC;
+
+		//Inner samples, whose taps all lie inside the row
+		const int nInnerEnd		= max((nWidth - 1) / 2, 1);
+
+		#pragma omp parallel
+		{
+			//Each kept row is filtered across the rows of the source into a single line, which is then 
+			//filtered along the row at the kept columns. The border samples are repeated.
+			vector<float> line(nSrcRow);
+			float *pLine = &line[0];
+
+			#pragma omp for
+			for (int j = 0; j < nDstHeight; j++)
+			{
+				const float *p0 = pSrc + static_cast<size_t>(max(2*j - 2, 0)) * nSrcRow;
+				const float *p1 = pSrc + static_cast<size_t>(max(2*j - 1, 0)) * nSrcRow;
+				const float *p2 = pSrc + static_cast<size_t>(2*j) * nSrcRow;
+				const float *p3 = pSrc + static_cast<size_t>(min(2*j + 1, nHeight - 1)) * nSrcRow;
+				const float *p4 = pSrc + static_cast<size_t>(min(2*j + 2, nHeight - 1)) * nSrcRow;
+
+				float fLineSum(0.0f);
+
+				for (int i = 0; i < nSrcRow; i++)
+				{
+					pLine[i] = GP_WEIGHT_OUTER * (p0[i] + p4[i]) + GP_WEIGHT_INNER * (p1[i] + p3[i]) + GP_WEIGHT_CENTER * p2[i];
+					fLineSum += pLine[i];
+				}
+
+				//A value with a dead tap is not finite, and neither is the sum of the line then.
+				//Such lines are rare, so their values are recomputed in a second pass.
+				if (!isFiniteNumber(fLineSum))
+				{
+					for (int i = 0; i < nSrcRow; i++)
+					{
+						if (isFiniteNumber(pLine[i])) continue;
+
+						const float pTaps[5] = { p0[i], p1[i], p2[i], p3[i], p4[i] };
+						pLine[i] = _getLiveMean(pTaps, s_pBinomialWeights, 5);
+					}
+				}
+
+				float *pOut = pDst + static_cast<size_t>(j) * nDstRow;
+				float fRowSum(0.0f);
+
+				for (int i = 1; i < nInnerEnd; i++)
+				{
+					const float *p = pLine + (2*i) * nC;
+
+					for (int c = 0; c < nC; c++)
+					{
+						pOut[i * nC + c] = GP_WEIGHT_OUTER * (p[c - 2*nC] + p[c + 2*nC]) + GP_WEIGHT_INNER * (p[c - nC] + p[c + nC]) + GP_WEIGHT_CENTER * p[c];
+						fRowSum += pOut[i * nC + c];
+					}
+				}
+
+				//The first and the last samples
+				for (int i = 0; i < nDstWidth; i = (i == 0 && nInnerEnd < nDstWidth)? nInnerEnd : i + 1)
+				{
+					const float *q0 = pLine + max(2*i - 2, 0) * nC;
+					const float *q1 = pLine + max(2*i - 1, 0) * nC;
+					const float *q2 = pLine + (2*i) * nC;
+					const float *q3 = pLine + min(2*i + 1, nWidth - 1) * nC;
+					const float *q4 = pLine + min(2*i + 2, nWidth - 1) * nC;
+
+					for (int c = 0; c < nC; c++)
+					{
+						pOut[i * nC + c] = GP_WEIGHT_OUTER * (q0[c] + q4[c]) + GP_WEIGHT_INNER * (q1[c] + q3[c]) + GP_WEIGHT_CENTER * q2[c];
+						fRowSum += pOut[i * nC + c];
+					}
+				}
+
+				if (isFiniteNumber(fRowSum)) continue;
+
+				for (int n = 0; n < nDstRow; n++)
+				{
+					if (isFiniteNumber(pOut[n])) continue;
+
+					const int i = n / nC;
+					const int c = n % nC;
+					const float pTaps[5] = {	pLine[max(2*i - 2, 0) * nC + c], pLine[max(2*i - 1, 0) * nC + c], pLine[2*i * nC + c], 
+												pLine[min(2*i + 1, nWidth - 1) * nC + c], pLine[min(2*i + 2, nWidth - 1) * nC + c] };
+
+					pOut[n] = _getLiveMean(pTaps, s_pBinomialWeights, 5);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,138 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+#include "DataField.h"
+#include <vector>
+
+using namespace std;
+
+#define GP_MAX_LEVELS	16		//Upper bound of the number of levels of a CGridPyramid
+
+namespace FICore
+{
+	/**
+	 *	CGridPyramid is a mip-map of a grid, whose samples have one or more float components, e.g. a scalar field or a frame of vectors.
+	 *	Each level halves the resolution of the previous one, after a low-pass filter by the binomial kernel (1 4 6 4 1) / 16, 
+	 *	which is evaluated only at the kept samples. Levels are built on first use, each in a parallel pass, 
+	 *	so a pyramid, that is only sampled at coarse levels, costs less than a single pass over the finest level.
+	 *
+	 *	Components, that are infinite or NaN, e.g. in masked regions, are dead. They are left out of the filter and the 
+	 *	interpolation, so dead regions do not spread into live ones. A value, that has no live sample in reach, is NaN. 
+	 *
+	 *	The finest level is the grid itself, which is referenced, not copied. It must stay valid, until the pyramid is initialized again.
+	 */
+	class CGridPyramid
+	{
+	protected:
+		struct Level
+		{
+			vector<float>	data;		/**< The samples of the level, row by row. Empty for the finest level. */
+			int				nWidth;		/**< Number of samples per row. */
+			int				nHeight;	/**< Number of rows. */
+		};
+
+		const float	   *m_pBase;		/**< The grid, i.e. the finest level. */
+		int				m_nComponents;	/**< Number of floats per sample. */
+		vector<Level>	m_Levels;		/**< All levels, the finest first. */
+		int				m_nNumBuilt;	/**< Number of levels, that are valid, including the finest one. */
+
+	public:
+		CGridPyramid();
+
+	public:
+		/**
+		 *	Initializes the pyramid for a grid. No level is built yet, but the memory of previous levels is reused.
+		 *
+		 *	@param pData Pointer to the samples, row by row, with nComponents interleaved floats per sample.
+		 *	@param nWidth Number of samples per row.
+		 *	@param nHeight Number of rows.
+		 *	@param nComponents Number of floats per sample.
+		 */
+		void Init(const float *pData, int nWidth, int nHeight, int nComponents);
+
+		/**
+		 *	Discards all levels.
+		 */
+		void Clear();
+
+		/**
+		 *	Retrieve the level, whose sample spacing matches a footprint best, i.e. the level, that is sampled about once per footprint.
+		 *
+		 *	@param fFootprint Size of the sampled area, e.g. a screen pixel, in samples of the finest level.
+		 */
+		int GetLevel(float fFootprint) const;
+
+		/**
+		 *	Retrieve the samples of a level. The level, and all finer ones, are built, if necessary.
+		 *
+		 *	@param nLevel The level.
+		 *
+		 *	@return Pointer to the samples, row by row.
+		 */
+		const float* GetData(int nLevel);
+
+		/**
+		 *	Retrieve the bi-linearly interpolated sample at the level, that matches a footprint.
+		 *
+		 *	@param x X-component of the location in samples of the finest level.
+		 *	@param y Y-component of the location in samples of the finest level.
+		 *	@param fFootprint Size of the sampled area in samples of the finest level, see GetLevel().
+		 *	@param pOut Array of GetNumComponents() floats, receives the sample.
+		 *
+		 *	@remarks This function builds the level, if necessary. It is only safe to call it from several threads at once, 
+		 *			 if the level was retrieved before by GetData().
+		 */
+		void GetAt(float x, float y, float fFootprint, float *pOut);
+
+		/**
+		 *	Halves the resolution of a grid by the binomial filter of the pyramid, which is only evaluated at the kept samples, 
+		 *	i.e. every second one of each row and column. Both passes of a kept row are fused, so only one row of the source 
+		 *	is held per thread, and the kept rows are filtered in parallel.
+		 *
+		 *	@param pSrc Pointer to the samples, row by row, with nComponents interleaved floats per sample.
+		 *	@param nWidth Number of samples per row.
+		 *	@param nHeight Number of rows.
+		 *	@param nComponents Number of floats per sample.
+		 *	@param pDst Receives (nWidth+1)/2 by (nHeight+1)/2 samples.
+		 */
+		static void Reduce(const float *pSrc, int nWidth, int nHeight, int nComponents, float *pDst);
+
+		__inline bool IsEmpty() const { return m_Levels.empty(); }
+		__inline const float* GetBase() const { return m_pBase; }
+		__inline int GetNumLevels() const { return static_cast<int>(m_Levels.size()); }
+		__inline int GetNumComponents() const { return m_nComponents; }
+		__inline int GetWidth(int nLevel) const { return m_Levels[nLevel].nWidth; }
+		__inline int GetHeight(int nLevel) const { return m_Levels[nLevel].nHeight; }
+
+	protected:
+		/**
+		 *	Builds a level from the previous one.
+		 */
+		void _reduce(int nLevel);
+	};
+}
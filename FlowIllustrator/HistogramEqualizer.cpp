@@ -0,0 +1,344 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "StdAfx.h"
+#include "HistogramEqualizer.h"
+#include <float.h>
+#include <math.h>
+#include <emmintrin.h>
+
+#define HE_NUM_BINS		256		//Default number of histogram bins
+#define HE_NUM_TILES	8		//Number of CLAHE tiles along the longer side of the image
+#define HE_CLIP_LIMIT	3.0f	//CLAHE clip limit, relative to the mean bin height
+
+namespace FICore
+{
+	//Minimum and maximum of the samples or their magnitudes
+	static void _getMinMax(const float *pData, int nNumSamples, bool bAbs, float &fMin, float &fMax)
+	{
+		fMin = FLT_MAX;
+		fMax = -FLT_MAX;
+
+		#pragma omp parallel
+		{
+			float fLocalMin(FLT_MAX), fLocalMax(-FLT_MAX);
+
+			#pragma omp for
+			for (int i = 0; i < nNumSamples; i++)
+			{
+				const float val = (bAbs)? fabs(pData[i]) : pData[i];
+
+				if (val < fLocalMin) fLocalMin = val;
+				if (val > fLocalMax) fLocalMax = val;
+			}
+
+			#pragma omp critical
+			{
+				fMin = min(fMin, fLocalMin);
+				fMax = max(fMax, fLocalMax);
+			}
+		}
+	}
+
+	/*
+		Tiles and weight of the bi-linear interpolation between the mappings of neighbouring tiles along one axis.
+		Samples before the center of the first tile and after the center of the last tile only use that tile.
+	*/
+	static void _getTileWeights(int n, int nTiles, vector<int> &tile0, vector<int> &tile1, vector<float> &weight)
+	{
+		tile0.resize(n);
+		tile1.resize(n);
+		weight.resize(n);
+
+		vector<float> centers(nTiles);
+
+		for (int t = 0; t < nTiles; t++)
+			centers[t] = 0.5f * ((t * n) / nTiles + ((t + 1) * n) / nTiles - 1);
+
+		int t = 0;
+
+		for (int i = 0; i < n; i++)
+		{
+			while (t < nTiles - 1 && centers[t + 1] <= i) t++;
+
+			if (i <= centers[0] || t == nTiles - 1)
+			{
+				tile0[i] = tile1[i] = t;
+				weight[i] = 0.0f;
+			}
+			else
+			{
+				tile0[i]	= t;
+				tile1[i]	= t + 1;
+				weight[i]	= (i - centers[t]) / (centers[t + 1] - centers[t]);
+			}
+		}
+	}
+
+	CHistogramEqualizer::CHistogramEqualizer()
+	{
+		m_nNumBins		= HE_NUM_BINS;
+		m_nTilesX		= 1;
+		m_nTilesY		= 1;
+		m_fClipLimit	= 0.0f;
+		m_fBlend		= 1.0f;
+		m_fMin			= 0.0f;
+		m_fMax			= 0.0f;
+		m_bSymmetric	= false;
+	}
+
+	void CHistogramEqualizer::SetMode(CONTRAST_ENHANCEMENT nMode, int nWidth, int nHeight)
+	{
+		if (nMode == CE_ADAPTIVE)
+		{
+			const int nTileSize = max( max(nWidth, nHeight) / HE_NUM_TILES, 1 );
+
+			SetTiles( (nWidth + nTileSize - 1) / nTileSize, (nHeight + nTileSize - 1) / nTileSize );
+			SetClipLimit(HE_CLIP_LIMIT);
+		}
+		else
+		{
+			SetTiles(1, 1);
+			SetClipLimit(0.0f);
+		}
+	}
+
+	void CHistogramEqualizer::_getRange(const float *pData, int nNumSamples, float &fMin, float &fMax) const
+	{
+		if (m_fMax > m_fMin)
+		{
+			fMin = (m_bSymmetric)? 0.0f : m_fMin;
+			fMax = (m_bSymmetric)? max(fabs(m_fMin), fabs(m_fMax)) : m_fMax;
+		}
+		else
+		{
+			_getMinMax(pData, nNumSamples, m_bSymmetric, fMin, fMax);
+
+			if (m_bSymmetric) fMin = 0.0f;
+		}
+	}
+
+	void CHistogramEqualizer::_addToHistogram(const float *pData, int nWidth, int nMinX, int nMinY, int nMaxX, int nMaxY, float fMin, float fScale, int *pHisto) const
+	{
+		const int nLastBin = m_nNumBins - 1;
+
+		for (int j = nMinY; j < nMaxY; j++)
+		{
+			const float *pRow = pData + static_cast<size_t>(j) * nWidth;
+
+			for (int i = nMinX; i < nMaxX; i++)
+			{
+				const float val = (m_bSymmetric)? fabs(pRow[i]) : pRow[i];
+				const int nBin	= static_cast<int>( min( max((val - fMin) * fScale, 0.0f), static_cast<float>(nLastBin) ) );
+
+				pHisto[nBin]++;
+			}
+		}
+	}
+
+	void CHistogramEqualizer::_buildMapping(const int *pHisto, bool bClip, float fMin, float fMax, float *pMapping) const
+	{
+		float fTotal(0.0f);
+
+		for (int b = 0; b < m_nNumBins; b++)
+			fTotal += pHisto[b];
+
+		if (fTotal == 0.0f)
+		{
+			for (int b = 0; b < m_nNumBins; b++)
+				pMapping[b] = fMin + (fMax - fMin) * (b + 0.5f) / m_nNumBins;
+
+			return;
+		}
+
+		//Bins above the clip limit are cut, and the excess is distributed evenly over all bins
+		const float fLimit	= (bClip)? max(m_fClipLimit * fTotal / m_nNumBins, 1.0f) : FLT_MAX;
+		float fExcess(0.0f);
+
+		for (int b = 0; b < m_nNumBins; b++)
+			fExcess += max(pHisto[b] - fLimit, 0.0f);
+
+		const float fBonus = fExcess / m_nNumBins;
+		float fSum(0.0f);
+
+		for (int b = 0; b < m_nNumBins; b++)
+		{
+			fSum += min(static_cast<float>(pHisto[b]), fLimit) + fBonus;
+			pMapping[b] = fMin + (fMax - fMin) * (fSum / fTotal);
+		}
+	}
+
+	void CHistogramEqualizer::Apply(float *pData, int nWidth, int nHeight) const
+	{
+		if (!pData || nWidth <= 0 || nHeight <= 0) return;
+
+		float fMin, fMax;
+		_getRange(pData, nWidth * nHeight, fMin, fMax);
+
+		if (!(fMax > fMin)) return;
+
+		const int nNumBins	= m_nNumBins;
+		const float fScale	= nNumBins / (fMax - fMin);
+		const int nTilesX	= min(m_nTilesX, nWidth);
+		const int nTilesY	= min(m_nTilesY, nHeight);
+		const int nTiles	= nTilesX * nTilesY;
+
+		vector<int> histo(nTiles * nNumBins, 0);
+		vector<float> mapping(nTiles * nNumBins);
+
+		if (nTiles == 1)
+		{
+			#pragma omp parallel
+			{
+				//Each thread has its own histogram, merged at the end
+				vector<int> local(nNumBins, 0);
+
+				#pragma omp for
+				for (int j = 0; j < nHeight; j++)
+					_addToHistogram(pData, nWidth, 0, j, nWidth, j + 1, fMin, fScale, &local[0]);
+
+				#pragma omp critical
+				{
+					for (int b = 0; b < nNumBins; b++)
+						histo[b] += local[b];
+				}
+			}
+		}
+		else
+		{
+			#pragma omp parallel for schedule(dynamic, 1)
+			for (int t = 0; t < nTiles; t++)
+			{
+				const int tx = t % nTilesX, ty = t / nTilesX;
+
+				_addToHistogram(pData, nWidth, (tx * nWidth) / nTilesX, (ty * nHeight) / nTilesY, ((tx + 1) * nWidth) / nTilesX, 
+								((ty + 1) * nHeight) / nTilesY, fMin, fScale, &histo[t * nNumBins]);
+			}
+		}
+
+		for (int t = 0; t < nTiles; t++)
+			_buildMapping(&histo[t * nNumBins], nTiles > 1 && m_fClipLimit > 0.0f, fMin, fMax, &mapping[t * nNumBins]);
+
+		vector<int> tx0, tx1, ty0, ty1;
+		vector<float> wx, wy;
+
+		_getTileWeights(nWidth, nTilesX, tx0, tx1, wx);
+		_getTileWeights(nHeight, nTilesY, ty0, ty1, wy);
+
+		const float *pMapping = &mapping[0];
+		const bool bTiled = nTiles > 1;
+
+		#pragma omp parallel for
+		for (int j = 0; j < nHeight; j++)
+		{
+			float *pRow				= pData + static_cast<size_t>(j) * nWidth;
+			const float *pMapRow0	= pMapping + ty0[j] * nTilesX * nNumBins;
+			const float *pMapRow1	= pMapping + ty1[j] * nTilesX * nNumBins;
+
+			const __m128 vMin		= _mm_set1_ps(fMin);
+			const __m128 vScale		= _mm_set1_ps(fScale);
+			const __m128 vLastBin	= _mm_set1_ps(static_cast<float>(nNumBins - 1));
+			const __m128 vBlend		= _mm_set1_ps(m_fBlend);
+			const __m128 vWeightY	= _mm_set1_ps(wy[j]);
+			const __m128 vSignMask	= _mm_set1_ps(-0.0f);
+			const __m128 vZero		= _mm_setzero_ps();
+
+			int i = 0;
+
+			for (; i + 4 <= nWidth; i += 4)
+			{
+				const __m128 val	= _mm_loadu_ps(pRow + i);
+				const __m128 mag	= (m_bSymmetric)? _mm_andnot_ps(vSignMask, val) : val;
+				const __m128 pos	= _mm_min_ps( _mm_max_ps(_mm_mul_ps(_mm_sub_ps(mag, vMin), vScale), vZero), vLastBin );
+
+				int bins[4];
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(bins), _mm_cvttps_epi32(pos));
+
+				__m128 result;
+
+				if (bTiled)
+				{
+					float c00[4], c01[4], c10[4], c11[4];
+
+					for (int k = 0; k < 4; k++)
+					{
+						const int x = i + k;
+
+						c00[k] = pMapRow0[tx0[x] * nNumBins + bins[k]];
+						c01[k] = pMapRow0[tx1[x] * nNumBins + bins[k]];
+						c10[k] = pMapRow1[tx0[x] * nNumBins + bins[k]];
+						c11[k] = pMapRow1[tx1[x] * nNumBins + bins[k]];
+					}
+
+					const __m128 weightX	= _mm_loadu_ps(&wx[i]);
+					const __m128 top		= _mm_add_ps(_mm_loadu_ps(c00), _mm_mul_ps(weightX, _mm_sub_ps(_mm_loadu_ps(c01), _mm_loadu_ps(c00))));
+					const __m128 bottom		= _mm_add_ps(_mm_loadu_ps(c10), _mm_mul_ps(weightX, _mm_sub_ps(_mm_loadu_ps(c11), _mm_loadu_ps(c10))));
+
+					result = _mm_add_ps(top, _mm_mul_ps(vWeightY, _mm_sub_ps(bottom, top)));
+				}
+				else
+				{
+					result = _mm_set_ps(pMapping[bins[3]], pMapping[bins[2]], pMapping[bins[1]], pMapping[bins[0]]);
+				}
+
+				if (m_bSymmetric)
+					result = _mm_or_ps(result, _mm_and_ps(vSignMask, val));
+
+				_mm_storeu_ps(pRow + i, _mm_add_ps(val, _mm_mul_ps(vBlend, _mm_sub_ps(result, val))));
+			}
+
+			for (; i < nWidth; i++)
+			{
+				const float val = pRow[i];
+				const float mag = (m_bSymmetric)? fabs(val) : val;
+				const int nBin	= static_cast<int>( min( max((mag - fMin) * fScale, 0.0f), static_cast<float>(nNumBins - 1) ) );
+
+				const float top		= pMapRow0[tx0[i] * nNumBins + nBin] + wx[i] * (pMapRow0[tx1[i] * nNumBins + nBin] - pMapRow0[tx0[i] * nNumBins + nBin]);
+				const float bottom	= pMapRow1[tx0[i] * nNumBins + nBin] + wx[i] * (pMapRow1[tx1[i] * nNumBins + nBin] - pMapRow1[tx0[i] * nNumBins + nBin]);
+				float result		= top + wy[j] * (bottom - top);
+
+				if (m_bSymmetric && val < 0.0f) result = -result;
+
+				pRow[i] = val + m_fBlend * (result - val);
+			}
+		}
+	}
+
+	void CHistogramEqualizer::Apply(CScalarField2D &field) const
+	{
+		const int nWidth	= static_cast<int>(field.GetExtentX());
+		const int nHeight	= static_cast<int>(field.GetExtentY());
+
+		Apply(field.GetData(), nWidth, nHeight);
+
+		float fMin, fMax;
+		_getMinMax(field.GetData(), nWidth * nHeight, false, fMin, fMax);
+
+		field.SetMinMax(fMin, fMax);
+	}
+}
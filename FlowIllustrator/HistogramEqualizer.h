@@ -0,0 +1,138 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+#include "ScalarField.h"
+#include <vector>
+
+using namespace std;
+
+/**
+ *	Contrast enhancement, that is applied to a scalar display.
+ */
+enum CONTRAST_ENHANCEMENT
+{
+	CE_NONE = 0,	/**< The values are displayed as they are. */
+	CE_GLOBAL,		/**< Histogram equalisation of the entire image. */
+	CE_ADAPTIVE		/**< Contrast limited adaptive histogram equalisation (CLAHE) in tiles. */
+};
+
+namespace FICore
+{
+	/**
+	 *	CHistogramEqualizer enhances the contrast of a row-major grid of floats by histogram equalisation.
+	 *
+	 *	Each value is replaced by the cumulative distribution of its histogram bin, scaled to the range of the histogram.
+	 *	The histogram is either built for the entire grid, by several threads with their own histograms, that are merged
+	 *	at the end, or for each of several tiles in parallel (CLAHE). Tile histograms can be clipped, limiting the gain of 
+	 *	nearly constant regions, and the mappings of the four closest tiles are bi-linearly interpolated. The mappings 
+	 *	are applied four samples at a time with SSE.
+	 *
+	 *	In symmetric mode, the magnitudes are equalised and the signs are kept, which suits diverging colour maps.
+	 */
+	class CHistogramEqualizer
+	{
+	protected:
+		int		m_nNumBins;		/**< Number of histogram bins. */
+		int		m_nTilesX;		/**< Number of tiles in X-direction. */
+		int		m_nTilesY;		/**< Number of tiles in Y-direction. */
+		float	m_fClipLimit;	/**< Maximum height of a tile histogram bin, relative to the mean bin height. Zero disables clipping. */
+		float	m_fBlend;		/**< Weight of the equalised value. The original value has the weight 1 - m_fBlend. */
+		float	m_fMin;			/**< Lower end of the histogram. */
+		float	m_fMax;			/**< Upper end of the histogram. If it is not greater than m_fMin, the range of the data is used. */
+		bool	m_bSymmetric;	/**< If true, the magnitudes are equalised and the signs kept. */
+
+	public:
+		CHistogramEqualizer();
+
+	public:
+		/**
+		 *	Set the number of histogram bins. The default is 256.
+		 */
+		__inline void SetNumBins(int nNumBins) { m_nNumBins = max(nNumBins, 2); }
+
+		/**
+		 *	Set the number of tiles. The default of one tile equalises the entire grid at once.
+		 */
+		__inline void SetTiles(int nTilesX, int nTilesY) { m_nTilesX = max(nTilesX, 1); m_nTilesY = max(nTilesY, 1); }
+
+		/**
+		 *	Set the clip limit of the tile histograms, relative to the mean bin height. The default of zero disables clipping.
+		 */
+		__inline void SetClipLimit(float fClipLimit) { m_fClipLimit = fClipLimit; }
+
+		/**
+		 *	Set the weight of the equalised value, with the original value weighted by 1 - fBlend. The default is 1.
+		 */
+		__inline void SetBlend(float fBlend) { m_fBlend = fBlend; }
+
+		/**
+		 *	Set the range of the histogram. Values outside are clamped. By default, the range of the data is used.
+		 */
+		__inline void SetRange(float fMin, float fMax) { m_fMin = fMin; m_fMax = fMax; }
+
+		/**
+		 *	Equalise the magnitudes and keep the signs. The default is false.
+		 */
+		__inline void SetSymmetric(bool bSymmetric) { m_bSymmetric = bSymmetric; }
+
+		/**
+		 *	Set up the equaliser for a CONTRAST_ENHANCEMENT mode, with a tile size suited to an image of the specified size.
+		 */
+		void SetMode(CONTRAST_ENHANCEMENT nMode, int nWidth, int nHeight);
+
+		/**
+		 *	Equalises a grid.
+		 *
+		 *	@param pData Pointer to the samples, which are overwritten by the result.
+		 *	@param nWidth Number of samples per row.
+		 *	@param nHeight Number of rows.
+		 */
+		void Apply(float *pData, int nWidth, int nHeight) const;
+
+		/**
+		 *	Equalises a scalar field, and updates its minimum and maximum.
+		 */
+		void Apply(CScalarField2D &field) const;
+
+	protected:
+		/**
+		 *	Computes the histogram of a block of samples, and adds it to pHisto.
+		 */
+		void _addToHistogram(const float *pData, int nWidth, int nMinX, int nMinY, int nMaxX, int nMaxY, float fMin, float fScale, int *pHisto) const;
+
+		/**
+		 *	Computes the equalising mapping of a histogram, from bin index to output value.
+		 */
+		void _buildMapping(const int *pHisto, bool bClip, float fMin, float fMax, float *pMapping) const;
+
+		/**
+		 *	Retrieve the range of the histogram, either from the settings or from the data.
+		 */
+		void _getRange(const float *pData, int nNumSamples, float &fMin, float &fMax) const;
+	};
+}
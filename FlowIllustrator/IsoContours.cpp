@@ -0,0 +1,390 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "StdAfx.h"
+#include "IsoContours.h"
+#include <algorithm>
+
+#define IC_BAND_ROWS	16	//Number of rows of cells, that are processed as a unit by one thread
+#define IC_MAX_SAMPLES	(0x7FFFFFFF / 2)	//Edge IDs are twice the sample index, plus one for vertical edges
+
+namespace FICore
+{
+	/*
+		Part of an iso line within a grid cell, connecting crossings on two cell edges.
+		The ID of the horizontal edge from (x,y) to (x+1,y) is 2*(y*w+x), of the vertical edge from (x,y) to (x,y+1) it
+		is 2*(y*w+x)+1. The position of a crossing along its edge is measured from (x,y), so both cells sharing an edge 
+		compute the same crossing.
+	*/
+	struct IsoSegment
+	{
+		int				nLevel;		//Index of the iso value
+		unsigned int	nEdge[2];	//IDs of the two edges
+		float			t[2];		//Positions of the crossings along the edges
+	};
+
+	/*
+		Edges, that are connected by a segment for each marching squares case without a saddle.
+		Bit i of the case is set, if corner i is above the iso value. The corners are (x,y), (x+1,y), (x+1,y+1), (x,y+1), 
+		the edges are bottom, right, top and left.
+	*/
+	static const int s_nCaseEdges[16][2] = {
+		{-1,-1},	{3, 0},		{0, 1},		{3, 1},
+		{1, 2},		{-1,-1},	{0, 2},		{3, 2},
+		{3, 2},		{0, 2},		{-1,-1},	{1, 2},
+		{3, 1},		{0, 1},		{3, 0},		{-1,-1}
+	};
+
+	//Adds the segment between two cell edges
+	static __inline void _addSegment(int nLevel, int e0, int e1, const unsigned int *pEdgeIDs, const float *pValues, float fIso, vector<IsoSegment> &segments)
+	{
+		//Corners at the start and the end of each edge
+		static const int s_nEdgeCorners[4][2] = { {0, 1}, {1, 2}, {3, 2}, {0, 3} };
+
+		IsoSegment seg;
+		seg.nLevel		= nLevel;
+		seg.nEdge[0]	= pEdgeIDs[e0];
+		seg.nEdge[1]	= pEdgeIDs[e1];
+		seg.t[0]		= (fIso - pValues[s_nEdgeCorners[e0][0]]) / (pValues[s_nEdgeCorners[e0][1]] - pValues[s_nEdgeCorners[e0][0]]);
+		seg.t[1]		= (fIso - pValues[s_nEdgeCorners[e1][0]]) / (pValues[s_nEdgeCorners[e1][1]] - pValues[s_nEdgeCorners[e1][0]]);
+
+		segments.push_back(seg);
+	}
+
+	//Marching squares on the cells of the rows nMinY to nMaxY-1, for all iso values
+	static void _extractBand(const float *pData, int nWidth, int nMinY, int nMaxY, const float *pLevels, int nNumLevels, vector<IsoSegment> &segments)
+	{
+		const float *pLevelsEnd = pLevels + nNumLevels;
+
+		for (int y = nMinY; y < nMaxY; y++)
+		{
+			const float *pRow0 = pData + y*nWidth;
+			const float *pRow1 = pRow0 + nWidth;
+
+			for (int x = 0; x < nWidth-1; x++)
+			{
+				const float values[4] = { pRow0[x], pRow0[x+1], pRow1[x+1], pRow1[x] };
+				const float fMin = min( min(values[0], values[1]), min(values[2], values[3]) );
+				const float fMax = max( max(values[0], values[1]), max(values[2], values[3]) );
+
+				//A corner is above an iso value, if it is greater. So the cell is crossed by fMin <= iso < fMax.
+				const float *pLevel = lower_bound(pLevels, pLevelsEnd, fMin);
+
+				if (pLevel == pLevelsEnd || *pLevel >= fMax)
+					continue;
+
+				const unsigned int nID = 2*(y*nWidth + x);
+				const unsigned int edgeIDs[4] = { nID, nID + 3, nID + 2*nWidth, nID + 1 };
+
+				for (; pLevel < pLevelsEnd && *pLevel < fMax; ++pLevel)
+				{
+					const float fIso	= *pLevel;
+					const int	nLevel	= static_cast<int>(pLevel - pLevels);
+
+					int nCase = 0;
+					if (values[0] > fIso) nCase |= 1;
+					if (values[1] > fIso) nCase |= 2;
+					if (values[2] > fIso) nCase |= 4;
+					if (values[3] > fIso) nCase |= 8;
+
+					if (nCase == 5 || nCase == 10)
+					{
+						//Saddle: if the center is above, the corners above are connected through it
+						const bool bCenterAbove = (values[0] + values[1] + values[2] + values[3]) * 0.25f > fIso;
+
+						if (bCenterAbove == (nCase == 5)) {
+							_addSegment(nLevel, 0, 1, edgeIDs, values, fIso, segments);
+							_addSegment(nLevel, 2, 3, edgeIDs, values, fIso, segments);
+						} else {
+							_addSegment(nLevel, 3, 0, edgeIDs, values, fIso, segments);
+							_addSegment(nLevel, 1, 2, edgeIDs, values, fIso, segments);
+						}
+					}
+					else {
+						_addSegment(nLevel, s_nCaseEdges[nCase][0], s_nCaseEdges[nCase][1], edgeIDs, values, fIso, segments);
+					}
+				}
+			}
+		}
+	}
+
+	//Converts a crossing on a cell edge to domain coordinates
+	static __inline CPointf _getCrossing(const CScalarField2D *pField, unsigned int nEdge, float t)
+	{
+		const int nWidth	= pField->GetExtentX();
+		const int nSample	= static_cast<int>(nEdge >> 1);
+		const float x		= static_cast<float>(nSample % nWidth);
+		const float y		= static_cast<float>(nSample / nWidth);
+
+		return (nEdge & 1)? pField->GetDomainCoordinates(x, y + t) : pField->GetDomainCoordinates(x + t, y);
+	}
+
+	//Orders segment end points by edge ID
+	static bool _compareEndPoints(const pair<unsigned int, int> &a, const pair<unsigned int, int> &b)
+	{
+		return a.first < b.first;
+	}
+
+	CIsoContours::CIsoContours()
+	{
+	}
+
+	void CIsoContours::Clear()
+	{
+		m_Levels.clear();
+		m_Points.clear();
+		m_Lines.clear();
+	}
+
+	bool CIsoContours::Extract(const CScalarField2D *pField, float fMin, float fMax, int nNumLevels)
+	{
+		vector<float> levels(max(nNumLevels, 0));
+
+		for (int i = 0; i < nNumLevels; i++) {
+			levels[i] = fMin + (i + 0.5f) * (fMax - fMin) / nNumLevels;
+		}
+
+		return Extract(pField, (levels.empty())? nullptr : &levels[0], nNumLevels);
+	}
+
+	bool CIsoContours::Extract(const CScalarField2D *pField, const float *pLevels, int nNumLevels)
+	{
+		Clear();
+
+		if (!pField || !pField->GetData() || nNumLevels < 1)
+			return false;
+
+		const int nWidth	= pField->GetExtentX();
+		const int nHeight	= pField->GetExtentY();
+
+		if (nWidth < 2 || nHeight < 2 || static_cast<double>(nWidth) * nHeight > IC_MAX_SAMPLES)
+			return false;
+
+		m_Levels.assign(pLevels, pLevels + nNumLevels);
+		sort(m_Levels.begin(), m_Levels.end());
+
+		//Marching squares, the segments of each band are kept in order, such that the result is deterministic
+		const int nNumBands = (nHeight - 1 + IC_BAND_ROWS - 1) / IC_BAND_ROWS;
+		vector< vector<IsoSegment> > bands(nNumBands);
+
+		#pragma omp parallel for schedule(dynamic,1)
+		for (int b = 0; b < nNumBands; b++)
+		{
+			const int nMinY = b * IC_BAND_ROWS;
+			const int nMaxY = min(nMinY + IC_BAND_ROWS, nHeight - 1);
+
+			_extractBand(pField->GetData(), nWidth, nMinY, nMaxY, &m_Levels[0], nNumLevels, bands[b]);
+		}
+
+		//Sort the segments by iso value
+		vector<int> levelStart(nNumLevels + 1, 0);
+
+		for (int b = 0; b < nNumBands; b++) {
+			for (auto iter = bands[b].begin(); iter != bands[b].end(); ++iter)
+				levelStart[iter->nLevel + 1]++;
+		}
+
+		for (int i = 0; i < nNumLevels; i++)
+			levelStart[i+1] += levelStart[i];
+
+		if (levelStart[nNumLevels] == 0)
+			return true;
+
+		vector<IsoSegment> segments(levelStart[nNumLevels]);
+		vector<int> levelPos(levelStart.begin(), levelStart.end() - 1);
+
+		for (int b = 0; b < nNumBands; b++)
+		{
+			for (auto iter = bands[b].begin(); iter != bands[b].end(); ++iter)
+				segments[levelPos[iter->nLevel]++] = *iter;
+
+			vector<IsoSegment>().swap(bands[b]);
+		}
+
+		//Stitch the lines of each iso value
+		vector< vector<CPointf> >			levelPoints(nNumLevels);
+		vector< vector<IsoContourLine> >	levelLines(nNumLevels);
+
+		#pragma omp parallel for schedule(dynamic,1)
+		for (int i = 0; i < nNumLevels; i++)
+		{
+			const int nNumSegments = levelStart[i+1] - levelStart[i];
+
+			if (nNumSegments > 0)
+				_stitch(pField, &segments[levelStart[i]], nNumSegments, i, levelPoints[i], levelLines[i]);
+		}
+
+		//Concatenate the lines of all iso values
+		size_t nNumPoints(0), nNumLines(0);
+
+		for (int i = 0; i < nNumLevels; i++) {
+			nNumPoints	+= levelPoints[i].size();
+			nNumLines	+= levelLines[i].size();
+		}
+
+		m_Points.reserve(nNumPoints);
+		m_Lines.reserve(nNumLines);
+
+		for (int i = 0; i < nNumLevels; i++)
+		{
+			const int nOffset = static_cast<int>(m_Points.size());
+
+			for (auto iter = levelLines[i].begin(); iter != levelLines[i].end(); ++iter) {
+				m_Lines.push_back(*iter);
+				m_Lines.back().nFirst += nOffset;
+			}
+
+			m_Points.insert(m_Points.end(), levelPoints[i].begin(), levelPoints[i].end());
+		}
+
+		return true;
+	}
+
+	void CIsoContours::_stitch(const CScalarField2D *pField, const IsoSegment *pSegments, int nNumSegments, int nLevel, 
+		vector<CPointf> &points, vector<IsoContourLine> &lines) const
+	{
+		//End point 2*i+e is end e of segment i. An edge is shared by at most two cells, so each end point has at most one partner.
+		vector< pair<unsigned int, int> > endPoints(2*nNumSegments);
+
+		for (int i = 0; i < nNumSegments; i++) {
+			endPoints[2*i]		= make_pair(pSegments[i].nEdge[0], 2*i);
+			endPoints[2*i+1]	= make_pair(pSegments[i].nEdge[1], 2*i+1);
+		}
+
+		sort(endPoints.begin(), endPoints.end(), _compareEndPoints);
+
+		vector<int> partner(2*nNumSegments, -1);
+
+		for (size_t k = 1; k < endPoints.size(); k++)
+		{
+			if (endPoints[k].first == endPoints[k-1].first) {
+				partner[endPoints[k].second]	= endPoints[k-1].second;
+				partner[endPoints[k-1].second]	= endPoints[k].second;
+			}
+		}
+
+		vector<bool> visited(nNumSegments, false);
+
+		points.reserve(nNumSegments + nNumSegments/4);
+
+		/*
+			The first pass starts at open ends, which are at the boundary of the grid, and the second one
+			starts the remaining closed lines at an arbitrary segment.
+		*/
+		for (int nPass = 0; nPass < 2; nPass++)
+		{
+			for (int nStart = 0; nStart < nNumSegments; nStart++)
+			{
+				if (visited[nStart])
+					continue;
+
+				int nEnd = 0;
+
+				if (nPass == 0)
+				{
+					if (partner[2*nStart] < 0)
+						nEnd = 0;
+					else if (partner[2*nStart+1] < 0)
+						nEnd = 1;
+					else
+						continue;
+				}
+
+				IsoContourLine line;
+				line.nFirst		= static_cast<int>(points.size());
+				line.nLevel		= nLevel;
+				line.bClosed	= false;
+
+				points.push_back(_getCrossing(pField, pSegments[nStart].nEdge[nEnd], pSegments[nStart].t[nEnd]));
+
+				for (int nSeg = nStart;;)
+				{
+					const int nOther	= 1 - nEnd;
+					const int nNext		= partner[2*nSeg + nOther];
+
+					visited[nSeg] = true;
+
+					if (nNext >> 1 == nStart) {
+						line.bClosed = true;	//back at the first point, which is not repeated
+						break;
+					}
+
+					points.push_back(_getCrossing(pField, pSegments[nSeg].nEdge[nOther], pSegments[nSeg].t[nOther]));
+
+					if (nNext < 0 || visited[nNext >> 1])
+						break;
+
+					nSeg = nNext >> 1;
+					nEnd = nNext & 1;
+				}
+
+				line.nNumPoints = static_cast<int>(points.size()) - line.nFirst;
+				lines.push_back(line);
+			}
+		}
+	}
+
+#ifdef WIN32
+	CString CIsoContours::toString(const floatColor &color, float fThickness, float fLineWidthFactor) const
+	{
+		CString strRetVal, strDummy;
+		size_t nLine = 0;
+
+		while (nLine < m_Lines.size())
+		{
+			const int nLevel = m_Lines[nLine].nLevel;
+
+			strDummy.Format(_T("<path\nstyle=\"fill:none;stroke:%s;stroke-width:%f\"\nisovalue=\"%g\"\nd=\""), 
+				color.GetHexString(), fThickness/fLineWidthFactor, m_Levels[nLevel]);
+			strRetVal += strDummy;
+
+			//All lines of an iso value form one path, with relative coordinates after the first point of each line
+			for (; nLine < m_Lines.size() && m_Lines[nLine].nLevel == nLevel; nLine++)
+			{
+				const IsoContourLine &line = m_Lines[nLine];
+				const CPointf *pt = &m_Points[line.nFirst];
+
+				strDummy.Format(_T("M%g %g"), pt[0].x, pt[0].y);
+				strRetVal += strDummy;
+
+				for (int i = 1; i < line.nNumPoints; i++) {
+					strDummy.Format((i == 1)? _T("l%g %g") : _T(" %g %g"), pt[i].x - pt[i-1].x, pt[i].y - pt[i-1].y);
+					strRetVal += strDummy;
+				}
+
+				if (line.bClosed)
+					strRetVal += _T("z");
+			}
+
+			strRetVal += _T("\"\n/>\n");
+		}
+
+		return strRetVal;
+	}
+#endif
+}
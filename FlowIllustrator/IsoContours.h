@@ -0,0 +1,159 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#pragma once
+#include "ScalarField.h"
+#include "FloatColor.h"
+#include <vector>
+
+using namespace std;
+
+namespace FICore
+{
+	/**
+	 *	A contour line, stored as a range of points in CIsoContours.
+	 */
+	struct IsoContourLine
+	{
+		int		nFirst;		/**< Index of the first point of the line. */
+		int		nNumPoints;	/**< Number of points of the line. */
+		int		nLevel;		/**< Index of the iso value of the line, see CIsoContours::GetLevel(). */
+		bool	bClosed;	/**< If true, the last point is connected to the first one. The first point is not repeated. */
+	};
+
+	struct IsoSegment;
+
+	/**
+	 *	CIsoContours extracts the iso lines of a scalar field for any number of iso values with marching squares.
+	 *
+	 *	All iso values are extracted in a single pass over the grid, in which bands of rows are processed in parallel. 
+	 *	Every cell only visits the iso values between the minimum and the maximum of its corners. Crossings are linearly 
+	 *	interpolated along the cell edges, and saddle cells are resolved with the bi-linear value at the cell center 
+	 *	(asymptotic decider), such that the lines of neighbouring cells never cross.
+	 *
+	 *	The segments are stitched into polylines, each iso value in parallel, by sorting their end points by the cell edge 
+	 *	they lie on. The result is stored in two flat arrays: the points of all lines in domain coordinates, and the 
+	 *	lines referencing ranges of them.
+	 */
+	class CIsoContours
+	{
+	protected:
+		vector<float>			m_Levels;	/**< The iso values, sorted in ascending order. */
+		vector<CPointf>			m_Points;	/**< The points of all lines, in domain coordinates. */
+		vector<IsoContourLine>	m_Lines;	/**< The lines, ordered by iso value. */
+
+	public:
+		CIsoContours();
+
+	public:
+		/**
+		 *	Remove all lines and iso values.
+		 */
+		void Clear();
+
+		/**
+		 *	Extracts the iso lines of a scalar field.
+		 *
+		 *	@param pField Pointer to the scalar field.
+		 *	@param pLevels Pointer to the iso values. They need not be sorted.
+		 *	@param nNumLevels Number of iso values.
+		 *
+		 *	@return true, if the lines were extracted. false, if the field is empty or too large.
+		 */
+		bool Extract(const CScalarField2D *pField, const float *pLevels, int nNumLevels);
+
+		/**
+		 *	Extracts the iso lines of nNumLevels iso values, that are evenly distributed over a range of values. 
+		 *	The iso values are at the centers of nNumLevels intervals of equal size between fMin and fMax.
+		 *
+		 *	@see Extract()
+		 */
+		bool Extract(const CScalarField2D *pField, float fMin, float fMax, int nNumLevels);
+
+		/**
+		 *	Retrieve the number of iso values of the last extraction.
+		 */
+		__inline int GetNumLevels() const { return static_cast<int>(m_Levels.size()); }
+
+		/**
+		 *	Retrieve an iso value, by the index stored in IsoContourLine::nLevel.
+		 */
+		__inline float GetLevel(int nLevel) const { return m_Levels[nLevel]; }
+
+		/**
+		 *	Retrieve the number of lines.
+		 */
+		__inline size_t GetNumLines() const { return m_Lines.size(); }
+
+		/**
+		 *	Retrieve a line. Its points start at GetPoints() + nFirst.
+		 */
+		__inline const IsoContourLine& GetLine(size_t n) const { return m_Lines[n]; }
+
+		/**
+		 *	Retrieve the total number of points of all lines.
+		 */
+		__inline size_t GetNumPoints() const { return m_Points.size(); }
+
+		/**
+		 *	Retrieve a pointer to the points of all lines, or nullptr if there are none.
+		 *	The points are pairs of floats, that can be directly passed to glVertexPointer().
+		 */
+		__inline const CPointf* GetPoints() const { return (m_Points.empty())? nullptr : &m_Points[0]; }
+
+		/**
+		 *	Check, if there are any lines.
+		 */
+		__inline bool IsEmpty() const { return m_Lines.empty(); }
+
+#ifdef WIN32
+		/**
+		 *	Retrieve the lines as SVG paths, one path per iso value.
+		 *
+		 *	@param color Stroke color of the paths.
+		 *	@param fThickness Stroke width in pixels.
+		 *	@param fLineWidthFactor Pixels per domain unit, see CDrawingObject::toString().
+		 */
+		CString toString(const floatColor &color, float fThickness, float fLineWidthFactor) const;
+#endif
+
+	protected:
+		/**
+		 *	Stitches the segments of one iso value into lines.
+		 *
+		 *	@param pField The scalar field, used to convert grid to domain coordinates.
+		 *	@param pSegments Pointer to the segments of the iso value.
+		 *	@param nNumSegments Number of segments.
+		 *	@param nLevel Index of the iso value.
+		 *	@param points Receives the points of the lines.
+		 *	@param lines Receives the lines, whose nFirst refers to points.
+		 */
+		void _stitch(const CScalarField2D *pField, const IsoSegment *pSegments, int nNumSegments, int nLevel, 
+			vector<CPointf> &points, vector<IsoContourLine> &lines) const;
+	};
+}
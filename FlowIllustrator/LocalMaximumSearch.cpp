@@ -0,0 +1,110 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "StdAfx.h"
+#include "LocalMaximumSearch.h"
+#include <math.h>
+
+#define LMS_MAX_ITERATIONS		32
+#define LMS_MAX_BACKTRACKING	8
+#define LMS_TOLERANCE			1e-3f
+#define LMS_MAX_STEP			1.0f
+#define LMS_SUFFICIENT			1e-4f
+
+namespace FICore
+{
+	CLocalMaximumSearch::CLocalMaximumSearch()
+	{
+		m_nMaxIterations	= LMS_MAX_ITERATIONS;
+		m_nMaxBacktracking	= LMS_MAX_BACKTRACKING;
+		m_fTolerance		= LMS_TOLERANCE;
+		m_fMaxStep			= LMS_MAX_STEP;
+	}
+
+	void CLocalMaximumSearch::_evaluate(const float *f, float wx, float wy, float &value, CVector2D &gradient, float *hessian)
+	{
+		float gx[4], gy[4], gxx[4], gxy[4], gyy[4];
+
+		//Finite differences at the four corners of the central cell, i.e. at the grid points (1,1), (2,1), (1,2) and (2,2) of f
+		for (int i = 0; i < 4; i++)
+		{
+			const float *c = f + (1 + i/2) * 4 + (1 + i%2);
+
+			gx[i]	= 0.5f * (c[1] - c[-1]);
+			gy[i]	= 0.5f * (c[4] - c[-4]);
+			gxx[i]	= c[1] - 2.0f * c[0] + c[-1];
+			gyy[i]	= c[4] - 2.0f * c[0] + c[-4];
+			gxy[i]	= 0.25f * (c[5] - c[3] - c[-3] + c[-5]);
+		}
+
+		const float w[4] = { (1.0f - wx) * (1.0f - wy), wx * (1.0f - wy), (1.0f - wx) * wy, wx * wy };
+
+		value = gradient.x = gradient.y = hessian[0] = hessian[1] = hessian[2] = 0.0f;
+
+		for (int i = 0; i < 4; i++)
+		{
+			value		+= w[i] * f[(1 + i/2) * 4 + (1 + i%2)];
+			gradient.x	+= w[i] * gx[i];
+			gradient.y	+= w[i] * gy[i];
+			hessian[0]	+= w[i] * gxx[i];
+			hessian[1]	+= w[i] * gxy[i];
+			hessian[2]	+= w[i] * gyy[i];
+		}
+	}
+
+	bool CLocalMaximumSearch::_getStep(const CVector2D &gradient, const float *hessian, CVector2D &step) const
+	{
+		const float det		= hessian[0] * hessian[2] - hessian[1] * hessian[1];
+		const bool bNewton	= hessian[0] < 0.0f && det > 0.0f;
+
+		if (bNewton) {
+			//step = -H^-1 * gradient
+			step.x = -( hessian[2] * gradient.x - hessian[1] * gradient.y) / det;
+			step.y = -(-hessian[1] * gradient.x + hessian[0] * gradient.y) / det;
+		} else {
+			step = gradient * (m_fMaxStep / gradient.abs());
+		}
+
+		const float len = step.abs();
+
+		if (len > m_fMaxStep) {
+			step = step * (m_fMaxStep / len);
+		}
+
+		return bNewton;
+	}
+
+	bool CLocalMaximumSearch::_accept(bool bNewton, float alpha, const CVector2D &step, float value, const CVector2D &gradient, float trialValue, const CVector2D &trialGradient)
+	{
+		if (bNewton) {
+			return trialGradient.abs() <= (1.0f - LMS_SUFFICIENT * alpha) * gradient.abs();
+		}
+
+		return trialValue >= value + LMS_SUFFICIENT * alpha * (gradient.x * step.x + gradient.y * step.y);
+	}
+}
@@ -0,0 +1,234 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#pragma once
+#include "Vector2D.h"
+#include <math.h>
+
+namespace FICore
+{
+	/**
+	 *	CLocalMaximumSearch locates the local maximum of a sampled scalar field, e.g. the core of a vortex in the vorticity magnitude.
+	 *
+	 *	Value, gradient and Hessian are bi-linear interpolations of the values and finite differences at the grid points, 
+	 *	taken from the 4x4 grid points around the current position. Where the Hessian is negative definite, Newton steps 
+	 *	are taken and accepted by a backtracking line search on the length of the gradient. Elsewhere, the search takes 
+	 *	steps along the gradient with a backtracking line search on the value. Steps are limited to a maximum length, 
+	 *	and the number of iterations is bounded, so the costs of a search are predictable.
+	 *
+	 *	The grid is accessed by the template function Search(), which works with every class providing 
+	 *	float GetAt(int x, int y) const, such as CScalarField2D.
+	 */
+	class CLocalMaximumSearch
+	{
+	public:
+		/**
+		 *	Outcome of a search.
+		 */
+		enum SEARCH_RESULT {
+			CONVERGED = 0,		/**< The search converged at a local maximum. */
+			STALLED,			/**< No step along the gradient increased the value any further. */
+			MAX_ITERATIONS,		/**< The search did not converge within the maximum number of iterations. */
+			LEFT_BOUNDS			/**< The search started outside the bounds, or the ascent leads out of them. */
+		};
+
+	protected:
+		int		m_nMaxIterations;	/**< Maximum number of iterations of a search. */
+		int		m_nMaxBacktracking;	/**< Maximum number of times a step is halved by the line search. */
+		float	m_fTolerance;		/**< A search converges, if a Newton step is shorter than this, in grid cells. */
+		float	m_fMaxStep;			/**< Maximum length of a single step, in grid cells. */
+
+	public:
+		CLocalMaximumSearch();
+
+	public:
+		/**
+		 *	Set the maximum number of iterations of a search. The default is 32.
+		 */
+		__inline void SetMaxIterations(int nMaxIterations) { m_nMaxIterations = nMaxIterations; }
+
+		/**
+		 *	Set the length of the final Newton step, at which a search is considered converged. The default is 1e-3 grid cells.
+		 */
+		__inline void SetTolerance(float fTolerance) { m_fTolerance = fTolerance; }
+
+		/**
+		 *	Set the maximum length of a single step. The default is one grid cell.
+		 */
+		__inline void SetMaxStep(float fMaxStep) { m_fMaxStep = fMaxStep; }
+
+		/**
+		 *	Search the local maximum, starting at a location in grid space.
+		 *
+		 *	@param grid The sampled scalar field. GetAt() is only called for grid points inside the specified bounds.
+		 *	@param nMinX First column of the grid, that may be accessed.
+		 *	@param nMinY First row of the grid, that may be accessed.
+		 *	@param nMaxX Last column of the grid, that may be accessed.
+		 *	@param nMaxY Last row of the grid, that may be accessed.
+		 *	@param pos The start location in grid space, receives the location of the local maximum. If the search fails, 
+		 *			   it receives the last location the ascent reached inside the bounds.
+		 *	@param pNumIterations Optional pointer to an int, that receives the number of iterations.
+		 *	@param pResult Optional pointer to a SEARCH_RESULT, that receives the outcome of the search.
+		 *
+		 *	@return Returns true, if the search converged. Returns false, if the search would leave the bounds, 
+		 *			stalled, or did not converge within the maximum number of iterations.
+		 */
+		template <class TGrid>
+		bool Search(const TGrid &grid, int nMinX, int nMinY, int nMaxX, int nMaxY, CVector2D &pos, int *pNumIterations = nullptr, SEARCH_RESULT *pResult = nullptr) const
+		{
+			float f[16];
+			float value, trialValue;
+			CVector2D gradient, trialGradient, step;
+			float hessian[3], trialHessian[3];
+
+			if (pNumIterations) *pNumIterations = 0;
+
+			if (!_inside(pos, nMinX, nMinY, nMaxX, nMaxY)) return _result(LEFT_BOUNDS, pResult);
+
+			_gather(grid, nMinX, nMinY, nMaxX, nMaxY, pos, f);
+			_evaluate(f, pos.x - floor(pos.x), pos.y - floor(pos.y), value, gradient, hessian);
+
+			for (int i = 0; i < m_nMaxIterations; i++)
+			{
+				if (pNumIterations) *pNumIterations = i + 1;
+
+				if (gradient.abs() < 1e-12f) return _result(CONVERGED, pResult);
+
+				const bool bNewton = _getStep(gradient, hessian, step);
+
+				if (bNewton && step.abs() < m_fTolerance) {
+					pos += step;
+					return _result(CONVERGED, pResult);
+				}
+
+				CVector2D trial;
+				float alpha = 1.0f;
+				bool bOutside = false;
+				int j;
+
+				for (j = 0; j <= m_nMaxBacktracking; j++, alpha *= 0.5f)
+				{
+					trial = pos + step * alpha;
+
+					if (!_inside(trial, nMinX, nMinY, nMaxX, nMaxY)) {
+						bOutside = true;
+						continue;
+					}
+
+					_gather(grid, nMinX, nMinY, nMaxX, nMaxY, trial, f);
+					_evaluate(f, trial.x - floor(trial.x), trial.y - floor(trial.y), trialValue, trialGradient, trialHessian);
+
+					if (_accept(bNewton, alpha, step, value, gradient, trialValue, trialGradient)) break;
+				}
+
+				//No acceptable step inside the bounds. If some were outside, the maximum lies beyond the bounds.
+				if (j > m_nMaxBacktracking) return _result(bOutside? LEFT_BOUNDS : STALLED, pResult);
+
+				pos = trial;
+
+				//Only Newton steps are short close to the maximum, short gradient steps indicate that the search is stuck
+				if ((step * alpha).abs() < m_fTolerance) return _result(bNewton? CONVERGED : STALLED, pResult);
+
+				value		= trialValue;
+				gradient	= trialGradient;
+				hessian[0]	= trialHessian[0];
+				hessian[1]	= trialHessian[1];
+				hessian[2]	= trialHessian[2];
+			}
+
+			return _result(MAX_ITERATIONS, pResult);
+		}
+
+		/**
+		 *	Interpolates value, gradient and Hessian at a location in grid space, as used by Search().
+		 *
+		 *	@param hessian Receives the second derivatives xx, xy and yy, per grid cell.
+		 */
+		template <class TGrid>
+		static void Evaluate(const TGrid &grid, int nMinX, int nMinY, int nMaxX, int nMaxY, const CVector2D &pos, float &value, CVector2D &gradient, float *hessian)
+		{
+			float f[16];
+
+			_gather(grid, nMinX, nMinY, nMaxX, nMaxY, pos, f);
+			_evaluate(f, pos.x - floor(pos.x), pos.y - floor(pos.y), value, gradient, hessian);
+		}
+
+	protected:
+		__inline static bool _inside(const CVector2D &pos, int nMinX, int nMinY, int nMaxX, int nMaxY) {
+			return pos.x >= nMinX && pos.y >= nMinY && pos.x <= nMaxX && pos.y <= nMaxY;
+		}
+
+		/**
+		 *	Stores the outcome of a search in pResult, if it is not nullptr.
+		 *
+		 *	@return Returns true, if nResult is CONVERGED.
+		 */
+		__inline static bool _result(SEARCH_RESULT nResult, SEARCH_RESULT *pResult) {
+			if (pResult) *pResult = nResult;
+			return (nResult == CONVERGED);
+		}
+
+		/**
+		 *	Copies the 4x4 grid points around a location, clamped to the bounds, to f, row by row.
+		 */
+		template <class TGrid>
+		static void _gather(const TGrid &grid, int nMinX, int nMinY, int nMaxX, int nMaxY, const CVector2D &pos, float *f)
+		{
+			const int px = static_cast<int>(floor(pos.x));
+			const int py = static_cast<int>(floor(pos.y));
+
+			for (int y = 0; y < 4; y++)
+			{
+				const int gy = (py + y - 1 < nMinY)? nMinY : ( (py + y - 1 > nMaxY)? nMaxY : py + y - 1 );
+
+				for (int x = 0; x < 4; x++) 
+				{
+					const int gx = (px + x - 1 < nMinX)? nMinX : ( (px + x - 1 > nMaxX)? nMaxX : px + x - 1 );
+					f[y * 4 + x] = grid.GetAt(gx, gy);
+				}
+			}
+		}
+
+		/**
+		 *	Interpolates value, gradient and Hessian (xx, xy, yy) from the 4x4 grid points f at the location (wx, wy) within the central cell.
+		 */
+		static void _evaluate(const float *f, float wx, float wy, float &value, CVector2D &gradient, float *hessian);
+
+		/**
+		 *	Computes a Newton step, if the Hessian is negative definite, or a gradient step otherwise. The step is limited to m_fMaxStep.
+		 *
+		 *	@return Returns true for a Newton step.
+		 */
+		bool _getStep(const CVector2D &gradient, const float *hessian, CVector2D &step) const;
+
+		/**
+		 *	Sufficient decrease of the gradient for Newton steps, sufficient increase of the value for gradient steps.
+		 */
+		static bool _accept(bool bNewton, float alpha, const CVector2D &step, float value, const CVector2D &gradient, float trialValue, const CVector2D &trialGradient);
+	};
+}
@@ -0,0 +1,178 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "StdAfx.h"
+#include "OccupancyGrid.h"
+
+namespace FICore
+{
+	//A sample carries flow, if its vector is finite and not zero
+	static __inline bool _isLiveSample(const CVector2D &v)
+	{
+		return isFiniteNumber(v.x) && isFiniteNumber(v.y) && (v.x != 0.0f || v.y != 0.0f);
+	}
+
+	COccupancyGrid::COccupancyGrid()
+	{
+		Clear();
+	}
+
+	void COccupancyGrid::Clear()
+	{
+		m_nCellsX		= 0;
+		m_nCellsY		= 0;
+		m_nBlocksX		= 0;
+		m_nBlocksY		= 0;
+		m_nNumLiveCells		= 0;
+		m_nNumBoundaryCells	= 0;
+		m_LiveMasks.clear();
+		m_BoundaryMasks.clear();
+		m_States.clear();
+	}
+
+	void COccupancyGrid::Build(const CVector2D *pData, const CRectF &rcDomain, int nSamplesX, int nSamplesY)
+	{
+		Clear();
+
+		if (!pData || nSamplesX < 2 || nSamplesY < 2) return;
+
+		m_rcDomain	= rcDomain;
+		m_nCellsX	= nSamplesX - 1;
+		m_nCellsY	= nSamplesY - 1;
+		m_nBlocksX	= (m_nCellsX + OG_BLOCK_SIZE - 1) / OG_BLOCK_SIZE;
+		m_nBlocksY	= (m_nCellsY + OG_BLOCK_SIZE - 1) / OG_BLOCK_SIZE;
+
+		m_LiveMasks.assign(m_nBlocksX * m_nBlocksY, 0);
+		m_BoundaryMasks.assign(m_nBlocksX * m_nBlocksY, 0);
+		m_States.assign(m_nBlocksX * m_nBlocksY, OG_EMPTY);
+
+		long long nNumLive = 0, nNumBoundary = 0;
+
+		//Each thread processes one row of blocks, and classifies each sample of the row only once
+		#pragma omp parallel for reduction(+:nNumLive,nNumBoundary) schedule(dynamic)
+		for (int by = 0; by < m_nBlocksY; by++)
+		{
+			const int nMinY		= by * OG_BLOCK_SIZE;
+			const int nNumRows	= min(OG_BLOCK_SIZE, m_nCellsY - nMinY) + 1;
+			vector<unsigned char> live(nNumRows * nSamplesX);
+
+			for (int y = 0; y < nNumRows; y++)
+			{
+				const CVector2D *pRow = pData + (nMinY + y) * nSamplesX;
+
+				for (int x = 0; x < nSamplesX; x++)
+					live[y * nSamplesX + x] = _isLiveSample(pRow[x])? 1 : 0;
+			}
+
+			for (int bx = 0; bx < m_nBlocksX; bx++)
+			{
+				const int nMinX			= bx * OG_BLOCK_SIZE;
+				const int nNumCols		= min(OG_BLOCK_SIZE, m_nCellsX - nMinX);
+				unsigned long long nLiveMask = 0, nBoundaryMask = 0;
+				int nLive = 0, nBoundary = 0;
+
+				for (int y = 0; y < nNumRows - 1; y++)
+				{
+					const unsigned char *pLive0 = &live[y * nSamplesX + nMinX];
+					const unsigned char *pLive1 = pLive0 + nSamplesX;
+
+					for (int x = 0; x < nNumCols; x++)
+					{
+						const int nCorners	= pLive0[x] + pLive0[x+1] + pLive1[x] + pLive1[x+1];
+						const int nBit		= y * OG_BLOCK_SIZE + x;
+
+						if (nCorners > 0) {
+							nLiveMask |= 1ULL << nBit;
+							nLive++;
+						}
+						if (nCorners > 0 && nCorners < 4) {
+							nBoundaryMask |= 1ULL << nBit;
+							nBoundary++;
+						}
+					}
+				}
+
+				const int nBlock = by * m_nBlocksX + bx;
+				m_LiveMasks[nBlock]		= nLiveMask;
+				m_BoundaryMasks[nBlock]	= nBoundaryMask;
+				m_States[nBlock]		= static_cast<unsigned char>( (nLive == 0)? OG_EMPTY : (nBoundary == 0 && nLive == nNumCols * (nNumRows - 1))? OG_FULL : OG_MIXED );
+				nNumLive		+= nLive;
+				nNumBoundary	+= nBoundary;
+			}
+		}
+
+		m_nNumLiveCells		= static_cast<size_t>(nNumLive);
+		m_nNumBoundaryCells	= static_cast<size_t>(nNumBoundary);
+	}
+
+	bool COccupancyGrid::_getCell(float x, float y, int &cx, int &cy) const
+	{
+		if (!(x >= 0.0f && y >= 0.0f && x <= m_nCellsX && y <= m_nCellsY)) return false;
+
+		cx = min(static_cast<int>(x), m_nCellsX - 1);
+		cy = min(static_cast<int>(y), m_nCellsY - 1);
+
+		return true;
+	}
+
+	bool COccupancyGrid::IsLive(float x, float y) const
+	{
+		//An empty grid has no extents. Otherwise locations outside the grid are dead, even if all cells are live.
+		if (m_nCellsX == 0 || m_nCellsY == 0) return true;
+
+		int cx, cy;
+		if (!_getCell(x, y, cx, cy)) return false;
+
+		if (IsFull()) return true;
+
+		switch (GetBlockState(cx / OG_BLOCK_SIZE, cy / OG_BLOCK_SIZE))
+		{
+			case OG_EMPTY:	return false;
+			case OG_FULL:	return true;
+			default:		return IsLiveCell(cx, cy);
+		}
+	}
+
+	bool COccupancyGrid::IsLive(const CPointf &posD) const
+	{
+		const float x = (posD.x - m_rcDomain.m_Min.x) / m_rcDomain.getWidth() * m_nCellsX;
+		const float y = (posD.y - m_rcDomain.m_Min.y) / m_rcDomain.getHeight() * m_nCellsY;
+
+		return IsLive(x, y);
+	}
+
+	bool COccupancyGrid::IsBoundary(float x, float y) const
+	{
+		if (IsFull()) return false;
+
+		int cx, cy;
+		if (!_getCell(x, y, cx, cy)) return false;
+
+		return (GetBlockState(cx / OG_BLOCK_SIZE, cy / OG_BLOCK_SIZE) == OG_MIXED) && IsBoundaryCell(cx, cy);
+	}
+}
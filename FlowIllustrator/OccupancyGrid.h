@@ -0,0 +1,165 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#pragma once
+#include "DataField.h"
+#include "Vector2D.h"
+#include <vector>
+
+using namespace std;
+
+#define OG_BLOCK_SIZE	8	//Edge length of a block in cells. The cells of a block are stored as the bits of a 64 bit mask.
+
+/**
+ *	Occupancy of a block of cells in a COccupancyGrid.
+ */
+enum OCCUPANCY
+{
+	OG_EMPTY = 0,	/**< All cells of the block are dead. */
+	OG_MIXED,		/**< The block contains live cells, and cells with at least one dead sample. */
+	OG_FULL			/**< All samples of the block are live. */
+};
+
+namespace FICore
+{
+	/**
+	 *	COccupancyGrid marks the cells of a vector field, that contain flow.
+	 *
+	 *	A sample is dead, if its vector is zero or not finite, as inside solid obstacles or masked regions.
+	 *	A cell is dead, if all four of its samples are dead, hence cells along the boundary of an obstacle stay live.
+	 *	Live cells with at least one dead sample are boundary cells, where the flow may stagnate towards the obstacle.
+	 *	Cells are grouped into square blocks of OG_BLOCK_SIZE cells, which are classified as a whole, such that 
+	 *	consumers can skip empty blocks without looking at their cells.
+	 *
+	 *	The grid is built in a single parallel pass. Queries are read-only and can be issued from multiple threads.
+	 */
+	class COccupancyGrid
+	{
+	protected:
+		CRectF						m_rcDomain;			/**< Domain of the vector field. */
+		int							m_nCellsX;			/**< Number of cells in x-direction. */
+		int							m_nCellsY;			/**< Number of cells in y-direction. */
+		int							m_nBlocksX;			/**< Number of blocks in x-direction. */
+		int							m_nBlocksY;			/**< Number of blocks in y-direction. */
+		vector<unsigned long long>	m_LiveMasks;		/**< One bit per cell of each block, set for live cells. Bit y*OG_BLOCK_SIZE+x is cell (x,y) of the block. */
+		vector<unsigned long long>	m_BoundaryMasks;	/**< One bit per cell of each block, set for boundary cells. */
+		vector<unsigned char>		m_States;			/**< The OCCUPANCY of each block. */
+		size_t						m_nNumLiveCells;	/**< Total number of live cells. */
+		size_t						m_nNumBoundaryCells;/**< Total number of boundary cells. */
+
+	public:
+		COccupancyGrid();
+
+	public:
+		/**
+		 *	Classifies the cells of a single frame of a vector field.
+		 *
+		 *	@param pData Pointer to the vectors of the frame, row by row.
+		 *	@param rcDomain The domain of the vector field.
+		 *	@param nSamplesX Number of samples in x-direction.
+		 *	@param nSamplesY Number of samples in y-direction.
+		 */
+		void Build(const CVector2D *pData, const CRectF &rcDomain, int nSamplesX, int nSamplesY);
+
+		/**
+		 *	Removes all cells. An empty grid reports every location as live.
+		 */
+		void Clear();
+
+		/**
+		 *	Checks, if the cell containing a location in grid space is live. Locations outside the grid are dead.
+		 */
+		bool IsLive(float x, float y) const;
+
+		/**
+		 *	Checks, if the cell containing a location in domain space is live. Locations outside the domain are dead.
+		 */
+		bool IsLive(const CPointf &posD) const;
+
+		/**
+		 *	Checks, if the cell containing a location in grid space is a boundary cell.
+		 */
+		bool IsBoundary(float x, float y) const;
+
+		/**
+		 *	Checks, if a cell is live. The cell must lie inside the grid.
+		 */
+		__inline bool IsLiveCell(int cx, int cy) const {
+			return _testBit(m_LiveMasks, cx, cy);
+		}
+
+		/**
+		 *	Checks, if a cell is a boundary cell. The cell must lie inside the grid.
+		 */
+		__inline bool IsBoundaryCell(int cx, int cy) const {
+			return _testBit(m_BoundaryMasks, cx, cy);
+		}
+
+		/**
+		 *	Retrieve the OCCUPANCY of a block.
+		 */
+		__inline OCCUPANCY GetBlockState(int bx, int by) const {
+			return static_cast<OCCUPANCY>( m_States[by * m_nBlocksX + bx] );
+		}
+
+		/**
+		 *	Retrieve the number of blocks in x-direction.
+		 */
+		__inline int GetNumBlocksX() const { return m_nBlocksX; }
+
+		/**
+		 *	Retrieve the number of blocks in y-direction.
+		 */
+		__inline int GetNumBlocksY() const { return m_nBlocksY; }
+
+		/**
+		 *	Retrieve the number of live cells.
+		 */
+		__inline size_t GetNumLiveCells() const { return m_nNumLiveCells; }
+
+		/**
+		 *	Checks, if all samples are live. Consumers should skip all other queries in this case.
+		 */
+		__inline bool IsFull() const { 
+			return m_nNumBoundaryCells == 0 && m_nNumLiveCells == static_cast<size_t>(m_nCellsX) * m_nCellsY; 
+		}
+
+	protected:
+		__inline bool _testBit(const vector<unsigned long long> &masks, int cx, int cy) const {
+			const int nBlock = (cy / OG_BLOCK_SIZE) * m_nBlocksX + cx / OG_BLOCK_SIZE;
+			return ( masks[nBlock] >> ((cy % OG_BLOCK_SIZE) * OG_BLOCK_SIZE + cx % OG_BLOCK_SIZE) & 1 ) != 0;
+		}
+
+		/**
+		 *	Computes the index of the cell containing a location in grid space.
+		 *
+		 *	@return Returns false, if the location lies outside the grid.
+		 */
+		bool _getCell(float x, float y, int &cx, int &cy) const;
+	};
+}
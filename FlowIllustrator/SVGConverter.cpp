@@ -35,6 +35,7 @@
 #include "TimeLine.h"
 #include "Rectangle.h"
 #include "FlowIllustratorDoc.h"
+#include "FlowIllustratorRenderView.h"
 #include <cctype>
 
 
@@ -494,6 +495,12 @@ CString CSVGConverter::GetSVGString(CDocument &document)
 			str += pMngr->GetAt(i)->toString(fLineWidthFactor);
 		}
 
+		//Iso contours are exported as plain paths, which are skipped by LoadSVG()
+		const CFlowIllustratorRenderView *pView = reinterpret_cast<CFlowIllustratorRenderView*>(doc.GetActiveView());
+		if (pView) {
+			str += pView->GetIsoContoursSVGString(fLineWidthFactor);
+		}
+
 		str += _T("\n</g>\n\n</svg>");
 	}
 
@@ -28,9 +28,11 @@
 #include "StdAfx.h"
 #include "ScalarField.h"
 #include "Vector2D.h"
+#include "GaussianFilter.h"
 
 #define _USE_MATH_DEFINES 
 #include <math.h>
+#include <algorithm>
 
 
 namespace FICore
@@ -117,89 +119,21 @@ namespace FICore
 	}
 
 	/*
-		Smoothes the scalar field using a gaussian filter
-		This implementation uses the property of a gaussian that it is seperable.
-		In order to achieve a better performance, the image is rotated by 90 when the 
-		convolution in the first dimension is computed. This allows to take better advantage
-		of the serial layout of the main memory and reduces the "jumps" between rows otherwise
+		Smoothes the scalar field using a gaussian filter with a standard deviation of SIGMA samples.
+		The kernel is truncated at nKernelHalfSize, see CGaussianFilter.
 	*/
 	void CScalarField2D::Smooth(int nKernelHalfSize)
 	{
-		CScalarField2D dummy(m_rcDomain, m_nSamplesX, m_nSamplesY);	//Receives the intermediate (rotated) result after the first step
-	
-		float *pKernel = _GetGaussKernel(nKernelHalfSize);
+		CGaussianFilter filter(SIGMA, nKernelHalfSize);
 
-		//Step One, convolve in x
-		for (int j = 0; j < m_nSamplesY; j++)
-		{
-			for (int i = 0; i < m_nSamplesX; i++)
-			{
-				register float sum(0.0f);
-
-				//Loop over kernel
-				for (int k = -nKernelHalfSize; k <= nKernelHalfSize; k++)
-				{
-					//enforces a black boundary
-					if (i+k > -1 &&  i+k < m_nSamplesX) // ( j >= 0 && j < m_nSamplesY) // implicitly given
-					{
-						sum += pKernel[k+nKernelHalfSize] * m_pField[j*m_nSamplesX + i + k];
-					}
-				}
-
-				//Automatically rotate
-				dummy.m_pField[i*m_nSamplesY + j] = sum;
-			}
-		}
-
-		//Setp 2, convolve in y
-		for (int j = 0; j < m_nSamplesX; j++)
-		{
-			for (int i = 0; i < m_nSamplesY; i++)
-			{
-				register float sum(0.0f);
-
-				//Loop over kernel
-				for (int k = -nKernelHalfSize; k <= nKernelHalfSize; k++)
-				{
-					//enforces a black boundary
-					if (i+k > -1 &&  i+k < m_nSamplesY) // ( j >= 0 && j < m_nSamplesY) // implicitly given
-					{
-						sum += pKernel[k+nKernelHalfSize] * dummy.m_pField[j*m_nSamplesY + i + k];
-					}
-				}
-
-				//Automatically rotate back to original position
-				m_pField[i*m_nSamplesX + j] = sum;
-			}
-		}
-
-		delete pKernel;
+		filter.Apply(m_pField, m_nSamplesX, m_nSamplesY);
 	}
 
-	/*
-		Computes the kernel for gaussian convolution and returns a pointer to it
-	*/
-	float* CScalarField2D::_GetGaussKernel(int nKernelHalfSize)
+	void CScalarField2D::SmoothGaussian(float fSigma)
 	{
-		int kSize = 2 * nKernelHalfSize + 1;
-		float *pKernel = new float [ kSize ];
-
-		//fill with values
-		float sum = 0.0f;
-
-		for (int k = -nKernelHalfSize; k <= nKernelHalfSize; k++) 
-		{
-			pKernel[k+nKernelHalfSize] = static_cast<float>((((1.0/(sqrt(2.0*M_PI)*SIGMA))*(exp(-(float)(k*k)/(2.0*SIGMA*SIGMA))))));
-			sum += pKernel[k+nKernelHalfSize];
-		}
+		CGaussianFilter filter(fSigma);
 
-		//Normalize
-		for (int i = 0; i < kSize; i++) 
-		{
-			pKernel[i] /= sum;
-		}
-
-		return pKernel;
+		filter.Apply(m_pField, m_nSamplesX, m_nSamplesY);
 	}
 
 	/*
@@ -212,32 +146,41 @@ namespace FICore
 		ptEnd:		Location of the local maximum
 
 	*/
-	bool CScalarField2D::GradientAscent(const CPointf& ptStart, CPointf& ptEnd) const
+	bool CScalarField2D::GradientAscent(const CPointf& ptStart, CPointf& ptEnd, int *pNumIterations) const
 	{
 		CVector2D pos;
 		_getGridCoordinates(ptStart.x, ptStart.y, pos.x, pos.y);
 
-		CVector2D gradient = _getDerivative(pos.x, pos.y);
-
-		static const float step = .1f;
+		CLocalMaximumSearch search;
 
-		while ( gradient.abs() > 1e-3)
-		{
-			if (!_insideGrid(pos)) {
-				ptEnd.x = -1;
-				ptEnd.y = -1;
-				return false;
-			}
-
-			pos = pos + (gradient*step);
-			gradient = _getDerivative(pos.x, pos.y);
-		
+		if (!search.Search(*this, 0, 0, m_nSamplesX-1, m_nSamplesY-1, pos, pNumIterations)) {
+			ptEnd.x = -1;
+			ptEnd.y = -1;
+			return false;
 		}
+
 		_getDomainCoordinates(pos.x, pos.y, ptEnd.x, ptEnd.y);
 
 		return true;
 	}
 
+	size_t CScalarField2D::GradientAscent(const vector<CPointf> &ptStart, vector<CPointf> &ptEnd, vector<int> *pNumIterations) const
+	{
+		const int nNumPoints = static_cast<int>(ptStart.size());
+		size_t nNumFound = 0;
+
+		ptEnd.resize(nNumPoints);
+		if (pNumIterations) pNumIterations->resize(nNumPoints);
+
+		#pragma omp parallel for reduction(+:nNumFound) schedule(dynamic, 16)
+		for (int i = 0; i < nNumPoints; i++) {
+			if (GradientAscent(ptStart[i], ptEnd[i], (pNumIterations)? &(*pNumIterations)[i] : nullptr))
+				nNumFound++;
+		}
+
+		return nNumFound;
+	}
+
 	/*
 		Returns the derivative at the specified grid location.
 		By default this function returns central differences.
@@ -279,21 +222,38 @@ namespace FICore
 	*/
 	CScalarField2D* CScalarField2D::Abs() const
 	{
-		int numElements = m_nSamplesX*m_nSamplesY;
+		const int numElements = m_nSamplesX*m_nSamplesY;
 
 		CScalarField2D* retVal = new CScalarField2D(m_rcDomain, m_nSamplesX, m_nSamplesY);
 
-		float min =m_pField[0], max =0.0f;
-	
+		if (numElements == 0) return retVal;
+
+		const int nNumRows = m_nSamplesY;
+		vector<float> rowMin(nNumRows), rowMax(nNumRows);
+
+		//Single sweep per row, which also yields the range
+		#pragma omp parallel for
+		for (int j = 0; j < nNumRows; j++)
+		{
+			const float *pSrc	= m_pField + j * m_nSamplesX;
+			float *pDst			= retVal->m_pField + j * m_nSamplesX;
+			float min(fabs(pSrc[0])), max(min);
+
+			for (int i = 0; i < static_cast<int>(m_nSamplesX); i++)
+			{
+				const float curr(fabs(pSrc[i]));
+
+				if (curr > max) max = curr;
+				if (curr < min) min = curr;
+
+				pDst[i] = curr;
+			}
 
-		for (int i =0; i < numElements; i++) {
-			float curr (fabs(m_pField[i]));
-			if (curr > max) max = curr;
-			else if(curr < min) min = curr;
-			(*retVal)[i] = curr;
+			rowMin[j] = min;
+			rowMax[j] = max;
 		}
 
-		retVal->SetMinMax(min, max);
+		retVal->SetMinMax(*min_element(rowMin.begin(), rowMin.end()), *max_element(rowMax.begin(), rowMax.end()));
 
 		return retVal;
 	}
@@ -29,6 +29,10 @@
 #include "DataField.h"
 #include "RectF.h"
 #include "Vector2D.h"
+#include "LocalMaximumSearch.h"
+#include <vector>
+
+using namespace std;
 
 namespace FICore
 {
@@ -152,24 +156,45 @@ namespace FICore
 		 *	
 		 *	@param nKernelHalfSize The kernel halfsize of the filterkernel, used to smooth this CScalarField2D.
 		 *
-		 *	@remarks	The size of the actual filter kernel is 2*nKernelHalfSize + 1.
-		 *				Greater filter kernels cause a stronger smoothing/bluring of the CScalarField2D.
-		 *				However, this can also cause a considerable drop in performance.
+		 *	@remarks	The size of the actual filter kernel is 2*nKernelHalfSize + 1, and its standard deviation is two samples.
+		 *				Half sizes beyond four standard deviations do not increase the smoothing any further.
 		 */
 		void Smooth(int nKernelHalfSize);
 
+		/**
+		 *	Applies a Gaussian smoothing operation with the specified standard deviation to this entire CScalarField2D.
+		 *
+		 *	@param fSigma The standard deviation in samples.
+		 *
+		 *	@remarks	The costs do not depend on fSigma for large standard deviations, see CGaussianFilter.
+		 */
+		void SmoothGaussian(float fSigma);
+
 		/**
 		 *	Perform gradient ascent to find a local maximum.
 		 *
 		 *	@param ptStart Reference to CPointf to a location in domain space, from where the gradient ascent is started.
 		 *	@param ptEnd Reference to a CPointf to receive the location of the local maximum in domain coordinates.
+		 *	@param pNumIterations Optional pointer to an int, that receives the number of iterations.
 		 *
 		 *	@return This function returns true, if a local maximum was found, otherwise false.
 		 *
-		 *	@remarks	This function returns true if the length of the local gradient vector is less than 1e-3.
-		 *				If the search for a local maximum crosses grid/domain boundaries, the search is aborted, and false is returned.
+		 *	@remarks	The search is performed by a CLocalMaximumSearch with its default settings.
+		 *				If the search for a local maximum crosses grid/domain boundaries, or does not converge, 
+		 *				the search is aborted, ptEnd is set to (-1,-1) and false is returned.
+		 */
+		bool GradientAscent(const CPointf& ptStart, CPointf& ptEnd, int *pNumIterations = nullptr) const;
+
+		/**
+		 *	Perform gradient ascent for many start locations in parallel.
+		 *
+		 *	@param ptStart The locations in domain space, from where the searches are started.
+		 *	@param ptEnd Receives the location of each local maximum in domain coordinates, or (-1,-1) if the respective search failed.
+		 *	@param pNumIterations Optional pointer to a vector, that receives the number of iterations of each search.
+		 *
+		 *	@return The number of successful searches.
 		 */
-		bool GradientAscent(const CPointf& ptStart, CPointf& ptEnd) const;
+		size_t GradientAscent(const vector<CPointf> &ptStart, vector<CPointf> &ptEnd, vector<int> *pNumIterations = nullptr) const;
 
 		/**
 		 *	Retrieve the gradient vector at the specified location.
@@ -217,7 +242,6 @@ namespace FICore
 		}
 
 	private:
-		float* _GetGaussKernel(int nKernelHalfSize);
 		float _getValue(float x, float y) const;
 		CVector2D _getDerivative(float x, float y) const;
 		bool _insideGrid(const CVector2D& pos) const;
@@ -0,0 +1,374 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "StdAfx.h"
+#include "ScaleSpace.h"
+#include "GaussianFilter.h"
+#include "GridPyramid.h"
+#include <math.h>
+#include <algorithm>
+#include <xmmintrin.h>
+
+#define SS_MIN_EXTENT		3		//Levels have at least this number of samples per row and column
+
+namespace FICore
+{
+	static bool _responseGreater(const ScaleSpaceExtremum &a, const ScaleSpaceExtremum &b)
+	{
+		return fabs(a.fResponse) > fabs(b.fResponse);
+	}
+
+	//Largest magnitude of nCount floats
+	static float _getMaxMagnitude(const float *pData, int nCount)
+	{
+		__m128 vMax = _mm_setzero_ps();
+		__m128 vMin = _mm_setzero_ps();
+
+		int i = 0;
+
+		for (; i + 4 <= nCount; i += 4)
+		{
+			const __m128 v = _mm_loadu_ps(pData + i);
+			vMax = _mm_max_ps(vMax, v);
+			vMin = _mm_min_ps(vMin, v);
+		}
+
+		float pMax[4], pMin[4];
+		_mm_storeu_ps(pMax, vMax);
+		_mm_storeu_ps(pMin, vMin);
+
+		float fMax = max(max(pMax[0], pMax[1]), max(pMax[2], pMax[3]));
+		float fMin = min(min(pMin[0], pMin[1]), min(pMin[2], pMin[3]));
+
+		for (; i < nCount; i++)
+		{
+			fMax = max(fMax, pData[i]);
+			fMin = min(fMin, pData[i]);
+		}
+
+		return max(fMax, -fMin);
+	}
+
+	//Offset of the vertex of the parabola through (-1, a), (0, b), (1, c)
+	static float _parabolicOffset(float a, float b, float c)
+	{
+		const float fDenom = a - 2.0f * b + c;
+
+		if (fDenom == 0.0f) return 0.0f;
+
+		return min(max(0.5f * (a - c) / fDenom, -0.5f), 0.5f);
+	}
+
+	//Height of the vertex of the parabola through (-1, a), (0, b), (1, c)
+	static float _parabolicPeak(float a, float b, float c)
+	{
+		const float fOffset = _parabolicOffset(a, b, c);
+
+		return b - 0.25f * (a - c) * fOffset;
+	}
+
+	//Height of the vertex of the Gaussian through (-1, a), (0, b), (1, c), i.e. of the parabola through their logarithms.
+	//Unlike the parabola, it does not flatten the peak of a smoothed blob, that is sampled coarsely.
+	static float _gaussianPeak(float a, float b, float c)
+	{
+		if (a * b <= 0.0f || b * c <= 0.0f) return _parabolicPeak(a, b, c);
+
+		const float fSign = (b < 0.0f)? -1.0f : 1.0f;
+
+		return fSign * exp(_parabolicPeak(log(fSign * a), log(fSign * b), log(fSign * c)));
+	}
+
+	CScaleSpace::CScaleSpace(float fBaseSigma, float fGamma)
+	{
+		m_fBaseSigma	= max(fBaseSigma, 0.5f);
+		m_fGamma		= fGamma;
+	}
+
+	void CScaleSpace::Clear()
+	{
+		m_Levels.clear();
+	}
+
+	void CScaleSpace::Build(const float *pData, int nWidth, int nHeight, int nNumLevels)
+	{
+		if (!pData || nWidth < SS_MIN_EXTENT || nHeight < SS_MIN_EXTENT || nNumLevels < 1) {
+			Clear();
+			return;
+		}
+
+		//Levels of a previous build keep their memory, so rebuilding a pyramid of the same size does not allocate
+		int nLevels = 1;
+
+		for (int w = nWidth, h = nHeight; nLevels < nNumLevels; nLevels++)
+		{
+			w = (w + 1) / 2;
+			h = (h + 1) / 2;
+
+			if (w < SS_MIN_EXTENT || h < SS_MIN_EXTENT) break;
+		}
+
+		m_Levels.resize(nLevels);
+
+		Level &finest	= m_Levels[0];
+		finest.nWidth	= nWidth;
+		finest.nHeight	= nHeight;
+		finest.nStride	= 1;
+		finest.fSigma	= m_fBaseSigma;
+		finest.fNorm	= pow(finest.fSigma, m_fGamma);
+		finest.data.assign(pData, pData + nWidth * nHeight);
+
+		CGaussianFilter filter(m_fBaseSigma);
+		filter.Apply(&finest.data[0], nWidth, nHeight);
+
+		//The binomial kernel of the reduction has a variance of one sample of the finer level
+		for (int l = 1; l < nLevels; l++)
+		{
+			const Level &src	= m_Levels[l-1];
+			Level &dst			= m_Levels[l];
+
+			dst.nWidth	= (src.nWidth + 1) / 2;
+			dst.nHeight	= (src.nHeight + 1) / 2;
+			dst.nStride	= src.nStride * 2;
+			dst.fSigma	= sqrt(src.fSigma * src.fSigma + static_cast<float>(src.nStride * src.nStride));
+			dst.fNorm	= pow(dst.fSigma, m_fGamma);
+			dst.data.resize(dst.nWidth * dst.nHeight);
+
+			CGridPyramid::Reduce(&src.data[0], src.nWidth, src.nHeight, 1, &dst.data[0]);
+		}
+	}
+
+	float CScaleSpace::GetAt(int nLevel, float x, float y) const
+	{
+		const Level &level = m_Levels[nLevel];
+
+		//To the samples of the level
+		x /= level.nStride;
+		y /= level.nStride;
+
+		x = min(max(x, 0.0f), static_cast<float>(level.nWidth - 1));
+		y = min(max(y, 0.0f), static_cast<float>(level.nHeight - 1));
+
+		const int px	= min(static_cast<int>(x), level.nWidth - 2);
+		const int py	= min(static_cast<int>(y), level.nHeight - 2);
+		const float wx	= x - px;
+		const float wy	= y - py;
+
+		const float *p = &level.data[py * level.nWidth + px];
+
+		return	(p[0] * (1.0f - wx) + p[1] * wx) * (1.0f - wy) + 
+				(p[level.nWidth] * (1.0f - wx) + p[level.nWidth + 1] * wx) * wy;
+	}
+
+	void CScaleSpace::_getNeighbourhood(int nLevel, int x, int y, int nStride, float *pValues) const
+	{
+		const float fNorm = m_Levels[nLevel].fNorm;
+
+		for (int j = -1; j <= 1; j++)
+		{
+			for (int i = -1; i <= 1; i++)
+				*pValues++ = fNorm * GetAt(nLevel, static_cast<float>(x + i * nStride), static_cast<float>(y + j * nStride));
+		}
+	}
+
+	float CScaleSpace::_getPeakValue(int nLevel, float x, float y) const
+	{
+		const int nStride = m_Levels[nLevel].nStride;
+
+		//Nearest sample of the level
+		const int px = static_cast<int>(x / nStride + 0.5f) * nStride;
+		const int py = static_cast<int>(y / nStride + 0.5f) * nStride;
+
+		float pValues[9];
+		_getNeighbourhood(nLevel, px, py, nStride, pValues);
+
+		//Along x and along y through the sample. The logarithm of a Gaussian is separable, so the peaks multiply.
+		const float fPeakX = _gaussianPeak(pValues[3], pValues[4], pValues[5]);
+		const float fPeakY = _gaussianPeak(pValues[1], pValues[4], pValues[7]);
+
+		if (fPeakX * pValues[4] <= 0.0f || fPeakY * pValues[4] <= 0.0f)
+			return fPeakX + fPeakY - pValues[4];
+
+		return fPeakX * fPeakY / pValues[4];
+	}
+
+	size_t CScaleSpace::FindExtrema(vector<ScaleSpaceExtremum> &extrema, float fThreshold, bool bMinima) const
+	{
+		extrema.clear();
+
+		const int nNumLevels = GetNumLevels();
+
+		if (nNumLevels < 3) return 0;
+
+		//Largest magnitude of the finest level
+		const Level &finest	= m_Levels[0];
+		const float *pData	= &finest.data[0];
+		float fMax(0.0f);
+
+		#pragma omp parallel
+		{
+			float fLocalMax(0.0f);
+
+			#pragma omp for
+			for (int j = 0; j < finest.nHeight; j++)
+				fLocalMax = max(fLocalMax, _getMaxMagnitude(pData + j * finest.nWidth, finest.nWidth));
+
+			#pragma omp critical
+			fMax = max(fMax, fLocalMax);
+		}
+
+		if (fMax <= 0.0f) return 0;
+
+		const float fMin = fThreshold * fMax;
+
+		//All rows of all inner levels are searched in parallel
+		vector< pair<int, int> > rows;
+
+		for (int l = 1; l < nNumLevels - 1; l++)
+		{
+			for (int j = 1; j < m_Levels[l].nHeight - 1; j++)
+				rows.push_back( make_pair(l, j) );
+		}
+
+		const int nNumRows = static_cast<int>(rows.size());
+
+		#pragma omp parallel
+		{
+			vector<ScaleSpaceExtremum> found;
+
+			#pragma omp for schedule(dynamic, 16)
+			for (int r = 0; r < nNumRows; r++)
+			{
+				const int l				= rows[r].first;
+				const int j				= rows[r].second;
+				const Level &level		= m_Levels[l];
+				const Level &finer		= m_Levels[l-1];
+				const int nWidth		= level.nWidth;
+				const float *pRow		= &level.data[j * nWidth];
+				const float *pAbove		= pRow - nWidth;
+				const float *pBelow		= pRow + nWidth;
+
+				for (int i = 1; i < nWidth - 1; i++)
+				{
+					//Spatial extremum within the level. Most samples are rejected here, so the neighbours are 
+					//reduced to their range without branches, which noise would mispredict half of the time.
+					const float fNeighbourMax = max(max(max(pAbove[i-1], pAbove[i]), max(pAbove[i+1], pRow[i-1])), 
+													max(max(pRow[i+1], pBelow[i-1]), max(pBelow[i], pBelow[i+1])));
+					const float fNeighbourMin = min(min(min(pAbove[i-1], pAbove[i]), min(pAbove[i+1], pRow[i-1])), 
+													min(min(pRow[i+1], pBelow[i-1]), min(pBelow[i], pBelow[i+1])));
+
+					const bool bMaximum = (pRow[i] > fNeighbourMax && pRow[i] > 0.0f);
+					const bool bMinimum = (pRow[i] < fNeighbourMin && pRow[i] < 0.0f && bMinima);
+
+					if (!bMaximum && !bMinimum) continue;
+
+					const float fSign = bMaximum? 1.0f : -1.0f;
+
+					//A blob at its own scale is smoothed to about half its height, so it is compared on the finest level
+					if (fSign * finest.data[min(j * level.nStride, finest.nHeight - 1) * finest.nWidth + min(i * level.nStride, finest.nWidth - 1)] < fMin) continue;
+
+					//Extremum across scales. The peak lies within half a sample of this one, 
+					//so the finer level is compared at its own samples around it.
+					const int x			= i * level.nStride;
+					const int y			= j * level.nStride;
+					const float fVal	= level.fNorm * pRow[i];
+
+					//The samples right above and below in scale reject most candidates, before the neighbourhoods are interpolated.
+					//The finer level has a sample at (x, y).
+					if (fSign * finer.fNorm * finer.data[(2*j) * finer.nWidth + 2*i] >= fSign * fVal || 
+						fSign * m_Levels[l+1].fNorm * GetAt(l + 1, static_cast<float>(x), static_cast<float>(y)) >= fSign * fVal) continue;
+
+					bool bExtremum = true;
+
+					float pFiner[9], pCoarser[9];
+					_getNeighbourhood(l - 1, x, y, finer.nStride, pFiner);
+					_getNeighbourhood(l + 1, x, y, level.nStride, pCoarser);
+
+					int nFinerPeak = 4;
+
+					for (int k = 0; k < 9 && bExtremum; k++)
+					{
+						bExtremum = (fSign * pFiner[k] < fSign * fVal) && (fSign * pCoarser[k] < fSign * fVal);
+
+						if (fSign * pFiner[k] > fSign * pFiner[nFinerPeak]) nFinerPeak = k;
+					}
+
+					if (!bExtremum) continue;
+
+					//The finer level samples the peak twice as densely, so it is located there
+					const int fx = x + (nFinerPeak % 3 - 1) * finer.nStride;
+					const int fy = y + (nFinerPeak / 3 - 1) * finer.nStride;
+
+					float pPeak[9];
+					_getNeighbourhood(l - 1, fx, fy, finer.nStride, pPeak);
+
+					ScaleSpaceExtremum e;
+					e.pos		= CVector2D(fx + _parabolicOffset(pPeak[3], pPeak[4], pPeak[5]) * finer.nStride, 
+											fy + _parabolicOffset(pPeak[1], pPeak[4], pPeak[7]) * finer.nStride);
+					e.fScale	= _getBlobScale(l, e.pos.x, e.pos.y, _parabolicOffset(pFiner[4], fVal, pCoarser[4]));
+					e.fResponse	= fVal;
+					e.fValue	= GetAt(l, e.pos.x, e.pos.y);
+					e.nLevel	= l;
+
+					found.push_back(e);
+				}
+			}
+
+			#pragma omp critical
+			extrema.insert(extrema.end(), found.begin(), found.end());
+		}
+
+		sort(extrema.begin(), extrema.end(), _responseGreater);
+
+		return extrema.size();
+	}
+
+	float CScaleSpace::_getBlobScale(int nLevel, float x, float y, float fOffset) const
+	{
+		const Level &level = m_Levels[nLevel];
+		const Level &finer = m_Levels[nLevel-1];
+
+		//A Gaussian blob of standard deviation a decays as a^2 / (a^2 + sigma^2) with the smoothing sigma,
+		//so the peak values of two levels determine a. They are interpolated from the samples around 
+		//the peak, since sampling in between flattens coarse levels noticeably.
+		//The model holds for the smoothed values, not for the normalized response.
+		const float f1 = _getPeakValue(nLevel-1, x, y) / finer.fNorm;
+		const float f2 = _getPeakValue(nLevel, x, y) / level.fNorm;
+		const float s1 = finer.fSigma * finer.fSigma;
+		const float s2 = level.fSigma * level.fSigma;
+
+		if (fabs(f1) > fabs(f2) && f1 * f2 > 0.0f)
+		{
+			const float a2 = (f2 * s2 - f1 * s1) / (f1 - f2);
+
+			if (a2 > s1 && a2 < 4.0f * s2) 
+				return sqrt(a2);
+		}
+
+		//Otherwise by the parabola through the responses in log(sigma)
+		return level.fSigma * pow(2.0f, fOffset);
+	}
+}
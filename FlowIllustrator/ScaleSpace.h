@@ -0,0 +1,151 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+#include "Vector2D.h"
+#include <vector>
+
+using namespace std;
+
+#define SS_BASE_SIGMA	0.57735f	//Default standard deviation of the finest level. With 1/sqrt(3), the levels are exactly an octave apart.
+
+namespace FICore
+{
+	/**
+	 *	A local extremum of the scale-normalized response of a CScaleSpace, in space and across scales.
+	 */
+	struct ScaleSpaceExtremum
+	{
+		CVector2D	pos;		/**< Location in samples of the finest level, with sub-sample accuracy. */
+		float		fScale;		/**< Characteristic scale, i.e. the standard deviation at which the response peaks, in samples of the finest level. */
+		float		fResponse;	/**< Scale-normalized response at the extremum. It is negative for minima. */
+		float		fValue;		/**< Value of the smoothed field at the extremum. */
+		int			nLevel;		/**< The level, at which the extremum was found. */
+	};
+
+	/**
+	 *	CScaleSpace is a Gaussian pyramid of a scalar grid, i.e. the grid smoothed at standard deviations, that double from one level
+	 *	to the next. Only the finest level is smoothed by a CGaussianFilter. Each coarser level is reduced from the previous one by the 
+	 *	5-tap binomial filter of CGridPyramid::Reduce(), which adds a variance of one sample of the finer level, and which is only 
+	 *	evaluated at the kept samples. Each level thus holds the same standard deviation in its own samples, if the finest one holds 
+	 *	1/sqrt(3), and all coarser levels together cost about half a smoothing pass of the finest level.
+	 *
+	 *	Extrema of the scale-normalized response sigma^gamma * L(x, sigma) are searched in all levels in parallel. 
+	 *	With gamma = 1, a Gaussian blob of standard deviation a responds strongest at sigma = a, which yields its characteristic scale.
+	 */
+	class CScaleSpace
+	{
+	protected:
+		struct Level
+		{
+			vector<float>	data;		/**< The smoothed samples, row by row. */
+			int				nWidth;		/**< Number of samples per row. */
+			int				nHeight;	/**< Number of rows. */
+			int				nStride;	/**< Distance between two samples in samples of the finest level. */
+			float			fSigma;		/**< Standard deviation of the smoothing in samples of the finest level. */
+			float			fNorm;		/**< Factor of the scale normalization, i.e. fSigma^gamma. */
+		};
+
+		vector<Level>	m_Levels;		/**< The levels, the finest first. */
+		float			m_fBaseSigma;	/**< Standard deviation of the finest level. */
+		float			m_fGamma;		/**< Exponent of the scale normalization. */
+
+	public:
+		/**
+		 *	Creates an empty scale space.
+		 *
+		 *	@param fBaseSigma Standard deviation of the finest level. With the default, every other level has the same one in its own samples. 
+		 *	@param fGamma Exponent of the scale normalization.
+		 */
+		CScaleSpace(float fBaseSigma = SS_BASE_SIGMA, float fGamma = 1.0f);
+
+	public:
+		/**
+		 *	Builds the pyramid of a grid. The finest level is the grid smoothed by the base standard deviation.
+		 *	The memory of a previous pyramid is reused.
+		 *
+		 *	@param pData Pointer to the samples, row by row.
+		 *	@param nWidth Number of samples per row.
+		 *	@param nHeight Number of rows.
+		 *	@param nNumLevels Maximum number of levels. Fewer levels are built, if a level would have less than three samples per row or column.
+		 */
+		void Build(const float *pData, int nWidth, int nHeight, int nNumLevels);
+
+		/**
+		 *	Discards all levels.
+		 */
+		void Clear();
+
+		/**
+		 *	Searches the local extrema of the scale-normalized response, that are larger than all 8 neighbours in their level, and than
+		 *	the 3x3 closest samples of the finer and the coarser level. Their location is refined by parabolic interpolation on the finer level,
+		 *	their scale by fitting a Gaussian blob to the peak values of both levels. The first and the last level only bound the search, 
+		 *	so extrema on them, and on the border of a level are not reported.
+		 *
+		 *	@param extrema Receives the extrema, ordered by decreasing magnitude of the response.
+		 *	@param fThreshold Extrema, whose value on the finest level is below this fraction of its largest magnitude, are discarded.
+		 *	@param bMinima If true, minima are searched as well as maxima.
+		 *
+		 *	@return The number of extrema.
+		 */
+		size_t FindExtrema(vector<ScaleSpaceExtremum> &extrema, float fThreshold, bool bMinima) const;
+
+		/**
+		 *	Retrieve the bi-linearly interpolated value of a level.
+		 *
+		 *	@param nLevel The level.
+		 *	@param x X-component of the location in samples of the finest level.
+		 *	@param y Y-component of the location in samples of the finest level.
+		 */
+		float GetAt(int nLevel, float x, float y) const;
+
+		__inline int GetNumLevels() const { return static_cast<int>(m_Levels.size()); }
+		__inline int GetWidth(int nLevel) const { return m_Levels[nLevel].nWidth; }
+		__inline int GetHeight(int nLevel) const { return m_Levels[nLevel].nHeight; }
+		__inline int GetStride(int nLevel) const { return m_Levels[nLevel].nStride; }
+		__inline float GetSigma(int nLevel) const { return m_Levels[nLevel].fSigma; }
+		__inline const float* GetData(int nLevel) const { return &m_Levels[nLevel].data[0]; }
+
+	protected:
+		/**
+		 *	Retrieve the scale-normalized response of a level at the 3x3 samples of another level around (x, y) with spacing nStride.
+		 */
+		void _getNeighbourhood(int nLevel, int x, int y, int nStride, float *pValues) const;
+
+		/**
+		 *	Normalized value of the peak of nLevel next to (x, y), interpolated from the samples around it by a Gaussian, 
+		 *	or by a parabola, if they change their sign.
+		 */
+		float _getPeakValue(int nLevel, float x, float y) const;
+
+		/**
+		 *	Estimates the characteristic scale of an extremum at (x, y) on nLevel, assuming it is a Gaussian blob. If the values of 
+		 *	nLevel and the finer level contradict this, the scale is interpolated from fOffset, the offset of the peak response in levels.
+		 */
+		float _getBlobScale(int nLevel, float x, float y, float fOffset) const;
+	};
+}
@@ -0,0 +1,122 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "StdAfx.h"
+#include "SpatialHash.h"
+#include <math.h>
+
+CSpatialHash2D::CSpatialHash2D()
+{
+	m_fCellSize		= 1.0f;
+	m_nCellsX		= 0;
+	m_nCellsY		= 0;
+	m_nNumPoints	= 0;
+}
+
+CSpatialHash2D::CSpatialHash2D(const CRectF &rcDomain, float fCellSize)
+{
+	Init(rcDomain, fCellSize);
+}
+
+CSpatialHash2D::~CSpatialHash2D(void)
+{
+}
+
+void CSpatialHash2D::Init(const CRectF &rcDomain, float fCellSize)
+{
+	m_rcDomain	= rcDomain;
+	m_fCellSize	= (fCellSize > 0.0f)? fCellSize : 1.0f;
+	m_nCellsX	= max(1, static_cast<int>( ceil(rcDomain.getWidth() / m_fCellSize) ));
+	m_nCellsY	= max(1, static_cast<int>( ceil(rcDomain.getHeight() / m_fCellSize) ));
+
+	m_Cells.clear();
+	m_Cells.resize(m_nCellsX * m_nCellsY);
+	m_nNumPoints = 0;
+}
+
+void CSpatialHash2D::Clear()
+{
+	for (auto iter = m_Cells.begin(); iter != m_Cells.end(); ++iter) {
+		iter->clear();
+	}
+	m_nNumPoints = 0;
+}
+
+void CSpatialHash2D::_getCell(const CPointf &pt, int &cx, int &cy) const
+{
+	cx = static_cast<int>( floor((pt.x - m_rcDomain.m_Min.x) / m_fCellSize) );
+	cy = static_cast<int>( floor((pt.y - m_rcDomain.m_Min.y) / m_fCellSize) );
+
+	cx = min(max(cx, 0), m_nCellsX - 1);
+	cy = min(max(cy, 0), m_nCellsY - 1);
+}
+
+void CSpatialHash2D::Insert(const CPointf &pt)
+{
+	if (m_Cells.empty()) return;
+
+	int cx, cy;
+	_getCell(pt, cx, cy);
+
+	m_Cells[cy * m_nCellsX + cx].push_back(pt);
+	m_nNumPoints++;
+}
+
+bool CSpatialHash2D::IsCloser(const CPointf &pt, float fDist) const
+{
+	if (!m_nNumPoints) return false;
+
+	int cx, cy;
+	_getCell(pt, cx, cy);
+
+	//Number of neighbouring cells, that may contain points within fDist
+	const int nRing		= max(1, static_cast<int>( ceil(fDist / m_fCellSize) ));
+	const float fDist2	= fDist * fDist;
+
+	const int yMin = max(cy - nRing, 0);
+	const int yMax = min(cy + nRing, m_nCellsY - 1);
+	const int xMin = max(cx - nRing, 0);
+	const int xMax = min(cx + nRing, m_nCellsX - 1);
+
+	for (int y = yMin; y <= yMax; y++)
+	{
+		for (int x = xMin; x <= xMax; x++)
+		{
+			const vector<CPointf> &cell = m_Cells[y * m_nCellsX + x];
+
+			for (auto iter = cell.begin(); iter != cell.end(); ++iter)
+			{
+				const float dx = iter->x - pt.x;
+				const float dy = iter->y - pt.y;
+
+				if (dx*dx + dy*dy < fDist2) return true;
+			}
+		}
+	}
+
+	return false;
+}
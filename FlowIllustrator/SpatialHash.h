@@ -0,0 +1,103 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+#include "RectF.h"
+#include "Pointf.h"
+#include <vector>
+
+using namespace std;
+
+/**
+ *	Uniform grid over a rectangular domain, that stores points in the cells they fall into.
+ *	Used to answer "is there any point closer than d" queries in constant time, 
+ *	as long as d is in the order of the cell size.
+ */
+class CSpatialHash2D
+{
+protected:
+	CRectF						m_rcDomain;		/**< Domain covered by the grid. Points outside are clamped to the border cells. */
+	float						m_fCellSize;	/**< Edge length of a grid cell in domain units. */
+	int							m_nCellsX;		/**< Number of cells in X-direction. */
+	int							m_nCellsY;		/**< Number of cells in Y-direction. */
+	size_t						m_nNumPoints;	/**< Number of points stored. */
+	vector< vector<CPointf> >	m_Cells;		/**< Points stored in each cell, row by row. */
+
+public:
+	CSpatialHash2D();
+
+	/**
+	 *	Construct a new, empty CSpatialHash2D.
+	 *
+	 *	@param rcDomain Domain covered by the grid.
+	 *	@param fCellSize Edge length of a grid cell in domain units.
+	 */
+	CSpatialHash2D(const CRectF &rcDomain, float fCellSize);
+	~CSpatialHash2D(void);
+
+public:
+	/**
+	 *	Discards all points and sets up a new grid.
+	 *
+	 *	@param rcDomain Domain covered by the grid.
+	 *	@param fCellSize Edge length of a grid cell in domain units.
+	 */
+	void Init(const CRectF &rcDomain, float fCellSize);
+
+	/**
+	 *	Discards all points, but keeps the grid.
+	 */
+	void Clear();
+
+	/**
+	 *	Inserts a point.
+	 *
+	 *	@param pt The point in domain space.
+	 */
+	void Insert(const CPointf &pt);
+
+	/**
+	 *	Checks, if any stored point lies closer than the specified distance to a location.
+	 *
+	 *	@param pt The location in domain space.
+	 *	@param fDist The distance in domain units.
+	 *
+	 *	@return Returns true, if at least one point is closer than fDist to pt.
+	 */
+	bool IsCloser(const CPointf &pt, float fDist) const;
+
+	/**
+	 *	Retrieve the number of stored points.
+	 */
+	__inline size_t Size() const { return m_nNumPoints; }
+
+protected:
+	/**
+	 *	Computes the cell coordinates of a location, clamped to the grid.
+	 */
+	void _getCell(const CPointf &pt, int &cx, int &cy) const;
+};
@@ -0,0 +1,99 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "StdAfx.h"
+#include "TemporalDerivativeCache.h"
+
+#define TDC_MAX_FRAMES	8
+
+CTemporalDerivativeCache::CTemporalDerivativeCache() : m_LRU(TDC_MAX_FRAMES)
+{
+	m_pVecField		= nullptr;
+}
+
+CTemporalDerivativeCache::~CTemporalDerivativeCache()
+{
+}
+
+void CTemporalDerivativeCache::Init(const CAmiraVectorField2D *pVecField)
+{
+	if (m_pVecField == pVecField) return;
+
+	Clear();
+	m_pVecField = pVecField;
+}
+
+void CTemporalDerivativeCache::Clear()
+{
+	m_LRU.Clear();
+}
+
+void CTemporalDerivativeCache::SetMaxFrames(size_t nMaxFrames)
+{
+	m_LRU.SetMaxFrames(nMaxFrames);
+}
+
+shared_ptr<const CVectorField2D> CTemporalDerivativeCache::GetField(int nFrame)
+{
+	if (!m_pVecField) return nullptr;
+
+	nFrame = min(max(nFrame, 0), static_cast<int>(m_pVecField->GetNumTimeSteps()) - 1);
+
+	shared_ptr<const CVectorField2D> pField = m_LRU.Find(nFrame);
+	if (pField) return pField;
+
+	return m_LRU.Insert(nFrame, shared_ptr<const CVectorField2D>( m_pVecField->GetTemporalDerivativeField(nFrame) ));
+}
+
+CVector2D CTemporalDerivativeCache::GetVectorAt(float dx, float dy, float time)
+{
+	if (!m_pVecField) return CVector2D(0.0f, 0.0f);
+
+	const int nMaxFrame = static_cast<int>(m_pVecField->GetNumTimeSteps()) - 1;
+
+	time = min(max(time, 0.0f), static_cast<float>(nMaxFrame));
+
+	const int tx	= min(static_cast<int>(time), nMaxFrame);
+	const float wt	= time - tx;
+
+	shared_ptr<const CVectorField2D> pField0 = GetField(tx);
+	CVector2D v ( pField0->GetVectorAt(dx, dy) );
+
+	if (wt > 0.0f && tx < nMaxFrame)
+	{
+		shared_ptr<const CVectorField2D> pField1 = GetField(tx + 1);
+		v = v * (1.0f - wt) + pField1->GetVectorAt(dx, dy) * wt;
+	}
+
+	return v;
+}
+
+CVector2D CTemporalDerivativeCache::GetVectorAt(const CPointf &point, float time)
+{
+	return GetVectorAt(point.x, point.y, time);
+}
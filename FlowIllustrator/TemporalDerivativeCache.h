@@ -0,0 +1,97 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#pragma once
+#include "AmiraVectorField2D.h"
+#include "FrameLRU.h"
+#include <memory>
+
+using namespace std;
+
+/**
+ *	CTemporalDerivativeCache holds the temporal derivatives dv/dt of recently used time steps of a CAmiraVectorField2D.
+ *	Each time step is computed at most once while it is cached, see CAmiraVectorField2D::GetTemporalDerivativeField().
+ *	If the number of time steps exceeds a limit, the least recently used one is evicted.
+ *
+ *	The derivatives are sampled like the velocity, either through a CVectorField2D per time step, or by
+ *	GetVectorAt() with linear interpolation in time. The cache itself is not thread-safe. Parallel code, such as
+ *	feature tracking, should retrieve the fields of the involved time steps beforehand and sample those.
+ */
+class CTemporalDerivativeCache
+{
+protected:
+	const CAmiraVectorField2D			*m_pVecField;	/**< The vector field. */
+	CFrameLRU<const CVectorField2D>		 m_LRU;			/**< Cached time steps. */
+
+public:
+	CTemporalDerivativeCache();
+	~CTemporalDerivativeCache();
+
+public:
+	/**
+	 *	Initializes the cache for the specified vector field. If the vector field changed, all cached time steps are discarded.
+	 *
+	 *	@param pVecField Pointer to the vector field.
+	 */
+	void Init(const CAmiraVectorField2D *pVecField);
+
+	/**
+	 *	Discards all cached time steps. This is necessary, if the reference frame of the vector field changed.
+	 */
+	void Clear();
+
+	/**
+	 *	Set the maximum number of cached time steps. The default is 8.
+	 */
+	void SetMaxFrames(size_t nMaxFrames);
+
+	/**
+	 *	Retrieve the temporal derivative of a time step, and compute it if it is not cached.
+	 *
+	 *	@param nFrame The time step.
+	 *
+	 *	@return The derivative field, which stays valid even if the cache evicts it, or nullptr if the cache is not initialized.
+	 */
+	shared_ptr<const CVectorField2D> GetField(int nFrame);
+
+	/**
+	 *	Retrieve the temporal derivative at a location in domain space, like CAmiraVectorField2D::GetVectorAt().
+	 *	The derivatives of the enclosing time steps are interpolated linearly.
+	 *
+	 *	@param dx X-component of the coordinate in domain space.
+	 *	@param dy Y-component of the coordinate in domain space.
+	 *	@param time The time in time steps.
+	 */
+	CVector2D GetVectorAt(float dx, float dy, float time);
+	CVector2D GetVectorAt(const CPointf &point, float time);
+
+	/**
+	 *	Retrieve the number of time steps computed since the last call to Init().
+	 */
+	__inline size_t GetNumComputedFrames() const { return m_LRU.GetNumComputedFrames(); }
+};
@@ -0,0 +1,295 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "StdAfx.h"
+#include "TopologicalSkeleton.h"
+#include <math.h>
+#include <algorithm>
+
+#define TS_CHUNK_SIZE		64		//Number of integration steps per call of the integrator
+#define TS_SADDLE_MATCH		0.05f	//Maximum motion of a saddle in cells, up to which its previous separatrices are kept
+
+CTopologicalSkeleton::CTopologicalSkeleton()
+{
+	m_pVecField	= nullptr;
+	m_pCache	= nullptr;
+	m_fStepLen	= 0.1f;
+	m_nMaxSteps	= 1000;
+	m_fMaxAngle	= 0.5f;
+	m_nFrame	= -1;
+}
+
+CTopologicalSkeleton::~CTopologicalSkeleton()
+{
+}
+
+void CTopologicalSkeleton::Init(const CAmiraVectorField2D *pVecField, CCriticalPointCache *pCache)
+{
+	if (m_pVecField != pVecField || m_pCache != pCache) {
+		Clear();
+	}
+
+	m_pVecField = pVecField;
+	m_pCache	= pCache;
+}
+
+void CTopologicalSkeleton::Clear()
+{
+	m_Separatrices.clear();
+	m_nFrame = -1;
+}
+
+void CTopologicalSkeleton::SetIntegrationParams(float fStepLen, int nMaxSteps)
+{
+	if (fStepLen == m_fStepLen && nMaxSteps == m_nMaxSteps) return;
+
+	m_fStepLen	= fStepLen;
+	m_nMaxSteps	= max(nMaxSteps, 2);
+
+	Clear();
+}
+
+void CTopologicalSkeleton::SetMaxAngle(float fDegrees)
+{
+	m_fMaxAngle = max(fDegrees, 0.0f);
+}
+
+bool CTopologicalSkeleton::_getEigenvectors(const CriticalPoint &cp, CVector2D dirs[2])
+{
+	const float tr	= cp.ux + cp.vy;
+	const float det	= cp.ux*cp.vy - cp.uy*cp.vx;
+
+	if (det >= 0.0f) return false;
+
+	//A saddle has two real eigenvalues of opposite sign
+	const float d		= sqrt(tr*tr*0.25f - det);
+	const float l[2]	= { tr*0.5f + d, tr*0.5f - d };
+
+	for (int i = 0; i < 2; i++)
+	{
+		//Both rows of (J - l*I) are orthogonal to the eigenvector, use the longer one
+		CVector2D e0(cp.uy, l[i] - cp.ux);
+		CVector2D e1(l[i] - cp.vy, cp.vx);
+
+		dirs[i] = (e0.abs() >= e1.abs())? e0 : e1;
+
+		const float fLen = dirs[i].abs();
+		if (fLen == 0.0f) return false;
+
+		dirs[i] = dirs[i] / fLen;
+	}
+
+	return true;
+}
+
+size_t CTopologicalSkeleton::_validPrefix(const Separatrix &sep, int nFrame) const
+{
+	const float fOld	= static_cast<float>(m_nFrame);
+	const float fNew	= static_cast<float>(nFrame);
+	const float fCosMax	= cos(m_fMaxAngle * 3.14159265f / 180.0f);
+	const size_t nSize	= sep.points.size();
+
+	//The field vanishes at the saddle, its first vertex is always valid
+	for (size_t i = 1; i < nSize; i++)
+	{
+		const CVector2D v0 = m_pVecField->GetParticleVelocity(sep.points[i], fOld);
+		const CVector2D v1 = m_pVecField->GetParticleVelocity(sep.points[i], fNew);
+
+		if (v0.x == v1.x && v0.y == v1.y) continue;
+
+		const float fLen = v0.abs() * v1.abs();
+
+		if (fLen == 0.0f || (v0.x*v1.x + v0.y*v1.y) < fCosMax * fLen) {
+			return i + 1;	//Vertex i is still valid, but not the integration step, that starts there
+		}
+	}
+
+	return nSize;
+}
+
+void CTopologicalSkeleton::_integrate(Separatrix &sep, size_t nKeep, const CSpatialHash2D &targets, float fCapture) const
+{
+	vector<CPointf> &points = sep.points;
+	points.resize(nKeep);
+	sep.nEnd = SE_LENGTH;
+
+	//The saddle of the separatrix only counts as target after the separatrix left its vicinity
+	const float fLeaveDist2	= 4.0f * fCapture * fCapture;
+	bool bLeft				= false;
+
+	//Critical points may have moved onto the part, that is kept
+	for (size_t i = 1; i < points.size(); i++) 
+	{
+		const float dx = points[i].x - sep.ptSaddle.x;
+		const float dy = points[i].y - sep.ptSaddle.y;
+		bLeft = bLeft || (dx*dx + dy*dy > fLeaveDist2);
+
+		if (bLeft && targets.IsCloser(points[i], fCapture)) {
+			points.resize(i + 1);
+			sep.nEnd = SE_CRITICAL_POINT;
+			return;
+		}
+	}
+
+	const CRectF rcDomain = m_pVecField->GetDomainRect();
+	CAmiraVectorField2D::IntegrationState state;
+	vector<CPointf> buff;
+
+	while (static_cast<int>(points.size()) < m_nMaxSteps)
+	{
+		const int nChunk		= min(TS_CHUNK_SIZE, m_nMaxSteps - static_cast<int>(points.size()));
+		const CPointf ptLast	= points.back();
+
+		//Restarting the integration at the last vertex is exact, RK4 is a single-step method
+		buff.clear();
+		m_pVecField->integrateRK4( CVector3D(ptLast.x, ptLast.y, 0.0f), nChunk + 1, m_fStepLen, sep.bForward, &buff, rcDomain, &state);
+
+		const size_t nSize = buff.size();
+
+		for (size_t i = 1; i < nSize; i++)
+		{
+			//Backward integration inserts new vertices at the front
+			const CPointf &pt = (sep.bForward)? buff[i] : buff[nSize - 1 - i];
+			points.push_back(pt);
+
+			const float dx = pt.x - sep.ptSaddle.x;
+			const float dy = pt.y - sep.ptSaddle.y;
+			bLeft = bLeft || (dx*dx + dy*dy > fLeaveDist2);
+
+			if (bLeft && targets.IsCloser(pt, fCapture)) {
+				sep.nEnd = SE_CRITICAL_POINT;
+				return;
+			}
+		}
+
+		if (state.bTerminated || nSize < 2) {
+			sep.nEnd = SE_BOUNDARY;
+			return;
+		}
+	}
+}
+
+size_t CTopologicalSkeleton::Update()
+{
+	if (!m_pVecField || !m_pCache) return 0;
+
+	const int nFrame = static_cast<int>(m_pVecField->GetCurrentTimeStep());
+	if (nFrame == m_nFrame) return m_Separatrices.size();
+
+	const CRectF rcDomain	= m_pVecField->GetDomainRect();
+	const float fCellX		= rcDomain.getWidth() / (m_pVecField->GetExtentX() - 1);
+	const float fCellY		= rcDomain.getHeight() / (m_pVecField->GetExtentY() - 1);
+	const float fCapture	= max(fCellX, fCellY);
+	const float fSeedDist	= m_fStepLen * min(fCellX, fCellY);
+	const float fMatchDist	= TS_SADDLE_MATCH * min(fCellX, fCellY);
+	const float fCosMax		= cos(m_fMaxAngle * 3.14159265f / 180.0f);
+
+	const vector<CriticalPoint> *pPoints = m_pCache->GetCriticalPoints(nFrame);
+	if (!pPoints) return 0;
+
+	CSpatialHash2D targets;
+	targets.Init(rcDomain, fCapture);
+
+	for (auto iter = pPoints->begin(); iter != pPoints->end(); ++iter)
+	{
+		//Stream lines circle around centers, but never reach them
+		if (iter->nType != CENTER && iter->nType != NONE) {
+			targets.Insert(iter->pos);
+		}
+	}
+
+	//The previous separatrices come in groups of four per saddle, sorted by the x-coordinate of the saddle
+	vector< pair<float, size_t> > prev;
+	for (size_t i = 0; i + 3 < m_Separatrices.size(); i += 4) {
+		prev.push_back( make_pair(m_Separatrices[i].ptSaddle.x, i) );
+	}
+	sort(prev.begin(), prev.end());
+
+	vector<Separatrix>	next;
+	vector<char>		reused;
+
+	for (auto iter = pPoints->begin(); iter != pPoints->end(); ++iter)
+	{
+		CVector2D dirs[2];
+		if (iter->nType != SADDLE || !_getEigenvectors(*iter, dirs)) continue;
+
+		size_t nPrev = m_Separatrices.size();
+		auto range = lower_bound(prev.begin(), prev.end(), make_pair(iter->pos.x - fMatchDist, size_t(0)));
+
+		for (; range != prev.end() && range->first <= iter->pos.x + fMatchDist; ++range)
+		{
+			if (fabs(m_Separatrices[range->second].ptSaddle.y - iter->pos.y) <= fMatchDist) {
+				nPrev = range->second;
+				break;
+			}
+		}
+
+		for (int i = 0; i < 4; i++)
+		{
+			Separatrix sep;
+			sep.ptSaddle	= iter->pos;
+			sep.dir			= (i & 1)? dirs[i/2] * -1.0f : dirs[i/2];
+			sep.bForward	= (i < 2);
+			sep.nEnd		= SE_LENGTH;
+
+			bool bReused = false;
+
+			for (size_t j = nPrev; j < nPrev + 4 && j < m_Separatrices.size(); j++)
+			{
+				Separatrix &old = m_Separatrices[j];
+
+				if (old.bForward == sep.bForward && old.dir.x*sep.dir.x + old.dir.y*sep.dir.y >= fCosMax && !old.points.empty()) {
+					sep.points.swap(old.points);
+					bReused = true;
+					break;
+				}
+			}
+
+			if (!bReused) {
+				sep.points.push_back(iter->pos);
+				sep.points.push_back( CPointf(iter->pos.x + sep.dir.x * fSeedDist, iter->pos.y + sep.dir.y * fSeedDist) );
+			}
+
+			next.push_back(sep);
+			reused.push_back(bReused? 1 : 0);
+		}
+	}
+
+	const int nNumSeparatrices = static_cast<int>(next.size());
+
+	#pragma omp parallel for schedule(dynamic, 1)
+	for (int i = 0; i < nNumSeparatrices; i++)
+	{
+		const size_t nKeep = (reused[i])? _validPrefix(next[i], nFrame) : next[i].points.size();
+		_integrate(next[i], nKeep, targets, fCapture);
+	}
+
+	m_Separatrices.swap(next);
+	m_nFrame = nFrame;
+
+	return m_Separatrices.size();
+}
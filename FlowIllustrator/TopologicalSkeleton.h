@@ -0,0 +1,160 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+#include "CriticalPoints.h"
+#include "SpatialHash.h"
+#include <vector>
+
+using namespace std;
+
+/**
+ *	Reasons for a separatrix to end.
+ */
+enum SEPARATRIX_END
+{
+	SE_LENGTH,				/**< The maximum number of integration steps was reached. */
+	SE_BOUNDARY,			/**< The separatrix left the domain, or reached a zero of the vector field. */
+	SE_CRITICAL_POINT		/**< The separatrix reached a source, sink, focus or saddle. */
+};
+
+/**
+ *	A single separatrix of a saddle.
+ */
+struct Separatrix
+{
+	CPointf			ptSaddle;	/**< Position of the saddle in domain space. */
+	CVector2D		dir;		/**< Normalized eigenvector of the saddle, along which the separatrix leaves the saddle. */
+	bool			bForward;	/**< If true, the separatrix is unstable (flow leaves the saddle), otherwise it is stable. */
+	SEPARATRIX_END	nEnd;		/**< Reason for the end of the separatrix. */
+	vector<CPointf>	points;		/**< Vertices in domain space, starting at the saddle. */
+};
+
+/**
+ *	CTopologicalSkeleton computes the topological skeleton of the current time step of a CAmiraVectorField2D,
+ *	i.e. the four separatrices of each saddle. They are integrated along the eigenvectors of the saddle,
+ *	until they reach another critical point, the boundary of the domain, or the maximum length.
+ *	All separatrices are integrated in parallel.
+ *
+ *	Update() works incrementally. A separatrix of the previous result is kept, as long as its saddle did not move
+ *	and the field along it did not change direction by more than a tolerance. Only the invalid part is integrated again.
+ *	In steady regions of a time-dependent vector field, this avoids most of the integration work during playback.
+ */
+class CTopologicalSkeleton
+{
+protected:
+	const CAmiraVectorField2D	*m_pVecField;	/**< The vector field. */
+	CCriticalPointCache			*m_pCache;		/**< Provides the critical points of each time step. */
+	float						 m_fStepLen;	/**< Step length of the integration in grid space. */
+	int							 m_nMaxSteps;	/**< Maximum number of integration steps per separatrix. */
+	float						 m_fMaxAngle;	/**< Maximum change of the direction of the field, in degrees, up to which a previous separatrix is kept. */
+	int							 m_nFrame;		/**< Time step of m_Separatrices, or -1. */
+	vector<Separatrix>			 m_Separatrices;/**< The separatrices of the time step m_nFrame. */
+
+public:
+	CTopologicalSkeleton();
+	~CTopologicalSkeleton();
+
+public:
+	/**
+	 *	Initializes the skeleton for the specified vector field. If the vector field changed, the current result is discarded.
+	 *
+	 *	@param pVecField Pointer to the vector field.
+	 *	@param pCache Pointer to a CCriticalPointCache, initialized for pVecField.
+	 */
+	void Init(const CAmiraVectorField2D *pVecField, CCriticalPointCache *pCache);
+
+	/**
+	 *	Discards the current result.
+	 */
+	void Clear();
+
+	/**
+	 *	Set the parameters of the integration. Discards the current result, if they changed.
+	 *
+	 *	@param fStepLen Step length in grid space.
+	 *	@param nMaxSteps Maximum number of integration steps per separatrix.
+	 */
+	void SetIntegrationParams(float fStepLen, int nMaxSteps);
+
+	/**
+	 *	Set the maximum change of the direction of the field, up to which a separatrix of the previous time step is kept.
+	 *
+	 *	@param fDegrees The angle in degrees. If zero, a separatrix is only kept, if the field did not change at all.
+	 */
+	void SetMaxAngle(float fDegrees);
+
+	/**
+	 *	Computes the skeleton of the current time step of the vector field, reusing the previous result where possible.
+	 *
+	 *	@return The number of separatrices.
+	 */
+	size_t Update();
+
+	/**
+	 *	Retrieve the number of separatrices.
+	 */
+	__inline size_t GetNumSeparatrices() const { return m_Separatrices.size(); }
+
+	/**
+	 *	Retrieve a single separatrix.
+	 *
+	 *	@param nIdx Index of the separatrix.
+	 */
+	__inline const Separatrix& GetSeparatrix(size_t nIdx) const { return m_Separatrices[nIdx]; }
+
+protected:
+	/**
+	 *	Computes the eigenvectors of a saddle.
+	 *
+	 *	@param cp The saddle.
+	 *	@param dirs Receives the normalized eigenvector of the positive (unstable) and of the negative (stable) eigenvalue.
+	 *
+	 *	@return Returns false, if cp is not a saddle.
+	 */
+	static bool _getEigenvectors(const CriticalPoint &cp, CVector2D dirs[2]);
+
+	/**
+	 *	Determines, how many vertices of a separatrix of the previous time step are still valid.
+	 *
+	 *	@param sep The separatrix.
+	 *	@param nFrame The new time step.
+	 *
+	 *	@return The number of leading vertices, at which the field kept its direction.
+	 */
+	size_t _validPrefix(const Separatrix &sep, int nFrame) const;
+
+	/**
+	 *	Truncates a separatrix to the specified number of vertices and continues its integration.
+	 *
+	 *	@param sep The separatrix. Must contain at least its first vertex.
+	 *	@param nKeep Number of vertices to keep.
+	 *	@param targets Critical points, at which the integration stops. The saddle of sep is ignored, until sep left its vicinity.
+	 *	@param fCapture Distance to a target in domain units, at which the integration stops.
+	 */
+	void _integrate(Separatrix &sep, size_t nKeep, const CSpatialHash2D &targets, float fCapture) const;
+};
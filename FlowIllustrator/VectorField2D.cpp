@@ -27,9 +27,10 @@
 
 #include "StdAfx.h"
 #include "VectorField2D.h"
-#include <complex>
 #include "Vector3D.h"
 #include <iostream>
+#include <float.h>
+#include <xmmintrin.h>
 
 CVectorField2D::CVectorField2D()
 	: CDataField2D( CRectF(0,0,0,0), 0, 0)
@@ -38,6 +39,7 @@ CVectorField2D::CVectorField2D()
 	m_bIsMM		= false;
 	m_nSamplesX = 0;
 	m_nSamplesY = 0;
+	m_pOccupancy	= nullptr;
 }
 
 CVectorField2D::CVectorField2D(const CRectF &rcDomain, int nSamplesX, int nSamplesY)
@@ -45,6 +47,7 @@ CVectorField2D::CVectorField2D(const CRectF &rcDomain, int nSamplesX, int nSampl
 {
 	m_pData = new CVector2D[nSamplesX * nSamplesY];
 	m_bIsMM = false;
+	m_pOccupancy = nullptr;
 }
 
 CVectorField2D::~CVectorField2D(void)
@@ -99,42 +102,235 @@ void CVectorField2D::integrateRK4(float dx, float dy, int numSteps, float stepLe
 	}
 }
 
-CRITICAL_POINT_TYPE CVectorField2D::GetCriticalPointType(const CPointf& point) const
+/*
+	Helpers for the cell-wise stream line tracer.
+	Inside a cell, the bi-linear interpolant is v(u,w) = a + b*u + c*w + d*u*w,
+	where u,w in [0,1] are the local coordinates inside the cell.
+*/
+static __inline CVector2D _cellVector(const CVector2D &a, const CVector2D &b, const CVector2D &c, const CVector2D &d, const CVector2D &q)
 {
-	arma::fmat22 J;
-	GetJacobian(point.x, point.y, &J);
+	return a + b*q.x + c*q.y + d*(q.x*q.y);
+}
+
+static __inline CVector2D _cellRK4(const CVector2D &a, const CVector2D &b, const CVector2D &c, const CVector2D &d, const CVector2D &q, const CVector2D &v1, float h)
+{
+	CVector2D v2 ( _cellVector(a, b, c, d, q + v1*(h/2.0f)) );
+	CVector2D v3 ( _cellVector(a, b, c, d, q + v2*(h/2.0f)) );
+	CVector2D v4 ( _cellVector(a, b, c, d, q + v3*h) );
+
+	return q + ((v1 + (v2 + v3)*2.0f + v4)/6.0f)*h;
+}
+
+//Parameter distance until a particle at q, moving with constant velocity v, hits the cell boundary.
+//Components not exceeding fEps are treated as tangential motion.
+static __inline float _cellExitTime(const CVector2D &q, const CVector2D &v, float fEps)
+{
+	float h = FLT_MAX;
+
+	if (v.x > fEps)			h = (1.0f - q.x) / v.x;
+	else if (v.x < -fEps)	h = -q.x / v.x;
+
+	if (v.y > fEps)			h = min(h, (1.0f - q.y) / v.y);
+	else if (v.y < -fEps)	h = min(h, -q.y / v.y);
+
+	return (h > 0.0f)? h : 0.0f;
+}
+
+int CVectorField2D::integrateCellwise(float dx, float dy, int nNumSteps, float stepLen, bool bForward, std::vector<CPointf> *pOutBuff, const CRectF &rcIntegrationDomain) const
+{
+	static const float	fCellTol	= 1e-5f;	//Tolerance to decide, if a particle reached a cell boundary
+	static const int	nMaxIdle	= 64;		//Maximum number of steps without progress
+
+	CRectF rcDomain(rcIntegrationDomain);
+
+	//Ensure the integration domain does not exceed the real domain
+	if (rcDomain.m_Min.x < m_rcDomain.m_Min.x) rcDomain.m_Min.x = m_rcDomain.m_Min.x;
+	if (rcDomain.m_Min.y < m_rcDomain.m_Min.y) rcDomain.m_Min.y = m_rcDomain.m_Min.y;
+	if (rcDomain.m_Max.x > m_rcDomain.m_Max.x) rcDomain.m_Max.x = m_rcDomain.m_Max.x;
+	if (rcDomain.m_Max.y > m_rcDomain.m_Max.y) rcDomain.m_Max.y = m_rcDomain.m_Max.y;
 
-	std::complex<double> c( static_cast<double>( pow((J(1,1)-J(0,0))/2.0, 2) + J(0,1)*J(1,0) - J(0,0)*J(1,1)) );
-	c = std::sqrt(c);
+	pOutBuff->reserve(nNumSteps);
+	pOutBuff->push_back( CPointf(dx, dy) );
 
-	std::complex<double> eig1, eig2;
+	if (m_nSamplesX < 2 || m_nSamplesY < 2 || stepLen <= 0.0f) return 0;
 
-	eig1 = (J(0,0) + J(1,1))/2.0 + c;
-	eig2 = (J(0,0) + J(1,1))/2.0 - c;
+	const CVector2D *pData(reinterpret_cast<const CVector2D *>(m_pData));
+	const float fDir	= (bForward)? 1.0f : -1.0f;
+	const int nMaxCellX = static_cast<int>(m_nSamplesX) - 2;
+	const int nMaxCellY = static_cast<int>(m_nSamplesY) - 2;
 
-	//we have an imaginary number
-	if ( fabs(c.imag()) > EPSILON) // Do we have a complex result?
+	CVector2D p;
+	_getGridCoordinates(dx, dy, p.x, p.y);
+	if (p.x < 0.0f || p.y < 0.0f || p.x > nMaxCellX+1 || p.y > nMaxCellY+1) return 0;
+
+	int cx = min(static_cast<int>(p.x), nMaxCellX);
+	int cy = min(static_cast<int>(p.y), nMaxCellY);
+
+	const COccupancyGrid *pOccupancy = (m_pOccupancy && !m_pOccupancy->IsFull())? m_pOccupancy : nullptr;
+	if (pOccupancy && !pOccupancy->IsLiveCell(cx, cy)) return 0;
+
+	CVector2D q(p.x - cx, p.y - cy);	//Local coordinates inside the current cell
+	CVector2D vq;
+	CPointf trace;
+
+	float	t			= 0.0f;			//Integration parameter at q
+	float	tNext		= stepLen;		//Integration parameter of the next output vertex
+	int		nVertices	= 1;
+	int		nEval		= 0;
+	int		nIdle		= 0;
+	bool	bFirst		= true;
+
+	while (nVertices < nNumSteps)
 	{
-		double fReal = eig1.real();
+		const CVector2D &v00 = pData[cy * m_nSamplesX + cx];
+		const CVector2D &v10 = pData[cy * m_nSamplesX + cx + 1];
+		const CVector2D &v01 = pData[(cy+1) * m_nSamplesX + cx];
+		const CVector2D &v11 = pData[(cy+1) * m_nSamplesX + cx + 1];
+
+		const CVector2D a ( (v00 - m_ReferenceVelocity) * fDir );
+		const CVector2D b ( (v10 - v00) * fDir );
+		const CVector2D c ( (v01 - v00) * fDir );
+		const CVector2D d ( (v11 - v10 - v01 + v00) * fDir );
+
+		//The interpolant is continuous across cell boundaries, so vq can be reused after a cell transition
+		if (bFirst) {
+			vq = _cellVector(a, b, c, d, q);
+			nEval++;
+			bFirst = false;
+		}
 
-		if ( fReal > EPSILON  ) //null
-			return REPELLING_FOCUS;
-		if( fReal < (-EPSILON) )
-			return ATTRACTING_FOCUS;
+		int nExitX = 0, nExitY = 0;
 
-		return CENTER;
+		while (nVertices < nNumSteps && !nExitX && !nExitY)
+		{
+			float fSpeed = vq.abs();
+			if (!(fSpeed > 1e-15f) || !isFinite(vq.x) || !isFinite(vq.y)) {
+				return nEval; //Critical point
+			}
+
+			//Either step onto the cell boundary, or at most one cell length
+			float fEps		= fCellTol * fSpeed;
+			float h			= _cellExitTime(q, vq, fEps);
+			float hMax		= 1.0f / fSpeed;
+			bool bExitStep	= (h <= hMax);
+			if (!bExitStep) h = hMax;
+
+			CVector2D q1 ( (h > 0.0f)? _cellRK4(a, b, c, d, q, vq, h) : q );
+			CVector2D dir ( vq );	//Direction in which the particle leaves the cell
+			nEval += 3;
+
+			if (q1.x < 0.0f || q1.x > 1.0f || q1.y < 0.0f || q1.y > 1.0f)
+			{
+				//The curved path left the cell: shorten the step, s.t. the chord ends on the boundary
+				float s = 1.0f;
+				CVector2D dq (q1 - q);
+				if (q1.x > 1.0f) s = min(s, (1.0f - q.x) / dq.x);
+				if (q1.x < 0.0f) s = min(s, -q.x / dq.x);
+				if (q1.y > 1.0f) s = min(s, (1.0f - q.y) / dq.y);
+				if (q1.y < 0.0f) s = min(s, -q.y / dq.y);
+
+				h *= s;
+				q1 = (h > 0.0f)? _cellRK4(a, b, c, d, q, vq, h) : q;
+				dir = dq;
+				nEval += 3;
+				bExitStep = true;
+			}
+
+			if (bExitStep)
+			{
+				fEps = fCellTol * dir.abs();
+				if		(q1.x >= 1.0f - fCellTol && dir.x > fEps)	nExitX =  1;
+				else if (q1.x <= fCellTol && dir.x < -fEps)			nExitX = -1;
+				if		(q1.y >= 1.0f - fCellTol && dir.y > fEps)	nExitY =  1;
+				else if (q1.y <= fCellTol && dir.y < -fEps)			nExitY = -1;
+			}
+
+			q1.x = min(max(q1.x, 0.0f), 1.0f);
+			q1.y = min(max(q1.y, 0.0f), 1.0f);
+
+			CVector2D vq1 ( _cellVector(a, b, c, d, q1) );
+			nEval++;
+
+			//Resample the segment [t, t+h] at the output vertices by cubic hermite interpolation
+			bool bEmitted = false;
+			while (nVertices < nNumSteps && tNext <= t + h)
+			{
+				float s		= (tNext - t) / h;
+				float s2	= s*s;
+				float s3	= s2*s;
+
+				CVector2D pos (	q * (2.0f*s3 - 3.0f*s2 + 1.0f) + vq * ((s3 - 2.0f*s2 + s)*h) 
+							  + q1 * (3.0f*s2 - 2.0f*s3) + vq1 * ((s3 - s2)*h) );
+
+				_getDomainCoordinates(pos.x + cx, pos.y + cy, trace.x, trace.y);
+
+				if (!rcDomain.PtInRect(trace.x, trace.y)) return nEval;
+
+				if (bForward) {
+					pOutBuff->push_back( trace );
+				} else {
+					pOutBuff->insert(pOutBuff->begin(), trace );
+				}
+
+				nVertices++;
+				tNext += stepLen;
+				bEmitted = true;
+			}
+
+			//Crossing a cell boundary without moving is no progress, the particle may bounce between two cells
+			nIdle = (bEmitted || h * fSpeed > fCellTol)? 0 : nIdle + 1;
+			if (nIdle > nMaxIdle) return nEval;
+
+			t	+= h;
+			q	= q1;
+			vq	= vq1;
+		}
+
+		//Move on to the neighbouring cell
+		cx += nExitX;
+		cy += nExitY;
+
+		if (cx < 0 || cy < 0 || cx > nMaxCellX || cy > nMaxCellY) break;
+		if (pOccupancy && !pOccupancy->IsLiveCell(cx, cy)) break;
+
+		if (nExitX) q.x = (nExitX > 0)? 0.0f : 1.0f;
+		if (nExitY) q.y = (nExitY > 0)? 0.0f : 1.0f;
 	}
 
-	if (eig1.real() < (-EPSILON) && eig2.real() < (-EPSILON))
-		return ATTRACTING_SADDLE;
+	return nEval;
+}
 
-	if (eig1.real() > EPSILON && eig2.real() > EPSILON)
-		return REPELLING_SADDLE;
+CRITICAL_POINT_TYPE CVectorField2D::GetCriticalPointType(const CPointf& point) const
+{
+	arma::fmat22 J;
+	GetJacobian(point.x, point.y, &J);
+
+	return ClassifyCriticalPoint(J(0,0), J(0,1), J(1,0), J(1,1));
+}
 
-	if ( (eig1.real() > EPSILON && eig2.real() < (-EPSILON)) || (eig1.real() < (-EPSILON) && eig2.real() > EPSILON))
+CRITICAL_POINT_TYPE ClassifyCriticalPoint(float ux, float uy, float vx, float vy)
+{
+	const float fScale = max( max(fabs(ux), fabs(uy)), max(fabs(vx), fabs(vy)) );
+	if (fScale == 0.0f || !isFinite(fScale)) return NONE;
+
+	//Eigenvalues are (tr +- sqrt(tr^2 - 4 det)) / 2
+	const float tr	= (ux + vy) / fScale;
+	const float det	= (ux*vy - uy*vx) / (fScale*fScale);
+
+	if (fabs(det) < EPSILON) return NONE;	//Degenerate, at least one eigenvalue is (nearly) zero
+
+	if (det < 0.0f) return SADDLE;			//Real eigenvalues of opposite sign
+
+	if (tr*tr - 4.0f*det < 0.0f)
+	{
+		//Complex conjugate eigenvalues, the sign of the real part decides
+		if (tr > EPSILON) return REPELLING_FOCUS;
+		if (tr < -EPSILON) return ATTRACTING_FOCUS;
 		return CENTER;
+	}
 
-	return NONE; //could not be classified
+	//Real eigenvalues of equal sign
+	return (tr > 0.0f)? REPELLING_SADDLE : ATTRACTING_SADDLE;
 }
 
 /*
@@ -236,60 +432,318 @@ CVector2D CVectorField2D::_getVectorAt(float x, float y) const
 
 	return dummy1 * wx + dummy2 * (1.0f - wx);*/
 
-	return (v1 * wy + v2 * (1.0f - wy)) * wx + (v3 * wy + v4 * (1.0f - wy)) * (1.0f - wx);
+	return (v1 * wy + v2 * (1.0f - wy)) * wx + (v3 * wy + v4 * (1.0f - wy)) * (1.0f - wx) - m_ReferenceVelocity;
 }
 
 CScalarField2D* CVectorField2D::GetMagnitudeField() const
 {
-	CScalarField2D *pMagField = new CScalarField2D(m_rcDomain, m_nSamplesX, m_nSamplesY);
-	CVector2D *pData = reinterpret_cast<CVector2D *>(m_pData);
+	CScalarField2D *ppFields[DF_NUM_FIELDS];
 
-	static float min, max;
+	GetDerivedFields(DF_MAGNITUDE, ppFields);
 
-	min = max = pData[0,0].abs();
-	int nIdx(0);
-	
-	for (unsigned int j = 0; j < m_nSamplesY; j++)
+	return ppFields[0];
+}
+
+CScalarField2D* CVectorField2D::GetVorticityField(bool bGetMagnitude) const
+{
+	CScalarField2D *pVortField(nullptr);
+
+	if (bGetMagnitude)
+		GetVorticityFields(nullptr, &pVortField);
+	else
+		GetVorticityFields(&pVortField, nullptr);
+
+	return pVortField;
+}
+
+/*
+	Vorticity of a single sample with the differences of GetDerivedFields(). 
+	pRow, pRowM and pRowP point to the interleaved (u,v) samples of the row, and the rows used for du/dy.
+*/
+static __inline float _getVorticitySample(const float *pRow, const float *pRowM, const float *pRowP, int nx, int i, float fWeightY)
+{
+	const int im			= (i > 0)? i - 1 : 0;
+	const int ip			= (i < nx - 1)? i + 1 : nx - 1;
+	const float fWeightX	= (i == 0 && nx > 1)? 1.0f : 0.5f;
+
+	return fWeightX * (pRow[2*ip + 1] - pRow[2*im + 1]) - fWeightY * (pRowP[2*i] - pRowM[2*i]);
+}
+
+/*
+	Computes the vorticity of the samples nMinX to nMaxX-1 of row j, and updates the minimum and maximum
+	of the vorticity and the minimum of its magnitude. pOut and pAbs receive the values from nMinX on, 
+	and may be nullptr. Interior samples are computed four at a time, on the interleaved frame data.
+*/
+static void _getVorticityRow(const float *pData, int nx, int ny, int j, int nMinX, int nMaxX, float *pOut, float *pAbs, 
+							 float &fMin, float &fMax, float &fAbsMin)
+{
+	const int jm			= (j > 0)? j - 1 : 0;
+	const int jp			= (j < ny - 1)? j + 1 : ny - 1;
+	const float fWeightY	= (j == 0 && ny > 1)? 1.0f : 0.5f;
+
+	const float *pRow	= pData + 2 * static_cast<size_t>(j) * nx;
+	const float *pRowM	= pData + 2 * static_cast<size_t>(jm) * nx;
+	const float *pRowP	= pData + 2 * static_cast<size_t>(jp) * nx;
+
+	int i = nMinX;
+
+	//The first column uses a forward difference
+	for (; i < nMaxX && i < 1; i++)
 	{
-		for (unsigned int i = 0; i < m_nSamplesX; i++)
-		{
-			float curr = pData[j * m_nSamplesX + i].abs();
-			if (curr > max) max = curr;
-			else if (curr < min) min = curr;
-			(*pMagField)[nIdx++] = curr;
-		}
+		const float w = _getVorticitySample(pRow, pRowM, pRowP, nx, i, fWeightY);
+
+		if (pOut) pOut[i - nMinX] = w;
+		if (pAbs) pAbs[i - nMinX] = fabs(w);
+
+		fMin	= min(fMin, w);
+		fMax	= max(fMax, w);
+		fAbsMin	= min(fAbsMin, fabs(w));
 	}
-	
-	pMagField->SetMinMax(min, max);
 
-	return pMagField;
+	const __m128 half		= _mm_set1_ps(0.5f);
+	const __m128 weightY	= _mm_set1_ps(fWeightY);
+	const __m128 signMask	= _mm_set1_ps(-0.0f);
+
+	__m128 vMin		= _mm_set1_ps(fMin);
+	__m128 vMax		= _mm_set1_ps(fMax);
+	__m128 vAbsMin	= _mm_set1_ps(fAbsMin);
+
+	//Central differences in x up to the second to last column. Even lanes hold u, odd lanes v.
+	const int nEnd = min(nMaxX, nx - 1);
+
+	for (; i + 4 <= nEnd; i += 4)
+	{
+		const __m128 vp = _mm_shuffle_ps(_mm_loadu_ps(pRow + 2*i + 2), _mm_loadu_ps(pRow + 2*i + 6), _MM_SHUFFLE(3, 1, 3, 1));
+		const __m128 vm = _mm_shuffle_ps(_mm_loadu_ps(pRow + 2*i - 2), _mm_loadu_ps(pRow + 2*i + 2), _MM_SHUFFLE(3, 1, 3, 1));
+		const __m128 up = _mm_shuffle_ps(_mm_loadu_ps(pRowP + 2*i), _mm_loadu_ps(pRowP + 2*i + 4), _MM_SHUFFLE(2, 0, 2, 0));
+		const __m128 um = _mm_shuffle_ps(_mm_loadu_ps(pRowM + 2*i), _mm_loadu_ps(pRowM + 2*i + 4), _MM_SHUFFLE(2, 0, 2, 0));
+
+		const __m128 w		= _mm_sub_ps(_mm_mul_ps(half, _mm_sub_ps(vp, vm)), _mm_mul_ps(weightY, _mm_sub_ps(up, um)));
+		const __m128 wAbs	= _mm_andnot_ps(signMask, w);
+
+		if (pOut) _mm_storeu_ps(pOut + i - nMinX, w);
+		if (pAbs) _mm_storeu_ps(pAbs + i - nMinX, wAbs);
+
+		vMin	= _mm_min_ps(vMin, w);
+		vMax	= _mm_max_ps(vMax, w);
+		vAbsMin	= _mm_min_ps(vAbsMin, wAbs);
+	}
+
+	float lanes[3][4];
+	_mm_storeu_ps(lanes[0], vMin);
+	_mm_storeu_ps(lanes[1], vMax);
+	_mm_storeu_ps(lanes[2], vAbsMin);
+
+	for (int k = 0; k < 4; k++)
+	{
+		fMin	= min(fMin, lanes[0][k]);
+		fMax	= max(fMax, lanes[1][k]);
+		fAbsMin	= min(fAbsMin, lanes[2][k]);
+	}
+
+	for (; i < nMaxX; i++)
+	{
+		const float w = _getVorticitySample(pRow, pRowM, pRowP, nx, i, fWeightY);
+
+		if (pOut) pOut[i - nMinX] = w;
+		if (pAbs) pAbs[i - nMinX] = fabs(w);
+
+		fMin	= min(fMin, w);
+		fMax	= max(fMax, w);
+		fAbsMin	= min(fAbsMin, fabs(w));
+	}
 }
 
-CScalarField2D* CVectorField2D::GetVorticityField(bool bGetMagnitude) const
+void CVectorField2D::GetVorticity(int nMinX, int nMinY, int nWidth, int nHeight, float *pOut, int nStride) const
 {
-	CScalarField2D *pVortField = new CScalarField2D(m_rcDomain, m_nSamplesX, m_nSamplesY);
+	const float *pData = reinterpret_cast<const float*>(m_pData);
+	float fMin(FLT_MAX), fMax(-FLT_MAX), fAbsMin(FLT_MAX);
 
-	//Get function pointer to desired vorticity function
-	float (CVectorField2D::*pVorticityFunc)(float x, float y) const = (bGetMagnitude)? &CVectorField2D::_getVorticityAbs : &CVectorField2D::_getVorticity;
+	for (int j = 0; j < nHeight; j++) {
+		_getVorticityRow(pData, m_nSamplesX, m_nSamplesY, nMinY + j, nMinX, nMinX + nWidth, pOut + j * nStride, nullptr, fMin, fMax, fAbsMin);
+	}
+}
 
-	static float min, max;
+void CVectorField2D::GetVorticityFields(CScalarField2D **ppVorticity, CScalarField2D **ppVorticityAbs) const
+{
+	const int nx = static_cast<int>(m_nSamplesX);
+	const int ny = static_cast<int>(m_nSamplesY);
 
-	min = max = (this->*pVorticityFunc)(0,0);
-	int nIdx(0);
-	for (unsigned int j = 0; j < m_nSamplesY; j++)
+	CScalarField2D *pVort	= (ppVorticity)? new CScalarField2D(m_rcDomain, nx, ny) : nullptr;
+	CScalarField2D *pAbs	= (ppVorticityAbs)? new CScalarField2D(m_rcDomain, nx, ny) : nullptr;
+
+	if (ppVorticity)	*ppVorticity	= pVort;
+	if (ppVorticityAbs)	*ppVorticityAbs	= pAbs;
+
+	if (nx == 0 || ny == 0 || (!pVort && !pAbs)) return;
+
+	const float *pData = reinterpret_cast<const float*>(m_pData);
+	float *pVortData	= (pVort)? pVort->GetData() : nullptr;
+	float *pAbsData		= (pAbs)? pAbs->GetData() : nullptr;
+
+	//Ranges of each row, reduced after the parallel pass
+	vector<float> rowMin(ny), rowMax(ny), rowAbsMin(ny);
+
+	#pragma omp parallel for
+	for (int j = 0; j < ny; j++)
+	{
+		float fMin(FLT_MAX), fMax(-FLT_MAX), fAbsMin(FLT_MAX);
+
+		_getVorticityRow(pData, nx, ny, j, 0, nx, (pVortData)? pVortData + static_cast<size_t>(j) * nx : nullptr, 
+						 (pAbsData)? pAbsData + static_cast<size_t>(j) * nx : nullptr, fMin, fMax, fAbsMin);
+
+		rowMin[j]		= fMin;
+		rowMax[j]		= fMax;
+		rowAbsMin[j]	= fAbsMin;
+	}
+
+	float fMin(FLT_MAX), fMax(-FLT_MAX), fAbsMin(FLT_MAX);
+
+	for (int j = 0; j < ny; j++)
+	{
+		fMin	= min(fMin, rowMin[j]);
+		fMax	= max(fMax, rowMax[j]);
+		fAbsMin	= min(fAbsMin, rowAbsMin[j]);
+	}
+
+	if (pVort)	pVort->SetMinMax(fMin, fMax);
+	if (pAbs)	pAbs->SetMinMax(fAbsMin, max(-fMin, fMax));
+}
+
+/*
+	Neighbours and weight of the difference along one axis of the grid, with the same results as the 
+	half-cell offsets of _getVorticity() through _getVectorAt(): central differences in the interior,
+	a forward difference at the first sample and half a backward difference at the last one.
+*/
+static void _getDifferenceStencil(int n, vector<int> &lower, vector<int> &upper, vector<float> &weight)
+{
+	lower.resize(n);
+	upper.resize(n);
+	weight.resize(n);
+
+	for (int i = 0; i < n; i++)
+	{
+		lower[i]	= (i > 0)? i - 1 : 0;
+		upper[i]	= (i < n - 1)? i + 1 : n - 1;
+		weight[i]	= (i == 0 && n > 1)? 1.0f : 0.5f;
+	}
+}
+
+void CVectorField2D::GetDerivedFields(unsigned int nFields, CScalarField2D **ppFields) const
+{
+	const int nx		= static_cast<int>(m_nSamplesX);
+	const int ny		= static_cast<int>(m_nSamplesY);
+	const int nTileSize	= 64;
+	const int nTilesX	= (nx + nTileSize - 1) / nTileSize;
+	const int nTilesY	= (ny + nTileSize - 1) / nTileSize;
+	const int nTiles	= nTilesX * nTilesY;
+
+	const CVector2D *pData = reinterpret_cast<const CVector2D*>(m_pData);
+	float *pOut[DF_NUM_FIELDS];
+
+	for (int k = 0; k < DF_NUM_FIELDS; k++)
+	{
+		ppFields[k] = (nFields & (1 << k))? new CScalarField2D(m_rcDomain, nx, ny) : nullptr;
+		pOut[k]		= (ppFields[k])? ppFields[k]->GetData() : nullptr;
+	}
+
+	if (nTiles == 0) return;
+
+	//The vorticity alone is computed by the vectorized kernel
+	if (nFields == DF_VORTICITY)
+	{
+		delete ppFields[1];
+		GetVorticityFields(&ppFields[1], nullptr);
+		return;
+	}
+
+	vector<int> xm, xp, ym, yp;
+	vector<float> xw, yw;
+
+	_getDifferenceStencil(nx, xm, xp, xw);
+	_getDifferenceStencil(ny, ym, yp, yw);
+
+	//Minimum and maximum of each field per tile, reduced after the parallel pass
+	vector<float> minmax(nTiles * DF_NUM_FIELDS * 2);
+
+	#pragma omp parallel for schedule(dynamic, 1)
+	for (int t = 0; t < nTiles; t++)
 	{
-		for (unsigned int i = 0; i < m_nSamplesX; i++)
+		const int nMinX = (t % nTilesX) * nTileSize;
+		const int nMinY = (t / nTilesX) * nTileSize;
+		const int nMaxX = min(nMinX + nTileSize, nx);
+		const int nMaxY = min(nMinY + nTileSize, ny);
+
+		float fMin[DF_NUM_FIELDS], fMax[DF_NUM_FIELDS];
+
+		for (int k = 0; k < DF_NUM_FIELDS; k++) {
+			fMin[k] = FLT_MAX;
+			fMax[k] = -FLT_MAX;
+		}
+
+		for (int j = nMinY; j < nMaxY; j++)
 		{
-			float curr = (this->*pVorticityFunc)( static_cast<float>(i), static_cast<float>(j) );
-			if (curr > max) max = curr;
-			else if (curr < min) min = curr;
-			(*pVortField)[nIdx++] = curr;
+			for (int i = nMinX; i < nMaxX; i++)
+			{
+				const int idx = j * nx + i;
+
+				//Velocity gradient, computed once for all fields
+				const CVector2D dx = (pData[j * nx + xp[i]] - pData[j * nx + xm[i]]) * xw[i];
+				const CVector2D dy = (pData[yp[j] * nx + i] - pData[ym[j] * nx + i]) * yw[j];
+
+				const float ux = dx.x, vx = dx.y, uy = dy.x, vy = dy.y;
+				float val[DF_NUM_FIELDS];
+
+				if (pOut[0]) val[0] = (pData[idx] - m_ReferenceVelocity).abs();
+				if (pOut[1]) val[1] = vx - uy;
+				if (pOut[2]) val[2] = ux + vy;
+				if (pOut[3]) val[3] = -0.5f * (ux * ux + vy * vy) - uy * vx;
+
+				if (pOut[4])
+				{
+					//S^2 + Omega^2 = S^2 - a^2 I, the smaller eigenvalue of S^2 is the square of the eigenvalue of S closest to zero
+					const float m = 0.5f * (ux + vy);
+					const float s = 0.5f * (uy + vx);
+					const float a = 0.5f * (uy - vx);
+					const float r = sqrt( 0.25f * (ux - vy) * (ux - vy) + s * s );
+					const float e = fabs(m) - r;
+
+					val[4] = e * e - a * a;
+				}
+
+				if (pOut[5]) val[5] = (ux - vy) * (ux - vy) + (vx + uy) * (vx + uy) - (vx - uy) * (vx - uy);
+				if (pOut[6]) val[6] = sqrt( ux * ux + vy * vy + 0.5f * (uy + vx) * (uy + vx) );
+
+				for (int k = 0; k < DF_NUM_FIELDS; k++)
+				{
+					if (!pOut[k]) continue;
+
+					pOut[k][idx] = val[k];
+					if (val[k] < fMin[k]) fMin[k] = val[k];
+					if (val[k] > fMax[k]) fMax[k] = val[k];
+				}
+			}
+		}
+
+		for (int k = 0; k < DF_NUM_FIELDS; k++) {
+			minmax[(t * DF_NUM_FIELDS + k) * 2]		= fMin[k];
+			minmax[(t * DF_NUM_FIELDS + k) * 2 + 1]	= fMax[k];
 		}
 	}
-	
-	pVortField->SetMinMax(min, max);
 
-	return pVortField;
+	for (int k = 0; k < DF_NUM_FIELDS; k++)
+	{
+		if (!ppFields[k]) continue;
+
+		float fMin(FLT_MAX), fMax(-FLT_MAX);
+
+		for (int t = 0; t < nTiles; t++) {
+			fMin = min(fMin, minmax[(t * DF_NUM_FIELDS + k) * 2]);
+			fMax = max(fMax, minmax[(t * DF_NUM_FIELDS + k) * 2 + 1]);
+		}
+
+		ppFields[k]->SetMinMax(fMin, fMax);
+	}
 }
 
 CScalarField2D* CVectorField2D::GetVorticityField(CRectF rect, bool bGetMagnitude) const
@@ -32,6 +32,8 @@
 #include "armadillo"
 #include "RectF.h"
 #include "ScalarField.h"
+#include "OccupancyGrid.h"
+#include <vector>
 
 static const float EPSILON = 1e-3f;
 /**
@@ -41,13 +43,53 @@ enum CRITICAL_POINT_TYPE
 { 
 	NONE,				/**< Not defined / invalid */
 	SADDLE,				/**< Saddle point */
-	REPELLING_SADDLE,	/**< Repelling saddle */
+	REPELLING_SADDLE,	/**< Repelling node (source) */
 	REPELLING_FOCUS,	/**< Repelling focus */
 	CENTER,				/**< Center vortex */
 	ATTRACTING_FOCUS,	/**< Vortex with attracting focus */
-	ATTRACTING_SADDLE	/**< Vortex with repelling focus */
+	ATTRACTING_SADDLE	/**< Attracting node (sink) */
 };
 
+/**
+ *	Classifies a critical point by the closed-form eigenvalues of its Jacobian.
+ *
+ *	@param ux Partial derivative du/dx.
+ *	@param uy Partial derivative du/dy.
+ *	@param vx Partial derivative dv/dx.
+ *	@param vy Partial derivative dv/dy.
+ *
+ *	@return The type of the critical point, or NONE if the Jacobian is (nearly) singular.
+ *
+ *	@remarks Trace and determinant are normalized by the largest entry of the Jacobian, hence EPSILON acts as a relative tolerance.
+ */
+CRITICAL_POINT_TYPE ClassifyCriticalPoint(float ux, float uy, float vx, float vy);
+
+/**
+ *	Enumeration of the available stream line integrators.
+ */
+enum STREAMLINE_INTEGRATOR
+{
+	SI_RK4,			/**< Runge-Kutta integration with a fixed step length, see integrateRK4(). */
+	SI_CELLWISE		/**< Cell by cell tracing through the bi-linear interpolant, see integrateCellwise(). */
+};
+
+/**
+ *	Flags of the scalar fields, that are derived from the velocity gradient by CVectorField2D::GetDerivedFields().
+ *	The field of the flag 1<<k is stored at index k.
+ */
+enum DERIVED_FIELD
+{
+	DF_MAGNITUDE	= 0x01,		/**< Vector magnitude. */
+	DF_VORTICITY	= 0x02,		/**< Vorticity, dv/dx - du/dy. */
+	DF_DIVERGENCE	= 0x04,		/**< Divergence, du/dx + dv/dy. */
+	DF_Q_CRITERION	= 0x08,		/**< Q-criterion, (|Omega|^2 - |S|^2)/2. Positive inside vortices. */
+	DF_LAMBDA2		= 0x10,		/**< The smaller eigenvalue of S^2 + Omega^2. Negative inside vortices. */
+	DF_OKUBO_WEISS	= 0x20,		/**< Okubo-Weiss parameter, normal strain^2 + shear strain^2 - vorticity^2. Negative inside vortices. */
+	DF_STRAIN_RATE	= 0x40		/**< Strain rate, the Frobenius norm of S. */
+};
+
+static const int DF_NUM_FIELDS = 7;
+
 /**
  *	This class resembles a two-dimensional vector field.
  *	The vector field consists of N x M samples on a uniform grid.
@@ -64,6 +106,8 @@ class CVectorField2D :
 protected:
 	CMathVector		*m_pData;	/**< Pointer to the actual vector data. For convenient access, it points to a class derived from CMathVector, instead of raw float values */ 
 	bool			 m_bIsMM;	/**< Flag that indicates, if the data in m_pData is retrieved via a memory mapped file */
+	CVector2D		 m_ReferenceVelocity;	/**< Velocity of the observer, which is subtracted from every sample. Zero in the lab frame. */
+	const COccupancyGrid *m_pOccupancy;	/**< Optional grid of the cells, that contain flow. Integration stops on entering a dead cell. Not owned. */
 
 protected:
 	CVectorField2D();
@@ -96,6 +140,33 @@ public:
 	 */
 	virtual CVector2D GetVectorAt(float dx, float dy) const;
 
+	/**
+	 *	Set the velocity of a Galilean reference frame, in the units of the samples. All vectors returned or integrated 
+	 *	by this CVectorField2D are relative to the reference frame. The samples themselves are not modified, so 
+	 *	switching the reference frame is free. Derivatives of the field do not depend on the reference frame.
+	 *
+	 *	@param velocity The velocity of the reference frame. Zero selects the lab frame.
+	 */
+	__inline void SetReferenceVelocity(const CVector2D &velocity) {
+		m_ReferenceVelocity = velocity;
+	}
+
+	/**
+	 *	Retrieve the velocity of the reference frame.
+	 */
+	__inline const CVector2D& GetReferenceVelocity() const {
+		return m_ReferenceVelocity;
+	}
+
+	/**
+	 *	Set the grid of live cells, that is used by the integrators to stop on entering an obstacle or a masked region.
+	 *
+	 *	@param pOccupancy Pointer to a COccupancyGrid of this field, or nullptr to integrate through all cells. It must outlive its use.
+	 */
+	__inline void SetOccupancy(const COccupancyGrid *pOccupancy) {
+		m_pOccupancy = pOccupancy;
+	}
+
 	/**
 	 *	Returns the unnormalised vorticity at the specified location.
 	 *
@@ -119,6 +190,26 @@ public:
 	 */
 	virtual void integrateRK4(float dx, float dy, int numSteps, float stepLen, CPointf *pOutBuff) const;
 
+	/**
+	 *	Traces a stream line cell by cell through the bi-linear interpolant of this CVectorField2D.
+	 *	Inside each cell, the four corner vectors are fetched once and the stream line is advanced with RK4 steps 
+	 *	that reach up to the cell boundary, instead of using a fixed step length.
+	 *	The resulting curve is resampled at multiples of stepLen, hence the output is compatible to integrateRK4().
+	 *
+	 *	@param dx X-component of the starting point in domain space
+	 *	@param dy Y-component of the starting point in domain space
+	 *	@param nNumSteps Maximum number of vertices of the resulting stream line.
+	 *	@param stepLen Distance between two vertices in terms of the integration parameter, in grid space.
+	 *	@param bForward If true, forward integration is performed, otherwise backward integration.
+	 *	@param pOutBuff Pointer to a std::vector to hold the vertices of the resulting stream line in domain space.
+	 *	@param rcIntegrationDomain Rectangular region in which the integration is performed.
+	 *
+	 *	@return The number of evaluations of the interpolant.
+	 *
+	 *	@remarks Tracing stops at critical points, in dead cells of the occupancy grid, as well as at the boundary of the grid or of rcIntegrationDomain.
+	 */
+	int integrateCellwise(float dx, float dy, int nNumSteps, float stepLen, bool bForward, std::vector<CPointf> *pOutBuff, const CRectF &rcIntegrationDomain) const;
+
 	/**
 	 *	Returns the type of the critical point, based on the classification scheme
 	 *	by Helman and Hesselink for at the specified location.
@@ -154,6 +245,43 @@ public:
 	 */
 	virtual CScalarField2D* CVectorField2D::GetVorticityField(CRectF rect, bool bGetMagnitude) const;
 
+	/**
+	 *	Computes the vorticity of a block of samples, with the same values as GetVorticityField().
+	 *
+	 *	@param nMinX Index of the first column of the block.
+	 *	@param nMinY Index of the first row of the block.
+	 *	@param nWidth Number of columns of the block.
+	 *	@param nHeight Number of rows of the block.
+	 *	@param pOut Receives the vorticity of the block, row by row.
+	 *	@param nStride Distance between two rows in pOut, in elements.
+	 *
+	 *	@remarks The block must lie inside the grid.
+	 */
+	void GetVorticity(int nMinX, int nMinY, int nWidth, int nHeight, float *pOut, int nStride) const;
+
+	/**
+	 *	Computes the vorticity field and its magnitude in a single sweep, with the same values as GetVorticityField().
+	 *	Rows are processed in parallel, four samples at a time, directly on the samples of the grid.
+	 *
+	 *	@param ppVorticity If not nullptr, receives the new vorticity field.
+	 *	@param ppVorticityAbs If not nullptr, receives the new vorticity magnitude field.
+	 *
+	 *	@remarks Minimum and maximum of the returned fields are set. The returned scalar fields have to be deleted by the user if not needed anymore.
+	 */
+	void GetVorticityFields(CScalarField2D **ppVorticity, CScalarField2D **ppVorticityAbs) const;
+
+	/**
+	 *	Computes several scalar fields derived from the velocity gradient in a single pass.
+	 *	The gradient is computed once per sample, with the same differences as GetVorticityField(), i.e. per grid cell. 
+	 *	The pass runs in parallel over tiles of the grid.
+	 *
+	 *	@param nFields Combination of DERIVED_FIELD flags.
+	 *	@param ppFields Array of DF_NUM_FIELDS pointers. Receives a new CScalarField2D for each requested field, and nullptr otherwise.
+	 *
+	 *	@remarks The returned scalar fields have to be deleted by the user if not needed anymore.
+	 */
+	void GetDerivedFields(unsigned int nFields, CScalarField2D **ppFields) const;
+
 	/**
 	 *	Retrieves the jacobian matrix for the specified location and stores the result in pJacobian.
 	 *
@@ -0,0 +1,78 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "StdAfx.h"
+#include "VirtualFramePool.h"
+
+#define VFP_MAX_FRAMES	16
+
+CVirtualFramePool::CVirtualFramePool() : m_LRU(VFP_MAX_FRAMES)
+{
+}
+
+CVirtualFramePool::~CVirtualFramePool()
+{
+}
+
+void CVirtualFramePool::Clear()
+{
+	m_LRU.Clear();
+}
+
+void CVirtualFramePool::SetMaxFrames(size_t nMaxFrames)
+{
+	m_LRU.SetMaxFrames(nMaxFrames);
+}
+
+shared_ptr< const vector<CVector2D> > CVirtualFramePool::GetFrame(int nFrame, const CVector2D * const *ppFrames, const float *pWeights, int nNumFrames, int nNumSamples)
+{
+	shared_ptr< vector<CVector2D> > pData = m_LRU.Find(nFrame);
+	if (pData) return pData;
+
+	//Reuse the memory of the least recently used frame, unless it is still referenced
+	pData = m_LRU.Evict();
+
+	if (!pData)
+		pData = make_shared< vector<CVector2D> >();
+
+	pData->resize(nNumSamples);
+
+	CVector2D *pOut = pData->data();
+
+	#pragma omp parallel for
+	for (int i = 0; i < nNumSamples; i++)
+	{
+		CVector2D v ( ppFrames[0][i] * pWeights[0] );
+
+		for (int j = 1; j < nNumFrames; j++)
+			v += ppFrames[j][i] * pWeights[j];
+
+		pOut[i] = v;
+	}
+
+	return m_LRU.Insert(nFrame, pData);
+}
@@ -0,0 +1,99 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+#include "Vector2D.h"
+#include "FrameLRU.h"
+#include <memory>
+#include <vector>
+
+using namespace std;
+using namespace FICore;
+
+/**
+ *	Interpolation schemes between the time steps of a CAmiraVectorField2D.
+ */
+enum TEMPORAL_INTERPOLATION
+{
+	TI_LINEAR = 0,	/**< Linear interpolation between the two enclosing time steps. */
+	TI_CUBIC		/**< Catmull-Rom interpolation through the four closest time steps. The time steps are clamped at the ends. */
+};
+
+/**
+ *	CVirtualFramePool holds virtual frames, i.e. time slices of a vector field between two of its time steps.
+ *	A virtual frame is the weighted sum of up to four time steps, and is materialized in a parallel pass when it
+ *	is requested for the first time. If the number of frames exceeds a limit, the least recently used one is evicted,
+ *	and its memory is reused for the next frame.
+ *
+ *	The pool is not thread-safe. It is keyed by an arbitrary frame index; the owner has to call Clear() whenever
+ *	the meaning of the index, or the weights of an index change.
+ */
+class CVirtualFramePool
+{
+protected:
+	CFrameLRU< vector<CVector2D> >	m_LRU;	/**< Pooled frames. */
+
+public:
+	CVirtualFramePool();
+	~CVirtualFramePool();
+
+public:
+	/**
+	 *	Discards all pooled frames. Frames, that are still referenced, stay valid.
+	 */
+	void Clear();
+
+	/**
+	 *	Set the maximum number of pooled frames. The default is 16.
+	 */
+	void SetMaxFrames(size_t nMaxFrames);
+
+	/**
+	 *	Retrieve a virtual frame, and materialize it if it is not pooled.
+	 *
+	 *	@param nFrame The index of the virtual frame.
+	 *	@param ppFrames Array of nNumFrames pointers to the time steps, the virtual frame is interpolated from.
+	 *	@param pWeights Array of nNumFrames weights of the time steps.
+	 *	@param nNumFrames Number of time steps, 1 to 4.
+	 *	@param nNumSamples Number of samples per time step.
+	 *
+	 *	@return The samples of the virtual frame, which stay valid even if the pool evicts the frame.
+	 *
+	 *	@remarks ppFrames and pWeights are only accessed, if the frame is not pooled.
+	 */
+	shared_ptr< const vector<CVector2D> > GetFrame(int nFrame, const CVector2D * const *ppFrames, const float *pWeights, int nNumFrames, int nNumSamples);
+
+	/**
+	 *	Retrieve the number of pooled frames.
+	 */
+	__inline size_t GetNumFrames() const { return m_LRU.GetNumFrames(); }
+
+	/**
+	 *	Retrieve the number of frames materialized since the last call to Clear().
+	 */
+	__inline size_t GetNumComputedFrames() const { return m_LRU.GetNumComputedFrames(); }
+};
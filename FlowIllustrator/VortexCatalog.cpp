@@ -0,0 +1,490 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "StdAfx.h"
+#include "VortexCatalog.h"
+#include "VortexMeasure.h"
+#include <math.h>
+#include <algorithm>
+#include <sys/stat.h>
+
+#define VC_FILE_MAGIC		0x54414356	//"VCAT"
+#define VC_FILE_VERSION		2
+
+//Provides GetAt() on a sampled frame for CVortexMeasure
+struct _GridView
+{
+	const float *pData;
+	int			 nx;
+
+	__inline float GetAt(int x, int y) const { return pData[y * nx + x]; }
+};
+
+//Bi-linear interpolation in a scalar grid, clamped to the grid
+static float _sampleGrid(const vector<float> &data, int nx, int ny, float x, float y)
+{
+	x = min( max(x, 0.0f), static_cast<float>(nx - 1) );
+	y = min( max(y, 0.0f), static_cast<float>(ny - 1) );
+
+	const int px = min(static_cast<int>(x), nx - 2);
+	const int py = min(static_cast<int>(y), ny - 2);
+	const float s = x - px;
+	const float t = y - py;
+
+	const float *pRow0 = &data[py * nx + px];
+	const float *pRow1 = pRow0 + nx;
+
+	return (1.0f - t) * ((1.0f - s) * pRow0[0] + s * pRow0[1]) + t * ((1.0f - s) * pRow1[0] + s * pRow1[1]);
+}
+
+CVortexCatalog::CVortexCatalog()
+{
+	m_fDetectionThreshold	= 0.2f;
+	m_fMeasureThreshold		= 0.3f;
+	Clear();
+}
+
+CVortexCatalog::~CVortexCatalog()
+{
+}
+
+void CVortexCatalog::Clear()
+{
+	m_nSamplesX		= 0;
+	m_nSamplesY		= 0;
+	m_nTimeSteps	= 0;
+	m_nFileSize		= 0;
+	m_nFileTime		= 0;
+	m_rcDomain		= CRectF(0, 0, 0, 0);
+
+	m_Frames.clear();
+	m_Tracks.clear();
+}
+
+void CVortexCatalog::SetDetectionThreshold(float fThreshold)
+{
+	m_fDetectionThreshold = min( max(fThreshold, 0.0f), 1.0f );
+}
+
+bool CVortexCatalog::IsValid(const CAmiraVectorField2D *pVecField) const
+{
+	return pVecField && m_nTimeSteps > 0
+		&& m_nSamplesX	== static_cast<int>(pVecField->GetExtentX())
+		&& m_nSamplesY	== static_cast<int>(pVecField->GetExtentY())
+		&& m_nTimeSteps	== static_cast<int>(pVecField->GetNumTimeSteps());
+}
+
+string CVortexCatalog::GetFileName(const char *strAmiraFile)
+{
+	return string(strAmiraFile) + ".vortices";
+}
+
+bool CVortexCatalog::_getFileStamp(const char *strFileName, long long &nSize, long long &nTime)
+{
+	struct _stat64 st;
+
+	if (!strFileName || _stat64(strFileName, &st) != 0) {
+		nSize = nTime = 0;
+		return false;
+	}
+
+	nSize = static_cast<long long>(st.st_size);
+	nTime = static_cast<long long>(st.st_mtime);
+
+	return true;
+}
+
+void CVortexCatalog::Build(const CAmiraVectorField2D *pVecField, float fThreshold, const char *strAmiraFile)
+{
+	Clear();
+
+	if (!pVecField || pVecField->GetExtentX() < 3 || pVecField->GetExtentY() < 3) return;
+
+	m_nSamplesX			= static_cast<int>(pVecField->GetExtentX());
+	m_nSamplesY			= static_cast<int>(pVecField->GetExtentY());
+	m_rcDomain			= pVecField->GetDomainRect();
+	m_fMeasureThreshold	= fThreshold;
+	_getFileStamp(strAmiraFile, m_nFileSize, m_nFileTime);
+
+	const int nTimeSteps = static_cast<int>(pVecField->GetNumTimeSteps());
+	m_Frames.resize(nTimeSteps);
+
+	#pragma omp parallel for schedule(dynamic, 1)
+	for (int i = 0; i < nTimeSteps; i++) {
+		_detect(pVecField, i, m_fDetectionThreshold, m_fMeasureThreshold, m_Frames[i]);
+	}
+
+	m_nTimeSteps = nTimeSteps;
+	_link();
+}
+
+void CVortexCatalog::_detect(const CAmiraVectorField2D *pVecField, int nFrame, float fDetectionThreshold, float fMeasureThreshold, vector<VortexCore> &cores)
+{
+	const int nx				= static_cast<int>(pVecField->GetExtentX());
+	const int ny				= static_cast<int>(pVecField->GetExtentY());
+	const CRectF rcDomain		= pVecField->GetDomainRect();
+	const float fCellX			= rcDomain.getWidth() / (nx - 1);
+	const float fCellY			= rcDomain.getHeight() / (ny - 1);
+	const CVector2D *pFrame		= pVecField->GetFrame(nFrame);
+
+	cores.clear();
+
+	//Vorticity in grid units, central differences in the interior, one-sided at the boundary
+	vector<float> vort(nx * ny), mag(nx * ny);
+	float fMax(0.0f);
+
+	for (int j = 0; j < ny; j++)
+	{
+		const int jm = max(j - 1, 0), jp = min(j + 1, ny - 1);
+
+		for (int i = 0; i < nx; i++)
+		{
+			const int im = max(i - 1, 0), ip = min(i + 1, nx - 1);
+			const float dvdx = (pFrame[j*nx + ip].y - pFrame[j*nx + im].y) / (ip - im);
+			const float dudy = (pFrame[jp*nx + i].x - pFrame[jm*nx + i].x) / (jp - jm);
+
+			vort[j*nx + i]	= dvdx - dudy;
+			mag[j*nx + i]	= fabs(dvdx - dudy);
+			fMax			= max(fMax, mag[j*nx + i]);
+		}
+	}
+
+	const float fMinCore = fDetectionThreshold * fMax;
+	if (fMax <= 0.0f) return;
+
+	const _GridView grid = { &mag[0], nx };
+	const CVortexMeasure measure;
+
+	for (int j = 1; j < ny - 1; j++)
+	{
+		for (int i = 1; i < nx - 1; i++)
+		{
+			const float *p	= &mag[j*nx + i];
+			const float f	= *p;
+
+			if (f < fMinCore || f <= 0.0f) continue;
+
+			//Local maximum, ties are resolved in favour of the first sample
+			if ( !(f > p[-nx-1] && f > p[-nx] && f > p[-nx+1] && f > p[-1] && f >= p[1] && f >= p[nx-1] && f >= p[nx] && f >= p[nx+1]) ) continue;
+
+			//Sub-cell position of the peak by fitting a parabola in each direction
+			const float fxx = p[1] - 2.0f*f + p[-1];
+			const float fyy = p[nx] - 2.0f*f + p[-nx];
+
+			float dx = (fxx < 0.0f)? 0.5f * (p[-1] - p[1]) / fxx : 0.0f;
+			float dy = (fyy < 0.0f)? 0.5f * (p[-nx] - p[nx]) / fyy : 0.0f;
+			dx = min( max(dx, -0.5f), 0.5f );
+			dy = min( max(dy, -0.5f), 0.5f );
+
+			const float gx		= i + dx;
+			const float gy		= j + dy;
+			VortexExtent extent;
+			measure.Measure(grid, 0, 0, nx - 1, ny - 1, fCellX, fCellY, CVector2D(gx, gy), fMeasureThreshold, extent);
+
+			VortexCore core;
+			core.pos		= CPointf(rcDomain.m_Min.x + gx * fCellX, rcDomain.m_Min.y + gy * fCellY);
+			core.fVorticity	= _sampleGrid(vort, nx, ny, gx, gy);
+			core.fRadius1	= extent.fRadius1;
+			core.fRadius2	= extent.fRadius2;
+			core.fAngle		= extent.fAngle;
+			core.nTrack		= -1;
+
+			//Jacobian at the closest sample, in domain units
+			const int ci = min( max(static_cast<int>(gx + 0.5f), 1), nx - 2 );
+			const int cj = min( max(static_cast<int>(gy + 0.5f), 1), ny - 2 );
+			const CVector2D *c = &pFrame[cj*nx + ci];
+
+			core.nType = ClassifyCriticalPoint(	(c[1].x - c[-1].x) / (2.0f * fCellX), (c[nx].x - c[-nx].x) / (2.0f * fCellY),
+												(c[1].y - c[-1].y) / (2.0f * fCellX), (c[nx].y - c[-nx].y) / (2.0f * fCellY) );
+
+			cores.push_back(core);
+		}
+	}
+}
+
+void CVortexCatalog::_link()
+{
+	if (m_Frames.empty()) return;
+
+	const float fMinDist = 2.0f * max( m_rcDomain.getWidth() / (m_nSamplesX - 1), m_rcDomain.getHeight() / (m_nSamplesY - 1) );
+	int nNumTracks(0);
+
+	for (auto iter = m_Frames[0].begin(); iter != m_Frames[0].end(); ++iter) {
+		iter->nTrack = nNumTracks++;
+	}
+
+	vector< pair<float, pair<int, int> > > candidates;
+
+	for (size_t f = 1; f < m_Frames.size(); f++)
+	{
+		vector<VortexCore> &prev = m_Frames[f - 1];
+		vector<VortexCore> &curr = m_Frames[f];
+
+		//All pairs with the same sense of rotation within reach, closest first
+		candidates.clear();
+
+		for (size_t i = 0; i < prev.size(); i++)
+		{
+			const float fReach = max( max(prev[i].fRadius1, prev[i].fRadius2), fMinDist );
+
+			for (size_t j = 0; j < curr.size(); j++)
+			{
+				if ( (prev[i].fVorticity < 0.0f) != (curr[j].fVorticity < 0.0f) ) continue;
+
+				const float dx = curr[j].pos.x - prev[i].pos.x;
+				const float dy = curr[j].pos.y - prev[i].pos.y;
+				const float d2 = dx*dx + dy*dy;
+
+				if (d2 <= fReach * fReach) {
+					candidates.push_back( make_pair(d2, make_pair(static_cast<int>(i), static_cast<int>(j))) );
+				}
+			}
+		}
+
+		sort(candidates.begin(), candidates.end());
+
+		vector<char> bUsed(prev.size(), 0);
+		for (auto iter = curr.begin(); iter != curr.end(); ++iter) {
+			iter->nTrack = -1;
+		}
+
+		for (auto iter = candidates.begin(); iter != candidates.end(); ++iter)
+		{
+			const int i = iter->second.first;
+			const int j = iter->second.second;
+
+			if (bUsed[i] || curr[j].nTrack >= 0) continue;
+
+			bUsed[i]		= 1;
+			curr[j].nTrack	= prev[i].nTrack;
+		}
+
+		for (auto iter = curr.begin(); iter != curr.end(); ++iter) {
+			if (iter->nTrack < 0) iter->nTrack = nNumTracks++;
+		}
+	}
+
+	_buildTracks();
+}
+
+void CVortexCatalog::_buildTracks()
+{
+	m_Tracks.clear();
+
+	for (size_t f = 0; f < m_Frames.size(); f++)
+	{
+		for (size_t i = 0; i < m_Frames[f].size(); i++)
+		{
+			const int nTrack = m_Frames[f][i].nTrack;
+			if (nTrack < 0) continue;
+
+			if (nTrack >= static_cast<int>(m_Tracks.size())) {
+				m_Tracks.resize(nTrack + 1);
+			}
+
+			VortexTrack &track = m_Tracks[nTrack];
+			if (track.cores.empty()) {
+				track.nStartFrame = static_cast<int>(f);
+			}
+
+			track.cores.resize(f - track.nStartFrame + 1, -1);
+			track.cores[f - track.nStartFrame] = static_cast<int>(i);
+		}
+	}
+}
+
+const VortexCore* CVortexCatalog::FindCore(int nFrame, const CPointf &pt) const
+{
+	if (nFrame < 0 || nFrame >= m_nTimeSteps) return nullptr;
+
+	const VortexCore *pResult = nullptr;
+	float fBest(1.0f);
+
+	for (auto iter = m_Frames[nFrame].begin(); iter != m_Frames[nFrame].end(); ++iter)
+	{
+		if (iter->fRadius1 <= 0.0f || iter->fRadius2 <= 0.0f) continue;
+
+		//Distance in the frame of the ellipse, normalized by its radii
+		const float a	= iter->fAngle * 3.14159265f / 180.0f;
+		const float dx	= pt.x - iter->pos.x;
+		const float dy	= pt.y - iter->pos.y;
+		const float u	= ( cos(a) * dx + sin(a) * dy) / iter->fRadius1;
+		const float v	= (-sin(a) * dx + cos(a) * dy) / iter->fRadius2;
+		const float d	= u*u + v*v;
+
+		if (d <= fBest) {
+			fBest	= d;
+			pResult	= &(*iter);
+		}
+	}
+
+	return pResult;
+}
+
+const VortexCore* CVortexCatalog::FollowCore(const VortexCore *pCore, int nFrame) const
+{
+	if (!pCore || pCore->nTrack < 0 || pCore->nTrack >= static_cast<int>(m_Tracks.size())) return nullptr;
+	if (nFrame < 0 || nFrame >= m_nTimeSteps) return nullptr;
+
+	const VortexTrack &track = m_Tracks[pCore->nTrack];
+	const int nOffset = nFrame - track.nStartFrame;
+
+	if (nOffset < 0 || nOffset >= static_cast<int>(track.cores.size())) return nullptr;
+
+	const int nIdx = track.cores[nOffset];
+	return (nIdx < 0)? nullptr : &m_Frames[nFrame][nIdx];
+}
+
+void CVortexCatalog::GetTrajectory(const VortexCore *pCore, int nFrame, int nMaxLen, vector<CPointf> &points) const
+{
+	points.clear();
+
+	if (!pCore || pCore->nTrack < 0 || pCore->nTrack >= static_cast<int>(m_Tracks.size())) return;
+
+	const VortexTrack &track = m_Tracks[pCore->nTrack];
+
+	for (int f = nFrame; f >= track.nStartFrame && static_cast<int>(points.size()) < nMaxLen; f--)
+	{
+		const int nIdx = track.cores[f - track.nStartFrame];
+		if (nIdx < 0) break;
+
+		points.push_back(m_Frames[f][nIdx].pos);
+	}
+}
+
+bool CVortexCatalog::Save(const char *strFileName) const
+{
+	if (m_nTimeSteps == 0) return false;
+
+	FILE *pFile(nullptr);
+	fopen_s(&pFile, strFileName, "wb");
+	if (!pFile) return false;
+
+	const int header[6] = { VC_FILE_MAGIC, VC_FILE_VERSION, m_nSamplesX, m_nSamplesY, m_nTimeSteps, static_cast<int>(sizeof(VortexCore)) };
+	const float params[6] = { m_rcDomain.m_Min.x, m_rcDomain.m_Min.y, m_rcDomain.m_Max.x, m_rcDomain.m_Max.y, m_fDetectionThreshold, m_fMeasureThreshold };
+	const long long stamp[2] = { m_nFileSize, m_nFileTime };
+
+	bool bResult =	fwrite(header, sizeof(int), 6, pFile) == 6 
+				 && fwrite(params, sizeof(float), 6, pFile) == 6
+				 && fwrite(stamp, sizeof(long long), 2, pFile) == 2;
+
+	for (size_t f = 0; f < m_Frames.size() && bResult; f++)
+	{
+		const int nNumCores = static_cast<int>(m_Frames[f].size());
+		bResult = fwrite(&nNumCores, sizeof(int), 1, pFile) == 1;
+
+		if (bResult && nNumCores > 0) {
+			bResult = fwrite(&m_Frames[f][0], sizeof(VortexCore), nNumCores, pFile) == static_cast<size_t>(nNumCores);
+		}
+	}
+
+	fclose(pFile);
+
+	return bResult;
+}
+
+bool CVortexCatalog::Load(const char *strFileName, const CAmiraVectorField2D *pVecField, const char *strAmiraFile)
+{
+	Clear();
+
+	if (!pVecField) return false;
+
+	FILE *pFile(nullptr);
+	fopen_s(&pFile, strFileName, "rb");
+	if (!pFile) return false;
+
+	int header[6];
+	float params[6];
+	long long stamp[2], nFileSize, nFileTime, nSidecarSize, nSidecarTime;
+
+	_getFileStamp(strAmiraFile, nFileSize, nFileTime);
+	_getFileStamp(strFileName, nSidecarSize, nSidecarTime);
+
+	const CRectF rcDomain = pVecField->GetDomainRect();
+
+	bool bResult =	fread(header, sizeof(int), 6, pFile) == 6
+				 && fread(params, sizeof(float), 6, pFile) == 6
+				 && fread(stamp, sizeof(long long), 2, pFile) == 2
+				 && header[0] == VC_FILE_MAGIC
+				 && header[1] == VC_FILE_VERSION
+				 && header[2] == static_cast<int>(pVecField->GetExtentX())
+				 && header[3] == static_cast<int>(pVecField->GetExtentY())
+				 && header[4] == static_cast<int>(pVecField->GetNumTimeSteps())
+				 && header[5] == static_cast<int>(sizeof(VortexCore))
+				 && params[0] == rcDomain.m_Min.x && params[1] == rcDomain.m_Min.y 
+				 && params[2] == rcDomain.m_Max.x && params[3] == rcDomain.m_Max.y
+				 && stamp[0] == nFileSize && stamp[1] == nFileTime;
+
+	if (bResult)
+	{
+		m_Frames.resize(header[4]);
+
+		//The counts are checked against the size of the file, before anything is allocated for them
+		long long nNumCoresTotal(0);
+
+		for (size_t f = 0; f < m_Frames.size() && bResult; f++)
+		{
+			int nNumCores(0);
+			bResult =	fread(&nNumCores, sizeof(int), 1, pFile) == 1 && nNumCores >= 0
+					 && (nNumCoresTotal + nNumCores) * static_cast<long long>(sizeof(VortexCore)) <= nSidecarSize;
+
+			if (bResult && nNumCores > 0) {
+				m_Frames[f].resize(nNumCores);
+				bResult = fread(&m_Frames[f][0], sizeof(VortexCore), nNumCores, pFile) == static_cast<size_t>(nNumCores);
+			}
+
+			nNumCoresTotal += nNumCores;
+		}
+
+		//Each track starts at a core, so its index is below the number of cores. Untracked cores have -1.
+		for (size_t f = 0; f < m_Frames.size() && bResult; f++)
+		{
+			for (auto iter = m_Frames[f].begin(); iter != m_Frames[f].end() && bResult; ++iter)
+				bResult = (iter->nTrack >= -1 && iter->nTrack < nNumCoresTotal);
+		}
+	}
+
+	fclose(pFile);
+
+	if (!bResult) {
+		Clear();
+		return false;
+	}
+
+	m_nSamplesX				= header[2];
+	m_nSamplesY				= header[3];
+	m_nTimeSteps			= header[4];
+	m_rcDomain				= CRectF(params[0], params[1], params[2], params[3]);
+	m_fDetectionThreshold	= params[4];
+	m_fMeasureThreshold		= params[5];
+	m_nFileSize				= stamp[0];
+	m_nFileTime				= stamp[1];
+
+	_buildTracks();
+
+	return true;
+}
@@ -0,0 +1,213 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+#include "AmiraVectorField2D.h"
+#include <vector>
+#include <string>
+
+using namespace std;
+
+/**
+ *	A vortex core, detected in a single time step.
+ */
+struct VortexCore
+{
+	CPointf				pos;		/**< Position of the core in domain space. */
+	float				fVorticity;	/**< Signed vorticity at the core, in the units of CAmiraVectorField2D::GetVorticityField(). */
+	float				fRadius1;	/**< Radius of the vortex along the axis given by fAngle, in domain units. */
+	float				fRadius2;	/**< Radius of the vortex perpendicular to the axis given by fAngle, in domain units. */
+	float				fAngle;		/**< Orientation of the first axis in degrees, measured from the x-axis. */
+	CRITICAL_POINT_TYPE	nType;		/**< Classification of the flow at the core. */
+	int					nTrack;		/**< Index of the track, this core belongs to. */
+};
+
+/**
+ *	A vortex, followed through time.
+ */
+struct VortexTrack
+{
+	int			nStartFrame;		/**< Time step, in which the vortex appeared first. */
+	vector<int>	cores;				/**< Index of the core of the vortex in each time step, starting at nStartFrame. */
+};
+
+/**
+ *	CVortexCatalog holds the vortex cores of every time step of a vector field, linked over time.
+ *
+ *	The catalog is built once for all time steps in parallel. Vortex cores are the local maxima of the 
+ *	vorticity magnitude above a fraction of the maximum of the time step. Their extent is measured along the 
+ *	principal axes of the vorticity peak. Cores of consecutive time steps are linked to tracks by the closest match 
+ *	with the same sense of rotation.
+ *
+ *	The catalog is stored in a sidecar file next to the vector field, see GetFileName(). Placing a vortex, following it
+ *	to another time step and its trajectory become lookups, instead of a search in the vorticity field.
+ */
+class CVortexCatalog
+{
+protected:
+	int							 m_nSamplesX;			/**< Number of samples in x-direction of the vector field. */
+	int							 m_nSamplesY;			/**< Number of samples in y-direction of the vector field. */
+	int							 m_nTimeSteps;			/**< Number of time steps of the vector field. Zero, if the catalog is empty. */
+	CRectF						 m_rcDomain;			/**< Domain of the vector field. */
+	long long					 m_nFileSize;			/**< Size of the vector field file, used to detect outdated sidecar files. */
+	long long					 m_nFileTime;			/**< Modification time of the vector field file, used to detect outdated sidecar files. */
+	float						 m_fDetectionThreshold;	/**< Minimum vorticity magnitude of a core, relative to the maximum of its time step. */
+	float						 m_fMeasureThreshold;	/**< The extent of a vortex ends, where the vorticity magnitude drops below this fraction of the core value. */
+	vector< vector<VortexCore> > m_Frames;				/**< The vortex cores of each time step. */
+	vector<VortexTrack>			 m_Tracks;				/**< The tracks of all vortices. */
+
+public:
+	CVortexCatalog();
+	~CVortexCatalog();
+
+public:
+	/**
+	 *	Discards the catalog.
+	 */
+	void Clear();
+
+	/**
+	 *	Set the minimum vorticity magnitude of a vortex core. Takes effect with the next call to Build().
+	 *
+	 *	@param fThreshold The threshold, relative to the maximum vorticity magnitude of each time step. The default is 0.2.
+	 */
+	void SetDetectionThreshold(float fThreshold);
+
+	/**
+	 *	Detects and links the vortices of all time steps of a vector field.
+	 *
+	 *	@param pVecField Pointer to the vector field.
+	 *	@param fThreshold The extent of a vortex ends, where the vorticity magnitude drops below this fraction of the core value.
+	 *	@param strAmiraFile Name of the file, the vector field was loaded from. Used to detect outdated sidecar files.
+	 */
+	void Build(const CAmiraVectorField2D *pVecField, float fThreshold, const char *strAmiraFile);
+
+	/**
+	 *	Loads a catalog from a sidecar file.
+	 *
+	 *	@param strFileName Name of the sidecar file.
+	 *	@param pVecField The vector field, the catalog has to belong to.
+	 *	@param strAmiraFile Name of the file, the vector field was loaded from.
+	 *
+	 *	@return Returns false, if the file could not be read, or if it belongs to another or a modified vector field.
+	 */
+	bool Load(const char *strFileName, const CAmiraVectorField2D *pVecField, const char *strAmiraFile);
+
+	/**
+	 *	Saves the catalog to a sidecar file.
+	 *
+	 *	@param strFileName Name of the sidecar file.
+	 *
+	 *	@return Returns false, if the file could not be written.
+	 */
+	bool Save(const char *strFileName) const;
+
+	/**
+	 *	Retrieve the name of the sidecar file, that belongs to a vector field file.
+	 *
+	 *	@param strAmiraFile Name of the vector field file.
+	 */
+	static string GetFileName(const char *strAmiraFile);
+
+	/**
+	 *	Checks, if the catalog was built for the specified vector field.
+	 */
+	bool IsValid(const CAmiraVectorField2D *pVecField) const;
+
+	/**
+	 *	Retrieve the measurement threshold, the catalog was built with.
+	 */
+	__inline float GetMeasureThreshold() const { return m_fMeasureThreshold; }
+
+	/**
+	 *	Retrieve the vortex cores of a time step.
+	 */
+	__inline const vector<VortexCore>& GetCores(int nFrame) const { return m_Frames[nFrame]; }
+
+	/**
+	 *	Retrieve the number of tracks.
+	 */
+	__inline size_t GetNumTracks() const { return m_Tracks.size(); }
+
+	/**
+	 *	Retrieve a single track.
+	 */
+	__inline const VortexTrack& GetTrack(size_t nIdx) const { return m_Tracks[nIdx]; }
+
+	/**
+	 *	Finds the vortex of a time step, whose extent contains a location.
+	 *
+	 *	@param nFrame The time step.
+	 *	@param pt The location in domain space.
+	 *
+	 *	@return A pointer to the vortex core, whose elliptic extent contains pt and whose center is closest to pt, relative 
+	 *			to its extent. If no vortex contains pt, nullptr is returned.
+	 */
+	const VortexCore* FindCore(int nFrame, const CPointf &pt) const;
+
+	/**
+	 *	Follows a vortex along its track to another time step.
+	 *
+	 *	@param pCore A vortex core of this catalog.
+	 *	@param nFrame The time step to follow pCore to.
+	 *
+	 *	@return A pointer to the core of the same track in nFrame. If pCore is not tracked or its track does not
+	 *			cover nFrame, nullptr is returned.
+	 */
+	const VortexCore* FollowCore(const VortexCore *pCore, int nFrame) const;
+
+	/**
+	 *	Retrieve the positions of a vortex in previous time steps.
+	 *
+	 *	@param pCore A vortex core of this catalog.
+	 *	@param nFrame The time step of pCore.
+	 *	@param nMaxLen Maximum number of positions.
+	 *	@param points Receives the positions in domain space, starting at nFrame and going backwards in time.
+	 */
+	void GetTrajectory(const VortexCore *pCore, int nFrame, int nMaxLen, vector<CPointf> &points) const;
+
+protected:
+	/**
+	 *	Detects and measures the vortex cores of a single time step.
+	 */
+	static void _detect(const CAmiraVectorField2D *pVecField, int nFrame, float fDetectionThreshold, float fMeasureThreshold, vector<VortexCore> &cores);
+
+	/**
+	 *	Links the cores of consecutive time steps and assigns the tracks.
+	 */
+	void _link();
+
+	/**
+	 *	Rebuilds m_Tracks from the track indices of the cores.
+	 */
+	void _buildTracks();
+
+	/**
+	 *	Retrieves size and modification time of a file.
+	 */
+	static bool _getFileStamp(const char *strFileName, long long &nSize, long long &nTime);
+};
@@ -0,0 +1,390 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "StdAfx.h"
+#include "VortexDetector.h"
+#include "LocalMaximumSearch.h"
+#include <math.h>
+#include <algorithm>
+
+#define VD_NUM_STRIPS	64
+#define VD_SCALE_RADIUS	1.585f	//Radius of maximum tangential velocity of a Lamb-Oseen vortex relative to the deviation of its vorticity
+
+//Provides GetAt() on the detection field for CLocalMaximumSearch
+struct _FieldView
+{
+	const float *pData;
+	int			 nx;
+
+	__inline float GetAt(int x, int y) const { return pData[y * nx + x]; }
+};
+
+//Moments of a region, accumulated in grid space
+struct _RegionMoments
+{
+	int		nRoot;
+	int		nNumSamples;
+	int		nPeak;
+	double	sx, sy, sxx, sxy, syy;
+};
+
+//Returns the root of a sample, halving the path on the way
+static int _find(vector<int> &parent, int i)
+{
+	while (parent[i] != i) 
+	{
+		parent[i]	= parent[parent[i]];
+		i			= parent[i];
+	}
+
+	return i;
+}
+
+//Joins two regions, the root with the smaller index becomes the root of both
+static void _union(vector<int> &parent, int a, int b)
+{
+	a = _find(parent, a);
+	b = _find(parent, b);
+
+	if (a < b)
+		parent[b] = a;
+	else if (b < a)
+		parent[a] = b;
+}
+
+static bool _peakGreater(const VortexRegion &a, const VortexRegion &b)
+{
+	return a.fPeak > b.fPeak;
+}
+
+CVortexDetector::CVortexDetector()
+{
+	m_nField		= VDF_VORTICITY;
+	m_fThreshold	= 0.2f;
+	m_nMinSamples	= 9;
+}
+
+float CVortexDetector::_computeFields(const CAmiraVectorField2D *pVecField, int nFrame, vector<float> &field, vector<float> &vorticity) const
+{
+	const int nx = static_cast<int>(pVecField->GetExtentX());
+	const int ny = static_cast<int>(pVecField->GetExtentY());
+
+	DERIVED_FIELD nDerived;
+	float fSign(1.0f);
+
+	switch (m_nField)
+	{
+	case VDF_Q_CRITERION:
+		nDerived = DF_Q_CRITERION;
+		break;
+	case VDF_LAMBDA2:
+		nDerived = DF_LAMBDA2;
+		fSign = -1.0f;	//Vortices have negative lambda2
+		break;
+	case VDF_OKUBO_WEISS:
+		nDerived = DF_OKUBO_WEISS;
+		fSign = -1.0f;	//Vortices have negative Okubo-Weiss parameter
+		break;
+	default:
+		nDerived = DF_VORTICITY;
+		break;
+	}
+
+	//The vorticity and the detection field share the velocity gradient, so both are computed in a single pass
+	CScalarField2D *ppFields[DF_NUM_FIELDS];
+	pVecField->GetDerivedFields(DF_VORTICITY | nDerived, ppFields, static_cast<float>(nFrame));
+
+	const CScalarField2D *pVorticity	= nullptr;
+	const CScalarField2D *pDerived		= nullptr;
+
+	for (int i = 0; i < DF_NUM_FIELDS; i++)
+	{
+		if ((1 << i) == DF_VORTICITY)	pVorticity = ppFields[i];
+		if ((1 << i) == nDerived)		pDerived = ppFields[i];
+	}
+
+	const float *pVortData		= pVorticity->GetData();
+	const float *pDerivedData	= pDerived->GetData();
+
+	vorticity.assign(pVortData, pVortData + nx * ny);
+	field.resize(nx * ny);
+
+	if (nDerived == DF_VORTICITY)
+	{
+		#pragma omp parallel for
+		for (int i = 0; i < nx * ny; i++)
+			field[i] = fabs(pVortData[i]);
+	}
+	else
+	{
+		#pragma omp parallel for
+		for (int i = 0; i < nx * ny; i++)
+			field[i] = fSign * pDerivedData[i];
+	}
+
+	for (int i = 0; i < DF_NUM_FIELDS; i++)
+	{
+		if (ppFields[i])
+			delete ppFields[i];
+	}
+
+	float fMax(0.0f);
+
+	for (int i = 0; i < nx * ny; i++)
+		fMax = max(fMax, field[i]);
+
+	return fMax;
+}
+
+void CVortexDetector::_label(const vector<float> &field, const vector<float> &vorticity, int nx, int ny, float fMin, vector<int> &labels) const
+{
+	vector<int> parent(nx * ny);
+
+	const int nNumStrips	= min(VD_NUM_STRIPS, ny);
+	const int nStripHeight	= (ny + nNumStrips - 1) / nNumStrips;
+
+	//Label each strip on its own. Unions only touch samples of the same strip, so the strips are independent.
+	#pragma omp parallel for schedule(dynamic, 1)
+	for (int s = 0; s < nNumStrips; s++)
+	{
+		const int nStart	= s * nStripHeight;
+		const int nEnd		= min(nStart + nStripHeight, ny);
+
+		for (int j = nStart; j < nEnd; j++)
+		{
+			for (int i = 0; i < nx; i++)
+			{
+				const int k = j*nx + i;
+
+				if (field[k] < fMin) {
+					parent[k] = -1;
+					continue;
+				}
+
+				parent[k] = k;
+
+				if (i > 0 && parent[k-1] >= 0 && (vorticity[k-1] < 0.0f) == (vorticity[k] < 0.0f))
+					_union(parent, k-1, k);
+
+				if (j > nStart && parent[k-nx] >= 0 && (vorticity[k-nx] < 0.0f) == (vorticity[k] < 0.0f))
+					_union(parent, k-nx, k);
+			}
+		}
+	}
+
+	//Join the strips along their borders
+	for (int s = 1; s < nNumStrips; s++)
+	{
+		const int j = s * nStripHeight;
+		if (j >= ny) break;
+
+		for (int i = 0; i < nx; i++)
+		{
+			const int k = j*nx + i;
+
+			if (parent[k] >= 0 && parent[k-nx] >= 0 && (vorticity[k-nx] < 0.0f) == (vorticity[k] < 0.0f))
+				_union(parent, k-nx, k);
+		}
+	}
+
+	//Resolve the roots without modifying the forest, so the samples are independent
+	labels.resize(nx * ny);
+
+	#pragma omp parallel for
+	for (int k = 0; k < nx * ny; k++)
+	{
+		int r = parent[k];
+
+		if (r >= 0) {
+			while (parent[r] != r) r = parent[r];
+		}
+
+		labels[k] = r;
+	}
+}
+
+size_t CVortexDetector::Detect(const CAmiraVectorField2D *pVecField, int nFrame, vector<VortexRegion> &regions) const
+{
+	regions.clear();
+
+	if (!pVecField || nFrame < 0 || nFrame >= static_cast<int>(pVecField->GetNumTimeSteps())) return 0;
+
+	const int nx			= static_cast<int>(pVecField->GetExtentX());
+	const int ny			= static_cast<int>(pVecField->GetExtentY());
+	const CRectF rcDomain	= pVecField->GetDomainRect();
+	const float fCellX		= rcDomain.getWidth() / (nx - 1);
+	const float fCellY		= rcDomain.getHeight() / (ny - 1);
+
+	if (nx < 2 || ny < 2) return 0;
+
+	vector<float> field, vorticity;
+	const float fMax = _computeFields(pVecField, nFrame, field, vorticity);
+
+	if (fMax <= 0.0f) return 0;
+
+	vector<int> labels;
+	_label(field, vorticity, nx, ny, max(m_fThreshold * fMax, 1e-30f), labels);
+
+	//Accumulate the moments of each region. Roots are the first sample of their region, so regions are created in scan order.
+	vector<int> index(nx * ny, -1);
+	vector<_RegionMoments> moments;
+
+	for (int j = 0; j < ny; j++)
+	{
+		for (int i = 0; i < nx; i++)
+		{
+			const int k = j*nx + i;
+			const int r = labels[k];
+
+			if (r < 0) continue;
+
+			if (index[r] < 0) 
+			{
+				const _RegionMoments m = { r, 0, k, 0.0, 0.0, 0.0, 0.0, 0.0 };
+				index[r] = static_cast<int>(moments.size());
+				moments.push_back(m);
+			}
+
+			_RegionMoments &m = moments[index[r]];
+
+			m.nNumSamples++;
+			m.sx	+= i;
+			m.sy	+= j;
+			m.sxx	+= static_cast<double>(i) * i;
+			m.sxy	+= static_cast<double>(i) * j;
+			m.syy	+= static_cast<double>(j) * j;
+
+			if (field[k] > field[m.nPeak]) m.nPeak = k;
+		}
+	}
+
+	const _FieldView view = { &field[0], nx };
+	const CLocalMaximumSearch search;
+
+	for (auto iter = moments.begin(); iter != moments.end(); ++iter)
+	{
+		if (iter->nNumSamples < m_nMinSamples) continue;
+
+		const double n	= iter->nNumSamples;
+		const double cx = iter->sx / n;
+		const double cy = iter->sy / n;
+
+		//Covariance in domain units
+		const double cxx = (iter->sxx / n - cx * cx) * fCellX * fCellX;
+		const double cxy = (iter->sxy / n - cx * cy) * fCellX * fCellY;
+		const double cyy = (iter->syy / n - cy * cy) * fCellY * fCellY;
+
+		const double mean = 0.5 * (cxx + cyy);
+		const double diff = sqrt( 0.25 * (cxx - cyy) * (cxx - cyy) + cxy * cxy );
+
+		//Sub-cell location of the peak, if the search stays at the peak
+		CVector2D pos(static_cast<float>(iter->nPeak % nx), static_cast<float>(iter->nPeak / nx));
+		CVector2D posPeak(pos);
+
+		if (!search.Search(view, 0, 0, nx - 1, ny - 1, posPeak) || (posPeak - pos).abs() > 1.0f) posPeak = pos;
+
+		VortexRegion region;
+		region.ptPeak		= CPointf(rcDomain.m_Min.x + posPeak.x * fCellX, rcDomain.m_Min.y + posPeak.y * fCellY);
+		region.fPeak		= field[iter->nPeak];
+		region.fVorticity	= vorticity[iter->nPeak];
+		region.ptCentroid	= CPointf(static_cast<float>(rcDomain.m_Min.x + cx * fCellX), static_cast<float>(rcDomain.m_Min.y + cy * fCellY));
+		region.fArea		= static_cast<float>(n * fCellX * fCellY);
+		region.nNumSamples	= iter->nNumSamples;
+		region.fScale		= 0.0f;
+
+		//A filled ellipse with radius r has the variance r^2/4 along its axis
+		region.fRadius1		= static_cast<float>( 2.0 * sqrt(mean + diff) );
+		region.fRadius2		= static_cast<float>( 2.0 * sqrt(max(mean - diff, 0.0)) );
+		region.fAngle		= static_cast<float>( 0.5 * atan2(2.0 * cxy, cxx - cyy) * 57.2957795 );
+
+		regions.push_back(region);
+	}
+
+	sort(regions.begin(), regions.end(), _peakGreater);
+
+	return regions.size();
+}
+
+size_t CVortexDetector::DetectMultiScale(const CAmiraVectorField2D *pVecField, int nFrame, vector<VortexRegion> &regions, int nNumScales) const
+{
+	regions.clear();
+
+	if (!pVecField || nFrame < 0 || nFrame >= static_cast<int>(pVecField->GetNumTimeSteps())) return 0;
+
+	const int nx			= static_cast<int>(pVecField->GetExtentX());
+	const int ny			= static_cast<int>(pVecField->GetExtentY());
+	const CRectF rcDomain	= pVecField->GetDomainRect();
+	const float fCellX		= rcDomain.getWidth() / (nx - 1);
+	const float fCellY		= rcDomain.getHeight() / (ny - 1);
+
+	if (nx < 2 || ny < 2) return 0;
+
+	vector<float> field, vorticity;
+	const float fMax = _computeFields(pVecField, nFrame, field, vorticity);
+
+	if (fMax <= 0.0f) return 0;
+
+	//The signed vorticity keeps neighbouring vortices of opposite rotation apart
+	const bool bSigned = (m_nField == VDF_VORTICITY);
+
+	CScaleSpace scaleSpace;
+	scaleSpace.Build(bSigned? &vorticity[0] : &field[0], nx, ny, nNumScales);
+
+	vector<ScaleSpaceExtremum> extrema;
+	scaleSpace.FindExtrema(extrema, m_fThreshold, bSigned);
+
+	for (auto iter = extrema.begin(); iter != extrema.end(); ++iter)
+	{
+		const float fRadiusX = VD_SCALE_RADIUS * iter->fScale * fCellX;
+		const float fRadiusY = VD_SCALE_RADIUS * iter->fScale * fCellY;
+		const float fArea	 = 3.14159265f * fRadiusX * fRadiusY;
+
+		const int nNumSamples = static_cast<int>(fArea / (fCellX * fCellY) + 0.5f);
+
+		if (nNumSamples < m_nMinSamples) continue;
+
+		const int i = min(max(static_cast<int>(iter->pos.x + 0.5f), 0), nx - 1);
+		const int j = min(max(static_cast<int>(iter->pos.y + 0.5f), 0), ny - 1);
+
+		VortexRegion region;
+		region.ptPeak		= CPointf(rcDomain.m_Min.x + iter->pos.x * fCellX, rcDomain.m_Min.y + iter->pos.y * fCellY);
+		region.fPeak		= field[j*nx + i];
+		region.fVorticity	= vorticity[j*nx + i];
+		region.ptCentroid	= region.ptPeak;
+		region.fArea		= fArea;
+		region.nNumSamples	= nNumSamples;
+		region.fRadius1		= max(fRadiusX, fRadiusY);
+		region.fRadius2		= min(fRadiusX, fRadiusY);
+		region.fAngle		= (fRadiusX >= fRadiusY)? 0.0f : 90.0f;
+		region.fScale		= iter->fScale * sqrt(fCellX * fCellY);
+
+		regions.push_back(region);
+	}
+
+	return regions.size();
+}
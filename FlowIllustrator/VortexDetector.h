@@ -0,0 +1,137 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#pragma once
+#include "AmiraVectorField2D.h"
+#include "ScaleSpace.h"
+#include <vector>
+
+using namespace std;
+
+#define VD_NUM_SCALES	8		//Default number of levels of the scale space of DetectMultiScale()
+
+/**
+ *	The scalar field, that is segmented by CVortexDetector.
+ */
+enum VORTEX_DETECTION_FIELD
+{
+	VDF_VORTICITY = 0,		/**< Vorticity magnitude. */
+	VDF_Q_CRITERION,		/**< Q-criterion, i.e. rotation dominates strain. */
+	VDF_LAMBDA2,			/**< Negated lambda2-criterion. For divergence-free flow, it equals the Q-criterion in 2D. */
+	VDF_OKUBO_WEISS			/**< Negated Okubo-Weiss parameter. */
+};
+
+/**
+ *	A connected region of a time step, that was detected as vortex by CVortexDetector.
+ */
+struct VortexRegion
+{
+	CPointf	ptPeak;			/**< Location of the maximum of the detection field inside the region, in domain space. */
+	float	fPeak;			/**< Value of the detection field at ptPeak. */
+	float	fVorticity;		/**< Signed vorticity at ptPeak. */
+	CPointf	ptCentroid;		/**< Centroid of the region in domain space. */
+	float	fArea;			/**< Area of the region in square domain units. */
+	float	fRadius1;		/**< Major radius of the ellipse with the same second moments as the region. */
+	float	fRadius2;		/**< Minor radius of the ellipse with the same second moments as the region. */
+	float	fAngle;			/**< Orientation of the major axis in degrees. */
+	int		nNumSamples;	/**< Number of samples of the region. */
+	float	fScale;			/**< Characteristic scale in domain units, if detected by CVortexDetector::DetectMultiScale(), 0 otherwise. */
+};
+
+/**
+ *	CVortexDetector finds all vortices of a time step at once by segmentation.
+ *
+ *	The detection field is thresholded at a fraction of its maximum, and the samples above the threshold are labeled as 
+ *	connected regions by a union-find, which runs on horizontal strips in parallel, before the strips are joined. 
+ *	Neighbouring samples only belong to the same region, if they rotate in the same direction. 
+ *	For each region, the peak, centroid, area and second-moment ellipse are computed in a single pass.
+ */
+class CVortexDetector
+{
+protected:
+	VORTEX_DETECTION_FIELD	m_nField;		/**< The field, that is segmented. */
+	float					m_fThreshold;	/**< Samples above this fraction of the maximum of the field are part of a vortex. */
+	int						m_nMinSamples;	/**< Regions with less samples are discarded. */
+
+public:
+	CVortexDetector();
+
+public:
+	/**
+	 *	Set the field, that is segmented. The default is VDF_VORTICITY.
+	 */
+	__inline void SetField(VORTEX_DETECTION_FIELD nField) { m_nField = nField; }
+
+	/**
+	 *	Set the threshold relative to the maximum of the field in the time step. The default is 0.2.
+	 */
+	__inline void SetThreshold(float fThreshold) { m_fThreshold = fThreshold; }
+
+	/**
+	 *	Set the minimum number of samples of a vortex. The default is 9.
+	 */
+	__inline void SetMinSamples(int nMinSamples) { m_nMinSamples = nMinSamples; }
+
+	/**
+	 *	Detects the vortices of a time step.
+	 *
+	 *	@param pVecField Pointer to the vector field.
+	 *	@param nFrame The time step.
+	 *	@param regions Receives the detected vortices, ordered by decreasing peak value.
+	 *
+	 *	@return The number of detected vortices.
+	 */
+	size_t Detect(const CAmiraVectorField2D *pVecField, int nFrame, vector<VortexRegion> &regions) const;
+
+	/**
+	 *	Detects the vortices of a time step as blobs of the detection field in a CScaleSpace, such that small and large vortices
+	 *	are found in the same pass, and vortices, that touch each other, are separated. For VDF_VORTICITY, the signed vorticity 
+	 *	is searched for maxima and minima. Each vortex is reported as circle of the radius of maximum tangential velocity 
+	 *	of a Lamb-Oseen vortex of its scale, which is stretched along the axes for non-square cells.
+	 *
+	 *	@param pVecField Pointer to the vector field.
+	 *	@param nFrame The time step.
+	 *	@param regions Receives the detected vortices, ordered by decreasing scale-normalized response.
+	 *	@param nNumScales Number of levels of the scale space, each of twice the scale of the previous one.
+	 *
+	 *	@return The number of detected vortices.
+	 */
+	size_t DetectMultiScale(const CAmiraVectorField2D *pVecField, int nFrame, vector<VortexRegion> &regions, int nNumScales = VD_NUM_SCALES) const;
+
+protected:
+	/**
+	 *	Computes the detection field and the vorticity of a time step, and returns the maximum of the detection field.
+	 *	Both are obtained from CAmiraVectorField2D::GetDerivedFields(), such that vortices have positive values.
+	 */
+	float _computeFields(const CAmiraVectorField2D *pVecField, int nFrame, vector<float> &field, vector<float> &vorticity) const;
+
+	/**
+	 *	Labels the connected regions of samples above fMin. Each sample receives the index of the root sample of its region, or -1.
+	 */
+	void _label(const vector<float> &field, const vector<float> &vorticity, int nx, int ny, float fMin, vector<int> &labels) const;
+};
@@ -0,0 +1,109 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "StdAfx.h"
+#include "VortexMeasure.h"
+#include <math.h>
+
+#define VM_NUM_BISECTIONS	16
+
+CVortexMeasure::CVortexMeasure()
+{
+	m_nNumDirections	= 0;
+	m_nNumBisections	= VM_NUM_BISECTIONS;
+}
+
+float CVortexMeasure::_getMajorAxis(const float *hessian, float fCellX, float fCellY)
+{
+	const float hxx = hessian[0] / (fCellX * fCellX);
+	const float hxy = hessian[1] / (fCellX * fCellY);
+	const float hyy = hessian[2] / (fCellY * fCellY);
+
+	//Eigenvector of the larger, i.e. less negative, eigenvalue
+	return 0.5f * atan2(2.0f * hxy, hxx - hyy);
+}
+
+bool CVortexMeasure::_fitEllipse(const vector<CVector2D> &crossings, VortexExtent &extent)
+{
+	//Least squares solution of A*x^2 + B*x*y + C*y^2 = 1 via the normal equations
+	double m[3][3] = { {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0} };
+	double r[3] = { 0.0, 0.0, 0.0 };
+
+	for (auto iter = crossings.begin(); iter != crossings.end(); ++iter)
+	{
+		const double v[3] = { iter->x * iter->x, iter->x * iter->y, iter->y * iter->y };
+
+		for (int i = 0; i < 3; i++) 
+		{
+			r[i] += v[i];
+
+			for (int j = 0; j < 3; j++)
+				m[i][j] += v[i] * v[j];
+		}
+	}
+
+	const double det =	m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+					 -	m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+					 +	m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+
+	if (fabs(det) < 1e-30) return false;
+
+	//Cramer's rule
+	double coeff[3];
+
+	for (int k = 0; k < 3; k++)
+	{
+		double a[3][3];
+
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 3; j++)
+				a[i][j] = (j == k)? r[i] : m[i][j];
+
+		coeff[k] = (	a[0][0] * (a[1][1] * a[2][2] - a[1][2] * a[2][1])
+					-	a[0][1] * (a[1][0] * a[2][2] - a[1][2] * a[2][0])
+					+	a[0][2] * (a[1][0] * a[2][1] - a[1][1] * a[2][0]) ) / det;
+	}
+
+	//Eigenvalues of the quadratic form [A, B/2; B/2, C]
+	const double mean	= 0.5 * (coeff[0] + coeff[2]);
+	const double diff	= sqrt( 0.25 * (coeff[0] - coeff[2]) * (coeff[0] - coeff[2]) + 0.25 * coeff[1] * coeff[1] );
+	const double lMin	= mean - diff;
+	const double lMax	= mean + diff;
+
+	if (lMin <= 0.0) return false;
+
+	//The eigenvector of the smaller eigenvalue is the major axis
+	extent.fRadius1 = static_cast<float>( 1.0 / sqrt(lMin) );
+	extent.fRadius2 = static_cast<float>( 1.0 / sqrt(lMax) );
+	extent.fAngle	= static_cast<float>( (0.5 * atan2(coeff[1], coeff[0] - coeff[2]) + 1.5707963) * 57.2957795 );
+	extent.bValid	= true;
+
+	if (extent.fAngle > 90.0f) extent.fAngle -= 180.0f;
+
+	return true;
+}
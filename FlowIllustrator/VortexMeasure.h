@@ -0,0 +1,245 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#pragma once
+#include "LocalMaximumSearch.h"
+#include <vector>
+
+using namespace std;
+using namespace FICore;
+
+/**
+ *	Extent of a vortex, as measured by CVortexMeasure.
+ */
+struct VortexExtent
+{
+	float	fRadius1;	/**< Radius along the major axis, in domain units. */
+	float	fRadius2;	/**< Radius along the minor axis, in domain units. */
+	float	fAngle;		/**< Orientation of the major axis in degrees. */
+	bool	bValid;		/**< False, if the vortex could not be measured. */
+};
+
+/**
+ *	CVortexMeasure measures the extent of a vortex in a scalar field such as the vorticity magnitude, 
+ *	i.e. the distance from the core to where the field drops below a fraction of its value at the core.
+ *
+ *	Rays are marched from the core in steps of one grid cell until the threshold is crossed or the grid is left, 
+ *	and the crossing is refined by bisection. By default, four rays are cast along the principal axes of the 
+ *	Hessian at the core. Alternatively, rays are cast in several directions and an ellipse is fitted to the crossings.
+ *
+ *	Like CLocalMaximumSearch, the grid is accessed by template functions, which work with every class 
+ *	providing float GetAt(int x, int y) const.
+ */
+class CVortexMeasure
+{
+protected:
+	int		m_nNumDirections;	/**< Number of rays used to fit an ellipse, or 0 to cast rays along the principal axes. */
+	int		m_nNumBisections;	/**< Number of bisection steps used to refine each crossing. */
+
+public:
+	CVortexMeasure();
+
+public:
+	/**
+	 *	Set the number of rays, used to fit an ellipse to the vortex. 
+	 *	With less than 3 rays, the radii are measured along the principal axes of the Hessian at the core, which is the default.
+	 */
+	__inline void SetNumDirections(int nNumDirections) { m_nNumDirections = (nNumDirections < 3)? 0 : nNumDirections; }
+
+	/**
+	 *	Set the number of bisection steps. The default of 16 refines each crossing to 1/65536 of a grid cell.
+	 */
+	__inline void SetNumBisections(int nNumBisections) { m_nNumBisections = nNumBisections; }
+
+	/**
+	 *	Measure the extent of a vortex.
+	 *
+	 *	@param grid The sampled scalar field. GetAt() is only called for grid points inside the specified bounds.
+	 *	@param nMinX First column of the grid, that may be accessed.
+	 *	@param nMinY First row of the grid, that may be accessed.
+	 *	@param nMaxX Last column of the grid, that may be accessed.
+	 *	@param nMaxY Last row of the grid, that may be accessed.
+	 *	@param fCellX Width of a grid cell in domain units.
+	 *	@param fCellY Height of a grid cell in domain units.
+	 *	@param posCore Location of the vortex core in grid space.
+	 *	@param fThreshold Fraction of the value at the core, that bounds the vortex.
+	 *	@param extent Receives the extent of the vortex.
+	 *
+	 *	@return Returns false, if the core lies outside the bounds or the value at the core is not positive.
+	 */
+	template <class TGrid>
+	bool Measure(const TGrid &grid, int nMinX, int nMinY, int nMaxX, int nMaxY, float fCellX, float fCellY, 
+				 const CVector2D &posCore, float fThreshold, VortexExtent &extent) const
+	{
+		extent.fRadius1 = extent.fRadius2 = extent.fAngle = 0.0f;
+		extent.bValid	= false;
+
+		if (posCore.x < nMinX || posCore.y < nMinY || posCore.x > nMaxX || posCore.y > nMaxY) return false;
+
+		float value, hessian[3];
+		CVector2D gradient;
+
+		CLocalMaximumSearch::Evaluate(grid, nMinX, nMinY, nMaxX, nMaxY, posCore, value, gradient, hessian);
+
+		if (value <= 0.0f) return false;
+
+		const float fEnd = _getValue(grid, nMinX, nMinY, nMaxX, nMaxY, posCore.x, posCore.y) * fThreshold;
+
+		if (m_nNumDirections >= 3)
+		{
+			vector<CVector2D> crossings(m_nNumDirections);
+
+			for (int i = 0; i < m_nNumDirections; i++) 
+			{
+				const float a = 6.2831853f * i / m_nNumDirections;
+				const CVector2D dir(cos(a), sin(a));
+
+				crossings[i] = dir * _castRay(grid, nMinX, nMinY, nMaxX, nMaxY, fCellX, fCellY, posCore, dir, fEnd);
+			}
+
+			if (_fitEllipse(crossings, extent)) return true;
+		}
+
+		//Principal axes in domain space. The axis of the weaker curvature is the major axis.
+		const float fAxis = _getMajorAxis(hessian, fCellX, fCellY);
+		const CVector2D axes[2] = { CVector2D(cos(fAxis), sin(fAxis)), CVector2D(-sin(fAxis), cos(fAxis)) };
+		float radii[2];
+
+		for (int i = 0; i < 2; i++) {
+			radii[i] = 0.5f * (	_castRay(grid, nMinX, nMinY, nMaxX, nMaxY, fCellX, fCellY, posCore,  axes[i], fEnd) + 
+								_castRay(grid, nMinX, nMinY, nMaxX, nMaxY, fCellX, fCellY, posCore, -axes[i], fEnd) );
+		}
+
+		extent.fRadius1 = radii[0];
+		extent.fRadius2 = radii[1];
+		extent.fAngle	= fAxis * 57.2957795f;
+		extent.bValid	= true;
+
+		return true;
+	}
+
+	/**
+	 *	Measure the extents of many vortices in parallel. Concurrent calls of TGrid::GetAt() must be safe.
+	 *
+	 *	@return The number of vortices, that were measured successfully.
+	 */
+	template <class TGrid>
+	size_t Measure(const TGrid &grid, int nMinX, int nMinY, int nMaxX, int nMaxY, float fCellX, float fCellY, 
+				   const vector<CVector2D> &posCores, float fThreshold, vector<VortexExtent> &extents) const
+	{
+		const int nNumCores = static_cast<int>(posCores.size());
+		size_t nNumMeasured = 0;
+
+		extents.resize(nNumCores);
+
+		#pragma omp parallel for reduction(+:nNumMeasured) schedule(dynamic, 4)
+		for (int i = 0; i < nNumCores; i++) {
+			if (Measure(grid, nMinX, nMinY, nMaxX, nMaxY, fCellX, fCellY, posCores[i], fThreshold, extents[i]))
+				nNumMeasured++;
+		}
+
+		return nNumMeasured;
+	}
+
+protected:
+	/**
+	 *	Returns the bi-linearly interpolated value of the grid at (x, y), clamped to the bounds.
+	 */
+	template <class TGrid>
+	static float _getValue(const TGrid &grid, int nMinX, int nMinY, int nMaxX, int nMaxY, float x, float y)
+	{
+		x = min( max(x, static_cast<float>(nMinX)), static_cast<float>(nMaxX) );
+		y = min( max(y, static_cast<float>(nMinY)), static_cast<float>(nMaxY) );
+
+		const int px	= static_cast<int>(x);
+		const int py	= static_cast<int>(y);
+		const int px1	= (px < nMaxX)? px + 1 : nMaxX;
+		const int py1	= (py < nMaxY)? py + 1 : nMaxY;
+		const float wx	= x - px;
+		const float wy	= y - py;
+
+		return	(grid.GetAt(px, py)  * (1.0f - wy) + grid.GetAt(px, py1)  * wy) * (1.0f - wx) 
+			+	(grid.GetAt(px1, py) * (1.0f - wy) + grid.GetAt(px1, py1) * wy) * wx;
+	}
+
+	/**
+	 *	Marches along a ray from the core in steps of one cell, and refines the threshold crossing by bisection.
+	 *
+	 *	@param dir Direction of the ray in domain space, normalized.
+	 *
+	 *	@return The distance from the core to the crossing in domain units. If the ray leaves the bounds first, 
+	 *			the distance to the boundary is returned.
+	 */
+	template <class TGrid>
+	float _castRay(const TGrid &grid, int nMinX, int nMinY, int nMaxX, int nMaxY, float fCellX, float fCellY, 
+				   const CVector2D &posCore, const CVector2D &dir, float fEnd) const
+	{
+		const CVector2D dirGrid(dir.x / fCellX, dir.y / fCellY);
+		const float fStep	= (fCellX < fCellY)? fCellX : fCellY;
+		const int nMaxSteps = (nMaxX - nMinX) + (nMaxY - nMinY) + 2;
+
+		float t0 = 0.0f, t1 = fStep;
+		int k = 1;
+
+		for (; k <= nMaxSteps; k++, t0 = t1, t1 += fStep) {
+			if (!_insideVortex(grid, nMinX, nMinY, nMaxX, nMaxY, posCore + dirGrid * t1, fEnd)) break;
+		}
+
+		if (k > nMaxSteps) return t0;
+
+		for (int i = 0; i < m_nNumBisections; i++)
+		{
+			const float t = 0.5f * (t0 + t1);
+
+			if (_insideVortex(grid, nMinX, nMinY, nMaxX, nMaxY, posCore + dirGrid * t, fEnd))
+				t0 = t;
+			else
+				t1 = t;
+		}
+
+		return 0.5f * (t0 + t1);
+	}
+
+	template <class TGrid>
+	__inline static bool _insideVortex(const TGrid &grid, int nMinX, int nMinY, int nMaxX, int nMaxY, const CVector2D &pos, float fEnd) {
+		return	pos.x >= nMinX && pos.y >= nMinY && pos.x <= nMaxX && pos.y <= nMaxY 
+			&&	_getValue(grid, nMinX, nMinY, nMaxX, nMaxY, pos.x, pos.y) >= fEnd;
+	}
+
+	/**
+	 *	Returns the direction of the major axis in radians, given the Hessian (xx, xy, yy) in grid space.
+	 */
+	static float _getMajorAxis(const float *hessian, float fCellX, float fCellY);
+
+	/**
+	 *	Fits an ellipse centred at the origin to the crossings by linear least squares.
+	 *
+	 *	@return Returns false, if the crossings do not describe an ellipse.
+	 */
+	static bool _fitEllipse(const vector<CVector2D> &crossings, VortexExtent &extent);
+};
@@ -0,0 +1,336 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "StdAfx.h"
+#include "VorticityCache.h"
+#include <math.h>
+
+#define VTC_TILE_SIZE	32
+#define VTC_MAX_TILES	16384
+
+CVorticityWindow::CVorticityWindow()
+{
+	m_pCache		= nullptr;
+	m_nFrame		= 0;
+	m_bMagnitude	= false;
+	m_nMinX = m_nMinY = m_nMaxX = m_nMaxY = 0;
+	m_nSamplesX = m_nSamplesY = 0;
+	m_nTileX0 = m_nTileY0 = m_nTilesX = 0;
+}
+
+float CVorticityWindow::_sample(int x, int y) const
+{
+	const int nTileSize = m_pCache->m_nTileSize;
+	const int tx		= x / nTileSize;
+	const int ty		= y / nTileSize;
+
+	shared_ptr< vector<float> > &pTile = m_Tiles[(ty - m_nTileY0) * m_nTilesX + (tx - m_nTileX0)];
+
+	if (!pTile) {
+		pTile = m_pCache->_getTile(m_nFrame, tx, ty);
+	}
+
+	const float val = (*pTile)[(y - ty * nTileSize) * nTileSize + (x - tx * nTileSize)];
+
+	return (m_bMagnitude)? fabs(val) : val;
+}
+
+float CVorticityWindow::_getValue(float x, float y) const
+{
+	x = min( max(x, static_cast<float>(m_nMinX)), static_cast<float>(m_nMaxX) );
+	y = min( max(y, static_cast<float>(m_nMinY)), static_cast<float>(m_nMaxY) );
+
+	const int px	= static_cast<int>(x);
+	const int py	= static_cast<int>(y);
+	const int px1	= min(px + 1, m_nMaxX);
+	const int py1	= min(py + 1, m_nMaxY);
+	const float wx	= x - px;
+	const float wy	= y - py;
+
+	return	(_sample(px, py) * (1.0f - wy) + _sample(px, py1) * wy) * (1.0f - wx) 
+		+	(_sample(px1, py) * (1.0f - wy) + _sample(px1, py1) * wy) * wx;
+}
+
+CVector2D CVorticityWindow::_getDerivative(float x, float y) const
+{
+	const float step	= 0.5f;
+	const float div		= 2.0f * step;
+
+	return CVector2D( (_getValue(x + step, y) - _getValue(x - step, y)) / div, (_getValue(x, y + step) - _getValue(x, y - step)) / div );
+}
+
+float CVorticityWindow::GetValue(float dx, float dy) const
+{
+	const float x = (dx - m_rcField.m_Min.x) / m_rcField.getWidth() * (m_nSamplesX - 1);
+	const float y = (dy - m_rcField.m_Min.y) / m_rcField.getHeight() * (m_nSamplesY - 1);
+
+	return _getValue(x, y);
+}
+
+float CVorticityWindow::GetValue(const CPointf &posD) const
+{
+	return GetValue(posD.x, posD.y);
+}
+
+CVector2D CVorticityWindow::GetGradient(float dx, float dy) const
+{
+	const float x = (dx - m_rcField.m_Min.x) / m_rcField.getWidth() * (m_nSamplesX - 1);
+	const float y = (dy - m_rcField.m_Min.y) / m_rcField.getHeight() * (m_nSamplesY - 1);
+
+	return _getDerivative(x, y);
+}
+
+bool CVorticityWindow::InsideDomain(const CVector2D &posD) const
+{
+	return	posD.x >= m_rcDomain.m_Min.x && posD.y >= m_rcDomain.m_Min.y 
+		&&	posD.x <= m_rcDomain.m_Max.x && posD.y <= m_rcDomain.m_Max.y;
+}
+
+bool CVorticityWindow::GradientAscent(const CPointf &ptStart, CPointf &ptEnd, int *pNumIterations) const
+{
+	CVector2D pos(_getGridCoordinates(ptStart));
+
+	CLocalMaximumSearch search;
+
+	if (!m_pCache || !search.Search(*this, m_nMinX, m_nMinY, m_nMaxX, m_nMaxY, pos, pNumIterations)) {
+		ptEnd.x = -1;
+		ptEnd.y = -1;
+		return false;
+	}
+
+	ptEnd.x = m_rcField.m_Min.x + pos.x / (m_nSamplesX - 1) * m_rcField.getWidth();
+	ptEnd.y = m_rcField.m_Min.y + pos.y / (m_nSamplesY - 1) * m_rcField.getHeight();
+
+	return true;
+}
+
+size_t CVorticityWindow::GradientAscent(const vector<CPointf> &ptStart, vector<CPointf> &ptEnd, vector<int> *pNumIterations)
+{
+	const int nNumPoints = static_cast<int>(ptStart.size());
+	size_t nNumFound = 0;
+
+	ptEnd.resize(nNumPoints);
+	if (pNumIterations) pNumIterations->resize(nNumPoints);
+
+	//The cache is not thread-safe, so the tiles must not be requested by the searches
+	_requestAllTiles();
+
+	#pragma omp parallel for reduction(+:nNumFound) schedule(dynamic, 16)
+	for (int i = 0; i < nNumPoints; i++) {
+		if (GradientAscent(ptStart[i], ptEnd[i], (pNumIterations)? &(*pNumIterations)[i] : nullptr))
+			nNumFound++;
+	}
+
+	return nNumFound;
+}
+
+bool CVorticityWindow::FollowMaximum(const CPointf &ptStart, CPointf &ptEnd) const
+{
+	CVector2D pos(_getGridCoordinates(ptStart));
+
+	CLocalMaximumSearch search;
+	CLocalMaximumSearch::SEARCH_RESULT nResult(CLocalMaximumSearch::LEFT_BOUNDS);
+
+	if (m_pCache) {
+		search.Search(*this, m_nMinX, m_nMinY, m_nMaxX, m_nMaxY, pos, nullptr, &nResult);
+	}
+
+	if (nResult == CLocalMaximumSearch::LEFT_BOUNDS) {
+		ptEnd.x = -1;
+		ptEnd.y = -1;
+		return false;
+	}
+
+	ptEnd.x = m_rcField.m_Min.x + pos.x / (m_nSamplesX - 1) * m_rcField.getWidth();
+	ptEnd.y = m_rcField.m_Min.y + pos.y / (m_nSamplesY - 1) * m_rcField.getHeight();
+
+	return true;
+}
+
+bool CVorticityWindow::MeasureVortex(const CVortexMeasure &measure, const CPointf &ptCore, float fThreshold, VortexExtent &extent) const
+{
+	const float fCellX = m_rcField.getWidth() / (m_nSamplesX - 1);
+	const float fCellY = m_rcField.getHeight() / (m_nSamplesY - 1);
+
+	if (!m_pCache) {
+		extent.bValid = false;
+		return false;
+	}
+
+	return measure.Measure(*this, m_nMinX, m_nMinY, m_nMaxX, m_nMaxY, fCellX, fCellY, _getGridCoordinates(ptCore), fThreshold, extent);
+}
+
+size_t CVorticityWindow::MeasureVortices(const CVortexMeasure &measure, const vector<CPointf> &ptCores, float fThreshold, vector<VortexExtent> &extents)
+{
+	const float fCellX = m_rcField.getWidth() / (m_nSamplesX - 1);
+	const float fCellY = m_rcField.getHeight() / (m_nSamplesY - 1);
+
+	if (!m_pCache) {
+		const VortexExtent invalid = { 0.0f, 0.0f, 0.0f, false };
+		extents.assign(ptCores.size(), invalid);
+		return 0;
+	}
+
+	vector<CVector2D> posCores(ptCores.size());
+
+	for (size_t i = 0; i < ptCores.size(); i++)
+		posCores[i] = _getGridCoordinates(ptCores[i]);
+
+	_requestAllTiles();
+
+	return measure.Measure(*this, m_nMinX, m_nMinY, m_nMaxX, m_nMaxY, fCellX, fCellY, posCores, fThreshold, extents);
+}
+
+CVector2D CVorticityWindow::_getGridCoordinates(const CPointf &posD) const
+{
+	return CVector2D( (posD.x - m_rcField.m_Min.x) / m_rcField.getWidth() * (m_nSamplesX - 1),
+					  (posD.y - m_rcField.m_Min.y) / m_rcField.getHeight() * (m_nSamplesY - 1) );
+}
+
+void CVorticityWindow::_requestAllTiles() const
+{
+	if (!m_pCache) return;
+
+	const int nTilesY = static_cast<int>(m_Tiles.size()) / max(m_nTilesX, 1);
+
+	for (int ty = 0; ty < nTilesY; ty++)
+		for (int tx = 0; tx < m_nTilesX; tx++)
+			if (!m_Tiles[ty * m_nTilesX + tx])
+				m_Tiles[ty * m_nTilesX + tx] = m_pCache->_getTile(m_nFrame, m_nTileX0 + tx, m_nTileY0 + ty);
+}
+
+CVorticityCache::CVorticityCache()
+{
+	m_pVecField		= nullptr;
+	m_nTileSize		= VTC_TILE_SIZE;
+	m_nMaxTiles		= VTC_MAX_TILES;
+	m_nNumComputed	= 0;
+}
+
+CVorticityCache::~CVorticityCache()
+{
+}
+
+void CVorticityCache::Init(const CAmiraVectorField2D *pVecField)
+{
+	if (m_pVecField == pVecField) return;
+
+	Clear();
+	m_pVecField = pVecField;
+}
+
+void CVorticityCache::Clear()
+{
+	m_LRU.clear();
+	m_Index.clear();
+	m_nNumComputed = 0;
+}
+
+void CVorticityCache::SetMaxTiles(size_t nMaxTiles)
+{
+	m_nMaxTiles = max(nMaxTiles, size_t(1));
+
+	while (m_LRU.size() > m_nMaxTiles) 
+	{
+		m_Index.erase(m_LRU.back().key);
+		m_LRU.pop_back();
+	}
+}
+
+shared_ptr< vector<float> > CVorticityCache::_getTile(int nFrame, int tx, int ty)
+{
+	const long long key = _key(nFrame, tx, ty);
+	auto iter = m_Index.find(key);
+
+	if (iter != m_Index.end()) 
+	{
+		//Move to the front of the LRU list
+		m_LRU.splice(m_LRU.begin(), m_LRU, iter->second);
+		return m_LRU.front().data;
+	}
+
+	const int nx		= static_cast<int>(m_pVecField->GetExtentX());
+	const int ny		= static_cast<int>(m_pVecField->GetExtentY());
+	const int nMinX		= tx * m_nTileSize;
+	const int nMinY		= ty * m_nTileSize;
+
+	Tile tile;
+	tile.key	= key;
+	tile.data	= shared_ptr< vector<float> >( new vector<float>(m_nTileSize * m_nTileSize, 0.0f) );
+
+	m_pVecField->GetVorticity(nFrame, nMinX, nMinY, min(m_nTileSize, nx - nMinX), min(m_nTileSize, ny - nMinY), &(*tile.data)[0], m_nTileSize);
+	m_nNumComputed++;
+
+	m_LRU.push_front(tile);
+	m_Index[key] = m_LRU.begin();
+
+	if (m_LRU.size() > m_nMaxTiles) 
+	{
+		m_Index.erase(m_LRU.back().key);
+		m_LRU.pop_back();
+	}
+
+	return m_LRU.front().data;
+}
+
+CVorticityWindow CVorticityCache::GetWindow(const CRectF &rect, int nFrame, bool bGetMagnitude)
+{
+	CVorticityWindow window;
+
+	if (!m_pVecField) return window;
+
+	const CRectF rcField	= m_pVecField->GetDomainRect();
+	const int nx			= static_cast<int>(m_pVecField->GetExtentX());
+	const int ny			= static_cast<int>(m_pVecField->GetExtentY());
+
+	//Closest samples, clamped to the grid
+	const CPointf ptMin = m_pVecField->GetClosestSamplePos( CPointf::fromVector2D(rect.m_Min) );
+	const CPointf ptMax = m_pVecField->GetClosestSamplePos( CPointf::fromVector2D(rect.m_Max) );
+
+	window.m_pCache		= this;
+	window.m_nFrame		= nFrame;
+	window.m_bMagnitude	= bGetMagnitude;
+	window.m_rcField	= rcField;
+	window.m_nSamplesX	= nx;
+	window.m_nSamplesY	= ny;
+	window.m_nMinX		= min( max(static_cast<int>(ptMin.x), 0), nx - 1 );
+	window.m_nMinY		= min( max(static_cast<int>(ptMin.y), 0), ny - 1 );
+	window.m_nMaxX		= min( max(static_cast<int>(ptMax.x), window.m_nMinX), nx - 1 );
+	window.m_nMaxY		= min( max(static_cast<int>(ptMax.y), window.m_nMinY), ny - 1 );
+
+	window.m_rcDomain.m_Min = CPointf::toVector2D( m_pVecField->GetDomainCoordinates(static_cast<float>(window.m_nMinX), static_cast<float>(window.m_nMinY)) );
+	window.m_rcDomain.m_Max = CPointf::toVector2D( m_pVecField->GetDomainCoordinates(static_cast<float>(window.m_nMaxX), static_cast<float>(window.m_nMaxY)) );
+
+	window.m_nTileX0	= window.m_nMinX / m_nTileSize;
+	window.m_nTileY0	= window.m_nMinY / m_nTileSize;
+	window.m_nTilesX	= window.m_nMaxX / m_nTileSize - window.m_nTileX0 + 1;
+
+	const int nTilesY	= window.m_nMaxY / m_nTileSize - window.m_nTileY0 + 1;
+	window.m_Tiles.resize(window.m_nTilesX * nTilesY);
+
+	return window;
+}
@@ -0,0 +1,225 @@
+/*
+ *	Copyright (C) 2014, Max Planck Institut fr Informatik, Saarbrcken.
+ *	Implementation: 2014, Gebhard Stopper [ gebhard.stopper@gmail.com ]
+ *	
+ *	If you perform any changes on this file, please append your name to 
+ *	the List of people who worked on this file.
+ *
+ *	If you add or modify functions or variable, please do not forget to
+ *	add/update the doxygen documentation.
+ *
+ *	This file is part of FlowIllustrator.
+ *
+ *	FlowIllustrator is free software: you can redistribute it and/or modify
+ *	it under the terms of the GNU General Public License as published by
+ *	the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	FlowIllustrator is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with FlowIllustrator.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+#include "AmiraVectorField2D.h"
+#include "LocalMaximumSearch.h"
+#include "VortexMeasure.h"
+#include <vector>
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+using namespace std;
+
+class CVorticityCache;
+
+/**
+ *	A rectangular region of the vorticity field of a single time step, backed by the tiles of a CVorticityCache.
+ *	
+ *	The interface matches the parts of CScalarField2D, that are used to locate and measure vortices. 
+ *	Tiles are requested from the cache on first access and are shared, not copied. A CVorticityWindow 
+ *	keeps its tiles alive, even if the cache evicts them, but must not outlive the cache itself.
+ */
+class CVorticityWindow
+{
+	friend class CVorticityCache;
+
+protected:
+	CVorticityCache		*m_pCache;		/**< The cache, that provides the tiles. */
+	int					 m_nFrame;		/**< Time step of the vorticity field. */
+	bool				 m_bMagnitude;	/**< If true, the vorticity magnitude is returned. */
+	int					 m_nMinX;		/**< First column of the window in grid space of the vector field. */
+	int					 m_nMinY;		/**< First row of the window in grid space of the vector field. */
+	int					 m_nMaxX;		/**< Last column of the window in grid space of the vector field. */
+	int					 m_nMaxY;		/**< Last row of the window in grid space of the vector field. */
+	CRectF				 m_rcDomain;	/**< Domain of the window. */
+	CRectF				 m_rcField;		/**< Domain of the vector field. */
+	int					 m_nSamplesX;	/**< Number of samples in x-direction of the vector field. */
+	int					 m_nSamplesY;	/**< Number of samples in y-direction of the vector field. */
+	int					 m_nTileX0;		/**< Index of the first tile column, that covers the window. */
+	int					 m_nTileY0;		/**< Index of the first tile row, that covers the window. */
+	int					 m_nTilesX;		/**< Number of tile columns, that cover the window. */
+	mutable vector< shared_ptr< vector<float> > > m_Tiles;	/**< The tiles covering the window, requested on first access. */
+
+public:
+	CVorticityWindow();
+
+public:
+	/**
+	 *	Retrieve the bi-linearly interpolated vorticity at a location in domain space. 
+	 *	Locations outside the window are clamped to the window.
+	 */
+	float GetValue(float dx, float dy) const;
+	float GetValue(const CPointf &posD) const;
+
+	/**
+	 *	Retrieve the gradient at a location in domain space, measured per grid cell, like CScalarField2D::GetGradient().
+	 */
+	CVector2D GetGradient(float dx, float dy) const;
+
+	/**
+	 *	Checks, if a location in domain space lies inside the window.
+	 */
+	bool InsideDomain(const CVector2D &posD) const;
+
+	/**
+	 *	Performs gradient ascent with a CLocalMaximumSearch, like CScalarField2D::GradientAscent().
+	 *
+	 *	@param ptStart Starting location in domain space.
+	 *	@param ptEnd Receives the location of the local maximum in domain space.
+	 *	@param pNumIterations Optional pointer to an int, that receives the number of iterations.
+	 *
+	 *	@return Returns false, if the ascent left the window or did not converge.
+	 */
+	bool GradientAscent(const CPointf &ptStart, CPointf &ptEnd, int *pNumIterations = nullptr) const;
+
+	/**
+	 *	Performs gradient ascent for many start locations in parallel. All tiles of the window are requested beforehand.
+	 *
+	 *	@return The number of successful searches. Failed searches receive (-1,-1).
+	 */
+	size_t GradientAscent(const vector<CPointf> &ptStart, vector<CPointf> &ptEnd, vector<int> *pNumIterations = nullptr);
+
+	/**
+	 *	Follows a vortex core to the local maximum of the window, e.g. after the time step changed.
+	 *
+	 *	@param ptStart Previous location of the core in domain space.
+	 *	@param ptEnd Receives the new location of the core in domain space. If the search stalled or did not converge 
+	 *				 within its iterations, this is the last location the ascent reached.
+	 *
+	 *	@return Returns false only, if the ascent leaves the window, i.e. the core was lost.
+	 */
+	bool FollowMaximum(const CPointf &ptStart, CPointf &ptEnd) const;
+
+	/**
+	 *	Measures the extent of a vortex inside the window.
+	 *
+	 *	@param measure The CVortexMeasure, that performs the measurement.
+	 *	@param ptCore Location of the vortex core in domain space.
+	 *	@param fThreshold Fraction of the vorticity at the core, that bounds the vortex.
+	 *	@param extent Receives the extent of the vortex.
+	 */
+	bool MeasureVortex(const CVortexMeasure &measure, const CPointf &ptCore, float fThreshold, VortexExtent &extent) const;
+
+	/**
+	 *	Measures the extents of many vortices inside the window in parallel. All tiles of the window are requested beforehand.
+	 *
+	 *	@return The number of vortices, that were measured successfully.
+	 */
+	size_t MeasureVortices(const CVortexMeasure &measure, const vector<CPointf> &ptCores, float fThreshold, vector<VortexExtent> &extents);
+
+	/**
+	 *	Retrieve the vorticity at a grid point of the vector field, which must lie inside the window.
+	 */
+	__inline float GetAt(int x, int y) const { return _sample(x, y); }
+
+	/**
+	 *	Retrieve the domain of the window.
+	 */
+	__inline CRectF GetDomainRect() const { return m_rcDomain; }
+
+protected:
+	float _sample(int x, int y) const;
+	float _getValue(float x, float y) const;
+	CVector2D _getDerivative(float x, float y) const;
+	CVector2D _getGridCoordinates(const CPointf &posD) const;
+	void _requestAllTiles() const;
+};
+
+/**
+ *	CVorticityCache holds the vorticity of a CAmiraVectorField2D in square tiles, keyed by time step and tile.
+ *	Each tile is computed at most once while it is cached. If the number of tiles exceeds a limit, the least 
+ *	recently used tiles are evicted.
+ *
+ *	The cache is meant to be shared by all consumers of the vorticity of the same vector field, 
+ *	which retrieve rectangular regions as CVorticityWindow. It is not thread-safe.
+ */
+class CVorticityCache
+{
+	friend class CVorticityWindow;
+
+protected:
+	struct Tile
+	{
+		long long					key;	/**< Time step and position of the tile, see _key(). */
+		shared_ptr< vector<float> >	data;	/**< Vorticity of the tile, row by row with a stride of m_nTileSize. */
+	};
+
+	const CAmiraVectorField2D					*m_pVecField;	/**< The vector field. */
+	int											 m_nTileSize;	/**< Edge length of a tile in samples. */
+	size_t										 m_nMaxTiles;	/**< Maximum number of cached tiles. */
+	list<Tile>									 m_LRU;			/**< Cached tiles, the most recently used first. */
+	unordered_map< long long, list<Tile>::iterator > m_Index;	/**< Maps the key of a tile to its position in m_LRU. */
+	size_t										 m_nNumComputed;/**< Number of tiles computed since the last call to Init(). */
+
+public:
+	CVorticityCache();
+	~CVorticityCache();
+
+public:
+	/**
+	 *	Initializes the cache for the specified vector field. If the vector field changed, all cached tiles are discarded.
+	 *
+	 *	@param pVecField Pointer to the vector field.
+	 */
+	void Init(const CAmiraVectorField2D *pVecField);
+
+	/**
+	 *	Discards all cached tiles.
+	 */
+	void Clear();
+
+	/**
+	 *	Set the maximum number of cached tiles. The default is 16384 tiles of 32x32 samples, i.e. 64 MB.
+	 */
+	void SetMaxTiles(size_t nMaxTiles);
+
+	/**
+	 *	Retrieve a rectangular region of the vorticity field of a time step.
+	 *
+	 *	@param rect The region in domain space. It is clamped to the domain and extended to the closest samples.
+	 *	@param nFrame The time step.
+	 *	@param bGetMagnitude If true, the window returns the vorticity magnitude.
+	 */
+	CVorticityWindow GetWindow(const CRectF &rect, int nFrame, bool bGetMagnitude);
+
+	/**
+	 *	Retrieve the number of tiles computed since the last call to Init().
+	 */
+	__inline size_t GetNumComputedTiles() const { return m_nNumComputed; }
+
+protected:
+	__inline long long _key(int nFrame, int tx, int ty) const {
+		return (static_cast<long long>(nFrame) << 40) | (static_cast<long long>(ty) << 20) | static_cast<long long>(tx);
+	}
+
+	/**
+	 *	Retrieves a tile, and computes it if it is not cached.
+	 */
+	shared_ptr< vector<float> > _getTile(int nFrame, int tx, int ty);
+};